@@ -1,6 +1,9 @@
 #include <string.h>
+#include <math.h>
 
 #include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
 
 #include "bm1397.h"
 #include "bm1366.h"
@@ -8,74 +11,294 @@
 #include "bm1370.h"
 
 #include "asic.h"
+#include "asic_emulator.h"
 #include "device_config.h"
 #include "frequency_transition_bmXX.h"
 
+// PLL frequency the chips come out of reset with
+#define ASIC_RESET_FREQUENCY 50.0
+
 static const char *TAG = "asic";
 
-uint8_t ASIC_init(GlobalState * GLOBAL_STATE)
+#if CONFIG_ASIC_EMULATOR
+static const uint16_t EMULATED_CHIP_IDS[] = {
+    [BM1397] = 0x1397,
+    [BM1366] = 0x1366,
+    [BM1368] = 0x1368,
+    [BM1370] = 0x1370,
+};
+
+// Puts a software chain behind the chain's serial port in place of the UART
+static esp_err_t start_emulator(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
+{
+    const AsicConfig * asic = &GLOBAL_STATE->DEVICE_CONFIG.family.asic;
+
+    asic_emulator_config_t config = {
+        .chip_id = EMULATED_CHIP_IDS[asic->id],
+        .chip_count = chain->asic_count,
+        .core_count = asic->core_count,
+        .small_core_count = asic->small_core_count,
+        .hash_domains = asic->hash_domains,
+        .hashrate_ghs = CONFIG_ASIC_EMULATOR_HASHRATE_GHS,
+        .ticket_difficulty = ldexp(1.0, CONFIG_ASIC_EMULATOR_TICKET_BITS - 32),
+        .error_permille = CONFIG_ASIC_EMULATOR_ERROR_PERMILLE,
+        .latency_ms = CONFIG_ASIC_EMULATOR_LATENCY_MS,
+    };
+
+    asic_emulator_t * emulator;
+    esp_err_t err = asic_emulator_create(&config, &emulator);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    serial_stream_t stream;
+    asic_emulator_get_stream(emulator, &stream);
+    return SERIAL_attach_stream(chain->port, &stream);
+}
+#endif
+
+esp_err_t ASIC_chain_setup(GlobalState * GLOBAL_STATE)
+{
+    int chain_count = ASIC_MAX_CHAINS;
+    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
+
+    if (asic_count % chain_count != 0) {
+        ESP_LOGW(TAG, "%d chips can't be split evenly over %d chains", asic_count, chain_count);
+    }
+
+    for (int i = 0; i < chain_count; i++) {
+        asic_chain_t * chain = &GLOBAL_STATE->ASIC_CHAINS[i].chain;
+
+        chain->index = i;
+        chain->port = SERIAL_get_port(i);
+        chain->asic_count = asic_count / chain_count;
+        chain->asic_offset = i * chain->asic_count;
+        chain->frequency = ASIC_RESET_FREQUENCY;
+
+        // the last chain picks up any remainder
+        if (i == chain_count - 1) {
+            chain->asic_count = asic_count - chain->asic_offset;
+        }
+
+        chain->active_jobs = heap_caps_malloc(sizeof(_Atomic(bm_job *)) * ASIC_JOB_SLOTS, MALLOC_CAP_SPIRAM);
+        chain->job_generations = heap_caps_malloc(sizeof(_Atomic uint32_t) * ASIC_JOB_SLOTS, MALLOC_CAP_SPIRAM);
+        if (chain->active_jobs == NULL || chain->job_generations == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate job tables for chain %d", i);
+            return ESP_ERR_NO_MEM;
+        }
+        for (int j = 0; j < ASIC_JOB_SLOTS; j++) {
+            atomic_init(&chain->active_jobs[j], NULL);
+            atomic_init(&chain->job_generations[j], 0);
+        }
+        atomic_init(&chain->job_epoch, 1);
+        atomic_init(&chain->job_in_use, NULL);
+        chain->retired_job = NULL;
+        atomic_init(&chain->stale_nonces, 0);
+        atomic_init(&chain->rx_collisions, 0);
+        atomic_init(&chain->paused, false);
+        chain->idle = xSemaphoreCreateBinary();
+        if (chain->idle == NULL) {
+            ESP_LOGE(TAG, "Failed to create the idle semaphore for chain %d", i);
+            return ESP_ERR_NO_MEM;
+        }
+
+        chip_health_t * chips = heap_caps_malloc(sizeof(chip_health_t) * chain->asic_count, MALLOC_CAP_SPIRAM);
+        if (chips == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate chip health for chain %d", i);
+            return ESP_ERR_NO_MEM;
+        }
+        chain_health_init(&chain->health, chips, chain->asic_count);
+
+#if CONFIG_ASIC_EMULATOR
+        esp_err_t err = start_emulator(GLOBAL_STATE, chain);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start emulator for chain %d: %s", i, esp_err_to_name(err));
+            return err;
+        }
+#endif
+
+        GLOBAL_STATE->ASIC_CHAINS[i].global_state = GLOBAL_STATE;
+    }
+
+    GLOBAL_STATE->asic_chain_count = chain_count;
+
+    return ESP_OK;
+}
+
+void ASIC_chain_reset(asic_chain_t * chain)
+{
+    chain->frequency = ASIC_RESET_FREQUENCY;
+    chain->chip_count = 0;
+    // a power cycle gives bypassed chips another chance
+    chain_health_clear(&chain->health);
+    atomic_store(&chain->paused, false);
+}
+
+static void init_register_poll(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
+{
+    register_poll_init(&chain->register_poll, chain->asic_count);
+
+    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
+        case BM1397:
+            BM1397_init_register_poll(chain);
+            break;
+        case BM1366:
+            BM1366_init_register_poll(chain);
+            break;
+        case BM1368:
+            BM1368_init_register_poll(chain);
+            break;
+        case BM1370:
+            BM1370_init_register_poll(chain);
+            break;
+    }
+
+    for (uint16_t asic_nr = 0; asic_nr < chain->asic_count; asic_nr++) {
+        if (chain_health_is_bypassed(&chain->health, asic_nr)) {
+            register_poll_skip(&chain->register_poll, asic_nr, true);
+        }
+    }
+
+    // chips past a break in the chain never see the read
+    if (chain->chip_count > 0 && chain->chip_count < chain->asic_count) {
+        ESP_LOGW(TAG, "Not polling chips %d-%d on chain %d", chain->chip_count, chain->asic_count - 1, chain->index);
+        for (uint16_t asic_nr = chain->chip_count; asic_nr < chain->asic_count; asic_nr++) {
+            register_poll_skip(&chain->register_poll, asic_nr, true);
+        }
+    }
+
+    register_poll_start(&chain->register_poll, esp_timer_get_time());
+}
+
+uint8_t ASIC_init(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
 {
-    ESP_LOGI(TAG, "Initializing %dx %s", GLOBAL_STATE->DEVICE_CONFIG.family.asic_count, GLOBAL_STATE->DEVICE_CONFIG.family.asic.name);
+    uint8_t chip_count;
+
+    ESP_LOGI(TAG, "Initializing %dx %s on chain %d", chain->asic_count, GLOBAL_STATE->DEVICE_CONFIG.family.asic.name, chain->index);
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            return BM1397_init(GLOBAL_STATE);
+            chip_count = BM1397_init(GLOBAL_STATE, chain);
+            break;
         case BM1366:
-            return BM1366_init(GLOBAL_STATE);
+            chip_count = BM1366_init(GLOBAL_STATE, chain);
+            break;
         case BM1368:
-            return BM1368_init(GLOBAL_STATE);
+            chip_count = BM1368_init(GLOBAL_STATE, chain);
+            break;
         case BM1370:
-            return BM1370_init(GLOBAL_STATE);
+            chip_count = BM1370_init(GLOBAL_STATE, chain);
+            break;
+        default:
+            ESP_LOGE(TAG, "Unknown ASIC id %d", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+            return 0;
     }
-    ESP_LOGE(TAG, "Unknown ASIC id %d", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-    return 0;
+
+    init_register_poll(GLOBAL_STATE, chain);
+    chain_health_restart(&chain->health, esp_timer_get_time());
+
+    return chip_count;
 }
 
-task_result * ASIC_process_work(GlobalState * GLOBAL_STATE)
+static void set_chain_default_baud(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            return BM1397_process_work(GLOBAL_STATE);
+            BM1397_set_default_baud(chain);
+            break;
         case BM1366:
-            return BM1366_process_work(GLOBAL_STATE);
+            BM1366_set_default_baud(chain);
+            break;
         case BM1368:
-            return BM1368_process_work(GLOBAL_STATE);
+            BM1368_set_default_baud(chain);
+            break;
         case BM1370:
-            return BM1370_process_work(GLOBAL_STATE);
+            BM1370_set_default_baud(chain);
+            break;
+    }
+}
+
+bool ASIC_pause_chain(asic_chain_t * chain)
+{
+    // a give left over from an earlier pause does not count
+    xSemaphoreTake(chain->idle, 0);
+    atomic_store(&chain->paused, true);
+
+    // the result task may be waiting on a receive that never ends early
+    return xSemaphoreTake(chain->idle, pdMS_TO_TICKS(ASIC_RECEIVE_TIMEOUT_MS + 1000)) == pdTRUE;
+}
+
+void ASIC_chain_idle(asic_chain_t * chain)
+{
+    xSemaphoreGive(chain->idle);
+}
+
+// Re-initializes the chain over the running UART, addressing it around the
+// bypassed chips, without the reset line or taking the core voltage down.
+// The chain must be paused with ASIC_pause_chain first.
+uint8_t ASIC_soft_reset_chain(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
+{
+    ESP_LOGW(TAG, "Soft resetting chain %d", chain->index);
+
+    // the init sequence talks at the power-on baud
+    set_chain_default_baud(GLOBAL_STATE, chain);
+    SERIAL_set_baud(chain->port, UART_FREQ);
+    SERIAL_clear_buffer(chain->port);
+
+    uint8_t chip_count = ASIC_init(GLOBAL_STATE, chain);
+    if (chip_count > 0) {
+        SERIAL_set_baud(chain->port, ASIC_set_max_baud(GLOBAL_STATE, chain));
+    }
+    SERIAL_clear_buffer(chain->port);
+
+    return chip_count;
+}
+
+task_result * ASIC_process_work(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
+{
+    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
+        case BM1397:
+            return BM1397_process_work(chain);
+        case BM1366:
+            return BM1366_process_work(chain);
+        case BM1368:
+            return BM1368_process_work(chain);
+        case BM1370:
+            return BM1370_process_work(chain);
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d — cannot process work", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
     return NULL;
 }
 
-int ASIC_set_max_baud(GlobalState * GLOBAL_STATE)
+int ASIC_set_max_baud(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            return BM1397_set_max_baud();
+            return BM1397_set_max_baud(chain);
         case BM1366:
-            return BM1366_set_max_baud();
+            return BM1366_set_max_baud(chain);
         case BM1368:
-            return BM1368_set_max_baud();
+            return BM1368_set_max_baud(chain);
         case BM1370:
-            return BM1370_set_max_baud();
+            return BM1370_set_max_baud(chain);
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set max baud", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
     return 0;
 }
 
-void ASIC_send_work(GlobalState * GLOBAL_STATE, void * next_job)
+void ASIC_send_work(GlobalState * GLOBAL_STATE, asic_chain_t * chain, void * next_job)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            BM1397_send_work(GLOBAL_STATE, next_job);
+            BM1397_send_work(chain, next_job);
             break;
         case BM1366:
-            BM1366_send_work(GLOBAL_STATE, next_job);
+            BM1366_send_work(chain, next_job);
             break;
         case BM1368:
-            BM1368_send_work(GLOBAL_STATE, next_job);
+            BM1368_send_work(chain, next_job);
             break;
         case BM1370:
-            BM1370_send_work(GLOBAL_STATE, next_job);
+            BM1370_send_work(chain, next_job);
             break;
         default:
             ESP_LOGE(TAG, "Unknown ASIC id %d — cannot send work", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
@@ -83,20 +306,20 @@ void ASIC_send_work(GlobalState * GLOBAL_STATE, void * next_job)
     }
 }
 
-void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask)
+static void set_chain_version_mask(GlobalState * GLOBAL_STATE, asic_chain_t * chain, uint32_t mask)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            BM1397_set_version_mask(mask);
+            BM1397_set_version_mask(chain, mask);
             break;
         case BM1366:
-            BM1366_set_version_mask(mask);
+            BM1366_set_version_mask(chain, mask);
             break;
         case BM1368:
-            BM1368_set_version_mask(mask);
+            BM1368_set_version_mask(chain, mask);
             break;
         case BM1370:
-            BM1370_set_version_mask(mask);
+            BM1370_set_version_mask(chain, mask);
             break;
         default:
             ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set version mask", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
@@ -104,86 +327,147 @@ void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask)
     }
 }
 
-void ASIC_set_frequency(GlobalState * GLOBAL_STATE)
+void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask)
+{
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        set_chain_version_mask(GLOBAL_STATE, &GLOBAL_STATE->ASIC_CHAINS[i].chain, mask);
+    }
+}
+
+static void set_chain_frequency(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            do_frequency_transition(GLOBAL_STATE, BM1397_send_hash_frequency);
+            do_frequency_transition(GLOBAL_STATE, chain, BM1397_send_hash_frequency);
             return;
         case BM1366:
-            do_frequency_transition(GLOBAL_STATE, BM1366_send_hash_frequency);
+            do_frequency_transition(GLOBAL_STATE, chain, BM1366_send_hash_frequency);
             return;
         case BM1368:
-            do_frequency_transition(GLOBAL_STATE, BM1368_send_hash_frequency);
+            do_frequency_transition(GLOBAL_STATE, chain, BM1368_send_hash_frequency);
             return;
         case BM1370:
-            do_frequency_transition(GLOBAL_STATE, BM1370_send_hash_frequency);
+            do_frequency_transition(GLOBAL_STATE, chain, BM1370_send_hash_frequency);
             return;
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set frequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
 }
 
-void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE)
+void ASIC_set_frequency(GlobalState * GLOBAL_STATE)
+{
+    // Chains are ramped one after the other so they never step the core rail at the same time
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        set_chain_frequency(GLOBAL_STATE, &GLOBAL_STATE->ASIC_CHAINS[i].chain);
+    }
+}
+
+static void set_chain_nonce_space(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
 {
     float nonce_percent = 1.0;
     int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
-    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
+    int asic_count = chain->live_count;
+    float frequency = chain->frequency;
 
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
             return;
         case BM1366:
-            BM1366_set_nonce_space(nonce_percent, frequency, asic_count, cores);
+            BM1366_set_nonce_space(chain, nonce_percent, frequency, asic_count, cores);
             return;
         case BM1368:
-            BM1368_set_nonce_space(nonce_percent, frequency, asic_count, cores);
+            BM1368_set_nonce_space(chain, nonce_percent, frequency, asic_count, cores);
             return;
         case BM1370:
-            BM1370_set_nonce_space(nonce_percent, frequency, asic_count, cores);
+            BM1370_set_nonce_space(chain, nonce_percent, frequency, asic_count, cores);
             return;
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set nonce space", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
 }
 
-double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE)
+void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE)
 {
-    float freq = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
-    int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
-    int small_cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.small_core_count;
-    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    int asic_default_timeout_divided = GLOBAL_STATE->DEVICE_CONFIG.family.asic.default_asic_timeout / _next_power_of_two(asic_count);
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        set_chain_nonce_space(GLOBAL_STATE, &GLOBAL_STATE->ASIC_CHAINS[i].chain);
+    }
+}
 
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
+double ASIC_get_chain_job_frequency_ms(GlobalState * GLOBAL_STATE, asic_chain_t * chain)
+{
+    const AsicConfig * asic = &GLOBAL_STATE->DEVICE_CONFIG.family.asic;
+    asic_job_timing_t timing = {
+        .default_timeout_ms = asic->default_asic_timeout,
+        .frequency_mhz = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value,
+        .cores = asic->core_count,
+        .small_cores = asic->small_core_count,
+    };
+
+    switch (asic->id) {
         case BM1397:
             // no version-rolling so same Nonce Space is splitted between Big Cores
-            return calculate_bm_timeout_ms(freq, asic_count, small_cores, cores, 4, 1.0, asic_default_timeout_divided);
+            timing.split_between_cores = true;
+            return asic_chain_job_interval_ms(chain, &timing);
         case BM1366:
         case BM1368:
         case BM1370:
-            return asic_default_timeout_divided;
+            return asic_chain_job_interval_ms(chain, &timing);
     }
-    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot compute job frequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot compute job frequency", asic->id);
     return 500;
 }
 
-void ASIC_read_registers(GlobalState * GLOBAL_STATE)
+double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE)
+{
+    // the chain with the most chips hashing runs out of work first
+    double shortest_ms = ASIC_get_chain_job_frequency_ms(GLOBAL_STATE, &GLOBAL_STATE->ASIC_CHAINS[0].chain);
+    for (int i = 1; i < GLOBAL_STATE->asic_chain_count; i++) {
+        double interval_ms = ASIC_get_chain_job_frequency_ms(GLOBAL_STATE, &GLOBAL_STATE->ASIC_CHAINS[i].chain);
+        if (interval_ms < shortest_ms) {
+            shortest_ms = interval_ms;
+        }
+    }
+    return shortest_ms;
+}
+
+static void read_chain_register(GlobalState * GLOBAL_STATE, asic_chain_t * chain, uint16_t asic_nr, uint8_t reg)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            BM1397_read_registers();
+            BM1397_read_register(chain, asic_nr, reg);
             break;
         case BM1366:
-            BM1366_read_registers();
+            BM1366_read_register(chain, asic_nr, reg);
             break;
         case BM1368:
-            BM1368_read_registers();
+            BM1368_read_register(chain, asic_nr, reg);
             break;
         case BM1370:
-            BM1370_read_registers();
+            BM1370_read_register(chain, asic_nr, reg);
             break;
         default:
             ESP_LOGE(TAG, "Unknown ASIC id %d — cannot read registers", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
             break;
     }
 }
+
+int64_t ASIC_poll_registers(GlobalState * GLOBAL_STATE, int64_t now_us)
+{
+    int64_t next_due_us = 0;
+
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        asic_chain_t * chain = &GLOBAL_STATE->ASIC_CHAINS[i].chain;
+        if (atomic_load(&chain->paused)) continue;
+
+        uint8_t reg;
+        uint16_t asic_nr;
+        while (register_poll_next(&chain->register_poll, now_us, &reg, &asic_nr)) {
+            read_chain_register(GLOBAL_STATE, chain, asic_nr, reg);
+        }
+
+        int64_t due_us = register_poll_next_due_us(&chain->register_poll);
+        if (due_us != 0 && (next_due_us == 0 || due_us < next_due_us)) {
+            next_due_us = due_us;
+        }
+    }
+
+    return next_due_us;
+}
@@ -52,13 +52,13 @@ int _next_power_of_two(int num)
     return power;
 }
 
-int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response_length)
+int count_asic_chips(asic_chain_t * chain, uint16_t chip_id, int chip_id_response_length)
 {
     uint8_t buffer[11] = {0};
 
     int chip_counter = 0;
     while (true) {
-        int received = SERIAL_rx(buffer, chip_id_response_length, 1000);
+        int received = SERIAL_rx(chain->port, buffer, chip_id_response_length, 1000);
         if (received == 0) break;
 
         if (received == -1) {
@@ -97,16 +97,82 @@ int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response
         chip_counter++;
     }    
     
-    if (chip_counter != asic_count) {
-        ESP_LOGW(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
+    if (chip_counter != chain->asic_count) {
+        ESP_LOGW(TAG, "%i chip(s) detected on chain %d, expected %i", chip_counter, chain->index, chain->asic_count);
     }
 
+    chain->chip_count = chip_counter;
+
     return chip_counter;
 }
 
-esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us)
+uint32_t register_poll_period_ms(register_type_t register_type)
 {
-    int received = SERIAL_rx(buffer, buffer_size, 10000);
+    switch (register_type) {
+        case REGISTER_HASHRATE:
+        case REGISTER_TOTAL_COUNT:
+            return REGISTER_POLL_COUNTER_MS;
+        default:
+            return REGISTER_POLL_DETAIL_MS;
+    }
+}
+
+// Splits the address space, and with it the nonce space, evenly over the
+// chips that hash. Bypassed chips are all parked on the address past the
+// last of them, so whatever they still send is kept apart.
+void asic_assign_addresses(asic_chain_t * chain, uint16_t chip_count)
+{
+    if (chip_count > ASIC_CHAIN_MAX_CHIPS) chip_count = ASIC_CHAIN_MAX_CHIPS;
+    if (chip_count == 0) return;
+
+    uint16_t live = 0;
+    chain->parked_position = 0;
+    for (uint16_t pos = 0; pos < chip_count; pos++) {
+        if (!chain_health_is_bypassed(&chain->health, pos)) {
+            chain->live_positions[live++] = pos;
+        } else if (chain->parked_position == 0) {
+            chain->parked_position = pos;
+        }
+    }
+
+    // nothing left to bypass to
+    if (live == 0) {
+        for (uint16_t pos = 0; pos < chip_count; pos++) {
+            chain->live_positions[pos] = pos;
+        }
+        live = chip_count;
+    }
+
+    bool parked = live < chip_count;
+    chain->live_count = live;
+    chain->address_interval = 256 / (live + parked);
+
+    uint16_t n = 0;
+    for (uint16_t pos = 0; pos < chip_count; pos++) {
+        if (n < live && chain->live_positions[n] == pos) {
+            chain->chip_addresses[pos] = n++ * chain->address_interval;
+        } else {
+            chain->chip_addresses[pos] = live * chain->address_interval;
+        }
+    }
+}
+
+uint8_t asic_chip_address(const asic_chain_t * chain, uint16_t asic_nr)
+{
+    return asic_nr < ASIC_CHAIN_MAX_CHIPS ? chain->chip_addresses[asic_nr] : 0;
+}
+
+uint16_t asic_chip_from_address(const asic_chain_t * chain, uint8_t address)
+{
+    if (chain->address_interval == 0) return 0;
+
+    uint16_t n = address / chain->address_interval;
+    return n < chain->live_count ? chain->live_positions[n] : chain->parked_position;
+}
+
+esp_err_t receive_work(asic_chain_t * chain, uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us)
+{
+    int received = SERIAL_rx(chain->port, buffer, buffer_size, ASIC_RECEIVE_TIMEOUT_MS);
     if (out_timestamp_us) {
         *out_timestamp_us = esp_timer_get_time();
     }
@@ -123,23 +189,26 @@ esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestam
 
     if (received != buffer_size) {
         ESP_LOGE(TAG, "Invalid response length %i", received);
+        atomic_fetch_add_explicit(&chain->rx_collisions, 1, memory_order_relaxed);
         ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
+        SERIAL_clear_buffer(chain->port);
         return ESP_FAIL;
     }
 
     uint16_t received_preamble = (buffer[0] << 8) | buffer[1];
     if (received_preamble != PREAMBLE) {
         ESP_LOGE(TAG, "Preamble mismatch: got 0x%04x, expected 0x%04x", received_preamble, PREAMBLE);
+        atomic_fetch_add_explicit(&chain->rx_collisions, 1, memory_order_relaxed);
         ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
+        SERIAL_clear_buffer(chain->port);
         return ESP_FAIL;
     }
 
     if (crc5(buffer + 2, buffer_size - 2) != 0) {
         ESP_LOGE(TAG, "Checksum failed on response");        
+        atomic_fetch_add_explicit(&chain->rx_collisions, 1, memory_order_relaxed);
         ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
+        SERIAL_clear_buffer(chain->port);
         return ESP_FAIL;
     }
 
@@ -175,6 +244,86 @@ void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask)
     job_difficulty_mask[5] = _reverse_bits( mask        & 0xFF);
 }
 
+// Called from the chain's dispatch task only
+void store_asic_job(asic_chain_t * chain, uint8_t job_id, bm_job * job)
+{
+    // take the slot out of service while the job is swapped
+    atomic_store(&chain->job_generations[job_id], 0);
+    bm_job * old_job = atomic_exchange(&chain->active_jobs[job_id], job);
+
+    // seq_cst against the publish in get_asic_job: either the reader sees the
+    // new job in the slot or this sees the old one in use
+    bm_job * in_use = atomic_load(&chain->job_in_use);
+    if (chain->retired_job != NULL && chain->retired_job != in_use) {
+        free_bm_job(chain->retired_job);
+        chain->retired_job = NULL;
+    }
+    if (old_job != NULL) {
+        if (old_job == in_use) {
+            // retired_job was freed above, only one job is in use at a time
+            chain->retired_job = old_job;
+        } else {
+            free_bm_job(old_job);
+        }
+    }
+
+    uint32_t epoch = job->epoch != 0 ? job->epoch : atomic_load(&chain->job_epoch);
+    atomic_store_explicit(&chain->job_generations[job_id], epoch, memory_order_release);
+}
+
+// Called from the chain's result task only. The job stays valid until its next call.
+bm_job * get_asic_job(asic_chain_t * chain, uint8_t job_id)
+{
+    if (job_id >= ASIC_JOB_SLOTS) {
+        return NULL;
+    }
+
+    uint32_t generation = atomic_load(&chain->job_generations[job_id]);
+    if (generation == 0) {
+        return NULL;
+    }
+
+    // publish the job, then make sure it is still the one in the slot: a
+    // store that replaced it in between may already have freed it
+    bm_job * job = atomic_load(&chain->active_jobs[job_id]);
+    atomic_store(&chain->job_in_use, job);
+    if (atomic_load(&chain->active_jobs[job_id]) != job || atomic_load(&chain->job_generations[job_id]) != generation) {
+        // the nonce belongs to the job that was replaced
+        atomic_fetch_add_explicit(&chain->stale_nonces, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    if (generation != atomic_load_explicit(&chain->job_epoch, memory_order_acquire)) {
+        atomic_fetch_add_explicit(&chain->stale_nonces, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    return job;
+}
+
+void invalidate_asic_jobs(asic_chain_t * chain)
+{
+    atomic_fetch_add_explicit(&chain->job_epoch, 1, memory_order_acq_rel);
+}
+
+/// @brief chips of the chain that hash, the expected count until the chain was enumerated
+uint16_t asic_chain_hashing_chips(const asic_chain_t * chain)
+{
+    return chain->live_count != 0 ? chain->live_count : chain->asic_count;
+}
+
+/// @brief how often a chain needs a new job, its chips split the nonce space between them
+double asic_chain_job_interval_ms(const asic_chain_t * chain, const asic_job_timing_t * timing)
+{
+    int asic_count = asic_chain_hashing_chips(chain);
+    double default_timeout_ms = timing->default_timeout_ms / _next_power_of_two(asic_count);
+
+    if (timing->split_between_cores) {
+        return calculate_bm_timeout_ms(timing->frequency_mhz, asic_count, timing->small_cores, timing->cores, 4, 1.0, default_timeout_ms);
+    }
+    return default_timeout_ms;
+}
+
 double calculate_bm_timeout_ms(float frequency_mhz, size_t asic_count, size_t small_cores, size_t cores, size_t version_size, float timeout_percent, double default_time_ms)
 {
     if (asic_count <= 0)
@@ -0,0 +1,801 @@
+#include "sdkconfig.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+
+#include "asic_emulator.h"
+#include "asic_common.h"
+#include "bm1370.h"
+#include "bm1397.h"
+#include "crc.h"
+#include "mining.h"
+#include "utils.h"
+
+// Power model reference point and how fast errors grow past the clean frequency
+#define MODEL_REFERENCE_MHZ 500.0f
+#define MODEL_REFERENCE_V 1.2f
+#define MODEL_ERROR_SLOPE 4.0f
+
+void asic_emulator_model(const asic_emulator_power_model_t * model, uint16_t chip_count,
+                         float frequency_mhz, float core_voltage_mv, asic_emulator_operating_point_t * point)
+{
+    float volts = core_voltage_mv / 1000.0f;
+    float per_chip = model->static_w + model->dynamic_w * (frequency_mhz / MODEL_REFERENCE_MHZ)
+                                     * (volts * volts) / (MODEL_REFERENCE_V * MODEL_REFERENCE_V);
+
+    point->power_w = per_chip * chip_count;
+    point->temp_c = model->ambient_c + model->thermal_c_per_w * point->power_w;
+
+    float clean_mhz = (core_voltage_mv - model->threshold_mv) * model->mhz_per_mv;
+    if (clean_mhz <= 0) {
+        point->error_fraction = 1.0f;
+    } else if (frequency_mhz <= clean_mhz) {
+        point->error_fraction = 0;
+    } else {
+        float error_fraction = (frequency_mhz / clean_mhz - 1.0f) * MODEL_ERROR_SLOPE;
+        point->error_fraction = error_fraction < 1.0f ? error_fraction : 1.0f;
+    }
+}
+
+#define TYPE_JOB 0x20
+#define GROUP_ALL 0x10
+
+#define CMD_SETADDRESS 0x00
+#define CMD_WRITE 0x01
+#define CMD_READ 0x02
+#define CMD_INACTIVE 0x03
+
+#define REG_CHIP_ID 0x00
+#define REG_HASHRATE 0x04       // BM1397
+#define REG_PLL0 0x08
+#define REG_TICKET_MASK 0x14
+#define REG_ERROR_COUNT 0x4C
+#define REG_DOMAIN_0_COUNT 0x88
+#define REG_TOTAL_COUNT 0x8C
+#define REG_VERSION_ROLLING 0xA4
+
+#define HASH_CNT_LSB 4294967296.0   // 2^32 hashes per counter tick
+#define HASHRATE_UNIT 0x100000      // BM1397 hashrate register unit
+#define RESET_FREQUENCY 50.0
+
+#define RX_BUFFER_SIZE 512
+#define MAX_FOUND 8                 // solutions waiting for the ticket rate to release them
+#define MAX_PENDING_FRAMES 64
+#define SEARCH_BATCH 1024           // hashes per receive iteration
+
+static const char * TAG = "asic_emulator";
+
+typedef struct
+{
+    uint8_t address;
+    uint32_t registers[256];
+    double hashes;
+    double error_hashes;        // bad hashes from the power model
+    uint32_t errors;
+} emu_chip_t;
+
+typedef struct
+{
+    uint8_t job_id;
+    uint8_t midstate;
+    uint8_t small_core;
+    uint32_t nonce_h;
+    uint32_t version_bits;
+} emu_solution_t;
+
+typedef struct
+{
+    uint8_t data[11];
+    uint8_t len;
+    uint8_t sent;               // bytes already handed to a short read
+    int64_t due_us;
+} emu_frame_t;
+
+struct asic_emulator
+{
+    asic_emulator_config_t config;
+
+    // the serial layer sends and receives from different tasks
+    pthread_mutex_t lock;
+    asic_emulator_stats_t stats;
+
+    float core_voltage_mv;
+
+    emu_chip_t * chips;
+    uint16_t addressed;
+    uint8_t response_len;
+
+    uint8_t rx[RX_BUFFER_SIZE];
+    size_t rx_len;
+
+    // job currently being searched
+    bool has_job;
+    uint8_t job_id;
+    uint8_t num_midstates;
+    BM1370_job job;             // BM1366/BM1368/BM1370 share this layout
+    job_packet job_1397;
+    uint8_t header[80];
+    uint32_t cursor;
+    uint32_t version_bits;
+    uint8_t midstate;
+
+    emu_solution_t found[MAX_FOUND];
+    int found_count;
+    double budget;
+    int64_t last_tick_us;
+
+    emu_frame_t pending[MAX_PENDING_FRAMES];
+    int pending_head;
+    int pending_count;
+
+    uint32_t rng;
+};
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// A BM1397 job only carries midstates, so the second block has to be
+// compressed starting from a caller supplied state
+static void sha256_transform(uint32_t state[8], const uint8_t block[64])
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static uint32_t next_random(asic_emulator_t * emu)
+{
+    emu->rng ^= emu->rng << 13;
+    emu->rng ^= emu->rng >> 17;
+    emu->rng ^= emu->rng << 5;
+    return emu->rng;
+}
+
+static uint32_t read_be32(const uint8_t * p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void write_be32(uint8_t * p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static bool is_bm1397(const asic_emulator_t * emu)
+{
+    return emu->config.chip_id == 0x1397;
+}
+
+static float chain_frequency(const asic_emulator_t * emu)
+{
+    uint32_t pll = emu->chips[0].registers[REG_PLL0];
+    uint8_t fb_divider = (pll >> 16) & 0xff;
+    uint8_t refdiv = (pll >> 8) & 0xff;
+    uint8_t postdiv1, postdiv2;
+
+    if (is_bm1397(emu)) {
+        postdiv1 = (pll >> 4) & 0x7;
+        postdiv2 = pll & 0x7;
+    } else {
+        postdiv1 = ((pll >> 4) & 0xf) + 1;
+        postdiv2 = (pll & 0xf) + 1;
+    }
+
+    if (fb_divider == 0 || refdiv == 0 || postdiv1 == 0 || postdiv2 == 0) {
+        return RESET_FREQUENCY;
+    }
+    return 25.0f * fb_divider / (refdiv * postdiv1 * postdiv2);
+}
+
+static double chain_hashrate(const asic_emulator_t * emu)
+{
+    if (emu->config.hashrate_ghs > 0) {
+        return emu->config.hashrate_ghs * 1e9;
+    }
+    return chain_frequency(emu) * 1e6 * emu->config.small_core_count * emu->config.chip_count;
+}
+
+// Difficulty the driver asked the chips to report at, see get_difficulty_mask
+static double ticket_mask_difficulty(const asic_emulator_t * emu)
+{
+    uint32_t value = emu->chips[0].registers[REG_TICKET_MASK];
+    if (value == 0) {
+        return emu->config.ticket_difficulty;
+    }
+    uint32_t mask = ((uint32_t)_reverse_bits(value >> 24) << 24) | ((uint32_t)_reverse_bits(value >> 16) << 16) |
+                    ((uint32_t)_reverse_bits(value >> 8) << 8) | _reverse_bits(value);
+    return (double)mask + 1;
+}
+
+static uint32_t version_mask(const asic_emulator_t * emu)
+{
+    if (is_bm1397(emu)) {
+        return 0;
+    }
+    return (emu->chips[0].registers[REG_VERSION_ROLLING] & 0xffff) << 13;
+}
+
+/// @brief picks the crc bits of the last byte so crc5 over the whole response is zero, like the chips do
+static void seal_response(uint8_t * response, uint8_t len, bool is_job_response, bool corrupt)
+{
+    uint8_t flags = is_job_response ? 0x80 : 0x00;
+    for (uint8_t crc = 0; crc < 32; crc++) {
+        response[len - 1] = flags | crc;
+        if (crc5(response + 2, len - 2) == 0) break;
+    }
+    if (corrupt) {
+        response[len - 1] ^= 0x01;
+    }
+}
+
+/// @return true when the response went out with a corrupted crc
+static bool queue_response(asic_emulator_t * emu, uint8_t * response, bool is_job_response, bool may_fail)
+{
+    bool corrupt = may_fail && emu->config.error_permille > 0 && (next_random(emu) % 1000) < emu->config.error_permille;
+    seal_response(response, emu->response_len, is_job_response, corrupt);
+
+    if (emu->pending_count == MAX_PENDING_FRAMES) {
+        ESP_LOGW(TAG, "Response queue full, dropping frame");
+        return false;
+    }
+
+    emu_frame_t * frame = &emu->pending[(emu->pending_head + emu->pending_count) % MAX_PENDING_FRAMES];
+    memcpy(frame->data, response, emu->response_len);
+    frame->len = emu->response_len;
+    frame->sent = 0;
+    frame->due_us = esp_timer_get_time() + (int64_t)emu->config.latency_ms * 1000;
+    emu->pending_count++;
+
+    if (is_job_response) {
+        emu->stats.nonces_sent++;
+    } else {
+        emu->stats.registers_sent++;
+    }
+    if (corrupt) {
+        emu->stats.errors_injected++;
+    }
+
+    return corrupt;
+}
+
+// Copies the responses whose latency ran out, a frame may span two reads
+static uint16_t take_responses(asic_emulator_t * emu, int64_t now_us, uint8_t * buf, uint16_t size)
+{
+    uint16_t taken = 0;
+
+    while (emu->pending_count > 0 && taken < size) {
+        emu_frame_t * frame = &emu->pending[emu->pending_head];
+        if (frame->due_us > now_us) break;
+
+        uint16_t n = frame->len - frame->sent;
+        if (n > size - taken) n = size - taken;
+        memcpy(buf + taken, frame->data + frame->sent, n);
+        frame->sent += n;
+        taken += n;
+
+        if (frame->sent == frame->len) {
+            emu->pending_head = (emu->pending_head + 1) % MAX_PENDING_FRAMES;
+            emu->pending_count--;
+        }
+    }
+
+    return taken;
+}
+
+static uint32_t register_value(const asic_emulator_t * emu, const emu_chip_t * chip, uint8_t reg)
+{
+    switch (reg) {
+        case REG_TOTAL_COUNT:
+            return (uint32_t)(uint64_t)(chip->hashes / HASH_CNT_LSB);
+        case REG_ERROR_COUNT:
+            return chip->errors + (uint32_t)(uint64_t)(chip->error_hashes / HASH_CNT_LSB);
+        case REG_HASHRATE:
+            if (is_bm1397(emu)) {
+                return (uint32_t)(chain_hashrate(emu) / emu->config.chip_count / HASHRATE_UNIT) & 0x7fffffff;
+            }
+            break;
+        default:
+            if (reg >= REG_DOMAIN_0_COUNT && reg < REG_DOMAIN_0_COUNT + 4 && !is_bm1397(emu)) {
+                if (reg - REG_DOMAIN_0_COUNT >= emu->config.hash_domains) return 0;
+                return (uint32_t)(uint64_t)(chip->hashes / emu->config.hash_domains / HASH_CNT_LSB);
+            }
+            break;
+    }
+    return chip->registers[reg];
+}
+
+static void respond_register(asic_emulator_t * emu, const emu_chip_t * chip, uint8_t reg)
+{
+    uint8_t response[11] = {0xAA, 0x55};
+
+    if (reg == REG_CHIP_ID) {
+        // AA 55 <chip id> <core num> <addr> 00 .. <crc>
+        response[2] = emu->config.chip_id >> 8;
+        response[3] = emu->config.chip_id & 0xff;
+        response[4] = 0x00;
+        response[5] = chip->address;
+        queue_response(emu, response, false, false);
+        return;
+    }
+
+    write_be32(response + 2, register_value(emu, chip, reg));
+    response[6] = chip->address;
+    response[7] = reg;
+    queue_response(emu, response, false, true);
+}
+
+static void on_register_write(asic_emulator_t * emu, uint8_t reg)
+{
+    switch (reg) {
+        case REG_TICKET_MASK:
+            ESP_LOGI(TAG, "Ticket mask set to difficulty %g", ticket_mask_difficulty(emu));
+            break;
+        case REG_PLL0:
+            ESP_LOGD(TAG, "Frequency set to %g MHz", chain_frequency(emu));
+            break;
+        case REG_VERSION_ROLLING:
+            emu->version_bits = 0;
+            break;
+    }
+}
+
+static void handle_command(asic_emulator_t * emu, uint8_t header, const uint8_t * data, int data_len)
+{
+    bool all = header & GROUP_ALL;
+    uint8_t cmd = header & 0x0f;
+
+    if (data_len < 2) return;
+
+    switch (cmd) {
+        case CMD_SETADDRESS:
+            if (emu->addressed < emu->config.chip_count) {
+                emu->chips[emu->addressed++].address = data[0];
+            }
+            break;
+        case CMD_INACTIVE:
+            emu->addressed = 0;
+            break;
+        case CMD_WRITE:
+            if (data_len < 6) return;
+            for (int i = 0; i < emu->config.chip_count; i++) {
+                if (all || emu->chips[i].address == data[0]) {
+                    emu->chips[i].registers[data[1]] = read_be32(data + 2);
+                }
+            }
+            on_register_write(emu, data[1]);
+            break;
+        case CMD_READ:
+            for (int i = 0; i < emu->config.chip_count; i++) {
+                if (all || emu->chips[i].address == data[0]) {
+                    respond_register(emu, &emu->chips[i], data[1]);
+                }
+            }
+            break;
+    }
+}
+
+static void build_header(asic_emulator_t * emu)
+{
+    uint32_t version;
+    memcpy(&version, emu->job.version, 4);
+    version |= emu->version_bits;
+
+    memcpy(emu->header, &version, 4);
+    reverse_32bit_words(emu->job.prev_block_hash, emu->header + 4);
+    reverse_32bit_words(emu->job.merkle_root, emu->header + 36);
+    memcpy(emu->header + 68, emu->job.ntime, 4);
+    memcpy(emu->header + 72, emu->job.nbits, 4);
+}
+
+static void handle_job(asic_emulator_t * emu, const uint8_t * data, int data_len)
+{
+    if (is_bm1397(emu)) {
+        if (data_len < (int)sizeof(job_packet)) return;
+        memcpy(&emu->job_1397, data, sizeof(job_packet));
+        emu->job_id = emu->job_1397.job_id;
+        emu->num_midstates = emu->job_1397.num_midstates == 4 ? 4 : 1;
+    } else {
+        if (data_len < (int)sizeof(BM1370_job)) return;
+        memcpy(&emu->job, data, sizeof(BM1370_job));
+        emu->job_id = emu->job.job_id;
+        emu->num_midstates = 1;
+        emu->version_bits = 0;
+        build_header(emu);
+    }
+
+    // real chips drop the running job as soon as a new one arrives
+    emu->has_job = true;
+    emu->cursor = 0;
+    emu->midstate = 0;
+
+    emu->stats.jobs_received++;
+}
+
+static void handle_frame(asic_emulator_t * emu, uint8_t * frame, int len)
+{
+    uint8_t header = frame[2];
+    bool is_job = header & TYPE_JOB;
+    bool crc_ok;
+
+    if (is_job) {
+        uint16_t crc = crc16_false(frame + 2, len - 4);
+        crc_ok = frame[len - 2] == (crc >> 8) && frame[len - 1] == (crc & 0xff);
+    } else {
+        crc_ok = crc5(frame + 2, len - 3) == frame[len - 1];
+    }
+
+    emu->stats.frames_received++;
+    if (!crc_ok) emu->stats.frames_rejected++;
+
+    if (!crc_ok) {
+        ESP_LOGW(TAG, "Dropping frame with bad crc, header %02x", header);
+        return;
+    }
+
+    if (is_job) {
+        handle_job(emu, frame + 4, len - 6);
+    } else {
+        handle_command(emu, header, frame + 4, len - 5);
+    }
+}
+
+static void process_rx(asic_emulator_t * emu)
+{
+    size_t pos = 0;
+
+    while (emu->rx_len - pos >= 4) {
+        if (emu->rx[pos] != 0x55 || emu->rx[pos + 1] != 0xAA) {
+            pos++;
+            continue;
+        }
+
+        size_t total = emu->rx[pos + 3] + 2;
+        if (total < 7) {
+            emu->stats.frames_rejected++;
+            pos += 2;
+            continue;
+        }
+        if (emu->rx_len - pos < total) break;
+
+        handle_frame(emu, emu->rx + pos, total);
+        pos += total;
+    }
+
+    memmove(emu->rx, emu->rx + pos, emu->rx_len - pos);
+    emu->rx_len -= pos;
+}
+
+// Spreads consecutive candidates over chips and cores the way the nonce space
+// is split on hardware: core id in bits 25-31, chip address in bits 17-24
+static uint32_t candidate_nonce(const asic_emulator_t * emu, uint32_t cursor, uint8_t * small_core)
+{
+    uint16_t chips = emu->config.chip_count;
+    uint16_t cores = emu->config.core_count > 128 ? 128 : emu->config.core_count; // 7 bit core id
+    uint16_t small_per_core = emu->config.small_core_count / cores;
+
+    uint32_t chip = cursor % chips;
+    uint32_t rest = cursor / chips;
+    uint32_t core = rest % cores;
+    uint32_t low = rest / cores;
+
+    *small_core = small_per_core > 1 ? low % small_per_core : 0;
+
+    return ((core & 0x7f) << 25) | ((uint32_t)emu->chips[chip].address << 17) | (low & 0x1ffff);
+}
+
+static double hash_candidate(asic_emulator_t * emu, uint32_t nonce_h)
+{
+    uint8_t hash[32];
+
+    if (is_bm1397(emu)) {
+        uint8_t midstate[32];
+        uint32_t state[8];
+        uint8_t block[64] = {0};
+
+        // midstate1..3 follow midstate in the packed job
+        reverse_32bit_words(emu->job_1397.midstate + emu->midstate * 32, midstate);
+        memcpy(state, midstate, 32);
+
+        memcpy(block, emu->job_1397.merkle4, 4);
+        memcpy(block + 4, emu->job_1397.ntime, 4);
+        memcpy(block + 8, emu->job_1397.nbits, 4);
+        write_be32(block + 12, nonce_h);
+        block[16] = 0x80;
+        block[62] = 0x02; // 640 bit message
+        block[63] = 0x80;
+        sha256_transform(state, block);
+
+        uint8_t first_hash[32];
+        for (int i = 0; i < 8; i++) {
+            write_be32(first_hash + i * 4, state[i]);
+        }
+        mbedtls_sha256(first_hash, 32, hash, 0);
+    } else {
+        write_be32(emu->header + 76, nonce_h);
+        double_sha256_bin(emu->header, 80, hash);
+    }
+
+    return truediffone / le256todouble(hash);
+}
+
+static void advance_roll(asic_emulator_t * emu)
+{
+    emu->cursor = 0;
+
+    if (is_bm1397(emu)) {
+        emu->midstate = (emu->midstate + 1) % emu->num_midstates;
+        return;
+    }
+
+    uint32_t mask = version_mask(emu);
+    if (mask != 0) {
+        emu->version_bits = increment_bitmask(emu->version_bits, mask) & mask;
+        build_header(emu);
+    }
+}
+
+static void search(asic_emulator_t * emu)
+{
+    uint32_t space = (uint32_t)emu->config.chip_count * emu->config.core_count * 0x20000;
+
+    for (int i = 0; i < SEARCH_BATCH && emu->found_count < MAX_FOUND; i++) {
+        if (emu->cursor >= space) {
+            advance_roll(emu);
+        }
+
+        uint8_t small_core;
+        uint32_t nonce_h = candidate_nonce(emu, emu->cursor++, &small_core);
+
+        if (hash_candidate(emu, nonce_h) >= emu->config.ticket_difficulty) {
+            emu_solution_t * solution = &emu->found[emu->found_count++];
+            solution->job_id = emu->job_id;
+            solution->midstate = emu->midstate;
+            solution->small_core = small_core;
+            solution->nonce_h = nonce_h;
+            solution->version_bits = emu->version_bits;
+        }
+    }
+
+    emu->stats.hashes_computed += SEARCH_BATCH;
+}
+
+static void send_solution(asic_emulator_t * emu, const emu_solution_t * solution)
+{
+    uint8_t response[11] = {0xAA, 0x55};
+
+    write_be32(response + 2, solution->nonce_h);
+
+    if (is_bm1397(emu)) {
+        response[6] = solution->midstate;
+        response[7] = solution->job_id | solution->midstate;
+    } else {
+        response[6] = 0x00;
+        if (emu->config.chip_id == 0x1366) {
+            response[7] = solution->job_id | (solution->small_core & 0x07);
+        } else {
+            response[7] = ((solution->job_id << 1) & 0xf0) | (solution->small_core & 0x0f);
+        }
+        uint16_t version = solution->version_bits >> 13;
+        response[8] = version >> 8;
+        response[9] = version & 0xff;
+    }
+
+    // the chip that owns the nonce counts the error when the response goes out corrupted
+    if (queue_response(emu, response, true, true)) {
+        uint8_t address = (solution->nonce_h >> 17) & 0xff;
+        for (int i = 0; i < emu->config.chip_count; i++) {
+            if (emu->chips[i].address == address) {
+                emu->chips[i].errors++;
+                break;
+            }
+        }
+    }
+}
+
+static void tick(asic_emulator_t * emu, int64_t now_us)
+{
+    double seconds = (now_us - emu->last_tick_us) / 1e6;
+    emu->last_tick_us = now_us;
+
+    if (!emu->has_job) return;
+
+    double hashes = chain_hashrate(emu) * seconds;
+
+    asic_emulator_operating_point_t point = {0};
+    if (emu->config.power_model.mhz_per_mv > 0) {
+        asic_emulator_model(&emu->config.power_model, emu->config.chip_count, chain_frequency(emu), emu->core_voltage_mv, &point);
+    }
+
+    for (int i = 0; i < emu->config.chip_count; i++) {
+        emu->chips[i].hashes += hashes / emu->config.chip_count;
+        emu->chips[i].error_hashes += hashes / emu->config.chip_count * point.error_fraction;
+    }
+
+    // results leave the chain at the rate the programmed ticket mask allows
+    emu->budget += hashes / (ticket_mask_difficulty(emu) * HASH_CNT_LSB);
+    if (emu->budget > MAX_FOUND) {
+        emu->budget = MAX_FOUND;
+    }
+
+    while (emu->budget >= 1.0 && emu->found_count > 0) {
+        send_solution(emu, &emu->found[0]);
+        emu->found_count--;
+        memmove(&emu->found[0], &emu->found[1], emu->found_count * sizeof(emu_solution_t));
+        emu->budget -= 1.0;
+    }
+}
+
+static int emulator_send(void * context, const uint8_t * data, int len)
+{
+    asic_emulator_t * emu = context;
+
+    pthread_mutex_lock(&emu->lock);
+    // bring the counters up to date before any register read in data answers
+    tick(emu, esp_timer_get_time());
+
+    int accepted = 0;
+    while (accepted < len) {
+        size_t n = sizeof(emu->rx) - emu->rx_len;
+        if (n > (size_t)(len - accepted)) n = len - accepted;
+        memcpy(emu->rx + emu->rx_len, data + accepted, n);
+        emu->rx_len += n;
+        accepted += n;
+
+        process_rx(emu);
+        // a full buffer without a single frame in it is garbage
+        if (emu->rx_len == sizeof(emu->rx)) {
+            emu->rx_len = 0;
+        }
+    }
+    pthread_mutex_unlock(&emu->lock);
+
+    return len;
+}
+
+// Same contract as uart_read_bytes. The search runs in the reader's time, a
+// batch per iteration until enough responses are due or the timeout expires.
+static int16_t emulator_receive(void * context, uint8_t * buf, uint16_t size, uint16_t timeout_ms)
+{
+    asic_emulator_t * emu = context;
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    uint16_t received = 0;
+
+    while (true) {
+        pthread_mutex_lock(&emu->lock);
+        int64_t now_us = esp_timer_get_time();
+        tick(emu, now_us);
+        received += take_responses(emu, now_us, buf + received, size - received);
+        if (received < size && emu->has_job && emu->found_count < MAX_FOUND) {
+            search(emu);
+        }
+        pthread_mutex_unlock(&emu->lock);
+
+        if (received == size || esp_timer_get_time() >= deadline_us) {
+            return received;
+        }
+        // lets the sending task and the idle task in between batches
+        vTaskDelay(1);
+    }
+}
+
+esp_err_t asic_emulator_create(const asic_emulator_config_t * config, asic_emulator_t ** out)
+{
+    if (config == NULL || out == NULL || config->chip_count == 0 || config->core_count == 0 ||
+        config->ticket_difficulty <= 0 || (config->chip_count > 1 && config->hash_domains == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    switch (config->chip_id) {
+        case 0x1397:
+        case 0x1366:
+        case 0x1368:
+        case 0x1370:
+            break;
+        default:
+            ESP_LOGE(TAG, "Unsupported chip id %04x", config->chip_id);
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    asic_emulator_t * emu = calloc(1, sizeof(asic_emulator_t));
+    if (emu == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    emu->chips = calloc(config->chip_count, sizeof(emu_chip_t));
+    if (emu->chips == NULL) {
+        free(emu);
+        return ESP_ERR_NO_MEM;
+    }
+
+    emu->config = *config;
+    if (emu->config.hash_domains == 0) {
+        emu->config.hash_domains = 1;
+    }
+    emu->core_voltage_mv = config->core_voltage_mv;
+    emu->response_len = config->chip_id == 0x1397 ? 9 : 11;
+    emu->rng = 0x2545F491 ^ (uint32_t)(uintptr_t)emu;
+    emu->last_tick_us = esp_timer_get_time();
+    pthread_mutex_init(&emu->lock, NULL);
+
+    ESP_LOGI(TAG, "Emulating %dx BM%04x (ticket difficulty %g)", config->chip_count, config->chip_id, config->ticket_difficulty);
+
+    *out = emu;
+    return ESP_OK;
+}
+
+void asic_emulator_destroy(asic_emulator_t * emu)
+{
+    if (emu == NULL) return;
+
+    pthread_mutex_destroy(&emu->lock);
+    free(emu->chips);
+    free(emu);
+}
+
+void asic_emulator_get_stream(asic_emulator_t * emu, serial_stream_t * stream)
+{
+    stream->send = emulator_send;
+    stream->receive = emulator_receive;
+    stream->context = emu;
+}
+
+void asic_emulator_get_stats(asic_emulator_t * emu, asic_emulator_stats_t * stats)
+{
+    pthread_mutex_lock(&emu->lock);
+    *stats = emu->stats;
+    pthread_mutex_unlock(&emu->lock);
+}
+
+void asic_emulator_set_core_voltage(asic_emulator_t * emu, float core_voltage_mv)
+{
+    pthread_mutex_lock(&emu->lock);
+    emu->core_voltage_mv = core_voltage_mv;
+    pthread_mutex_unlock(&emu->lock);
+}
+
+void asic_emulator_get_operating_point(asic_emulator_t * emu, asic_emulator_operating_point_t * point)
+{
+    pthread_mutex_lock(&emu->lock);
+    asic_emulator_model(&emu->config.power_model, emu->config.chip_count, chain_frequency(emu), emu->core_voltage_mv, point);
+    pthread_mutex_unlock(&emu->lock);
+}
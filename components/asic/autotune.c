@@ -0,0 +1,278 @@
+#include <string.h>
+#include <math.h>
+
+#include "esp_log.h"
+
+#include "autotune.h"
+
+// The sweep moves this many hill climb steps at a time
+#define SWEEP_SCALE 4
+// A neighbor has to beat the center by this much to be climbed to, so
+// measurement noise does not walk the search around a flat optimum
+#define MIN_IMPROVEMENT 0.005f
+// Typical number of points a hill climb measures, only used for progress
+#define CLIMB_ESTIMATE 12
+
+static const char * TAG = "autotune";
+
+// Hill climb neighbors in frequency and voltage steps, the ones that cost
+// less voltage first
+static const int8_t NEIGHBORS[][2] = {
+    { 1,  0},
+    { 0, -1},
+    { 1,  1},
+    {-1, -1},
+    {-1,  0},
+    { 0,  1},
+};
+#define NEIGHBOR_COUNT (sizeof(NEIGHBORS) / sizeof(NEIGHBORS[0]))
+
+static uint16_t sweep_voltage(const autotune_t * at, uint16_t level)
+{
+    uint32_t voltage = at->limits.min_voltage + (uint32_t)level * at->limits.voltage_step * SWEEP_SCALE;
+    return voltage < at->limits.max_voltage ? voltage : at->limits.max_voltage;
+}
+
+static void set_point(autotune_t * at, float frequency, uint16_t voltage)
+{
+    memset(&at->current, 0, sizeof(at->current));
+    at->current.frequency = frequency;
+    at->current.voltage = voltage;
+}
+
+static const autotune_point_t * find_tested(const autotune_t * at, float frequency, uint16_t voltage)
+{
+    for (int i = 0; i < at->tested_count; i++) {
+        if (at->tested[i].voltage == voltage && fabsf(at->tested[i].frequency - frequency) < 0.01f) {
+            return &at->tested[i];
+        }
+    }
+    return NULL;
+}
+
+float autotune_efficiency(const autotune_sample_t * sample)
+{
+    if (sample->hashrate <= 0) return 0;
+    return sample->power / (sample->hashrate / 1000.0f);
+}
+
+static void evaluate(const autotune_t * at, autotune_point_t * point)
+{
+    const autotune_limits_t * limits = &at->limits;
+    const autotune_sample_t * sample = &point->sample;
+
+    float expected = point->frequency * limits->hashrate_per_mhz;
+
+    point->stable = sample->hashrate > 0
+        && sample->hashrate >= expected * limits->min_hashrate_fraction
+        && sample->error_percentage <= limits->max_error_percentage
+        && sample->power <= limits->max_power
+        && sample->temp <= limits->max_temp;
+
+    if (!point->stable) {
+        point->score = 0;
+    } else if (limits->objective == AUTOTUNE_EFFICIENCY) {
+        point->score = -autotune_efficiency(sample);
+    } else {
+        point->score = sample->hashrate;
+    }
+}
+
+static void finish(autotune_t * at)
+{
+    at->state = AUTOTUNE_DONE;
+    if (at->has_best) {
+        at->current = at->best;
+        ESP_LOGI(TAG, "Best of %u points: %g MHz at %u mV, %.1f GH/s, %.1f W, %.2f J/TH",
+                 at->tested_count, at->best.frequency, at->best.voltage,
+                 at->best.sample.hashrate, at->best.sample.power, autotune_efficiency(&at->best.sample));
+    } else {
+        ESP_LOGW(TAG, "No stable point within the limits among %u tested", at->tested_count);
+    }
+}
+
+static void next_neighbor(autotune_t * at)
+{
+    const autotune_limits_t * limits = &at->limits;
+
+    while (at->neighbor < NEIGHBOR_COUNT) {
+        const int8_t * step = NEIGHBORS[at->neighbor++];
+        float frequency = at->center.frequency + step[0] * limits->frequency_step;
+        int voltage = at->center.voltage + step[1] * limits->voltage_step;
+
+        if (frequency < limits->min_frequency - 0.01f || frequency > limits->max_frequency + 0.01f) continue;
+        if (voltage < limits->min_voltage || voltage > limits->max_voltage) continue;
+        if (find_tested(at, frequency, voltage) != NULL) continue;
+
+        set_point(at, frequency, voltage);
+        return;
+    }
+
+    finish(at);
+}
+
+static void start_climb(autotune_t * at)
+{
+    if (!at->has_best) {
+        finish(at);
+        return;
+    }
+
+    at->state = AUTOTUNE_CLIMB;
+    at->center = at->best;
+    at->neighbor = 0;
+    next_neighbor(at);
+}
+
+static void next_sweep_level(autotune_t * at)
+{
+    at->sweep_level++;
+
+    // a higher voltage only pays for a higher frequency
+    if (at->sweep_level >= at->sweep_levels || at->sweep_stable_frequency >= at->limits.max_frequency) {
+        start_climb(at);
+        return;
+    }
+
+    at->sweep_level_started = false;
+    set_point(at, at->sweep_stable_frequency, sweep_voltage(at, at->sweep_level));
+}
+
+static void sweep(autotune_t * at, const autotune_point_t * point)
+{
+    const autotune_limits_t * limits = &at->limits;
+
+    if (point->stable) {
+        if (point->frequency > at->sweep_stable_frequency) {
+            at->sweep_stable_frequency = point->frequency;
+        }
+        if (point->frequency < limits->max_frequency) {
+            float frequency = point->frequency + limits->frequency_step * SWEEP_SCALE;
+            at->sweep_level_started = true;
+            set_point(at, frequency < limits->max_frequency ? frequency : limits->max_frequency, point->voltage);
+            return;
+        }
+    } else if (!at->sweep_level_started
+               && (point->sample.power > limits->max_power || point->sample.temp > limits->max_temp)) {
+        // over the limits where the previous voltage was not, more voltage only makes it worse
+        start_climb(at);
+        return;
+    }
+
+    next_sweep_level(at);
+}
+
+void autotune_start(autotune_t * at, const autotune_limits_t * limits)
+{
+    memset(at, 0, sizeof(*at));
+    at->limits = *limits;
+    if (at->limits.frequency_step <= 0) at->limits.frequency_step = 1;
+    if (at->limits.voltage_step == 0) at->limits.voltage_step = 1;
+
+    uint32_t coarse_voltage_step = (uint32_t)at->limits.voltage_step * SWEEP_SCALE;
+    at->sweep_levels = (limits->max_voltage - limits->min_voltage + coarse_voltage_step - 1) / coarse_voltage_step + 1;
+    at->sweep_stable_frequency = limits->min_frequency;
+
+    at->state = AUTOTUNE_SWEEP;
+    set_point(at, limits->min_frequency, limits->min_voltage);
+
+    ESP_LOGI(TAG, "Tuning for %s: %g-%g MHz, %u-%u mV, %.0f W, %.0f°C",
+             autotune_objective_to_string(limits->objective), limits->min_frequency, limits->max_frequency,
+             limits->min_voltage, limits->max_voltage, limits->max_power, limits->max_temp);
+}
+
+const autotune_point_t * autotune_get_point(const autotune_t * at)
+{
+    if (at->state != AUTOTUNE_SWEEP && at->state != AUTOTUNE_CLIMB) {
+        return NULL;
+    }
+    return &at->current;
+}
+
+void autotune_measured(autotune_t * at, const autotune_sample_t * sample)
+{
+    if (at->state != AUTOTUNE_SWEEP && at->state != AUTOTUNE_CLIMB) {
+        return;
+    }
+
+    autotune_point_t point = at->current;
+    point.sample = *sample;
+    evaluate(at, &point);
+
+    ESP_LOGI(TAG, "%g MHz at %u mV: %.1f GH/s, %.1f W, %.1f°C, %.2f%% errors%s",
+             point.frequency, point.voltage, sample->hashrate, sample->power, sample->temp,
+             sample->error_percentage, point.stable ? "" : ", unstable");
+
+    if (at->tested_count < AUTOTUNE_MAX_POINTS) {
+        at->tested[at->tested_count++] = point;
+    }
+
+    if (point.stable && (!at->has_best || point.score > at->best.score)) {
+        at->best = point;
+        at->has_best = true;
+    }
+
+    if (at->state == AUTOTUNE_SWEEP) {
+        sweep(at, &point);
+    } else {
+        at->climb_count++;
+        if (point.stable && point.score - at->center.score > fabsf(at->center.score) * MIN_IMPROVEMENT) {
+            at->center = point;
+            at->neighbor = 0;
+        }
+        next_neighbor(at);
+    }
+
+    if (at->tested_count >= AUTOTUNE_MAX_POINTS && at->state != AUTOTUNE_DONE) {
+        finish(at);
+    }
+}
+
+void autotune_abort(autotune_t * at)
+{
+    if (at->state == AUTOTUNE_SWEEP || at->state == AUTOTUNE_CLIMB) {
+        at->state = AUTOTUNE_ABORTED;
+    }
+}
+
+bool autotune_get_best(const autotune_t * at, autotune_point_t * best)
+{
+    if (!at->has_best) return false;
+    *best = at->best;
+    return true;
+}
+
+uint8_t autotune_get_progress(const autotune_t * at)
+{
+    switch (at->state) {
+        case AUTOTUNE_SWEEP:
+            return at->sweep_level * 60 / at->sweep_levels;
+        case AUTOTUNE_CLIMB:
+            return 60 + (at->climb_count < CLIMB_ESTIMATE ? at->climb_count * 39 / CLIMB_ESTIMATE : 39);
+        case AUTOTUNE_DONE:
+            return 100;
+        default:
+            return 0;
+    }
+}
+
+const char * autotune_state_to_string(autotune_state_t state)
+{
+    switch (state) {
+        case AUTOTUNE_IDLE:     return "idle";
+        case AUTOTUNE_SWEEP:    return "sweep";
+        case AUTOTUNE_CLIMB:    return "climb";
+        case AUTOTUNE_DONE:     return "done";
+        case AUTOTUNE_ABORTED:  return "aborted";
+    }
+    return "idle";
+}
+
+const char * autotune_objective_to_string(autotune_objective_t objective)
+{
+    switch (objective) {
+        case AUTOTUNE_EFFICIENCY:   return "efficiency";
+        case AUTOTUNE_HASHRATE:     return "hashrate";
+    }
+    return "efficiency";
+}
@@ -73,16 +73,12 @@ typedef struct __attribute__((__packed__))
 
 static const char * TAG = "bm1366";
 
-static task_result result;
-
-static int address_interval;
-
 /// @brief
 /// @param ftdi
 /// @param header
 /// @param data
 /// @param len
-static void _send_BM1366(uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
+static void _send_BM1366(asic_chain_t * chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
 {
     packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
     uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
@@ -112,51 +108,51 @@ static void _send_BM1366(uint8_t header, uint8_t * data, uint8_t data_len, bool
     }
 
     // send serial data
-    SERIAL_send(buf, total_length, debug);
+    SERIAL_send(chain->port, buf, total_length, debug);
 }
 
-static void _send_simple(uint8_t * data, uint8_t total_length)
+static void _send_simple(asic_chain_t * chain, uint8_t * data, uint8_t total_length)
 {
     uint8_t buf[total_length];
     memcpy(buf, data, total_length);
-    SERIAL_send(buf, total_length, BM1366_SERIALTX_DEBUG);
+    SERIAL_send(chain->port, buf, total_length, BM1366_SERIALTX_DEBUG);
 }
 
-static void _send_chain_inactive(void)
+static void _send_chain_inactive(asic_chain_t * chain)
 {
     unsigned char read_address[2] = {0x00, 0x00};
     // send serial data
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1366_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
+static void _set_chip_address(asic_chain_t * chain, uint8_t chipAddr)
 {
     ESP_LOGI(TAG, "Set chip address: 0x%02x", chipAddr);
 
     unsigned char read_address[2] = {chipAddr, 0x00};
     // send serial data
-    _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1366_SERIALTX_DEBUG);
 }
 
-void BM1366_set_version_mask(uint32_t version_mask) 
+void BM1366_set_version_mask(asic_chain_t * chain, uint32_t version_mask) 
 {
     int versions_to_roll = version_mask >> 13;
     uint8_t version_byte0 = (versions_to_roll >> 8);
     uint8_t version_byte1 = (versions_to_roll & 0xFF); 
     uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1366(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1366_SERIALTX_DEBUG);
 }
 
-void BM1366_set_hash_counting_number(uint32_t hcn) {
+void BM1366_set_hash_counting_number(asic_chain_t * chain, uint32_t hcn) {
     uint8_t set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x00, 0x00};
     set_10_hash_counting[2] = (hcn >> 24) & 0xFF;
     set_10_hash_counting[3] = (hcn >> 16) & 0xFF;
     set_10_hash_counting[4] = (hcn >> 8) & 0xFF;
     set_10_hash_counting[5] = hcn & 0xFF;
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1366_SERIALTX_DEBUG);
 }
 
-void BM1366_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores) 
+void BM1366_set_nonce_space(asic_chain_t * chain, double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores) 
 {   
     int cores_up = _next_power_of_two(cores);
     int asic_count_up =  _next_power_of_two(asic_count);
@@ -167,10 +163,10 @@ void BM1366_set_nonce_space(double nonce_percent, float frequency, uint16_t asic
     double hcn_frac = nonce_percent * hcn_max;
     uint32_t hcn_register_value = (uint32_t)hcn_frac;
 
-    BM1366_set_hash_counting_number(hcn_register_value);
+    BM1366_set_hash_counting_number(chain, hcn_register_value);
 }
 
-float BM1366_send_hash_frequency(float target_freq)
+float BM1366_send_hash_frequency(asic_chain_t * chain, float target_freq)
 {
     uint8_t fb_divider, refdiv, postdiv1, postdiv2;
     float new_freq;
@@ -181,97 +177,96 @@ float BM1366_send_hash_frequency(float target_freq)
     uint8_t postdiv = (((postdiv1 - 1) & 0xf) << 4) | ((postdiv2 - 1) & 0xf);
     uint8_t freqbuf[6] = {0x00, 0x08, vdo_scale, fb_divider, refdiv, postdiv};
 
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1366_SERIALTX_DEBUG);
 
     ESP_LOGI(TAG, "Setting Frequency to %g MHz (%g)", target_freq, new_freq);
 
     return new_freq;
 }
 
-uint8_t BM1366_init(void * pvParameters)
+uint8_t BM1366_init(void * pvParameters, asic_chain_t * chain)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
 
     // set version mask
     for (int i = 0; i < 3; i++) {
-        BM1366_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+        BM1366_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
     }
 
     // read register 00 on all chips
     unsigned char init3[7] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
-    _send_simple(init3, 7);
+    _send_simple(chain, init3, 7);
 
-    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    int chip_counter = count_asic_chips(asic_count, BM1366_CHIP_ID, BM1366_CHIP_ID_RESPONSE_LENGTH);
+    int chip_counter = count_asic_chips(chain, BM1366_CHIP_ID, BM1366_CHIP_ID_RESPONSE_LENGTH);
 
     if (chip_counter == 0) {
         return 0;
     }
 
     unsigned char init4[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03};
-    _send_simple(init4, 11);
+    _send_simple(chain, init4, 11);
 
     unsigned char init5[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00, 0x00};
-    _send_simple(init5, 11);
+    _send_simple(chain, init5, 11);
 
     //{0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03};
-    _send_chain_inactive();
+    _send_chain_inactive(chain);
 
-    // split the chip address space evenly
-    address_interval = 256 / chip_counter;
+    // split the chip address space evenly over the chips that hash
+    asic_assign_addresses(chain, chip_counter);
     for (uint8_t i = 0; i < chip_counter; i++) {
         //{ 0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C };
-        _set_chip_address(i * address_interval);
+        _set_chip_address(chain, asic_chip_address(chain, i));
     }
 
     unsigned char init135[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x85, 0x40, 0x0C};
-    _send_simple(init135, 11);
+    _send_simple(chain, init135, 11);
 
     unsigned char init136[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x20, 0x19};
-    _send_simple(init136, 11);
+    _send_simple(chain, init136, 11);
 
     uint16_t difficulty = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
 
     //set difficulty mask
     uint8_t difficulty_mask[6];
     get_difficulty_mask(difficulty, difficulty_mask);
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1366_SERIALTX_DEBUG);    
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1366_SERIALTX_DEBUG);    
 
     unsigned char init138[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D};
-    _send_simple(init138, 11);
+    _send_simple(chain, init138, 11);
 
     unsigned char init139[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x58, 0x02, 0x11, 0x11, 0x11, 0x06};
-    _send_simple(init139, 11);
+    _send_simple(chain, init139, 11);
 
     unsigned char init171[11] = {0x55, 0xAA, 0x41, 0x09, 0x00, 0x2C, 0x00, 0x7C, 0x00, 0x03, 0x03};
-    _send_simple(init171, 11);
+    _send_simple(chain, init171, 11);
 
     //S19XP Dump sends baudrate change here.. we wait until later.
     // unsigned char init173[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
     // _send_simple(init173, 11);
 
     for (uint8_t i = 0; i < chip_counter; i++) {
-        unsigned char set_a8_register[6] = {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_a8_register, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_18_register[6] = {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_18_register, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_3c_register_first[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x85, 0x40};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_first, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_3c_register_second[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x20};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_second, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_3c_register_third[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_third, 6, BM1366_SERIALTX_DEBUG);
+        unsigned char set_a8_register[6] = {asic_chip_address(chain, i), 0xA8, 0x00, 0x07, 0x01, 0xF0};
+        _send_BM1366(chain, (TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_a8_register, 6, BM1366_SERIALTX_DEBUG);
+        unsigned char set_18_register[6] = {asic_chip_address(chain, i), 0x18, 0xF0, 0x00, 0xC1, 0x00};
+        _send_BM1366(chain, (TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_18_register, 6, BM1366_SERIALTX_DEBUG);
+        unsigned char set_3c_register_first[6] = {asic_chip_address(chain, i), 0x3C, 0x80, 0x00, 0x85, 0x40};
+        _send_BM1366(chain, (TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_first, 6, BM1366_SERIALTX_DEBUG);
+        unsigned char set_3c_register_second[6] = {asic_chip_address(chain, i), 0x3C, 0x80, 0x00, 0x80, 0x20};
+        _send_BM1366(chain, (TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_second, 6, BM1366_SERIALTX_DEBUG);
+        unsigned char set_3c_register_third[6] = {asic_chip_address(chain, i), 0x3C, 0x80, 0x00, 0x82, 0xAA};
+        _send_BM1366(chain, (TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_third, 6, BM1366_SERIALTX_DEBUG);
     }
 
-    do_frequency_transition(GLOBAL_STATE, BM1366_send_hash_frequency);
+    do_frequency_transition(GLOBAL_STATE, chain, BM1366_send_hash_frequency);
 
     float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
     int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
 
-    BM1366_set_nonce_space(1.0, frequency, asic_count, cores);
+    BM1366_set_nonce_space(chain, 1.0, frequency, chain->live_count, cores);
 
     unsigned char init795[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C};
-    _send_simple(init795, 11);
+    _send_simple(chain, init795, 11);
 
     return chip_counter;
 }
@@ -286,32 +281,29 @@ uint8_t BM1366_init(void * pvParameters)
 
 // Baud formula = 25M/((denominator+1)*8)
 // The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1366_set_default_baud(void)
+int BM1366_set_default_baud(asic_chain_t * chain)
 {
     // default divider of 26 (11010) for 115,749
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1366_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1366_set_max_baud(void)
+int BM1366_set_max_baud(asic_chain_t * chain)
 {
     ESP_LOGI(TAG, "Setting max baud of 1000000");
 
     unsigned char reg28[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
-    _send_simple(reg28, 11);
+    _send_simple(chain, reg28, 11);
     return 1000000;
 }
 
-static uint8_t id = 0;
-
-void BM1366_send_work(void * pvParameters, bm_job * next_bm_job)
+void BM1366_send_work(asic_chain_t * chain, bm_job * next_bm_job)
 {
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
 
     BM1366_job job;
-    id = (id + 8) % 128;
-    job.job_id = id;
+    chain->job_id = (chain->job_id + 8) % 128;
+    job.job_id = chain->job_id;
     job.num_midstates = 0x01;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -320,79 +312,76 @@ void BM1366_send_work(void * pvParameters, bm_job * next_bm_job)
     memcpy(job.prev_block_hash, next_bm_job->prev_block_hash, 32);
     memcpy(&job.version, &next_bm_job->version, 4);
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
-    }
-
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
-
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    store_asic_job(chain, job.job_id, next_bm_job);
 
     //debug sent jobs - this can get crazy if the interval is short
     #if BM1366_DEBUG_JOBS
     ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
     #endif
 
-    _send_BM1366((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1366_job), BM1366_DEBUG_WORK);
+    _send_BM1366(chain, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1366_job), BM1366_DEBUG_WORK);
 }
 
-task_result * BM1366_process_work(void * pvParameters)
+task_result * BM1366_process_work(asic_chain_t * chain)
 {
     bm1366_asic_result_t asic_result = {0};
 
-    memset(&result, 0, sizeof(task_result));
+    memset(&chain->result, 0, sizeof(task_result));
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result), &result.timestamp_us) == ESP_FAIL) {
+    if (receive_work(chain, (uint8_t *)&asic_result, sizeof(asic_result), &chain->result.timestamp_us) == ESP_FAIL) {
         return NULL;
     }
 
     if (!asic_result.is_job_response) {
-        result.register_type = REGISTER_MAP[asic_result.cmd.register_address];
-        if (result.register_type == REGISTER_INVALID) {
+        chain->result.register_type = REGISTER_MAP[asic_result.cmd.register_address];
+        if (chain->result.register_type == REGISTER_INVALID) {
             ESP_LOGW(TAG, "Unknown register read: %02x", asic_result.cmd.register_address);
             return NULL;
         }
-        result.asic_nr = asic_result.cmd.asic_address / address_interval;
-        result.value = ntohl(asic_result.cmd.value);
+        chain->result.asic_nr = asic_chip_from_address(chain, asic_result.cmd.asic_address);
+        chain->result.value = ntohl(asic_result.cmd.value);
         
-        return &result;
+        return &chain->result;
     }
 
     uint8_t job_id = asic_result.job.id & 0xf8;
     uint32_t nonce_h = ntohl(asic_result.job.nonce);
-    uint8_t asic_nr = (uint8_t)((nonce_h >> 17) & 0xff) / address_interval; // Asic address is encoded in the next 8 bits
+    uint8_t asic_nr = asic_chip_from_address(chain, (nonce_h >> 17) & 0xff); // Asic address is encoded in the next 8 bits
     uint8_t core_id = (uint8_t)((nonce_h >> 25) & 0x7f); // BM1366 has 112 cores, so it should be coded on 7 bits
     uint8_t small_core_id = asic_result.job.id & 0x07; // BM1366 has 8 small cores, so it should be coded on 3 bits
     uint32_t version_bits = (ntohs(asic_result.job.version) << 13); // shift the 16 bit value left 13
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0) {
+    bm_job * job = get_asic_job(chain, job_id);
+    if (job == NULL) {
         ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
         return NULL;
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
+    uint32_t rolled_version = job->version | version_bits;
 
-    result.job_id = job_id;
-    result.nonce = asic_result.job.nonce;
-    result.rolled_version = rolled_version;
-    result.asic_nr = asic_nr;
-    result.core_id = core_id;
-    result.small_core_id = small_core_id;
+    chain->result.job_id = job_id;
+    chain->result.job = job;
+    chain->result.nonce = asic_result.job.nonce;
+    chain->result.rolled_version = rolled_version;
+    chain->result.asic_nr = asic_nr;
+    chain->result.core_id = core_id;
+    chain->result.small_core_id = small_core_id;
 
-    return &result;
+    return &chain->result;
 }
 
-void BM1366_read_registers(void)
+void BM1366_init_register_poll(asic_chain_t * chain)
 {
     int size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]);
     for (int reg = 0; reg < size; reg++) {
         if (REGISTER_MAP[reg] != REGISTER_INVALID) {
-            _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, reg}, 2, BM1366_SERIALTX_DEBUG);
-            vTaskDelay(1 / portTICK_PERIOD_MS);
+            register_poll_add(&chain->register_poll, reg, register_poll_period_ms(REGISTER_MAP[reg]));
         }
     }
 }
+
+void BM1366_read_register(asic_chain_t * chain, uint16_t asic_nr, uint8_t reg)
+{
+    uint8_t address = asic_chip_address(chain, asic_nr);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_SINGLE | CMD_READ), (uint8_t[]){address, reg}, 2, BM1366_SERIALTX_DEBUG);
+}
@@ -76,17 +76,12 @@ typedef struct __attribute__((__packed__))
 
 static const char * TAG = "bm1397";
 
-static uint32_t prev_nonce = 0;
-static task_result result;
-
-static int address_interval;
-
 /// @brief
 /// @param ftdi
 /// @param header
 /// @param data
 /// @param len
-static void _send_BM1397(uint8_t header, uint8_t *data, uint8_t data_len, bool debug)
+static void _send_BM1397(asic_chain_t * chain, uint8_t header, uint8_t *data, uint8_t data_len, bool debug)
 {
     packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
     uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
@@ -119,36 +114,36 @@ static void _send_BM1397(uint8_t header, uint8_t *data, uint8_t data_len, bool d
     }
 
     // send serial data
-    SERIAL_send(buf, total_length, debug);
+    SERIAL_send(chain->port, buf, total_length, debug);
 }
 
-static void _send_read_address(void)
+static void _send_read_address(asic_chain_t * chain)
 {
     unsigned char read_address[2] = {0x00, 0x00};
     // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1397_SERIALTX_DEBUG);
 }
 
-static void _send_chain_inactive(void)
+static void _send_chain_inactive(asic_chain_t * chain)
 {
     unsigned char read_address[2] = {0x00, 0x00};
     // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1397_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
+static void _set_chip_address(asic_chain_t * chain, uint8_t chipAddr)
 {
     unsigned char read_address[2] = {chipAddr, 0x00};
     // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1397_SERIALTX_DEBUG);
 }
 
-void BM1397_set_version_mask(uint32_t version_mask) 
+void BM1397_set_version_mask(asic_chain_t * chain, uint32_t version_mask) 
 {
     // placeholder
 }
 
-float BM1397_send_hash_frequency(float target_freq)
+float BM1397_send_hash_frequency(asic_chain_t * chain, float target_freq)
 {
     uint8_t fb_divider, refdiv, postdiv1, postdiv2;
     float frequency;
@@ -163,12 +158,12 @@ float BM1397_send_hash_frequency(float target_freq)
     for (int i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), prefreq1, 6, BM1397_SERIALTX_DEBUG);
+        _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), prefreq1, 6, BM1397_SERIALTX_DEBUG);
     }
     for (int i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1397_SERIALTX_DEBUG);
+        _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1397_SERIALTX_DEBUG);
     }
 
     vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -178,15 +173,14 @@ float BM1397_send_hash_frequency(float target_freq)
     return frequency;
 }
 
-uint8_t BM1397_init(void * pvParameters)
+uint8_t BM1397_init(void * pvParameters, asic_chain_t * chain)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
 
     // send the init command
-    _send_read_address();
+    _send_read_address(chain);
 
-    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    int chip_counter = count_asic_chips(asic_count, BM1397_CHIP_ID, BM1397_CHIP_ID_RESPONSE_LENGTH);
+    int chip_counter = count_asic_chips(chain, BM1397_CHIP_ID, BM1397_CHIP_ID_RESPONSE_LENGTH);
 
     if (chip_counter == 0) {
         return 0;
@@ -194,80 +188,77 @@ uint8_t BM1397_init(void * pvParameters)
 
     // send serial data
     vTaskDelay(SLEEP_TIME / portTICK_PERIOD_MS);
-    _send_chain_inactive();
+    _send_chain_inactive(chain);
 
-    // split the chip address space evenly
-    address_interval = 256 / chip_counter;
+    // split the chip address space evenly over the chips that hash
+    asic_assign_addresses(chain, chip_counter);
     for (uint8_t i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
+        _set_chip_address(chain, asic_chip_address(chain, i));
     }
 
     unsigned char init[6] = {0x00, CLOCK_ORDER_CONTROL_0, 0x00, 0x00, 0x00, 0x00}; // init1 - clock_order_control0
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), init, 6, BM1397_SERIALTX_DEBUG);
 
     unsigned char init2[6] = {0x00, CLOCK_ORDER_CONTROL_1, 0x00, 0x00, 0x00, 0x00}; // init2 - clock_order_control1
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init2, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), init2, 6, BM1397_SERIALTX_DEBUG);
 
     unsigned char init3[9] = {0x00, ORDERED_CLOCK_ENABLE, 0x00, 0x00, 0x00, 0x01}; // init3 - ordered_clock_enable
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init3, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), init3, 6, BM1397_SERIALTX_DEBUG);
 
     unsigned char init4[9] = {0x00, CORE_REGISTER_CONTROL, 0x80, 0x00, 0x80, 0x74}; // init4 - init_4_?
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init4, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), init4, 6, BM1397_SERIALTX_DEBUG);
 
     uint16_t difficulty = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
 
     //set difficulty mask
     uint8_t difficulty_mask[6];
     get_difficulty_mask(difficulty, difficulty_mask);
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1397_SERIALTX_DEBUG);
 
     unsigned char init5[9] = {0x00, PLL3_PARAMETER, 0xC0, 0x70, 0x01, 0x11}; // init5 - pll3_parameter
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init5, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), init5, 6, BM1397_SERIALTX_DEBUG);
 
     unsigned char init6[9] = {0x00, FAST_UART_CONFIGURATION, 0x06, 0x00, 0x00, 0x0F}; // init6 - fast_uart_configuration
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init6, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), init6, 6, BM1397_SERIALTX_DEBUG);
 
-    BM1397_set_default_baud();
+    BM1397_set_default_baud(chain);
 
     //ramp up the hash frequency
-    do_frequency_transition(GLOBAL_STATE, BM1397_send_hash_frequency);
+    do_frequency_transition(GLOBAL_STATE, chain, BM1397_send_hash_frequency);
 
     return chip_counter;
 }
 
 // Baud formula = 25M/((denominator+1)*8)
 // The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1397_set_default_baud(void)
+int BM1397_set_default_baud(asic_chain_t * chain)
 {
     // default divider of 26 (11010) for 115,749
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1397_set_max_baud(void)
+int BM1397_set_max_baud(asic_chain_t * chain)
 {
     // divider of 0 for 3,125,000
     ESP_LOGI(TAG, "Setting max baud of 3125000");
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01100000, 0b00110001};
     ; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
     return 3125000;
 }
 
-static uint8_t id = 0;
-
-void BM1397_send_work(void *pvParameters, bm_job *next_bm_job)
+void BM1397_send_work(asic_chain_t *chain, bm_job *next_bm_job)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
 
     job_packet job;
     // max job number is 128
     // there is still some really weird logic with the job id bits for the asic to sort out
     // so we have it limited to 128 and it has to increment by 4
-    id = (id + 4) % 128;
+    chain->job_id = (chain->job_id + 4) % 128;
 
-    job.job_id = id;
+    job.job_id = chain->job_id;
     job.num_midstates = next_bm_job->num_midstates;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -282,44 +273,35 @@ void BM1397_send_work(void *pvParameters, bm_job *next_bm_job)
         memcpy(job.midstate3, next_bm_job->midstate3, 32);
     }
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL)
-    {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
-    }
-
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
-
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    store_asic_job(chain, job.job_id, next_bm_job);
 
     #if BM1397_DEBUG_JOBS
     ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
     #endif
 
-    _send_BM1397((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
+    _send_BM1397(chain, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
 }
 
-task_result *BM1397_process_work(void *pvParameters)
+task_result *BM1397_process_work(asic_chain_t *chain)
 {
     bm1397_asic_result_t asic_result = {0};
 
-    memset(&result, 0, sizeof(task_result));
+    memset(&chain->result, 0, sizeof(task_result));
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result), &result.timestamp_us) == ESP_FAIL) {
+    if (receive_work(chain, (uint8_t *)&asic_result, sizeof(asic_result), &chain->result.timestamp_us) == ESP_FAIL) {
         return NULL;
     }
 
     if (!asic_result.is_job_response) {
-        result.register_type = REGISTER_MAP[asic_result.cmd.register_address];
-        if (result.register_type == REGISTER_INVALID) {
+        chain->result.register_type = REGISTER_MAP[asic_result.cmd.register_address];
+        if (chain->result.register_type == REGISTER_INVALID) {
             ESP_LOGW(TAG, "Unknown register read: %02x", asic_result.cmd.register_address);
             return NULL;
         }
-        result.asic_nr = asic_result.cmd.asic_address / address_interval;
-        result.value = ntohl(asic_result.cmd.value);
+        chain->result.asic_nr = asic_chip_from_address(chain, asic_result.cmd.asic_address);
+        chain->result.value = ntohl(asic_result.cmd.value);
 
-        return &result;
+        return &chain->result;
     }
 
     uint8_t nonce_found = 0;
@@ -328,17 +310,17 @@ task_result *BM1397_process_work(void *pvParameters)
     uint8_t rx_job_id = asic_result.job.id & 0xfc;
     uint8_t rx_midstate_index = asic_result.job.id & 0x03;
 
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
-    if (GLOBAL_STATE->valid_jobs[rx_job_id] == 0)
+    bm_job * job = get_asic_job(chain, rx_job_id);
+    if (job == NULL)
     {
         ESP_LOGW(TAG, "Invalid job nonce found, id=%d", rx_job_id);
         return NULL;
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version;
+    uint32_t rolled_version = job->version;
     for (int i = 0; i < rx_midstate_index; i++)
     {
-        rolled_version = increment_bitmask(rolled_version, GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version_mask);
+        rolled_version = increment_bitmask(rolled_version, job->version_mask);
     }
 
     // ASIC may return the same nonce multiple times
@@ -355,37 +337,43 @@ task_result *BM1397_process_work(void *pvParameters)
         return NULL;
     }
 
-    if (asic_result.job.nonce == prev_nonce)
+    if (asic_result.job.nonce == chain->prev_nonce)
     {
         return NULL;
     }
     else
     {
-        prev_nonce = asic_result.job.nonce;
+        chain->prev_nonce = asic_result.job.nonce;
     }
 
     uint32_t nonce_h = ntohl(asic_result.job.nonce);
-    uint8_t asic_nr = (uint8_t)((nonce_h >> 17) & 0xff) / address_interval;
+    uint8_t asic_nr = asic_chip_from_address(chain, (nonce_h >> 17) & 0xff);
     uint8_t core_id = (uint8_t)((nonce_h >> 25) & 0x7f);
     uint8_t small_core_id = asic_result.job.id & 0x0f;
 
-    result.job_id = rx_job_id;
-    result.nonce = asic_result.job.nonce;
-    result.rolled_version = rolled_version;
-    result.asic_nr = asic_nr;
-    result.core_id = core_id;
-    result.small_core_id = small_core_id;
+    chain->result.job_id = rx_job_id;
+    chain->result.job = job;
+    chain->result.nonce = asic_result.job.nonce;
+    chain->result.rolled_version = rolled_version;
+    chain->result.asic_nr = asic_nr;
+    chain->result.core_id = core_id;
+    chain->result.small_core_id = small_core_id;
 
-    return &result;
+    return &chain->result;
 }
 
-void BM1397_read_registers(void)
+void BM1397_init_register_poll(asic_chain_t * chain)
 {
     int size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]);
     for (int reg = 0; reg < size; reg++) {
         if (REGISTER_MAP[reg] != REGISTER_INVALID) {
-            _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, reg}, 2, BM1397_SERIALTX_DEBUG);
-            vTaskDelay(1 / portTICK_PERIOD_MS);
+            register_poll_add(&chain->register_poll, reg, register_poll_period_ms(REGISTER_MAP[reg]));
         }
     }
 }
+
+void BM1397_read_register(asic_chain_t * chain, uint16_t asic_nr, uint8_t reg)
+{
+    uint8_t address = asic_chip_address(chain, asic_nr);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_SINGLE | CMD_READ), (uint8_t[]){address, reg}, 2, BM1397_SERIALTX_DEBUG);
+}
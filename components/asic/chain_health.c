@@ -0,0 +1,143 @@
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "chain_health.h"
+
+// The nonce rate follows frequency changes over about a minute
+#define RATE_TAU_US 60000000LL
+
+static const char * TAG = "chain_health";
+
+void chain_health_init(chain_health_t * health, chip_health_t * chips, uint16_t chip_count)
+{
+    memset(health, 0, sizeof(*health));
+    memset(chips, 0, chip_count * sizeof(chip_health_t));
+    health->chips = chips;
+    health->chip_count = chip_count;
+    atomic_init(&health->nonces, 0);
+}
+
+void chain_health_clear(chain_health_t * health)
+{
+    for (int i = 0; i < health->chip_count; i++) {
+        health->chips[i].state = CHIP_HEALTH_OK;
+        health->chips[i].resets = 0;
+    }
+}
+
+void chain_health_restart(chain_health_t * health, int64_t now_us)
+{
+    for (int i = 0; i < health->chip_count; i++) {
+        health->chips[i].last_nonce_us = now_us;
+    }
+    atomic_store(&health->nonces, 0);
+    health->last_check_us = now_us;
+}
+
+void chain_health_nonce(chain_health_t * health, uint16_t asic_nr, int64_t time_us)
+{
+    if (asic_nr >= health->chip_count) return;
+
+    chip_health_t * chip = &health->chips[asic_nr];
+    chip->last_nonce_us = time_us;
+    chip->resets = 0;
+    if (chip->state == CHIP_HEALTH_STALLED) {
+        chip->state = CHIP_HEALTH_OK;
+    }
+    atomic_fetch_add_explicit(&health->nonces, 1, memory_order_relaxed);
+}
+
+static int live_chips(const chain_health_t * health)
+{
+    int live = 0;
+    for (int i = 0; i < health->chip_count; i++) {
+        if (health->chips[i].state != CHIP_HEALTH_BYPASSED) live++;
+    }
+    return live;
+}
+
+static void update_rate(chain_health_t * health, int64_t now_us)
+{
+    int64_t elapsed_us = now_us - health->last_check_us;
+    int live = live_chips(health);
+
+    // silence is what is being judged, so the window stays open until the
+    // next nonce rather than dragging the rate down with a stalled chain
+    if (atomic_load(&health->nonces) == 0 || elapsed_us <= 0 || live == 0) return;
+
+    uint32_t nonces = atomic_exchange(&health->nonces, 0);
+    health->last_check_us = now_us;
+
+    float rate = nonces / (elapsed_us / 1e6f) / live;
+    if (health->total_nonces == 0) {
+        health->rate = rate;
+    } else {
+        health->rate += (float)elapsed_us / (RATE_TAU_US + elapsed_us) * (rate - health->rate);
+    }
+    health->total_nonces += nonces;
+}
+
+chain_health_action_t chain_health_check(chain_health_t * health, int64_t now_us)
+{
+    update_rate(health, now_us);
+
+    if (health->total_nonces < CHAIN_HEALTH_MIN_NONCES) {
+        return CHAIN_HEALTH_OK;
+    }
+
+    chain_health_action_t action = CHAIN_HEALTH_OK;
+    int live = live_chips(health);
+
+    for (int i = 0; i < health->chip_count; i++) {
+        chip_health_t * chip = &health->chips[i];
+        if (chip->state == CHIP_HEALTH_BYPASSED) continue;
+
+        int64_t silence_us = now_us - chip->last_nonce_us;
+        if (silence_us < CHAIN_HEALTH_MIN_SILENCE_US || health->rate * (silence_us / 1e6f) < CHAIN_HEALTH_SIGNIFICANCE) {
+            continue;
+        }
+
+        if (chip->state == CHIP_HEALTH_OK) {
+            ESP_LOGW(TAG, "Chip %d silent for %.1f s, %.1f nonces expected", i, silence_us / 1e6f, health->rate * (silence_us / 1e6f));
+            chip->state = CHIP_HEALTH_STALLED;
+        }
+
+        chain_health_action_t chip_action;
+        if (chip->resets < CHAIN_HEALTH_MAX_RESETS) {
+            chip->resets++;
+            chip_action = CHAIN_HEALTH_RESET;
+        } else if (live > 1) {
+            ESP_LOGE(TAG, "Chip %d did not come back after %d resets, bypassing it", i, chip->resets);
+            chip->state = CHIP_HEALTH_BYPASSED;
+            live--;
+            chip_action = CHAIN_HEALTH_BYPASS;
+        } else {
+            ESP_LOGE(TAG, "Chip %d did not come back after %d resets", i, chip->resets);
+            chip->resets = 0;
+            chip_action = CHAIN_HEALTH_POWER_CYCLE;
+        }
+
+        if (chip_action > action) action = chip_action;
+    }
+
+    if (action == CHAIN_HEALTH_RESET) {
+        health->resets++;
+    }
+    return action;
+}
+
+bool chain_health_is_bypassed(const chain_health_t * health, uint16_t asic_nr)
+{
+    return asic_nr < health->chip_count && health->chips[asic_nr].state == CHIP_HEALTH_BYPASSED;
+}
+
+const char * chip_health_state_to_string(chip_health_state_t state)
+{
+    switch (state) {
+        case CHIP_HEALTH_OK: return "ok";
+        case CHIP_HEALTH_STALLED: return "stalled";
+        case CHIP_HEALTH_BYPASSED: return "bypassed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,185 @@
+#include <string.h>
+#include <math.h>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "core_heatmap.h"
+
+// Below this many nonces per core a missing core is still plausible by chance
+#define MIN_EXPECTED 16.0
+// A weak core returns under half its share, and is at least this many standard
+// deviations below it so noise alone does not flag it
+#define WEAK_FRACTION 0.5
+#define WEAK_SIGMAS 4.0
+// Upper 0.1% point of the standard normal distribution
+#define Z_999 3.09
+
+static const char * TAG = "core_heatmap";
+
+esp_err_t core_heatmap_init(core_heatmap_t * hm, uint16_t chip_count, uint16_t core_count, uint16_t small_core_count)
+{
+    memset(hm, 0, sizeof(*hm));
+    if (chip_count == 0 || core_count == 0 || small_core_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // small core ids count the small cores within one core
+    int small_cores_per_core = (small_core_count + core_count - 1) / core_count;
+
+    hm->chip_count = chip_count;
+    hm->core_count = core_count < CORE_HEATMAP_MAX_CORES ? core_count : CORE_HEATMAP_MAX_CORES;
+    hm->small_core_count = small_cores_per_core < CORE_HEATMAP_MAX_SMALL_CORES ? small_cores_per_core : CORE_HEATMAP_MAX_SMALL_CORES;
+
+    hm->cores = heap_caps_calloc(chip_count * hm->core_count, sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    hm->small_cores = heap_caps_calloc(chip_count * hm->small_core_count, sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    if (hm->cores == NULL || hm->small_cores == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate core heatmap");
+        heap_caps_free(hm->cores);
+        heap_caps_free(hm->small_cores);
+        hm->cores = NULL;
+        hm->small_cores = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_mutex_init(&hm->lock, NULL);
+    return ESP_OK;
+}
+
+static void halve(uint16_t * counts, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        counts[i] >>= 1;
+    }
+}
+
+static void decay(core_heatmap_t * hm, int64_t now_us)
+{
+    if (hm->last_decay_us == 0) {
+        hm->last_decay_us = now_us;
+        return;
+    }
+
+    int halvings = 0;
+    while (now_us - hm->last_decay_us >= CORE_HEATMAP_HALF_LIFE_US && halvings < 16) {
+        hm->last_decay_us += CORE_HEATMAP_HALF_LIFE_US;
+        halvings++;
+    }
+    if (halvings == 16) {
+        hm->last_decay_us = now_us;
+    }
+
+    for (int i = 0; i < halvings; i++) {
+        halve(hm->cores, hm->chip_count * hm->core_count);
+        halve(hm->small_cores, hm->chip_count * hm->small_core_count);
+    }
+}
+
+void core_heatmap_nonce(core_heatmap_t * hm, uint8_t asic_nr, uint8_t core_id, uint8_t small_core_id, int64_t now_us)
+{
+    if (hm->cores == NULL) return;
+
+    pthread_mutex_lock(&hm->lock);
+    decay(hm, now_us);
+
+    if (asic_nr >= hm->chip_count || core_id >= hm->core_count || small_core_id >= hm->small_core_count) {
+        hm->dropped++;
+        pthread_mutex_unlock(&hm->lock);
+        return;
+    }
+
+    uint16_t * cores = &hm->cores[asic_nr * hm->core_count];
+    uint16_t * small_cores = &hm->small_cores[asic_nr * hm->small_core_count];
+
+    // halve the whole chip early rather than let one counter saturate
+    if (cores[core_id] == UINT16_MAX || small_cores[small_core_id] == UINT16_MAX) {
+        halve(cores, hm->core_count);
+        halve(small_cores, hm->small_core_count);
+    }
+    cores[core_id]++;
+    small_cores[small_core_id]++;
+
+    pthread_mutex_unlock(&hm->lock);
+}
+
+// Flags the buckets that fall short of a uniform spread, returns the chi-square statistic
+static double test_uniform(const uint16_t * counts, uint8_t * health, int count,
+                           uint32_t * total_out, double * expected_out, uint16_t * weak_out, uint16_t * dead_out)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += counts[i];
+    }
+
+    double expected = (double)total / count;
+    double chi_square = 0;
+    uint16_t weak = 0;
+    uint16_t dead = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (expected > 0) {
+            double diff = counts[i] - expected;
+            chi_square += diff * diff / expected;
+        }
+
+        if (expected < MIN_EXPECTED) {
+            health[i] = CORE_UNKNOWN;
+        } else if (counts[i] == 0) {
+            health[i] = CORE_DEAD;
+            dead++;
+        } else if (counts[i] < expected * WEAK_FRACTION && (counts[i] - expected) / sqrt(expected) < -WEAK_SIGMAS) {
+            health[i] = CORE_WEAK;
+            weak++;
+        } else {
+            health[i] = CORE_OK;
+        }
+    }
+
+    if (total_out) *total_out = total;
+    if (expected_out) *expected_out = expected;
+    if (weak_out) *weak_out = weak;
+    if (dead_out) *dead_out = dead;
+    return chi_square;
+}
+
+// Wilson-Hilferty approximation of the chi-square 99.9% quantile
+static double chi_square_limit(int degrees)
+{
+    if (degrees < 1) return 0;
+    double k = 2.0 / (9.0 * degrees);
+    double root = 1.0 - k + Z_999 * sqrt(k);
+    return degrees * root * root * root;
+}
+
+esp_err_t core_heatmap_get_chip(core_heatmap_t * hm, uint16_t asic_nr, int64_t now_us, core_heatmap_chip_t * chip)
+{
+    if (hm->cores == NULL || asic_nr >= hm->chip_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(chip, 0, sizeof(*chip));
+
+    pthread_mutex_lock(&hm->lock);
+    decay(hm, now_us);
+    memcpy(chip->cores, &hm->cores[asic_nr * hm->core_count], hm->core_count * sizeof(uint16_t));
+    memcpy(chip->small_cores, &hm->small_cores[asic_nr * hm->small_core_count], hm->small_core_count * sizeof(uint16_t));
+    pthread_mutex_unlock(&hm->lock);
+
+    chip->chi_square = test_uniform(chip->cores, chip->core_health, hm->core_count,
+                                    &chip->total, &chip->expected, &chip->weak_cores, &chip->dead_cores);
+    chip->chi_square_limit = chi_square_limit(hm->core_count - 1);
+    test_uniform(chip->small_cores, chip->small_core_health, hm->small_core_count, NULL, NULL, NULL, NULL);
+
+    return ESP_OK;
+}
+
+const char * core_heatmap_health_to_string(core_health_t health)
+{
+    switch (health) {
+        case CORE_UNKNOWN:  return "unknown";
+        case CORE_OK:       return "ok";
+        case CORE_WEAK:     return "weak";
+        case CORE_DEAD:     return "dead";
+    }
+    return "unknown";
+}
@@ -0,0 +1,38 @@
+#include <stdlib.h>
+
+#include "frequency_ramp.h"
+
+void frequency_ramp_init(frequency_ramp_t * ramp, int16_t last_mv)
+{
+    ramp->adaptive = last_mv > 0;
+    ramp->steps = 1;
+    ramp->delay_ms = FREQUENCY_RAMP_DELAY_MS;
+    ramp->last_mv = last_mv;
+    ramp->max_droop_mv = 0;
+}
+
+void frequency_ramp_measured(frequency_ramp_t * ramp, int16_t measured_mv)
+{
+    if (!ramp->adaptive || measured_mv <= 0) {
+        return;
+    }
+
+    // by how much this move alone shifted the rail, up or down
+    int16_t droop_mv = abs(measured_mv - ramp->last_mv);
+    ramp->last_mv = measured_mv;
+    if (droop_mv > ramp->max_droop_mv) {
+        ramp->max_droop_mv = droop_mv;
+    }
+
+    if (droop_mv < FREQUENCY_RAMP_QUIET_MV) {
+        if (ramp->steps < FREQUENCY_RAMP_MAX_STEPS) ramp->steps *= 2;
+        if (ramp->delay_ms > FREQUENCY_RAMP_MIN_DELAY_MS) ramp->delay_ms /= 2;
+    } else if (droop_mv > FREQUENCY_RAMP_DROOP_MV) {
+        if (ramp->steps > 1) ramp->steps /= 2;
+        if (ramp->delay_ms < FREQUENCY_RAMP_MAX_DELAY_MS) ramp->delay_ms *= 2;
+    }
+
+    if (ramp->steps > FREQUENCY_RAMP_MAX_STEPS) ramp->steps = FREQUENCY_RAMP_MAX_STEPS;
+    if (ramp->delay_ms < FREQUENCY_RAMP_MIN_DELAY_MS) ramp->delay_ms = FREQUENCY_RAMP_MIN_DELAY_MS;
+    if (ramp->delay_ms > FREQUENCY_RAMP_MAX_DELAY_MS) ramp->delay_ms = FREQUENCY_RAMP_MAX_DELAY_MS;
+}
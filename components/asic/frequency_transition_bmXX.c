@@ -1,32 +1,53 @@
 #include "frequency_transition_bmXX.h"
+#include "frequency_ramp.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <math.h>
+#include <stdlib.h>
 #include "global_state.h"
 
 #define EPSILON 0.0001f
-#define STEP_SIZE 6.25 // MHz step size
+#define STEP_SIZE FREQUENCY_RAMP_STEP
 
 static const char * TAG = "frequency_transition";
 
-void do_frequency_transition(void * pvParameters, set_hash_frequency_fn set_frequency_fn)
+static int16_t read_core_voltage(GlobalState * GLOBAL_STATE)
+{
+    int16_t (*read_core_voltage_mv)(void *) = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.read_core_voltage_mv;
+
+    return read_core_voltage_mv != NULL ? read_core_voltage_mv(GLOBAL_STATE) : 0;
+}
+
+static void set_chain_frequency(GlobalState * GLOBAL_STATE, asic_chain_t * chain, set_hash_frequency_fn set_frequency_fn, float frequency)
+{
+    chain->frequency = set_frequency_fn(chain, frequency);
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = chain->frequency;
+}
+
+void do_frequency_transition(void * pvParameters, asic_chain_t * chain, set_hash_frequency_fn set_frequency_fn)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
     float target_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
-    float current_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
+    float current_frequency = chain->frequency;
 
     if (fabs(current_frequency - target_frequency) < EPSILON) {
         return;
     }
 
-    if (fabs(target_frequency - current_frequency) < STEP_SIZE) {
+    // a governor step is a single move of the ramp, no settling or logging needed
+    if (fabs(target_frequency - current_frequency) <= STEP_SIZE + EPSILON) {
         current_frequency = target_frequency;
-        GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
+        set_chain_frequency(GLOBAL_STATE, chain, set_frequency_fn, current_frequency);
         return;
     }
 
-    ESP_LOGI(TAG, "Ramping up frequency from %g MHz to %g MHz", current_frequency, target_frequency);
+    ESP_LOGI(TAG, "Ramping chain %d frequency from %g MHz to %g MHz", chain->index, current_frequency, target_frequency);
+
+    int64_t start_us = esp_timer_get_time();
+    frequency_ramp_t ramp;
+    frequency_ramp_init(&ramp, read_core_voltage(GLOBAL_STATE));
 
     int current_step = (target_frequency > current_frequency) ? (int)floor(current_frequency / STEP_SIZE) : (int)ceil(current_frequency / STEP_SIZE);
     int target_step = (target_frequency > current_frequency) ? (int)floor(target_frequency / STEP_SIZE) : (int)ceil(target_frequency / STEP_SIZE);
@@ -36,19 +57,28 @@ void do_frequency_transition(void * pvParameters, set_hash_frequency_fn set_freq
         
         while ((signum > 0 && current_step < target_step) ||
                (signum < 0 && current_step > target_step)) {
-            current_step += signum;
+            int steps = abs(target_step - current_step);
+            current_step += signum * (steps < ramp.steps ? steps : ramp.steps);
 
             current_frequency = current_step * STEP_SIZE;
-            GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
+            set_chain_frequency(GLOBAL_STATE, chain, set_frequency_fn, current_frequency);
             
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            vTaskDelay(ramp.delay_ms / portTICK_PERIOD_MS);
+            if (ramp.adaptive) {
+                frequency_ramp_measured(&ramp, read_core_voltage(GLOBAL_STATE));
+            }
         }
     }
     
     if (fabs(current_frequency - target_frequency) > EPSILON) {
         current_frequency = target_frequency;
-        GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
+        set_chain_frequency(GLOBAL_STATE, chain, set_frequency_fn, current_frequency);
     }
     
-    ESP_LOGI(TAG, "Successfully transitioned to %g MHz", target_frequency);
+    if (ramp.adaptive) {
+        ESP_LOGI(TAG, "Successfully transitioned to %g MHz in %lld ms, largest core voltage shift %d mV",
+                 target_frequency, (esp_timer_get_time() - start_us) / 1000, ramp.max_droop_mv);
+    } else {
+        ESP_LOGI(TAG, "Successfully transitioned to %g MHz in %lld ms", target_frequency, (esp_timer_get_time() - start_us) / 1000);
+    }
 }
@@ -0,0 +1,65 @@
+#include <string.h>
+#include <math.h>
+
+#include "hashrate_ewma.h"
+
+static const float HORIZON_S[HASHRATE_EWMA_HORIZONS] = {
+    [HASHRATE_EWMA_5S] = 5,
+    [HASHRATE_EWMA_1M] = 60,
+    [HASHRATE_EWMA_10M] = 10 * 60,
+    [HASHRATE_EWMA_15M] = 15 * 60,
+    [HASHRATE_EWMA_1H] = 60 * 60,
+    [HASHRATE_EWMA_24H] = 24 * 60 * 60,
+};
+
+static const char * HORIZON_NAME[HASHRATE_EWMA_HORIZONS] = {
+    [HASHRATE_EWMA_5S] = "5s",
+    [HASHRATE_EWMA_1M] = "1m",
+    [HASHRATE_EWMA_10M] = "10m",
+    [HASHRATE_EWMA_15M] = "15m",
+    [HASHRATE_EWMA_1H] = "1h",
+    [HASHRATE_EWMA_24H] = "24h",
+};
+
+void hashrate_ewma_reset(hashrate_ewma_t * ewma)
+{
+    memset(ewma, 0, sizeof(*ewma));
+}
+
+void hashrate_ewma_pause(hashrate_ewma_t * ewma)
+{
+    ewma->last_us = 0;
+}
+
+void hashrate_ewma_update(hashrate_ewma_t * ewma, float hashrate, int64_t time_us)
+{
+    int64_t last_us = ewma->last_us;
+
+    if (last_us == 0 || time_us <= last_us) {
+        // nothing to weigh it by yet, or a stale reading
+        if (last_us == 0) ewma->last_us = time_us;
+        return;
+    }
+    ewma->last_us = time_us;
+
+    float dt_s = (time_us - last_us) / 1e6f;
+    for (int i = 0; i < HASHRATE_EWMA_HORIZONS; i++) {
+        // the share of the horizon this sample stands for
+        float alpha = -expm1f(-dt_s / HORIZON_S[i]);
+        ewma->sum[i] += alpha * (hashrate - ewma->sum[i]);
+        ewma->weight[i] += alpha * (1.0f - ewma->weight[i]);
+    }
+}
+
+float hashrate_ewma_get(const hashrate_ewma_t * ewma, hashrate_ewma_horizon_t horizon)
+{
+    if (horizon >= HASHRATE_EWMA_HORIZONS || ewma->weight[horizon] <= 0) {
+        return 0;
+    }
+    return ewma->sum[horizon] / ewma->weight[horizon];
+}
+
+const char * hashrate_ewma_horizon_name(hashrate_ewma_horizon_t horizon)
+{
+    return horizon < HASHRATE_EWMA_HORIZONS ? HORIZON_NAME[horizon] : "unknown";
+}
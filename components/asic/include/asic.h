@@ -5,14 +5,26 @@
 #include "global_state.h"
 #include "asic_common.h"
 
-uint8_t ASIC_init(GlobalState * GLOBAL_STATE);
-task_result * ASIC_process_work(GlobalState * GLOBAL_STATE);
-int ASIC_set_max_baud(GlobalState * GLOBAL_STATE);
-void ASIC_send_work(GlobalState * GLOBAL_STATE, void * next_job);
+esp_err_t ASIC_chain_setup(GlobalState * GLOBAL_STATE);
+void ASIC_chain_reset(asic_chain_t * chain);
+uint8_t ASIC_init(GlobalState * GLOBAL_STATE, asic_chain_t * chain);
+// Pauses the chain and waits until its result task is off the UART, false
+// if it never got there
+bool ASIC_pause_chain(asic_chain_t * chain);
+// Called by the result task while its chain is paused
+void ASIC_chain_idle(asic_chain_t * chain);
+uint8_t ASIC_soft_reset_chain(GlobalState * GLOBAL_STATE, asic_chain_t * chain);
+task_result * ASIC_process_work(GlobalState * GLOBAL_STATE, asic_chain_t * chain);
+int ASIC_set_max_baud(GlobalState * GLOBAL_STATE, asic_chain_t * chain);
+void ASIC_send_work(GlobalState * GLOBAL_STATE, asic_chain_t * chain, void * next_job);
 void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask);
 void ASIC_set_frequency(GlobalState * GLOBAL_STATE);
 void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE);
+// How often a chain needs new work
+double ASIC_get_chain_job_frequency_ms(GlobalState * GLOBAL_STATE, asic_chain_t * chain);
+// The shortest of the chains' intervals
 double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE);
-void ASIC_read_registers(GlobalState * GLOBAL_STATE);
+// Sends the register reads that are due, returns when the next one is
+int64_t ASIC_poll_registers(GlobalState * GLOBAL_STATE, int64_t now_us);
 
 #endif // ASIC_H
@@ -3,7 +3,15 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "serial.h"
+#include "mining.h"
+#include "register_poll.h"
+#include "chain_health.h"
 
 static const double NONCE_SPACE = 4294967296.0; //  2^32
 
@@ -20,10 +28,15 @@ typedef enum
     REGISTER_PLL_PARAM,      // PLL/clock config readback (BM1370)
 } register_type_t;
 
+// How often each chip has its registers read
+#define REGISTER_POLL_COUNTER_MS 1000   // total count and hashrate, what the hashrate is made of
+#define REGISTER_POLL_DETAIL_MS 5000    // domain and error counts
+
 typedef struct
 {
     // -- job result response
     uint8_t job_id;
+    bm_job * job;            // job the nonce belongs to, checked against the epoch
     uint32_t nonce;
     uint32_t rolled_version;
     // ---- register response
@@ -36,12 +49,84 @@ typedef struct
     uint64_t timestamp_us;
 } task_result;
 
+#define ASIC_MAX_CHAINS SERIAL_MAX_PORTS
+#define ASIC_CHAIN_MAX_CHIPS 128    // addresses are at least 2 apart
+#define ASIC_JOB_SLOTS 128
+#define ASIC_RECEIVE_TIMEOUT_MS 10000   // a result task waits this long for a nonce
+
+// One string of ASICs hanging off its own serial port. Everything the drivers
+// used to keep in file-scope statics lives here so chains can run concurrently.
+typedef struct
+{
+    uint8_t index;
+    serial_port_t * port;
+    uint16_t asic_count;      // chips expected on this chain
+    uint16_t chip_count;      // chips detected during init
+    uint16_t asic_offset;     // board-wide number of the first chip on this chain
+    int address_interval;
+    uint16_t live_count;      // chips hashing, chip_count less the bypassed ones
+    uint8_t chip_addresses[ASIC_CHAIN_MAX_CHIPS];   // by position in the chain
+    uint8_t live_positions[ASIC_CHAIN_MAX_CHIPS];   // position of the n-th chip that hashes
+    uint16_t parked_position;                       // a bypassed chip, answers from the parked address
+    uint8_t job_id;           // last job id handed to the chain
+    uint32_t prev_nonce;      // BM1397 duplicate filter
+    float frequency;          // currently programmed hash frequency in MHz
+
+    // ASIC may not return the nonce in the same order as the jobs were sent
+    // it also may return a previous nonce under some circumstances
+    // so we keep a list of jobs indexed by the job id.
+    // A slot only counts while the generation it was stored in matches the
+    // chain's epoch, so clean jobs invalidate every slot with one increment
+    // and results are checked without taking a lock. The generation is the
+    // epoch of the work the job was built from, not the one it was stored in.
+    // The result task publishes the job it is using in job_in_use, and a
+    // store replacing that job retires it instead of freeing it.
+    _Atomic(bm_job *) * active_jobs;
+    _Atomic uint32_t * job_generations;  // 0 while the slot is empty or being written
+    _Atomic uint32_t job_epoch;          // starts at 1
+    _Atomic(bm_job *) job_in_use;        // last job get_asic_job handed out
+    bm_job * retired_job;                // replaced while in use, freed by a later store
+    _Atomic uint32_t stale_nonces;       // results for jobs of a previous epoch
+    _Atomic uint32_t rx_collisions;      // garbled frames, mostly replies running into each other
+
+    // Set while the chain is soft reset, and left set when the reset failed,
+    // until the next power cycle. No work is sent to a paused chain and
+    // neither results nor registers are read from it. The result task gives
+    // idle once it has seen the pause and is off the UART.
+    _Atomic bool paused;
+    SemaphoreHandle_t idle;
+
+    register_poll_t register_poll;
+    chain_health_t health;
+
+    task_result result;
+} asic_chain_t;
+
+// What the time a chain takes to run through a job depends on
+typedef struct
+{
+    double default_timeout_ms;  // of a single chip
+    float frequency_mhz;
+    uint16_t cores;
+    uint16_t small_cores;
+    bool split_between_cores;   // BM1397, no version rolling, the big cores split the nonce space
+} asic_job_timing_t;
+
 unsigned char _reverse_bits(unsigned char num);
 int _largest_power_of_two(int num);
 int _next_power_of_two(int num);
-int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response_length);
-esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us);
+int count_asic_chips(asic_chain_t * chain, uint16_t chip_id, int chip_id_response_length);
+uint32_t register_poll_period_ms(register_type_t register_type);
+void asic_assign_addresses(asic_chain_t * chain, uint16_t chip_count);
+uint8_t asic_chip_address(const asic_chain_t * chain, uint16_t asic_nr);
+uint16_t asic_chip_from_address(const asic_chain_t * chain, uint8_t address);
+esp_err_t receive_work(asic_chain_t * chain, uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us);
 void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask);
+void store_asic_job(asic_chain_t * chain, uint8_t job_id, bm_job * job);
+bm_job * get_asic_job(asic_chain_t * chain, uint8_t job_id);
+void invalidate_asic_jobs(asic_chain_t * chain);
+uint16_t asic_chain_hashing_chips(const asic_chain_t * chain);
+double asic_chain_job_interval_ms(const asic_chain_t * chain, const asic_job_timing_t * timing);
 double calculate_bm_timeout_ms(float frequency_mhz, size_t asic_count, size_t small_cores, size_t cores, size_t version_size, float timeout_percent, double default_time_ms);
 
 #endif /* ASIC_COMMON_H_ */
@@ -0,0 +1,80 @@
+#ifndef ASIC_EMULATOR_H_
+#define ASIC_EMULATOR_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "serial.h"
+
+// Software stand-in for a chain of BM13xx chips. It speaks the UART protocol
+// through a serial stream, so the mining tasks run without hardware on any
+// target, the Linux host included.
+//
+// Nonces are real: every one returned hashes to at least ticket_difficulty.
+// A PC cannot search at the difficulty the driver programs into the ticket
+// mask, so the search runs at ticket_difficulty instead while the rate at
+// which results come back follows hashrate / ticket mask like a real chain.
+
+// Electrical and thermal behaviour of the emulated chips, so code that tunes
+// frequency and voltage has power, temperature and errors to react to. Power
+// follows static + dynamic * f * V^2, and a chip clocked past what its core
+// voltage sustains returns a growing share of bad hashes.
+typedef struct
+{
+    float static_w;             // per chip, drawn at any frequency
+    float dynamic_w;            // per chip at 500 MHz and 1.2 V
+    float threshold_mv;         // core voltage the chips stop switching at
+    float mhz_per_mv;           // highest clean frequency per mV above the threshold, 0 disables the model
+    float thermal_c_per_w;      // die temperature rise per watt of the chain
+    float ambient_c;
+} asic_emulator_power_model_t;
+
+typedef struct
+{
+    float power_w;              // whole chain
+    float temp_c;
+    float error_fraction;       // of the hashes done
+} asic_emulator_operating_point_t;
+
+typedef struct
+{
+    uint16_t chip_id;           // 0x1397, 0x1366, 0x1368 or 0x1370
+    uint16_t chip_count;
+    uint16_t core_count;        // big cores per chip
+    uint16_t small_core_count;  // small cores per chip
+    uint8_t hash_domains;
+    float hashrate_ghs;         // whole chain, 0 derives it from the programmed PLL frequency
+    double ticket_difficulty;   // difficulty the returned nonces are searched at
+    uint16_t error_permille;    // responses sent with a corrupted crc
+    uint16_t latency_ms;        // delay before every response
+    asic_emulator_power_model_t power_model;
+    float core_voltage_mv;      // until asic_emulator_set_core_voltage
+} asic_emulator_config_t;
+
+typedef struct
+{
+    uint32_t frames_received;
+    uint32_t frames_rejected;   // bad preamble, length or crc
+    uint32_t jobs_received;
+    uint32_t nonces_sent;
+    uint32_t registers_sent;
+    uint32_t errors_injected;
+    uint64_t hashes_computed;
+} asic_emulator_stats_t;
+
+typedef struct asic_emulator asic_emulator_t;
+
+esp_err_t asic_emulator_create(const asic_emulator_config_t * config, asic_emulator_t ** out);
+void asic_emulator_destroy(asic_emulator_t * emulator);
+// Callbacks to hand to SERIAL_attach_stream
+void asic_emulator_get_stream(asic_emulator_t * emulator, serial_stream_t * stream);
+void asic_emulator_get_stats(asic_emulator_t * emulator, asic_emulator_stats_t * stats);
+
+// Stands in for the regulator, the model uses it from the next tick on
+void asic_emulator_set_core_voltage(asic_emulator_t * emulator, float core_voltage_mv);
+// The model at the programmed PLL frequency and the current core voltage
+void asic_emulator_get_operating_point(asic_emulator_t * emulator, asic_emulator_operating_point_t * point);
+
+void asic_emulator_model(const asic_emulator_power_model_t * model, uint16_t chip_count,
+                         float frequency_mhz, float core_voltage_mv, asic_emulator_operating_point_t * point);
+
+#endif /* ASIC_EMULATOR_H_ */
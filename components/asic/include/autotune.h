@@ -0,0 +1,110 @@
+#ifndef AUTOTUNE_H_
+#define AUTOTUNE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Searches the frequency/voltage pair a board runs best at. The engine only
+// decides which point to try next: the caller applies autotune_get_point(),
+// lets the chips settle, averages what it measures there and hands that to
+// autotune_measured(), until autotune_get_point() returns NULL.
+//
+// A coarse sweep walks every voltage up in frequency until the chips stop
+// keeping up or a limit is reached, then a hill climb refines the best point
+// of the sweep one frequency or voltage step at a time.
+
+#define AUTOTUNE_MAX_POINTS 64
+
+typedef enum
+{
+    AUTOTUNE_EFFICIENCY,                    // lowest J/TH
+    AUTOTUNE_HASHRATE,                      // highest hashrate within the limits
+} autotune_objective_t;
+
+typedef enum
+{
+    AUTOTUNE_IDLE,
+    AUTOTUNE_SWEEP,
+    AUTOTUNE_CLIMB,
+    AUTOTUNE_DONE,
+    AUTOTUNE_ABORTED,
+} autotune_state_t;
+
+typedef struct
+{
+    autotune_objective_t objective;
+    float min_frequency;                    // MHz
+    float max_frequency;
+    float frequency_step;                   // hill climb step, the sweep takes bigger ones
+    uint16_t min_voltage;                   // mV
+    uint16_t max_voltage;
+    uint16_t voltage_step;
+    float max_power;                        // W
+    float max_temp;                         // °C
+    float max_error_percentage;
+    float hashrate_per_mhz;                 // GH/s the board makes per MHz
+    float min_hashrate_fraction;            // of the expected hashrate, less counts as unstable
+} autotune_limits_t;
+
+typedef struct
+{
+    float hashrate;                         // GH/s
+    float power;                            // W
+    float temp;                             // hottest chip, °C
+    float error_percentage;
+} autotune_sample_t;
+
+typedef struct
+{
+    float frequency;
+    uint16_t voltage;
+    autotune_sample_t sample;
+    bool stable;                            // within every limit
+    float score;                            // higher is better, only set when stable
+} autotune_point_t;
+
+typedef struct
+{
+    autotune_limits_t limits;
+    autotune_state_t state;
+
+    autotune_point_t current;               // being measured
+    autotune_point_t best;
+    bool has_best;
+
+    autotune_point_t tested[AUTOTUNE_MAX_POINTS];
+    uint16_t tested_count;
+
+    // sweep
+    uint16_t sweep_level;
+    uint16_t sweep_levels;
+    float sweep_stable_frequency;           // highest stable frequency at any voltage so far
+    bool sweep_level_started;               // at least one point measured at the current voltage
+
+    // hill climb
+    autotune_point_t center;
+    uint8_t neighbor;
+    uint16_t climb_count;
+} autotune_t;
+
+void autotune_start(autotune_t * at, const autotune_limits_t * limits);
+
+// The point to apply and measure next, NULL once the search is over
+const autotune_point_t * autotune_get_point(const autotune_t * at);
+
+void autotune_measured(autotune_t * at, const autotune_sample_t * sample);
+
+void autotune_abort(autotune_t * at);
+
+// The best point found, false when no point was stable
+bool autotune_get_best(const autotune_t * at, autotune_point_t * best);
+
+uint8_t autotune_get_progress(const autotune_t * at);
+
+// Joules per terahash of a sample, 0 when it made no hashrate
+float autotune_efficiency(const autotune_sample_t * sample);
+
+const char * autotune_state_to_string(autotune_state_t state);
+const char * autotune_objective_to_string(autotune_objective_t objective);
+
+#endif /* AUTOTUNE_H_ */
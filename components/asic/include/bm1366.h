@@ -21,14 +21,15 @@ typedef struct __attribute__((__packed__))
     uint8_t version[4];
 } BM1366_job;
 
-uint8_t BM1366_init(void * GLOBAL_STATE);
-void BM1366_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1366_set_version_mask(uint32_t version_mask);
-int BM1366_set_max_baud(void);
-int BM1366_set_default_baud(void);
-float BM1366_send_hash_frequency(float frequency);
-task_result * BM1366_process_work(void * GLOBAL_STATE);
-void BM1366_read_registers(void);
-void BM1366_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores);
+uint8_t BM1366_init(void * GLOBAL_STATE, asic_chain_t * chain);
+void BM1366_send_work(asic_chain_t * chain, bm_job * next_bm_job);
+void BM1366_set_version_mask(asic_chain_t * chain, uint32_t version_mask);
+int BM1366_set_max_baud(asic_chain_t * chain);
+int BM1366_set_default_baud(asic_chain_t * chain);
+float BM1366_send_hash_frequency(asic_chain_t * chain, float frequency);
+task_result * BM1366_process_work(asic_chain_t * chain);
+void BM1366_init_register_poll(asic_chain_t * chain);
+void BM1366_read_register(asic_chain_t * chain, uint16_t asic_nr, uint8_t reg);
+void BM1366_set_nonce_space(asic_chain_t * chain, double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores);
 
 #endif /* BM1366_H_ */
@@ -23,13 +23,14 @@ typedef struct __attribute__((__packed__))
     uint8_t midstate3[32];
 } job_packet;
 
-uint8_t BM1397_init(void * GLOBAL_STATE);
-void BM1397_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1397_set_version_mask(uint32_t version_mask);
-int BM1397_set_max_baud(void);
-int BM1397_set_default_baud(void);
-float BM1397_send_hash_frequency(float frequency);
-task_result * BM1397_process_work(void * GLOBAL_STATE);
-void BM1397_read_registers(void);
+uint8_t BM1397_init(void * GLOBAL_STATE, asic_chain_t * chain);
+void BM1397_send_work(asic_chain_t * chain, bm_job * next_bm_job);
+void BM1397_set_version_mask(asic_chain_t * chain, uint32_t version_mask);
+int BM1397_set_max_baud(asic_chain_t * chain);
+int BM1397_set_default_baud(asic_chain_t * chain);
+float BM1397_send_hash_frequency(asic_chain_t * chain, float frequency);
+task_result * BM1397_process_work(asic_chain_t * chain);
+void BM1397_init_register_poll(asic_chain_t * chain);
+void BM1397_read_register(asic_chain_t * chain, uint16_t asic_nr, uint8_t reg);
 
 #endif /* BM1397_H_ */
@@ -0,0 +1,72 @@
+#ifndef CHAIN_HEALTH_H_
+#define CHAIN_HEALTH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Spots chips that stopped returning nonces.
+//
+// Nonces come in at random, at a rate learned from the chain as a whole. A
+// chip only counts as stalled once its silence has become too unlikely for a
+// healthy chip, e^-CHAIN_HEALTH_SIGNIFICANCE or about one in a billion. A
+// stalled chip first gets the chain soft reset, and once that has not helped
+// CHAIN_HEALTH_MAX_RESETS times it is given up on and bypassed. The last
+// chip of a chain cannot be bypassed, it asks for a power cycle instead.
+
+#define CHAIN_HEALTH_SIGNIFICANCE 20.7f             // -ln(1e-9), in expected nonces
+#define CHAIN_HEALTH_MIN_SILENCE_US 10000000LL
+#define CHAIN_HEALTH_MIN_NONCES 100                 // seen before the rate is trusted
+#define CHAIN_HEALTH_MAX_RESETS 2
+
+typedef enum
+{
+    CHIP_HEALTH_OK,
+    CHIP_HEALTH_STALLED,
+    CHIP_HEALTH_BYPASSED,
+} chip_health_state_t;
+
+typedef enum
+{
+    CHAIN_HEALTH_OK,
+    CHAIN_HEALTH_RESET,             // soft reset the chain
+    CHAIN_HEALTH_BYPASS,            // re-address the chain around the bypassed chips
+    CHAIN_HEALTH_POWER_CYCLE,       // nothing left to bypass to
+} chain_health_action_t;
+
+typedef struct
+{
+    int64_t last_nonce_us;      // or when the chain was last started
+    uint8_t resets;             // soft resets since its last nonce
+    chip_health_state_t state;
+} chip_health_t;
+
+typedef struct
+{
+    chip_health_t * chips;
+    uint16_t chip_count;
+    _Atomic uint32_t nonces;    // since the last check
+    uint32_t total_nonces;
+    float rate;                 // nonces per second per chip
+    int64_t last_check_us;
+    uint32_t resets;            // soft resets asked for
+} chain_health_t;
+
+// chips has room for chip_count entries
+void chain_health_init(chain_health_t * health, chip_health_t * chips, uint16_t chip_count);
+
+// Forgets the bypassed chips and the resets, for after a power cycle
+void chain_health_clear(chain_health_t * health);
+
+// Gives every chip a fresh start to prove itself, for after a (re)init
+void chain_health_restart(chain_health_t * health, int64_t now_us);
+
+void chain_health_nonce(chain_health_t * health, uint16_t asic_nr, int64_t time_us);
+
+chain_health_action_t chain_health_check(chain_health_t * health, int64_t now_us);
+
+bool chain_health_is_bypassed(const chain_health_t * health, uint16_t asic_nr);
+
+const char * chip_health_state_to_string(chip_health_state_t state);
+
+#endif /* CHAIN_HEALTH_H_ */
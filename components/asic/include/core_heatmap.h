@@ -0,0 +1,69 @@
+#ifndef CORE_HEATMAP_H_
+#define CORE_HEATMAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "esp_err.h"
+
+// Counts the nonces every core and small core of every chip returns. Work is
+// spread evenly over the cores, so a healthy chip returns nonces uniformly and
+// a core that falls behind its share stands out long before the chip's
+// hashrate drop is visible in the totals.
+//
+// Counters halve every CORE_HEATMAP_HALF_LIFE_US, so the map follows the
+// chips' current state rather than their history since boot.
+
+#define CORE_HEATMAP_MAX_CORES 128          // core id is 7 bits in every nonce format
+#define CORE_HEATMAP_MAX_SMALL_CORES 16
+#define CORE_HEATMAP_HALF_LIFE_US (60 * 60 * 1000000LL)
+
+typedef enum
+{
+    CORE_UNKNOWN,                           // too few nonces on the chip to tell
+    CORE_OK,
+    CORE_WEAK,                              // well below its share of nonces
+    CORE_DEAD,                              // no nonces where plenty were due
+} core_health_t;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+
+    uint16_t chip_count;
+    uint16_t core_count;
+    uint16_t small_core_count;              // per core
+    uint16_t * cores;                       // [chip][core]
+    uint16_t * small_cores;                 // [chip][small core], summed over the cores
+    uint32_t dropped;                       // nonces with ids out of range
+    int64_t last_decay_us;
+} core_heatmap_t;
+
+typedef struct
+{
+    uint32_t total;
+    double expected;                        // nonces per core under a uniform spread
+    double chi_square;                      // against the uniform spread
+    double chi_square_limit;                // 99.9% quantile for core_count - 1 degrees of freedom
+    uint16_t weak_cores;
+    uint16_t dead_cores;
+
+    uint16_t cores[CORE_HEATMAP_MAX_CORES];
+    uint8_t core_health[CORE_HEATMAP_MAX_CORES];
+    uint16_t small_cores[CORE_HEATMAP_MAX_SMALL_CORES];
+    uint8_t small_core_health[CORE_HEATMAP_MAX_SMALL_CORES];
+} core_heatmap_chip_t;
+
+// small_core_count is the chip's total, as the datasheets give it
+esp_err_t core_heatmap_init(core_heatmap_t * hm, uint16_t chip_count, uint16_t core_count, uint16_t small_core_count);
+
+// A chip returned a nonce for a valid job
+void core_heatmap_nonce(core_heatmap_t * hm, uint8_t asic_nr, uint8_t core_id, uint8_t small_core_id, int64_t now_us);
+
+// Copies a chip's counters and tests them against a uniform spread
+esp_err_t core_heatmap_get_chip(core_heatmap_t * hm, uint16_t asic_nr, int64_t now_us, core_heatmap_chip_t * chip);
+
+const char * core_heatmap_health_to_string(core_health_t health);
+
+#endif /* CORE_HEATMAP_H_ */
@@ -0,0 +1,35 @@
+#ifndef FREQUENCY_RAMP_H_
+#define FREQUENCY_RAMP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Paces the frequency ramp by the core voltage: every move is followed by a
+// reading, and the ramp takes bigger moves with less settling time in
+// between while the rail barely moves, and backs off when it sags. Without
+// a reading it keeps to the fixed pace of one grid step per 100 ms.
+
+#define FREQUENCY_RAMP_STEP 6.25f           // MHz, the PLL table's grid
+#define FREQUENCY_RAMP_MAX_STEPS 8          // grid steps per move
+#define FREQUENCY_RAMP_DELAY_MS 100         // the fixed pace, and where an adaptive ramp starts
+#define FREQUENCY_RAMP_MIN_DELAY_MS 20
+#define FREQUENCY_RAMP_MAX_DELAY_MS 200
+#define FREQUENCY_RAMP_QUIET_MV 10          // a move that shifts the rail less than this speeds up
+#define FREQUENCY_RAMP_DROOP_MV 25          // one that shifts it more than this slows down
+
+typedef struct
+{
+    bool adaptive;
+    int steps;                  // grid steps per move
+    uint32_t delay_ms;          // after each move
+    int16_t last_mv;
+    int16_t max_droop_mv;       // largest shift seen, for the log
+} frequency_ramp_t;
+
+// last_mv is the core voltage before the ramp, 0 or less when there is none
+void frequency_ramp_init(frequency_ramp_t * ramp, int16_t last_mv);
+
+// Feeds the reading taken delay_ms after a move, adapts the next move
+void frequency_ramp_measured(frequency_ramp_t * ramp, int16_t measured_mv);
+
+#endif /* FREQUENCY_RAMP_H_ */
@@ -2,6 +2,7 @@
 #define FREQUENCY_TRANSITION_H
 
 #include <stdbool.h>
+#include "asic_common.h"
 
 extern const char *FREQUENCY_TRANSITION_TAG;
 
@@ -11,9 +12,10 @@ extern const char *FREQUENCY_TRANSITION_TAG;
  * This type defines the signature for functions that set the hash frequency
  * for different ASIC types.
  * 
+ * @param chain The chain to program
  * @param frequency The frequency to set in MHz
  */
-typedef float (*set_hash_frequency_fn)(float frequency);
+typedef float (*set_hash_frequency_fn)(asic_chain_t * chain, float frequency);
 
 /**
  * @brief Transition the ASIC frequency to a target value
@@ -22,8 +24,9 @@ typedef float (*set_hash_frequency_fn)(float frequency);
  * stepping up or down in increments to ensure stability.
  * 
  * @param pvParameters Pointer to the GlobalState structure
+ * @param chain The chain to ramp, starting from its currently programmed frequency
  * @param set_frequency_fn Function pointer to the appropriate ASIC's set_hash_frequency function
  */
-void do_frequency_transition(void * pvParameters, set_hash_frequency_fn set_frequency_fn);
+void do_frequency_transition(void * pvParameters, asic_chain_t * chain, set_hash_frequency_fn set_frequency_fn);
 
 #endif // FREQUENCY_TRANSITION_H
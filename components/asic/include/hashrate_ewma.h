@@ -0,0 +1,45 @@
+#ifndef HASHRATE_EWMA_H_
+#define HASHRATE_EWMA_H_
+
+#include <stdint.h>
+
+// Exponentially time-decayed hashrate averages over several horizons.
+//
+// Every sample is weighed by the time it stands for, the interval since the
+// one before it, so polls that come late or get missed do not skew the
+// averages. Until a horizon has seen its own length of samples it reports
+// the plain average of what it has, rather than one pulled towards zero.
+// A pause is skipped over: the next sample after hashrate_ewma_pause() only
+// sets the clock, so the time spent stopped counts for nothing.
+
+typedef enum
+{
+    HASHRATE_EWMA_5S,
+    HASHRATE_EWMA_1M,
+    HASHRATE_EWMA_10M,
+    HASHRATE_EWMA_15M,
+    HASHRATE_EWMA_1H,
+    HASHRATE_EWMA_24H,
+    HASHRATE_EWMA_HORIZONS,
+} hashrate_ewma_horizon_t;
+
+typedef struct
+{
+    float sum[HASHRATE_EWMA_HORIZONS];          // decayed sum of samples times their weight
+    float weight[HASHRATE_EWMA_HORIZONS];       // decayed sum of the weights, 1 once full
+    int64_t last_us;                            // 0 after a reset or pause
+} hashrate_ewma_t;
+
+void hashrate_ewma_reset(hashrate_ewma_t * ewma);
+
+// Keeps the averages but skips the time until the next sample
+void hashrate_ewma_pause(hashrate_ewma_t * ewma);
+
+void hashrate_ewma_update(hashrate_ewma_t * ewma, float hashrate, int64_t time_us);
+
+float hashrate_ewma_get(const hashrate_ewma_t * ewma, hashrate_ewma_horizon_t horizon);
+
+// "5s", "1m", ..., for the API
+const char * hashrate_ewma_horizon_name(hashrate_ewma_horizon_t horizon);
+
+#endif /* HASHRATE_EWMA_H_ */
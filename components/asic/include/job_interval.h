@@ -0,0 +1,82 @@
+#ifndef JOB_INTERVAL_H_
+#define JOB_INTERVAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "asic_common.h"
+
+// Adapts the time between jobs sent to the chips to what the chips report
+// back, starting from the static ASIC_get_asic_job_frequency_ms() value.
+//
+// - duplicate nonces mean the chips went over the same space twice
+// - nonces thinning out in the second half of a job's life mean its space
+//   is running dry before the next job arrives
+// - a long wait for the first nonce of a new job means jobs are replaced
+//   before the chips get going
+//
+// The first two shorten the interval, the third lengthens it. With none of
+// them the interval slowly grows to spare UART bandwidth until one shows up.
+
+#define JOB_INTERVAL_DUPLICATE_HISTORY 64
+
+typedef enum
+{
+    JOB_INTERVAL_BASELINE,              // adaptive mode off, or not enough data yet
+    JOB_INTERVAL_DUPLICATES,
+    JOB_INTERVAL_EXHAUSTED,
+    JOB_INTERVAL_SLOW_PICKUP,
+    JOB_INTERVAL_STEADY,
+} job_interval_reason_t;
+
+typedef struct
+{
+    int64_t sent_us;
+    float interval_ms;                  // interval in effect when the job was sent
+    bool has_nonce;
+} job_interval_slot_t;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+
+    double base_ms;
+    double scale;                       // interval = base * scale
+    job_interval_reason_t reason;
+    uint32_t changes;
+
+    // current evaluation window
+    int64_t window_start_us;
+    uint32_t jobs;
+    uint32_t chains;                    // bit per chain that was sent a job
+    uint32_t nonces;
+    uint32_t duplicates;
+    uint32_t early_nonces;              // first half of the job's interval
+    uint32_t late_nonces;
+    uint32_t pickups;
+    double pickup_ms_total;
+
+    job_interval_slot_t slots[ASIC_MAX_CHAINS][ASIC_JOB_SLOTS];
+    uint64_t recent[ASIC_MAX_CHAINS][JOB_INTERVAL_DUPLICATE_HISTORY];
+    uint8_t recent_head[ASIC_MAX_CHAINS];
+} job_interval_t;
+
+void job_interval_init(job_interval_t * ji);
+
+// A job went out on a chain's slot
+void job_interval_job_sent(job_interval_t * ji, uint8_t chain, uint8_t job_id, int64_t now_us);
+
+// A chip returned a nonce for a valid job
+void job_interval_nonce(job_interval_t * ji, uint8_t chain, uint8_t job_id, const bm_job * job,
+                        uint32_t nonce, uint32_t rolled_version, int64_t timestamp_us);
+
+// Returns the interval to use from now on. base_ms is the static value, adaptive
+// off resets to it.
+double job_interval_update(job_interval_t * ji, double base_ms, bool adaptive, int64_t now_us);
+
+double job_interval_get_ms(job_interval_t * ji);
+job_interval_reason_t job_interval_get_reason(job_interval_t * ji);
+const char * job_interval_reason_to_string(job_interval_reason_t reason);
+
+#endif /* JOB_INTERVAL_H_ */
@@ -6,6 +6,13 @@
 
 #define FREQ_MULT 25.0 // MHz
 
+// Frequencies on this grid, the ramp's, up to PLL_TABLE_MAX_FREQ are looked
+// up in a table built on first use for each divider range, anything else is
+// searched for every time
+#define PLL_TABLE_STEP 6.25f            // MHz
+#define PLL_TABLE_MAX_FREQ 1000.0f      // MHz
+#define PLL_TABLE_RANGES 4              // divider ranges, one per chip family
+
 void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, 
                         uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
                         float *actual_freq);
@@ -0,0 +1,44 @@
+#ifndef POWER_GOVERNOR_H_
+#define POWER_GOVERNOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Keeps the board's measured power under a cap by running the chips below
+// the requested frequency, in PLL steps, instead of stopping them.
+//
+// Over the cap the frequency drops in proportion to the overshoot, as the
+// chips' power follows their frequency. Under the cap by more than the
+// headroom it climbs back one step at a time until the requested frequency
+// is reached again, so it settles just below the cap without hunting. Every
+// step rewrites the PLL and nonce space of each chain, so steps up are spaced
+// further apart than steps down.
+
+#define POWER_GOVERNOR_STEP 6.25f               // MHz, the frequency ramp's step
+#define POWER_GOVERNOR_HEADROOM 0.03f           // of the cap, kept free before stepping up
+#define POWER_GOVERNOR_INTERVAL_US 1000000LL    // between adjustments, for the power to follow
+#define POWER_GOVERNOR_UP_INTERVAL_US 5000000LL // before a step up, the least time at a frequency
+#define POWER_GOVERNOR_TAU_US 2000000LL         // power reading filter time constant
+
+typedef struct
+{
+    float cap;                  // W, 0 leaves the frequency alone
+    float min_frequency;        // never governed below this
+    float frequency;            // governed frequency, 0 until the first update
+    float power;                // filtered power reading
+    bool limiting;              // running below the requested frequency
+    int64_t last_sample_us;
+    int64_t last_change_us;
+} power_governor_t;
+
+void power_governor_init(power_governor_t * gov, float cap, float min_frequency);
+
+void power_governor_set_cap(power_governor_t * gov, float cap);
+
+// Forgets the power readings, for when the chips were stopped
+void power_governor_reset(power_governor_t * gov);
+
+// Feeds a power reading, returns the frequency to run at instead of the requested one
+float power_governor_update(power_governor_t * gov, float power, float requested_frequency, int64_t now_us);
+
+#endif /* POWER_GOVERNOR_H_ */
@@ -0,0 +1,54 @@
+#ifndef REGISTER_POLL_H_
+#define REGISTER_POLL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Schedules the register reads of a chain one chip at a time, rather than
+// broadcasting every read to the whole chain at once and having all the
+// replies come back in a burst between the nonces.
+//
+// Every register has its own period, which is cut into one slot per chip,
+// and the registers are offset against each other so their slots do not
+// line up. A chip that is skipped leaves its slot empty, the others keep
+// their pace. A poll that falls behind picks up from now instead of
+// catching up in a burst.
+
+#define REGISTER_POLL_MAX_REGISTERS 8
+#define REGISTER_POLL_MAX_ASICS 128
+
+typedef struct
+{
+    uint8_t address;
+    int64_t slot_us;        // period / chips
+    int64_t next_us;        // when the next read is due
+    uint16_t next_asic;
+} register_poll_register_t;
+
+typedef struct
+{
+    register_poll_register_t registers[REGISTER_POLL_MAX_REGISTERS];
+    int register_count;
+    uint16_t asic_count;
+    uint32_t skip[REGISTER_POLL_MAX_ASICS / 32];
+} register_poll_t;
+
+void register_poll_init(register_poll_t * poll, uint16_t asic_count);
+
+// Each chip has the register read once per period
+bool register_poll_add(register_poll_t * poll, uint8_t address, uint32_t period_ms);
+
+// Lays the slots out from now on
+void register_poll_start(register_poll_t * poll, int64_t now_us);
+
+void register_poll_skip(register_poll_t * poll, uint16_t asic_nr, bool skip);
+
+bool register_poll_is_skipped(const register_poll_t * poll, uint16_t asic_nr);
+
+// Hands out a read that is due by now, false when there is none
+bool register_poll_next(register_poll_t * poll, int64_t now_us, uint8_t * address, uint16_t * asic_nr);
+
+// When the next read is due, 0 when there is nothing to poll
+int64_t register_poll_next_due_us(const register_poll_t * poll);
+
+#endif /* REGISTER_POLL_H_ */
@@ -1,7 +1,11 @@
 #ifndef SERIAL_H_
 #define SERIAL_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "sdkconfig.h"
 
 typedef enum
 {
@@ -11,12 +15,54 @@ typedef enum
 
 #define UART_FREQ 115200
 
-int SERIAL_send(uint8_t *, int, bool);
-esp_err_t SERIAL_init(void);
-void SERIAL_debug_rx(void);
-int16_t SERIAL_rx(uint8_t *, uint16_t, uint16_t);
-void SERIAL_clear_buffer(void);
-esp_err_t SERIAL_set_baud(int baud);
-bool SERIAL_is_initialized(void);
+#ifdef CONFIG_ASIC_CHAIN_COUNT
+#define SERIAL_MAX_PORTS CONFIG_ASIC_CHAIN_COUNT
+#else
+#define SERIAL_MAX_PORTS 1
+#endif
+
+typedef enum
+{
+    SERIAL_BACKEND_UART = 0,    // ESP32 UART peripheral
+    SERIAL_BACKEND_FD = 1,      // POSIX file descriptor (pty, socketpair, ...)
+    SERIAL_BACKEND_STREAM = 2,  // functions of the caller, an emulated chain or a test
+} serial_backend_t;
+
+// A byte stream in place of the UART, receive keeps the contract of
+// uart_read_bytes: it returns once size bytes arrived or the timeout expired
+typedef struct
+{
+    int (*send)(void * context, const uint8_t * data, int len);
+    int16_t (*receive)(void * context, uint8_t * buf, uint16_t size, uint16_t timeout_ms);
+    void * context;
+} serial_stream_t;
+
+typedef struct
+{
+    uint8_t index;
+    serial_backend_t backend;
+    int uart_num;
+    int tx_pin;
+    int rx_pin;
+    // SERIAL_BACKEND_FD only
+    int fd;
+    int peer_fd;    // slave side of a pty opened by SERIAL_open_pty, kept open so reads don't fail with EIO
+    // SERIAL_BACKEND_STREAM only
+    serial_stream_t stream;
+    bool ready;     // FD and STREAM, once initialized
+} serial_port_t;
+
+serial_port_t * SERIAL_get_port(uint8_t index);
+esp_err_t SERIAL_attach_fd(serial_port_t * port, int fd);
+esp_err_t SERIAL_attach_stream(serial_port_t * port, const serial_stream_t * stream);
+esp_err_t SERIAL_open_pty(serial_port_t * port, char * slave_path, size_t slave_path_len);
+
+int SERIAL_send(serial_port_t * port, uint8_t *, int, bool);
+esp_err_t SERIAL_init(serial_port_t * port);
+void SERIAL_debug_rx(serial_port_t * port);
+int16_t SERIAL_rx(serial_port_t * port, uint8_t *, uint16_t, uint16_t);
+void SERIAL_clear_buffer(serial_port_t * port);
+esp_err_t SERIAL_set_baud(serial_port_t * port, int baud);
+bool SERIAL_is_initialized(serial_port_t * port);
 
 #endif /* SERIAL_H_ */
@@ -0,0 +1,46 @@
+#ifndef THERMAL_GOVERNOR_H_
+#define THERMAL_GOVERNOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Keeps the chips and the regulator out of the overheat stop by running the
+// chips below the requested frequency while they are close to their limits.
+//
+// It works on headroom, the degrees left before the nearest throttle limit,
+// and looks ahead along its trend: a board heating up quickly is slowed down
+// before it gets close, one that is still hot but cooling is left alone. As
+// long as the fan can still spin up, only a trend that would reach the limit
+// itself is acted on, the rest is the fan controller's job. Frequency comes
+// back one step at a time once the headroom has grown past the margin again.
+
+#define THERMAL_GOVERNOR_STEP 6.25f                 // MHz, the frequency ramp's step
+#define THERMAL_GOVERNOR_MARGIN 5.0f                // °C of headroom to keep
+#define THERMAL_GOVERNOR_HYSTERESIS 3.0f            // °C past the margin before stepping up
+#define THERMAL_GOVERNOR_HORIZON_US 10000000LL      // how far ahead the trend is followed
+
+typedef struct
+{
+    float min_frequency;        // never governed below this
+    float frequency;            // governed frequency, 0 until the first update
+    float headroom;             // filtered, °C
+    float slope;                // filtered, °C of headroom per second
+    float predicted;            // headroom expected at the horizon
+    bool limiting;              // running below the requested frequency
+    int64_t last_sample_us;
+    int64_t last_slope_us;
+    float last_slope_headroom;
+    int64_t last_change_us;
+} thermal_governor_t;
+
+void thermal_governor_init(thermal_governor_t * gov, float min_frequency);
+
+// Forgets the temperature history, for when the chips were stopped
+void thermal_governor_reset(thermal_governor_t * gov);
+
+// Feeds the current headroom, returns the frequency to run at instead of the
+// requested one. fan_headroom tells whether the fan can still spin up.
+float thermal_governor_update(thermal_governor_t * gov, float headroom, bool fan_headroom,
+                              float requested_frequency, int64_t now_us);
+
+#endif /* THERMAL_GOVERNOR_H_ */
@@ -0,0 +1,202 @@
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "job_interval.h"
+
+#define MIN_WINDOW_US (10 * 1000000LL)
+#define MAX_WINDOW_US (120 * 1000000LL)
+#define MIN_WINDOW_NONCES 32
+#define MIN_DECISION_NONCES 8
+#define MIN_HALF_NONCES 16
+#define MIN_PICKUPS 8
+
+#define MIN_SCALE 0.125
+#define MAX_SCALE 2.0
+#define SHORTEN 0.75
+#define LENGTHEN 1.1
+#define PICKUP_LENGTHEN 1.25
+
+static const char * TAG = "job_interval";
+
+static void reset_window(job_interval_t * ji, int64_t now_us)
+{
+    ji->window_start_us = now_us;
+    ji->jobs = 0;
+    ji->chains = 0;
+    ji->nonces = 0;
+    ji->duplicates = 0;
+    ji->early_nonces = 0;
+    ji->late_nonces = 0;
+    ji->pickups = 0;
+    ji->pickup_ms_total = 0;
+}
+
+void job_interval_init(job_interval_t * ji)
+{
+    memset(ji, 0, sizeof(*ji));
+    pthread_mutex_init(&ji->lock, NULL);
+    ji->scale = 1.0;
+    ji->reason = JOB_INTERVAL_BASELINE;
+}
+
+void job_interval_job_sent(job_interval_t * ji, uint8_t chain, uint8_t job_id, int64_t now_us)
+{
+    if (chain >= ASIC_MAX_CHAINS || job_id >= ASIC_JOB_SLOTS) return;
+
+    pthread_mutex_lock(&ji->lock);
+    job_interval_slot_t * slot = &ji->slots[chain][job_id];
+    slot->sent_us = now_us;
+    slot->interval_ms = ji->base_ms * ji->scale;
+    slot->has_nonce = false;
+    ji->jobs++;
+    ji->chains |= 1u << chain;
+    pthread_mutex_unlock(&ji->lock);
+}
+
+// FNV-1a over what makes a nonce unique: the header it completes
+static uint64_t fingerprint(const bm_job * job, uint32_t nonce, uint32_t rolled_version)
+{
+    uint32_t words[5] = {nonce, rolled_version, job->ntime};
+    memcpy(&words[3], job->merkle_root, 8);
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint8_t * bytes = (const uint8_t *)words;
+    for (size_t i = 0; i < sizeof(words); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+void job_interval_nonce(job_interval_t * ji, uint8_t chain, uint8_t job_id, const bm_job * job,
+                        uint32_t nonce, uint32_t rolled_version, int64_t timestamp_us)
+{
+    if (chain >= ASIC_MAX_CHAINS || job_id >= ASIC_JOB_SLOTS) return;
+
+    uint64_t hash = fingerprint(job, nonce, rolled_version);
+
+    pthread_mutex_lock(&ji->lock);
+    ji->nonces++;
+
+    bool duplicate = false;
+    for (int i = 0; i < JOB_INTERVAL_DUPLICATE_HISTORY; i++) {
+        if (ji->recent[chain][i] == hash) {
+            duplicate = true;
+            break;
+        }
+    }
+    if (duplicate) {
+        ji->duplicates++;
+    } else {
+        ji->recent[chain][ji->recent_head[chain]] = hash;
+        ji->recent_head[chain] = (ji->recent_head[chain] + 1) % JOB_INTERVAL_DUPLICATE_HISTORY;
+    }
+
+    job_interval_slot_t * slot = &ji->slots[chain][job_id];
+    if (slot->sent_us != 0 && slot->interval_ms > 0) {
+        double age_ms = (timestamp_us - slot->sent_us) / 1000.0;
+        if (age_ms < slot->interval_ms / 2) {
+            ji->early_nonces++;
+        } else {
+            ji->late_nonces++;
+        }
+        if (!slot->has_nonce) {
+            slot->has_nonce = true;
+            ji->pickups++;
+            ji->pickup_ms_total += age_ms > 0 ? age_ms : 0;
+        }
+    }
+    pthread_mutex_unlock(&ji->lock);
+}
+
+static job_interval_reason_t decide(job_interval_t * ji, double elapsed_ms, double * factor)
+{
+    double interval_ms = ji->base_ms * ji->scale;
+
+    if (ji->duplicates * 50 > ji->nonces) {
+        *factor = SHORTEN;
+        return JOB_INTERVAL_DUPLICATES;
+    }
+    if (ji->early_nonces >= MIN_HALF_NONCES && ji->late_nonces * 2 < ji->early_nonces) {
+        *factor = SHORTEN;
+        return JOB_INTERVAL_EXHAUSTED;
+    }
+    if (ji->pickups >= MIN_PICKUPS && ji->chains != 0) {
+        // Compare against the wait a steady nonce stream would give anyway,
+        // so rare nonces at a high ticket difficulty do not count as slow.
+        int chains = __builtin_popcount(ji->chains);
+        double nonce_gap_ms = elapsed_ms * chains / ji->nonces;
+        double pickup_ms = ji->pickup_ms_total / ji->pickups;
+        if (pickup_ms - nonce_gap_ms > interval_ms / 4) {
+            *factor = PICKUP_LENGTHEN;
+            return JOB_INTERVAL_SLOW_PICKUP;
+        }
+    }
+    *factor = LENGTHEN;
+    return JOB_INTERVAL_STEADY;
+}
+
+double job_interval_update(job_interval_t * ji, double base_ms, bool adaptive, int64_t now_us)
+{
+    pthread_mutex_lock(&ji->lock);
+    ji->base_ms = base_ms;
+
+    if (!adaptive) {
+        ji->scale = 1.0;
+        ji->reason = JOB_INTERVAL_BASELINE;
+        reset_window(ji, now_us);
+    } else if (ji->window_start_us == 0) {
+        reset_window(ji, now_us);
+    } else {
+        int64_t elapsed_us = now_us - ji->window_start_us;
+        bool enough = ji->nonces >= MIN_WINDOW_NONCES || elapsed_us >= MAX_WINDOW_US;
+        if (elapsed_us >= MIN_WINDOW_US && enough) {
+            if (ji->nonces >= MIN_DECISION_NONCES) {
+                double factor;
+                ji->reason = decide(ji, elapsed_us / 1000.0, &factor);
+
+                double scale = ji->scale * factor;
+                if (scale < MIN_SCALE) scale = MIN_SCALE;
+                if (scale > MAX_SCALE) scale = MAX_SCALE;
+                if (scale != ji->scale) {
+                    ESP_LOGI(TAG, "Job interval %.0f -> %.0f ms (%s, %lu jobs, %lu nonces, %lu duplicates, %lu/%lu early/late)",
+                             base_ms * ji->scale, base_ms * scale, job_interval_reason_to_string(ji->reason),
+                             (unsigned long)ji->jobs, (unsigned long)ji->nonces, (unsigned long)ji->duplicates,
+                             (unsigned long)ji->early_nonces, (unsigned long)ji->late_nonces);
+                    ji->scale = scale;
+                    ji->changes++;
+                }
+            }
+            reset_window(ji, now_us);
+        }
+    }
+
+    double interval_ms = ji->base_ms * ji->scale;
+    pthread_mutex_unlock(&ji->lock);
+    return interval_ms;
+}
+
+double job_interval_get_ms(job_interval_t * ji)
+{
+    pthread_mutex_lock(&ji->lock);
+    double interval_ms = ji->base_ms * ji->scale;
+    pthread_mutex_unlock(&ji->lock);
+    return interval_ms;
+}
+
+job_interval_reason_t job_interval_get_reason(job_interval_t * ji)
+{
+    return ji->reason;
+}
+
+const char * job_interval_reason_to_string(job_interval_reason_t reason)
+{
+    switch (reason) {
+        case JOB_INTERVAL_BASELINE:     return "baseline";
+        case JOB_INTERVAL_DUPLICATES:   return "duplicate nonces";
+        case JOB_INTERVAL_EXHAUSTED:    return "nonce space exhausted";
+        case JOB_INTERVAL_SLOW_PICKUP:  return "slow job pickup";
+        case JOB_INTERVAL_STEADY:       return "steady";
+    }
+    return "unknown";
+}
@@ -8,13 +8,34 @@
 
 #define EPSILON 0.0001f
 
+// 0 to PLL_TABLE_MAX_FREQ on the grid
+#define PLL_TABLE_SIZE 161
+
+typedef struct
+{
+    uint8_t fb_divider;
+    uint8_t refdiv;
+    uint8_t postdiv1;
+    uint8_t postdiv2;
+} pll_setting_t;
+
+typedef struct
+{
+    uint16_t fb_divider_min;
+    uint16_t fb_divider_max;
+    pll_setting_t settings[PLL_TABLE_SIZE];     // index i is i * PLL_TABLE_STEP
+} pll_table_t;
+
 static const char * TAG = "pll";
 
-void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, 
-                        uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
-                        float *actual_freq) 
+// Built the first time a family sets its frequency, during ASIC init,
+// before anything else can ramp
+static pll_table_t tables[PLL_TABLE_RANGES];
+static int table_count;
+
+static void search_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max,
+                              pll_setting_t * setting)
 {
-    float best_freq = 0;
     uint8_t best_refdiv = 0, best_fb_divider = 0, best_postdiv1 = 0, best_postdiv2 = 0;
     float min_diff = FLT_MAX;
     float min_vco_freq = FLT_MAX;
@@ -40,7 +61,6 @@ void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_
                         min_diff = curr_diff;
                         min_vco_freq = vco_freq;
                         min_postdiv = postdiv1 * postdiv2;
-                        best_freq = new_freq;
                         best_refdiv = refdiv;
                         best_fb_divider = fb_divider;
                         best_postdiv1 = postdiv1;
@@ -51,11 +71,61 @@ void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_
         }
     }
 
-    ESP_LOGI(TAG, "Frequency: %g MHz (fb_divider: %d, refdiv: %d, postdiv1: %d, postdiv2: %d)", best_freq, best_fb_divider, best_refdiv, best_postdiv1, best_postdiv2);
+    setting->fb_divider = best_fb_divider;
+    setting->refdiv = best_refdiv;
+    setting->postdiv1 = best_postdiv1;
+    setting->postdiv2 = best_postdiv2;
+}
+
+static const pll_table_t * get_table(uint16_t fb_divider_min, uint16_t fb_divider_max)
+{
+    for (int i = 0; i < table_count; i++) {
+        if (tables[i].fb_divider_min == fb_divider_min && tables[i].fb_divider_max == fb_divider_max) {
+            return &tables[i];
+        }
+    }
+    if (table_count == PLL_TABLE_RANGES) {
+        return NULL;
+    }
+
+    pll_table_t * table = &tables[table_count];
+    table->fb_divider_min = fb_divider_min;
+    table->fb_divider_max = fb_divider_max;
+    for (int i = 0; i < PLL_TABLE_SIZE; i++) {
+        search_parameters(i * PLL_TABLE_STEP, fb_divider_min, fb_divider_max, &table->settings[i]);
+    }
+    table_count++;
+
+    ESP_LOGI(TAG, "Built the table for dividers %u-%u up to %g MHz", fb_divider_min, fb_divider_max, PLL_TABLE_MAX_FREQ);
+    return table;
+}
+
+void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, 
+                        uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
+                        float *actual_freq) 
+{
+    pll_setting_t setting;
+
+    float index = roundf(target_freq / PLL_TABLE_STEP);
+    const pll_table_t * table = NULL;
+    if (fabsf(target_freq - index * PLL_TABLE_STEP) < EPSILON && index >= 0 && index < PLL_TABLE_SIZE) {
+        table = get_table(fb_divider_min, fb_divider_max);
+    }
+
+    if (table != NULL) {
+        setting = table->settings[(int)index];
+    } else {
+        search_parameters(target_freq, fb_divider_min, fb_divider_max, &setting);
+    }
+
+    uint16_t divider = setting.refdiv * setting.postdiv1 * setting.postdiv2;
+    float best_freq = divider == 0 ? 0 : FREQ_MULT * setting.fb_divider / divider;
+
+    ESP_LOGD(TAG, "Frequency: %g MHz (fb_divider: %d, refdiv: %d, postdiv1: %d, postdiv2: %d)", best_freq, setting.fb_divider, setting.refdiv, setting.postdiv1, setting.postdiv2);
 
     *actual_freq = best_freq;
-    *fb_divider = best_fb_divider;
-    *refdiv = best_refdiv;
-    *postdiv1 = best_postdiv1;
-    *postdiv2 = best_postdiv2;
+    *fb_divider = setting.fb_divider;
+    *refdiv = setting.refdiv;
+    *postdiv1 = setting.postdiv1;
+    *postdiv2 = setting.postdiv2;
 }
@@ -0,0 +1,82 @@
+#include <string.h>
+#include <math.h>
+
+#include "esp_log.h"
+
+#include "power_governor.h"
+
+static const char * TAG = "power_governor";
+
+void power_governor_init(power_governor_t * gov, float cap, float min_frequency)
+{
+    memset(gov, 0, sizeof(*gov));
+    gov->cap = cap;
+    gov->min_frequency = min_frequency;
+}
+
+void power_governor_set_cap(power_governor_t * gov, float cap)
+{
+    if (cap != gov->cap) {
+        ESP_LOGI(TAG, "Power cap set to %.1f W", cap);
+    }
+    gov->cap = cap;
+}
+
+void power_governor_reset(power_governor_t * gov)
+{
+    gov->power = 0;
+    gov->last_sample_us = 0;
+}
+
+float power_governor_update(power_governor_t * gov, float power, float requested_frequency, int64_t now_us)
+{
+    if (gov->last_sample_us == 0) {
+        gov->power = power;
+    } else {
+        float dt = now_us - gov->last_sample_us;
+        gov->power += dt / (POWER_GOVERNOR_TAU_US + dt) * (power - gov->power);
+    }
+    gov->last_sample_us = now_us;
+
+    // a lower request is followed at once
+    if (gov->cap <= 0 || gov->frequency <= 0 || gov->frequency > requested_frequency) {
+        gov->frequency = requested_frequency;
+    }
+
+    if (gov->cap > 0 && now_us - gov->last_change_us >= POWER_GOVERNOR_INTERVAL_US) {
+        float frequency = gov->frequency;
+
+        if (gov->power > gov->cap) {
+            frequency = floorf(gov->frequency * gov->cap / gov->power / POWER_GOVERNOR_STEP) * POWER_GOVERNOR_STEP;
+            if (frequency > gov->frequency - POWER_GOVERNOR_STEP) {
+                frequency = gov->frequency - POWER_GOVERNOR_STEP;
+            }
+        } else if (gov->power < gov->cap * (1.0f - POWER_GOVERNOR_HEADROOM) && gov->frequency < requested_frequency
+                   && now_us - gov->last_change_us >= POWER_GOVERNOR_UP_INTERVAL_US) {
+            frequency = (floorf(gov->frequency / POWER_GOVERNOR_STEP) + 1) * POWER_GOVERNOR_STEP;
+        }
+
+        if (frequency < gov->min_frequency) frequency = gov->min_frequency;
+        if (frequency > requested_frequency) frequency = requested_frequency;
+
+        if (frequency != gov->frequency) {
+            ESP_LOGD(TAG, "%.1f W against a %.1f W cap: %g MHz -> %g MHz", gov->power, gov->cap, gov->frequency, frequency);
+            // the filtered reading still holds the old frequency's power
+            gov->power *= frequency / gov->frequency;
+            gov->frequency = frequency;
+            gov->last_change_us = now_us;
+        }
+    }
+
+    bool limiting = gov->frequency < requested_frequency;
+    if (limiting != gov->limiting) {
+        if (limiting) {
+            ESP_LOGW(TAG, "Limiting to %g MHz to stay under %.1f W", gov->frequency, gov->cap);
+        } else {
+            ESP_LOGI(TAG, "Back at the requested %g MHz", requested_frequency);
+        }
+        gov->limiting = limiting;
+    }
+
+    return gov->frequency;
+}
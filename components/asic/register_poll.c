@@ -0,0 +1,102 @@
+#include <string.h>
+
+#include "register_poll.h"
+
+void register_poll_init(register_poll_t * poll, uint16_t asic_count)
+{
+    memset(poll, 0, sizeof(*poll));
+    poll->asic_count = asic_count < REGISTER_POLL_MAX_ASICS ? asic_count : REGISTER_POLL_MAX_ASICS;
+}
+
+bool register_poll_add(register_poll_t * poll, uint8_t address, uint32_t period_ms)
+{
+    if (poll->register_count >= REGISTER_POLL_MAX_REGISTERS || poll->asic_count == 0 || period_ms == 0) {
+        return false;
+    }
+
+    register_poll_register_t * reg = &poll->registers[poll->register_count++];
+    reg->address = address;
+    reg->slot_us = period_ms * 1000LL / poll->asic_count;
+    if (reg->slot_us < 1) reg->slot_us = 1;
+    return true;
+}
+
+void register_poll_start(register_poll_t * poll, int64_t now_us)
+{
+    if (poll->register_count == 0) return;
+
+    // spread the registers over the shortest slot
+    int64_t shortest_us = poll->registers[0].slot_us;
+    for (int i = 1; i < poll->register_count; i++) {
+        if (poll->registers[i].slot_us < shortest_us) shortest_us = poll->registers[i].slot_us;
+    }
+
+    for (int i = 0; i < poll->register_count; i++) {
+        poll->registers[i].next_us = now_us + shortest_us * i / poll->register_count;
+        poll->registers[i].next_asic = 0;
+    }
+}
+
+void register_poll_skip(register_poll_t * poll, uint16_t asic_nr, bool skip)
+{
+    if (asic_nr >= REGISTER_POLL_MAX_ASICS) return;
+
+    if (skip) {
+        poll->skip[asic_nr / 32] |= 1u << (asic_nr % 32);
+    } else {
+        poll->skip[asic_nr / 32] &= ~(1u << (asic_nr % 32));
+    }
+}
+
+bool register_poll_is_skipped(const register_poll_t * poll, uint16_t asic_nr)
+{
+    if (asic_nr >= REGISTER_POLL_MAX_ASICS) return true;
+
+    return poll->skip[asic_nr / 32] & (1u << (asic_nr % 32));
+}
+
+static register_poll_register_t * earliest(register_poll_t * poll)
+{
+    register_poll_register_t * first = NULL;
+    for (int i = 0; i < poll->register_count; i++) {
+        if (first == NULL || poll->registers[i].next_us < first->next_us) {
+            first = &poll->registers[i];
+        }
+    }
+    return first;
+}
+
+bool register_poll_next(register_poll_t * poll, int64_t now_us, uint8_t * address, uint16_t * asic_nr)
+{
+    register_poll_register_t * reg;
+
+    while ((reg = earliest(poll)) != NULL && reg->next_us <= now_us) {
+        uint16_t asic = reg->next_asic;
+
+        reg->next_asic = (asic + 1) % poll->asic_count;
+        reg->next_us += reg->slot_us;
+        if (reg->next_us <= now_us - reg->slot_us * poll->asic_count) {
+            // more than a period behind
+            reg->next_us = now_us + reg->slot_us;
+        }
+
+        if (!register_poll_is_skipped(poll, asic)) {
+            *address = reg->address;
+            *asic_nr = asic;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int64_t register_poll_next_due_us(const register_poll_t * poll)
+{
+    int64_t next_us = 0;
+    for (int i = 0; i < poll->register_count; i++) {
+        if (next_us == 0 || poll->registers[i].next_us < next_us) {
+            next_us = poll->registers[i].next_us;
+        }
+    }
+    return next_us;
+}
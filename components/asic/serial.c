@@ -1,13 +1,27 @@
+// posix_openpt and friends on the host target
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#if CONFIG_IDF_TARGET_LINUX
+#include <termios.h>
+#else
 #include "driver/uart.h"
+#include "soc/uart_struct.h"
+#endif
 
 #include "esp_log.h"
-#include "soc/uart_struct.h"
+#include "esp_timer.h"
 
 #include "serial.h"
 #include "utils.h"
@@ -16,12 +30,137 @@
 #define ECHO_TEST_RXD (18)
 #define BUF_SIZE (1024)
 
+// The host build has no UART peripheral, chains are backed by a pty or socketpair there
+#if CONFIG_IDF_TARGET_LINUX
+#define DEFAULT_BACKEND SERIAL_BACKEND_FD
+#define CHAIN0_UART_NUM 1
+#else
+#define DEFAULT_BACKEND SERIAL_BACKEND_UART
+#define CHAIN0_UART_NUM UART_NUM_1
+#endif
+
 static const char *TAG = "serial";
 
-esp_err_t SERIAL_init(void)
+static serial_port_t ports[SERIAL_MAX_PORTS] = {
+    {
+        .index = 0,
+        .backend = DEFAULT_BACKEND,
+        .uart_num = CHAIN0_UART_NUM,
+        .tx_pin = ECHO_TEST_TXD,
+        .rx_pin = ECHO_TEST_RXD,
+        .fd = -1,
+        .peer_fd = -1,
+    },
+#if SERIAL_MAX_PORTS > 1
+    {
+        .index = 1,
+        .backend = DEFAULT_BACKEND,
+        .uart_num = CONFIG_ASIC_CHAIN1_UART_NUM,
+        .tx_pin = CONFIG_ASIC_CHAIN1_TX_GPIO,
+        .rx_pin = CONFIG_ASIC_CHAIN1_RX_GPIO,
+        .fd = -1,
+        .peer_fd = -1,
+    },
+#endif
+};
+
+serial_port_t * SERIAL_get_port(uint8_t index)
+{
+    if (index >= SERIAL_MAX_PORTS) {
+        return NULL;
+    }
+    return &ports[index];
+}
+
+esp_err_t SERIAL_attach_fd(serial_port_t * port, int fd)
+{
+    if (port == NULL || fd < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    port->backend = SERIAL_BACKEND_FD;
+    port->fd = fd;
+    port->ready = false;
+
+    ESP_LOGI(TAG, "Chain %d attached to fd %d", port->index, fd);
+    return ESP_OK;
+}
+
+esp_err_t SERIAL_attach_stream(serial_port_t * port, const serial_stream_t * stream)
 {
-    ESP_LOGI(TAG, "Initializing serial");
-    // Configure UART1 parameters
+    if (port == NULL || stream == NULL || stream->send == NULL || stream->receive == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    port->backend = SERIAL_BACKEND_STREAM;
+    port->stream = *stream;
+    port->ready = false;
+
+    ESP_LOGI(TAG, "Chain %d attached to a stream", port->index);
+    return ESP_OK;
+}
+
+esp_err_t SERIAL_open_pty(serial_port_t * port, char * slave_path, size_t slave_path_len)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) {
+        ESP_LOGE(TAG, "posix_openpt failed: %s", strerror(errno));
+        return ESP_FAIL;
+    }
+
+    if (grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, slave_path, slave_path_len) != 0) {
+        ESP_LOGE(TAG, "Unable to set up pty: %s", strerror(errno));
+        close(master);
+        return ESP_FAIL;
+    }
+
+    // The line discipline lives on the slave side, switch it to raw so 0x55/0xAA frames pass untouched
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        ESP_LOGE(TAG, "Unable to open %s: %s", slave_path, strerror(errno));
+        close(master);
+        return ESP_FAIL;
+    }
+
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    port->peer_fd = slave;
+    ESP_LOGI(TAG, "Chain %d pty at %s", port->index, slave_path);
+
+    return SERIAL_attach_fd(port, master);
+#else
+    (void) port;
+    (void) slave_path;
+    (void) slave_path_len;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t SERIAL_init(serial_port_t * port)
+{
+    ESP_LOGI(TAG, "Initializing serial for chain %d", port->index);
+
+    if (port->backend == SERIAL_BACKEND_FD) {
+        if (port->fd < 0) {
+            ESP_LOGE(TAG, "Chain %d has no fd attached", port->index);
+            return ESP_ERR_INVALID_STATE;
+        }
+        port->ready = true;
+        return ESP_OK;
+    }
+
+    if (port->backend == SERIAL_BACKEND_STREAM) {
+        port->ready = true;
+        return ESP_OK;
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    return ESP_ERR_NOT_SUPPORTED;
+#else
     uart_config_t uart_config = {
         .baud_rate = UART_FREQ,
         .data_bits = UART_DATA_8_BITS,
@@ -30,73 +169,160 @@ esp_err_t SERIAL_init(void)
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
         .rx_flow_ctrl_thresh = 122,
     };
-    // Configure UART1 parameters
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(UART_NUM_1, &uart_config));
-    // Set UART1 pins(TX: IO17, RX: I018)
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(UART_NUM_1, ECHO_TEST_TXD, ECHO_TEST_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(port->uart_num, &uart_config));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(port->uart_num, port->tx_pin, port->rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
     // Install UART driver (we don't need an event queue here)
     // tx buffer 0 so the tx time doesn't overlap with the job wait time
     //  by returning before the job is written
-    return uart_driver_install(UART_NUM_1, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
+    return uart_driver_install(port->uart_num, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
+#endif
 }
 
-bool SERIAL_is_initialized(void)
+bool SERIAL_is_initialized(serial_port_t * port)
 {
-    return uart_is_driver_installed(UART_NUM_1);
+    if (port->backend != SERIAL_BACKEND_UART) {
+        return port->ready;
+    }
+#if CONFIG_IDF_TARGET_LINUX
+    return false;
+#else
+    return uart_is_driver_installed(port->uart_num);
+#endif
 }
 
-esp_err_t SERIAL_set_baud(int baud)
+esp_err_t SERIAL_set_baud(serial_port_t * port, int baud)
 {
-    ESP_LOGI(TAG, "Changing UART baud to %i", baud);
+    ESP_LOGI(TAG, "Changing chain %d baud to %i", port->index, baud);
+
+    // A pty, socketpair or stream has no line rate
+    if (port->backend != SERIAL_BACKEND_UART) {
+        return ESP_OK;
+    }
 
+#if !CONFIG_IDF_TARGET_LINUX
     // Make sure that we are done writing before setting a new baudrate.
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(UART_NUM_1, 1000 / portTICK_PERIOD_MS));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(port->uart_num, 1000 / portTICK_PERIOD_MS));
 
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(UART_NUM_1, baud));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(port->uart_num, baud));
+#endif
 
     return ESP_OK;
 }
 
-int SERIAL_send(uint8_t *data, int len, bool debug)
+static int fd_write_all(int fd, const uint8_t *data, int len)
+{
+    int written = 0;
+    while (written < len) {
+        int ret = write(fd, data + written, len - written);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        written += ret;
+    }
+    return written;
+}
+
+// Same contract as uart_read_bytes: returns once size bytes arrived or the timeout expired
+static int16_t fd_read_timeout(int fd, uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+{
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    uint16_t bytes_read = 0;
+
+    while (bytes_read < size) {
+        int64_t remaining_us = deadline_us - esp_timer_get_time();
+        if (remaining_us < 0) remaining_us = 0;
+
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        struct timeval tv = {
+            .tv_sec = remaining_us / 1000000,
+            .tv_usec = remaining_us % 1000000,
+        };
+
+        int ret = select(fd + 1, &rfds, NULL, NULL, &tv);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (ret == 0) break;
+
+        int n = read(fd, buf + bytes_read, size - bytes_read);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        if (n == 0) break; // peer closed
+        bytes_read += n;
+    }
+
+    return bytes_read;
+}
+
+int SERIAL_send(serial_port_t * port, uint8_t *data, int len, bool debug)
 {
     if (debug)
     {
-        printf("tx: ");
+        printf("tx[%d]: ", port->index);
         prettyHex((unsigned char *)data, len);
         printf("\n");
     }
 
-    return uart_write_bytes(UART_NUM_1, (const char *)data, len);
+    if (port->backend == SERIAL_BACKEND_FD) {
+        return fd_write_all(port->fd, data, len);
+    }
+    if (port->backend == SERIAL_BACKEND_STREAM) {
+        return port->stream.send(port->stream.context, data, len);
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    return -1;
+#else
+    return uart_write_bytes(port->uart_num, (const char *)data, len);
+#endif
 }
 
 /// @brief waits for a serial response from the device
+/// @param port chain to read from
 /// @param buf buffer to read data into
 /// @param buf number of ms to wait before timing out
 /// @return number of bytes read, or -1 on error
-int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+int16_t SERIAL_rx(serial_port_t * port, uint8_t *buf, uint16_t size, uint16_t timeout_ms)
 {
-    int16_t bytes_read = uart_read_bytes(UART_NUM_1, buf, size, timeout_ms / portTICK_PERIOD_MS);
+    if (port->backend == SERIAL_BACKEND_FD) {
+        return fd_read_timeout(port->fd, buf, size, timeout_ms);
+    }
+    if (port->backend == SERIAL_BACKEND_STREAM) {
+        return port->stream.receive(port->stream.context, buf, size, timeout_ms);
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    return -1;
+#else
+    int16_t bytes_read = uart_read_bytes(port->uart_num, buf, size, timeout_ms / portTICK_PERIOD_MS);
 
     #if BM1397_SERIALRX_DEBUG || BM1366_SERIALRX_DEBUG || BM1368_SERIALRX_DEBUG || BM1370_SERIALRX_DEBUG
     size_t buff_len = 0;
     if (bytes_read > 0) {
-        uart_get_buffered_data_len(UART_NUM_1, &buff_len);
-        printf("rx: ");
+        uart_get_buffered_data_len(port->uart_num, &buff_len);
+        printf("rx[%d]: ", port->index);
         prettyHex((unsigned char*) buf, bytes_read);
         printf(" [%d]\n", buff_len);
     }
     #endif
 
     return bytes_read;
+#endif
 }
 
-void SERIAL_debug_rx(void)
+void SERIAL_debug_rx(serial_port_t * port)
 {
     int ret;
     uint8_t buf[100];
 
-    ret = SERIAL_rx(buf, 100, 20);
+    ret = SERIAL_rx(port, buf, 100, 20);
     if (ret < 0)
     {
         fprintf(stderr, "unable to read data\n");
@@ -106,7 +332,22 @@ void SERIAL_debug_rx(void)
     memset(buf, 0, 100);
 }
 
-void SERIAL_clear_buffer(void)
+void SERIAL_clear_buffer(serial_port_t * port)
 {
-    uart_flush(UART_NUM_1);
+    if (port->backend == SERIAL_BACKEND_FD) {
+        uint8_t scratch[64];
+        while (fd_read_timeout(port->fd, scratch, sizeof(scratch), 0) > 0) {
+        }
+        return;
+    }
+    if (port->backend == SERIAL_BACKEND_STREAM) {
+        uint8_t scratch[64];
+        while (port->stream.receive(port->stream.context, scratch, sizeof(scratch), 0) > 0) {
+        }
+        return;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    uart_flush(port->uart_num);
+#endif
 }
@@ -0,0 +1,305 @@
+#include "unity.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "asic_emulator.h"
+#include "asic_common.h"
+#include "bm1370.h"
+#include "bm1397.h"
+#include "crc.h"
+#include "mining.h"
+#include "serial.h"
+#include "utils.h"
+
+// 8 leading zero bits, cheap enough to search on the device under test
+#define TICKET_DIFFICULTY (1.0 / (1 << 24))
+
+typedef struct
+{
+    asic_emulator_t * emulator;
+    asic_chain_t chain;
+    serial_port_t saved_port;
+} emulated_chain_t;
+
+static void send_command(serial_port_t * port, uint8_t header, uint8_t * data, uint8_t data_len)
+{
+    uint8_t buf[16] = {0x55, 0xAA, header, data_len + 3};
+    memcpy(buf + 4, data, data_len);
+    buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    TEST_ASSERT_EQUAL(data_len + 5, SERIAL_send(port, buf, data_len + 5, false));
+}
+
+static void address_chain(emulated_chain_t * emulated, int chip_count)
+{
+    send_command(emulated->chain.port, 0x53, (uint8_t[]){0x00, 0x00}, 2);
+    asic_assign_addresses(&emulated->chain, chip_count);
+    for (int i = 0; i < chip_count; i++) {
+        send_command(emulated->chain.port, 0x40, (uint8_t[]){asic_chip_address(&emulated->chain, i), 0x00}, 2);
+    }
+}
+
+static void start_chain(emulated_chain_t * emulated, asic_emulator_config_t * config)
+{
+    serial_port_t * port = SERIAL_get_port(0);
+    emulated->saved_port = *port;
+
+    serial_stream_t stream;
+    TEST_ASSERT_EQUAL(ESP_OK, asic_emulator_create(config, &emulated->emulator));
+    asic_emulator_get_stream(emulated->emulator, &stream);
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_attach_stream(port, &stream));
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_init(port));
+
+    memset(&emulated->chain, 0, sizeof(asic_chain_t));
+    emulated->chain.port = port;
+    emulated->chain.asic_count = config->chip_count;
+    emulated->chain.active_jobs = calloc(ASIC_JOB_SLOTS, sizeof(_Atomic(bm_job *)));
+    emulated->chain.job_generations = calloc(ASIC_JOB_SLOTS, sizeof(_Atomic uint32_t));
+    atomic_init(&emulated->chain.job_epoch, 1);
+
+    // enumerate and address the chips like the drivers do
+    send_command(port, 0x52, (uint8_t[]){0x00, 0x00}, 2);
+    TEST_ASSERT_EQUAL(config->chip_count, count_asic_chips(&emulated->chain, config->chip_id, config->chip_id == 0x1397 ? 9 : 11));
+
+    address_chain(emulated, config->chip_count);
+}
+
+static void stop_chain(emulated_chain_t * emulated)
+{
+    *emulated->chain.port = emulated->saved_port;
+    asic_emulator_destroy(emulated->emulator);
+
+    for (int i = 0; i < ASIC_JOB_SLOTS; i++) {
+        if (emulated->chain.active_jobs[i] != NULL) {
+            free_bm_job(emulated->chain.active_jobs[i]);
+        }
+    }
+    if (emulated->chain.retired_job != NULL) {
+        free_bm_job(emulated->chain.retired_job);
+    }
+    free(emulated->chain.active_jobs);
+    free(emulated->chain.job_generations);
+}
+
+static bm_job * make_job(uint32_t version_mask)
+{
+    mining_notify notify_message;
+    notify_message.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x646ff1a9;
+    uint8_t merkle_root[32];
+    hex2bin("6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9", merkle_root, 32);
+
+    bm_job * job = calloc(1, sizeof(bm_job));
+    construct_bm_job(&notify_message, merkle_root, version_mask, 1000, job);
+    job->version_mask = version_mask;
+    return job;
+}
+
+TEST_CASE("Emulator enumerates and addresses chips", "[emulator]")
+{
+    asic_emulator_config_t config = {
+        .chip_id = 0x1370,
+        .chip_count = 4,
+        .core_count = 128,
+        .small_core_count = 2040,
+        .hash_domains = 4,
+        .hashrate_ghs = 1000,
+        .ticket_difficulty = TICKET_DIFFICULTY,
+    };
+    emulated_chain_t emulated;
+    start_chain(&emulated, &config);
+
+    // the total counter of the third chip answers from its new address
+    send_command(emulated.chain.port, 0x42, (uint8_t[]){2 * emulated.chain.address_interval, 0x8C}, 2);
+    task_result * result = BM1370_process_work(&emulated.chain);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL(REGISTER_TOTAL_COUNT, result->register_type);
+    TEST_ASSERT_EQUAL(2, result->asic_nr);
+
+    // and only that chip answers a read from the driver
+    BM1370_read_register(&emulated.chain, 1, 0x4C);
+    result = BM1370_process_work(&emulated.chain);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL(REGISTER_ERROR_COUNT, result->register_type);
+    TEST_ASSERT_EQUAL(1, result->asic_nr);
+
+    stop_chain(&emulated);
+}
+
+TEST_CASE("Emulated chain is re-addressed around a bypassed chip", "[emulator]")
+{
+    asic_emulator_config_t config = {
+        .chip_id = 0x1370,
+        .chip_count = 4,
+        .core_count = 128,
+        .small_core_count = 2040,
+        .hash_domains = 4,
+        .hashrate_ghs = 1000,
+        .ticket_difficulty = TICKET_DIFFICULTY,
+    };
+    emulated_chain_t emulated;
+    start_chain(&emulated, &config);
+
+    chip_health_t chips[4];
+    chain_health_init(&emulated.chain.health, chips, 4);
+    chips[1].state = CHIP_HEALTH_BYPASSED;
+    address_chain(&emulated, 4);
+
+    // three chips left to split the address space
+    TEST_ASSERT_EQUAL(3, emulated.chain.live_count);
+    TEST_ASSERT_EQUAL(64, emulated.chain.address_interval);
+    TEST_ASSERT_EQUAL(64, asic_chip_address(&emulated.chain, 2));
+
+    // the third chip answers from the second chip's old slot
+    BM1370_read_register(&emulated.chain, 2, 0x4C);
+    task_result * result = BM1370_process_work(&emulated.chain);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL(2, result->asic_nr);
+
+    // and the bypassed chip from the parked address
+    BM1370_read_register(&emulated.chain, 1, 0x4C);
+    result = BM1370_process_work(&emulated.chain);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL(1, result->asic_nr);
+
+    stop_chain(&emulated);
+}
+
+TEST_CASE("Emulator returns real nonces for BM1370 jobs", "[emulator]")
+{
+    asic_emulator_config_t config = {
+        .chip_id = 0x1370,
+        .chip_count = 2,
+        .core_count = 128,
+        .small_core_count = 2040,
+        .hash_domains = 4,
+        .hashrate_ghs = 1000,
+        .ticket_difficulty = TICKET_DIFFICULTY,
+    };
+    emulated_chain_t emulated;
+    start_chain(&emulated, &config);
+
+    BM1370_set_version_mask(&emulated.chain, 0x1fffe000);
+
+    bm_job * job = make_job(0x1fffe000);
+    BM1370_send_work(&emulated.chain, job);
+
+    for (int i = 0; i < 4; i++) {
+        task_result * result = BM1370_process_work(&emulated.chain);
+        TEST_ASSERT_NOT_NULL(result);
+        TEST_ASSERT_EQUAL(emulated.chain.job_id, result->job_id);
+        TEST_ASSERT_TRUE(result->asic_nr < config.chip_count);
+        TEST_ASSERT_EQUAL(job->version, result->rolled_version & ~job->version_mask);
+        TEST_ASSERT_GREATER_OR_EQUAL(TICKET_DIFFICULTY, test_nonce_value(job, result->nonce, result->rolled_version));
+    }
+
+    stop_chain(&emulated);
+}
+
+TEST_CASE("Emulator returns real nonces for BM1397 midstates", "[emulator]")
+{
+    asic_emulator_config_t config = {
+        .chip_id = 0x1397,
+        .chip_count = 1,
+        .core_count = 168,
+        .small_core_count = 672,
+        .hash_domains = 1,
+        .hashrate_ghs = 1000,
+        .ticket_difficulty = TICKET_DIFFICULTY,
+    };
+    emulated_chain_t emulated;
+    start_chain(&emulated, &config);
+
+    bm_job * job = make_job(0x1fffe000);
+    BM1397_send_work(&emulated.chain, job);
+
+    task_result * result = BM1397_process_work(&emulated.chain);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL(emulated.chain.job_id, result->job_id);
+    TEST_ASSERT_GREATER_OR_EQUAL(TICKET_DIFFICULTY, test_nonce_value(job, result->nonce, result->rolled_version));
+
+    stop_chain(&emulated);
+}
+
+TEST_CASE("Emulator injects crc errors", "[emulator]")
+{
+    asic_emulator_config_t config = {
+        .chip_id = 0x1366,
+        .chip_count = 1,
+        .core_count = 112,
+        .small_core_count = 894,
+        .hash_domains = 4,
+        .hashrate_ghs = 1000,
+        .ticket_difficulty = TICKET_DIFFICULTY,
+        .error_permille = 1000,
+    };
+    emulated_chain_t emulated;
+    start_chain(&emulated, &config);
+
+    send_command(emulated.chain.port, 0x52, (uint8_t[]){0x00, 0x4C}, 2);
+    uint8_t response[11];
+    TEST_ASSERT_EQUAL(ESP_FAIL, receive_work(&emulated.chain, response, sizeof(response), NULL));
+    TEST_ASSERT_EQUAL(1, emulated.chain.rx_collisions);
+
+    asic_emulator_stats_t stats;
+    asic_emulator_get_stats(emulated.emulator, &stats);
+    TEST_ASSERT_EQUAL(1, stats.errors_injected);
+    TEST_ASSERT_EQUAL(0, stats.frames_rejected);
+
+    stop_chain(&emulated);
+}
+
+TEST_CASE("Emulator power model counts errors past the clean frequency", "[emulator]")
+{
+    asic_emulator_config_t config = {
+        .chip_id = 0x1370,
+        .chip_count = 1,
+        .core_count = 128,
+        .small_core_count = 2040,
+        .hash_domains = 4,
+        .hashrate_ghs = 1000,
+        .ticket_difficulty = TICKET_DIFFICULTY,
+        .power_model = {
+            .static_w = 2,
+            .dynamic_w = 14,
+            .threshold_mv = 750,
+            .mhz_per_mv = 1.5,
+            .thermal_c_per_w = 2.5,
+            .ambient_c = 25,
+        },
+        .core_voltage_mv = 1100,
+    };
+    emulated_chain_t emulated;
+    start_chain(&emulated, &config);
+
+    // 600 MHz: fb divider 168, refdiv 1, postdiv1 7, postdiv2 1
+    send_command(emulated.chain.port, 0x51, (uint8_t[]){0x00, 0x08, 0x40, 168, 0x01, 0x60}, 6);
+
+    BM1370_send_work(&emulated.chain, make_job(0x1fffe000));
+    vTaskDelay(200 / portTICK_PERIOD_MS);
+
+    asic_emulator_operating_point_t point;
+    asic_emulator_get_operating_point(emulated.emulator, &point);
+    TEST_ASSERT_TRUE(point.error_fraction > 0.5f);
+    TEST_ASSERT_TRUE(point.power_w > config.power_model.static_w);
+    TEST_ASSERT_EQUAL_FLOAT(config.power_model.ambient_c + config.power_model.thermal_c_per_w * point.power_w, point.temp_c);
+
+    send_command(emulated.chain.port, 0x42, (uint8_t[]){0x00, 0x4C}, 2);
+    task_result * result;
+    do {
+        result = BM1370_process_work(&emulated.chain);
+        TEST_ASSERT_NOT_NULL(result);
+    } while (result->register_type != REGISTER_ERROR_COUNT);
+    TEST_ASSERT_TRUE(result->value > 0);
+
+    asic_emulator_set_core_voltage(emulated.emulator, 1250);
+    asic_emulator_get_operating_point(emulated.emulator, &point);
+    TEST_ASSERT_EQUAL_FLOAT(0, point.error_fraction);
+
+    stop_chain(&emulated);
+}
@@ -0,0 +1,174 @@
+#include "unity.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "asic_common.h"
+
+static _Atomic(bm_job *) active_jobs[ASIC_JOB_SLOTS];
+static _Atomic uint32_t job_generations[ASIC_JOB_SLOTS];
+static asic_chain_t chain;
+
+static void start(void)
+{
+    memset(&chain, 0, sizeof(chain));
+    for (int i = 0; i < ASIC_JOB_SLOTS; i++) {
+        atomic_init(&active_jobs[i], NULL);
+        atomic_init(&job_generations[i], 0);
+    }
+    chain.active_jobs = active_jobs;
+    chain.job_generations = job_generations;
+    atomic_init(&chain.job_epoch, 1);
+    atomic_init(&chain.job_in_use, NULL);
+}
+
+static void stop(void)
+{
+    for (int i = 0; i < ASIC_JOB_SLOTS; i++) {
+        if (active_jobs[i] != NULL) {
+            free_bm_job(active_jobs[i]);
+        }
+    }
+    if (chain.retired_job != NULL) {
+        free_bm_job(chain.retired_job);
+    }
+}
+
+TEST_CASE("Job slots hand out only stored jobs", "[asic_jobs]")
+{
+    start();
+    bm_job * job = calloc(1, sizeof(bm_job));
+
+    TEST_ASSERT_NULL(get_asic_job(&chain, 24));
+    store_asic_job(&chain, 24, job);
+    TEST_ASSERT_EQUAL_PTR(job, get_asic_job(&chain, 24));
+    TEST_ASSERT_NULL(get_asic_job(&chain, 48));
+    TEST_ASSERT_NULL(get_asic_job(&chain, ASIC_JOB_SLOTS));
+    TEST_ASSERT_EQUAL(0, chain.stale_nonces);
+
+    stop();
+}
+
+TEST_CASE("Clean jobs reject nonces for every job sent before", "[asic_jobs]")
+{
+    start();
+    bm_job * old_job = calloc(1, sizeof(bm_job));
+    store_asic_job(&chain, 8, old_job);
+    store_asic_job(&chain, 13, calloc(1, sizeof(bm_job)));
+
+    invalidate_asic_jobs(&chain);
+
+    // slots off the 4 aligned ids are invalidated as well
+    TEST_ASSERT_NULL(get_asic_job(&chain, 8));
+    TEST_ASSERT_NULL(get_asic_job(&chain, 13));
+    TEST_ASSERT_EQUAL(2, chain.stale_nonces);
+
+    bm_job * new_job = calloc(1, sizeof(bm_job));
+    store_asic_job(&chain, 8, new_job);
+    TEST_ASSERT_EQUAL_PTR(new_job, get_asic_job(&chain, 8));
+    TEST_ASSERT_NULL(get_asic_job(&chain, 13));
+    TEST_ASSERT_EQUAL(3, chain.stale_nonces);
+
+    stop();
+}
+
+TEST_CASE("Jobs built before a clean are stale whenever they are sent", "[asic_jobs]")
+{
+    start();
+
+    // generated from the old work, still queued when the clean arrives
+    bm_job * queued = calloc(1, sizeof(bm_job));
+    queued->epoch = 1;
+    invalidate_asic_jobs(&chain);
+
+    store_asic_job(&chain, 8, queued);
+    TEST_ASSERT_NULL(get_asic_job(&chain, 8));
+    TEST_ASSERT_EQUAL(1, chain.stale_nonces);
+
+    // built from the new work
+    bm_job * fresh = calloc(1, sizeof(bm_job));
+    fresh->epoch = 2;
+    store_asic_job(&chain, 32, fresh);
+    TEST_ASSERT_EQUAL_PTR(fresh, get_asic_job(&chain, 32));
+
+    // a job without an epoch takes the one it is stored in
+    bm_job * unstamped = calloc(1, sizeof(bm_job));
+    store_asic_job(&chain, 56, unstamped);
+    TEST_ASSERT_EQUAL_PTR(unstamped, get_asic_job(&chain, 56));
+
+    stop();
+}
+
+TEST_CASE("A job in use by the result task outlives its slot", "[asic_jobs]")
+{
+    start();
+    bm_job * first = calloc(1, sizeof(bm_job));
+    first->version = 0x20000000;
+    store_asic_job(&chain, 8, first);
+
+    // the result task picks the job up ...
+    TEST_ASSERT_EQUAL_PTR(first, get_asic_job(&chain, 8));
+
+    // ... while the dispatch task wraps around to the same id
+    bm_job * second = calloc(1, sizeof(bm_job));
+    store_asic_job(&chain, 8, second);
+    TEST_ASSERT_EQUAL_PTR(first, chain.retired_job);
+    TEST_ASSERT_EQUAL_HEX32(0x20000000, first->version);
+    TEST_ASSERT_EQUAL_PTR(second, get_asic_job(&chain, 8));
+
+    // the next store frees it once the result task moved on
+    store_asic_job(&chain, 32, calloc(1, sizeof(bm_job)));
+    TEST_ASSERT_NULL(chain.retired_job);
+
+    // a job replaced while not in use is freed right away
+    store_asic_job(&chain, 56, calloc(1, sizeof(bm_job)));
+    store_asic_job(&chain, 56, calloc(1, sizeof(bm_job)));
+    TEST_ASSERT_NULL(chain.retired_job);
+
+    stop();
+}
+
+#define STRESS_STORES 20000
+
+static _Atomic bool dispatch_done;
+
+static void * dispatch_thread(void * arg)
+{
+    for (uint32_t i = 0; i < STRESS_STORES; i++) {
+        uint8_t job_id = (i * 24) % 128;
+        bm_job * job = calloc(1, sizeof(bm_job));
+        job->version = job_id;
+        job->ntime = ~(uint32_t)job_id;
+        store_asic_job(&chain, job_id, job);
+        if (i % 1000 == 999) {
+            invalidate_asic_jobs(&chain);
+        }
+    }
+    atomic_store(&dispatch_done, true);
+    return NULL;
+}
+
+TEST_CASE("Jobs survive results racing the dispatch task", "[asic_jobs]")
+{
+    start();
+
+    atomic_store(&dispatch_done, false);
+    pthread_t thread;
+    TEST_ASSERT_EQUAL(0, pthread_create(&thread, NULL, dispatch_thread, NULL));
+
+    // a freed and reused job would fail the check between its two fields
+    uint32_t found = 0;
+    for (uint32_t i = 0; !atomic_load(&dispatch_done); i++) {
+        bm_job * job = get_asic_job(&chain, (i * 24) % 128);
+        if (job != NULL) {
+            TEST_ASSERT_EQUAL_HEX32(~job->version, job->ntime);
+            found++;
+        }
+    }
+
+    pthread_join(thread, NULL);
+    TEST_ASSERT_GREATER_THAN(0, found);
+
+    stop();
+}
@@ -0,0 +1,148 @@
+#include "unity.h"
+
+#include "autotune.h"
+#include "asic_emulator.h"
+
+#define CHIPS 1
+#define SMALL_CORES 2040
+
+// roughly a BM1370 on a Gamma
+static const asic_emulator_power_model_t MODEL = {
+    .static_w = 2,
+    .dynamic_w = 14,
+    .threshold_mv = 750,
+    .mhz_per_mv = 1.5,
+    .thermal_c_per_w = 2.5,
+    .ambient_c = 25,
+};
+
+static autotune_t at;
+
+static autotune_limits_t make_limits(autotune_objective_t objective)
+{
+    autotune_limits_t limits = {
+        .objective = objective,
+        .min_frequency = 400,
+        .max_frequency = 625,
+        .frequency_step = 12.5,
+        .min_voltage = 1000,
+        .max_voltage = 1250,
+        .voltage_step = 10,
+        .max_power = 40,
+        .max_temp = 65,
+        .max_error_percentage = 1,
+        .hashrate_per_mhz = SMALL_CORES * CHIPS / 1000.0,
+        .min_hashrate_fraction = 0.85,
+    };
+    return limits;
+}
+
+static void measure(const autotune_limits_t * limits, float frequency, uint16_t voltage, autotune_sample_t * sample)
+{
+    asic_emulator_operating_point_t point;
+    asic_emulator_model(&MODEL, CHIPS, frequency, voltage, &point);
+
+    sample->hashrate = frequency * limits->hashrate_per_mhz * (1 - point.error_fraction);
+    sample->power = point.power_w;
+    sample->temp = point.temp_c;
+    sample->error_percentage = point.error_fraction * 100;
+}
+
+static int run(const autotune_limits_t * limits)
+{
+    int measured = 0;
+    const autotune_point_t * point;
+
+    autotune_start(&at, limits);
+    while ((point = autotune_get_point(&at)) != NULL) {
+        TEST_ASSERT_TRUE(point->frequency >= limits->min_frequency && point->frequency <= limits->max_frequency);
+        TEST_ASSERT_TRUE(point->voltage >= limits->min_voltage && point->voltage <= limits->max_voltage);
+
+        autotune_sample_t sample;
+        measure(limits, point->frequency, point->voltage, &sample);
+        autotune_measured(&at, &sample);
+
+        TEST_ASSERT_TRUE(++measured <= AUTOTUNE_MAX_POINTS);
+    }
+    return measured;
+}
+
+// the best score anywhere on the hill climb grid, found the slow way
+static float grid_optimum(const autotune_limits_t * limits)
+{
+    float optimum = -1e9;
+    for (float frequency = limits->min_frequency; frequency <= limits->max_frequency; frequency += limits->frequency_step) {
+        for (int voltage = limits->min_voltage; voltage <= limits->max_voltage; voltage += limits->voltage_step) {
+            autotune_sample_t sample;
+            measure(limits, frequency, voltage, &sample);
+            if (sample.error_percentage > limits->max_error_percentage || sample.power > limits->max_power || sample.temp > limits->max_temp) {
+                continue;
+            }
+            float score = limits->objective == AUTOTUNE_EFFICIENCY ? -autotune_efficiency(&sample) : sample.hashrate;
+            if (score > optimum) optimum = score;
+        }
+    }
+    return optimum;
+}
+
+TEST_CASE("Autotune finds the most efficient point", "[autotune]")
+{
+    autotune_limits_t limits = make_limits(AUTOTUNE_EFFICIENCY);
+    int measured = run(&limits);
+
+    autotune_point_t best;
+    TEST_ASSERT_TRUE(autotune_get_best(&at, &best));
+    TEST_ASSERT_EQUAL(AUTOTUNE_DONE, at.state);
+    TEST_ASSERT_EQUAL(100, autotune_get_progress(&at));
+    TEST_ASSERT_TRUE(best.stable);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f * -grid_optimum(&limits), -grid_optimum(&limits), autotune_efficiency(&best.sample));
+
+    // far fewer points than the grid has
+    TEST_ASSERT_TRUE(measured < 40);
+}
+
+TEST_CASE("Autotune maximizes hashrate under the thermal ceiling", "[autotune]")
+{
+    autotune_limits_t limits = make_limits(AUTOTUNE_HASHRATE);
+    run(&limits);
+
+    autotune_point_t best;
+    TEST_ASSERT_TRUE(autotune_get_best(&at, &best));
+    TEST_ASSERT_TRUE(best.sample.temp <= limits.max_temp);
+    TEST_ASSERT_TRUE(best.sample.hashrate >= 0.98f * grid_optimum(&limits));
+
+    // no point past the ceiling is ever picked, however fast
+    for (int i = 0; i < at.tested_count; i++) {
+        if (at.tested[i].sample.temp > limits.max_temp) {
+            TEST_ASSERT_FALSE(at.tested[i].stable);
+        }
+    }
+}
+
+TEST_CASE("Autotune gives up when nothing fits the limits", "[autotune]")
+{
+    autotune_limits_t limits = make_limits(AUTOTUNE_HASHRATE);
+    limits.max_power = 5;
+    int measured = run(&limits);
+
+    autotune_point_t best;
+    TEST_ASSERT_FALSE(autotune_get_best(&at, &best));
+    TEST_ASSERT_EQUAL(AUTOTUNE_DONE, at.state);
+    TEST_ASSERT_EQUAL(1, measured);
+}
+
+TEST_CASE("Autotune stops measuring once aborted", "[autotune]")
+{
+    autotune_limits_t limits = make_limits(AUTOTUNE_EFFICIENCY);
+    autotune_start(&at, &limits);
+
+    autotune_sample_t sample;
+    const autotune_point_t * point = autotune_get_point(&at);
+    measure(&limits, point->frequency, point->voltage, &sample);
+    autotune_measured(&at, &sample);
+
+    autotune_abort(&at);
+    TEST_ASSERT_EQUAL(AUTOTUNE_ABORTED, at.state);
+    TEST_ASSERT_NULL(autotune_get_point(&at));
+    TEST_ASSERT_EQUAL(1, at.tested_count);
+}
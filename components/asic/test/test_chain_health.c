@@ -0,0 +1,90 @@
+#include "unity.h"
+
+#include "chain_health.h"
+
+#define S_US 1000000LL
+
+// every live chip returns a nonce every 100 ms, for as long as given
+static int64_t hash(chain_health_t * health, int64_t now_us, int64_t duration_us, int dead_chip)
+{
+    for (int64_t end_us = now_us + duration_us; now_us < end_us; now_us += 100000) {
+        for (int i = 0; i < health->chip_count; i++) {
+            if (i != dead_chip && health->chips[i].state != CHIP_HEALTH_BYPASSED) {
+                chain_health_nonce(health, i, now_us);
+            }
+        }
+        if (now_us % S_US == 0) {
+            TEST_ASSERT_EQUAL(CHAIN_HEALTH_OK, chain_health_check(health, now_us));
+        }
+    }
+    return now_us;
+}
+
+TEST_CASE("Chain health waits for a significant silence before a reset", "[chain_health]")
+{
+    chip_health_t chips[4];
+    chain_health_t health;
+    chain_health_init(&health, chips, 4);
+    chain_health_restart(&health, 0);
+
+    int64_t now_us = hash(&health, 0, 20 * S_US, -1);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 10.0f, health.rate);
+
+    // 10 nonces a second, so 20.7 expected after about 2 s, but never before 10 s
+    now_us = hash(&health, now_us, 9 * S_US, 3);
+    TEST_ASSERT_EQUAL(CHIP_HEALTH_OK, chips[3].state);
+    now_us = hash(&health, now_us, 1 * S_US, 3);
+    TEST_ASSERT_EQUAL(CHAIN_HEALTH_RESET, chain_health_check(&health, now_us));
+    TEST_ASSERT_EQUAL(CHIP_HEALTH_STALLED, chips[3].state);
+    TEST_ASSERT_EQUAL(1, health.resets);
+
+    // the reset brought it back
+    chain_health_restart(&health, now_us);
+    hash(&health, now_us, 20 * S_US, -1);
+    TEST_ASSERT_EQUAL(CHIP_HEALTH_OK, chips[3].state);
+    TEST_ASSERT_EQUAL(0, chips[3].resets);
+}
+
+TEST_CASE("Chain health bypasses a chip the resets do not bring back", "[chain_health]")
+{
+    chip_health_t chips[4];
+    chain_health_t health;
+    chain_health_init(&health, chips, 4);
+    chain_health_restart(&health, 0);
+
+    int64_t now_us = hash(&health, 0, 20 * S_US, -1);
+    for (int i = 0; i < CHAIN_HEALTH_MAX_RESETS; i++) {
+        now_us = hash(&health, now_us, 10 * S_US, 2);
+        TEST_ASSERT_EQUAL(CHAIN_HEALTH_RESET, chain_health_check(&health, now_us));
+        chain_health_restart(&health, now_us);
+    }
+
+    now_us = hash(&health, now_us, 10 * S_US, 2);
+    TEST_ASSERT_EQUAL(CHAIN_HEALTH_BYPASS, chain_health_check(&health, now_us));
+    TEST_ASSERT_TRUE(chain_health_is_bypassed(&health, 2));
+    chain_health_restart(&health, now_us);
+
+    // the others hash on without it, and a power cycle forgives it
+    hash(&health, now_us, 30 * S_US, 2);
+    chain_health_clear(&health);
+    TEST_ASSERT_FALSE(chain_health_is_bypassed(&health, 2));
+}
+
+TEST_CASE("Chain health power cycles when the last chip stalls", "[chain_health]")
+{
+    chip_health_t chips[1];
+    chain_health_t health;
+    chain_health_init(&health, chips, 1);
+    chain_health_restart(&health, 0);
+
+    int64_t now_us = hash(&health, 0, 20 * S_US, -1);
+    for (int i = 0; i < CHAIN_HEALTH_MAX_RESETS; i++) {
+        now_us += 10 * S_US;
+        TEST_ASSERT_EQUAL(CHAIN_HEALTH_RESET, chain_health_check(&health, now_us));
+        chain_health_restart(&health, now_us);
+    }
+
+    now_us += 10 * S_US;
+    TEST_ASSERT_EQUAL(CHAIN_HEALTH_POWER_CYCLE, chain_health_check(&health, now_us));
+    TEST_ASSERT_FALSE(chain_health_is_bypassed(&health, 0));
+}
@@ -0,0 +1,105 @@
+#include "unity.h"
+
+#include <stdlib.h>
+
+#include "core_heatmap.h"
+
+#define CHIPS 2
+#define CORES 128
+#define SMALL_CORES 16
+#define SECOND_US 1000000LL
+
+static core_heatmap_t hm;
+static core_heatmap_chip_t chip;
+
+static void start(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, core_heatmap_init(&hm, CHIPS, CORES, CORES * SMALL_CORES));
+}
+
+static void stop(void)
+{
+    free(hm.cores);
+    free(hm.small_cores);
+}
+
+// every core of the chip returns the same number of nonces, except the listed ones
+static void mine(uint8_t asic_nr, int per_core, int64_t now_us, int weak_core, int weak_count)
+{
+    for (int core = 0; core < CORES; core++) {
+        int count = core == weak_core ? weak_count : per_core;
+        for (int n = 0; n < count; n++) {
+            core_heatmap_nonce(&hm, asic_nr, core, n % SMALL_CORES, now_us);
+        }
+    }
+}
+
+TEST_CASE("Core heatmap needs enough nonces before judging cores", "[core_heatmap]")
+{
+    start();
+    mine(0, 4, 1, 7, 0);
+
+    TEST_ASSERT_EQUAL(ESP_OK, core_heatmap_get_chip(&hm, 0, 1, &chip));
+    TEST_ASSERT_EQUAL(CORE_UNKNOWN, chip.core_health[7]);
+    TEST_ASSERT_EQUAL(0, chip.dead_cores);
+
+    stop();
+}
+
+TEST_CASE("Core heatmap flags dead and weak cores", "[core_heatmap]")
+{
+    start();
+    mine(0, 64, 1, 7, 0);
+    mine(1, 64, 1, 42, 10);
+
+    TEST_ASSERT_EQUAL(ESP_OK, core_heatmap_get_chip(&hm, 0, 1, &chip));
+    TEST_ASSERT_EQUAL(CORE_DEAD, chip.core_health[7]);
+    TEST_ASSERT_EQUAL(CORE_OK, chip.core_health[8]);
+    TEST_ASSERT_EQUAL(1, chip.dead_cores);
+    TEST_ASSERT_EQUAL(0, chip.weak_cores);
+    TEST_ASSERT_EQUAL(127 * 64, chip.total);
+
+    TEST_ASSERT_EQUAL(ESP_OK, core_heatmap_get_chip(&hm, 1, 1, &chip));
+    TEST_ASSERT_EQUAL(CORE_WEAK, chip.core_health[42]);
+    TEST_ASSERT_EQUAL(1, chip.weak_cores);
+    TEST_ASSERT_EQUAL(0, chip.dead_cores);
+
+    stop();
+}
+
+TEST_CASE("Core heatmap passes a uniform chip", "[core_heatmap]")
+{
+    start();
+    srand(1);
+    for (int n = 0; n < CORES * 64; n++) {
+        core_heatmap_nonce(&hm, 0, rand() % CORES, rand() % SMALL_CORES, 1);
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, core_heatmap_get_chip(&hm, 0, 1, &chip));
+    TEST_ASSERT_EQUAL(0, chip.dead_cores);
+    TEST_ASSERT_EQUAL(0, chip.weak_cores);
+    TEST_ASSERT_TRUE(chip.chi_square < chip.chi_square_limit);
+    for (int i = 0; i < SMALL_CORES; i++) {
+        TEST_ASSERT_EQUAL(CORE_OK, chip.small_core_health[i]);
+    }
+
+    stop();
+}
+
+TEST_CASE("Core heatmap halves its counters every half life", "[core_heatmap]")
+{
+    start();
+    mine(0, 64, 1, -1, 0);
+    core_heatmap_nonce(&hm, CHIPS, 0, 0, 1);
+    TEST_ASSERT_EQUAL(1, hm.dropped);
+
+    TEST_ASSERT_EQUAL(ESP_OK, core_heatmap_get_chip(&hm, 0, 1 + CORE_HEATMAP_HALF_LIFE_US, &chip));
+    TEST_ASSERT_EQUAL(32, chip.cores[0]);
+    TEST_ASSERT_EQUAL(CORES * 32, chip.total);
+
+    TEST_ASSERT_EQUAL(ESP_OK, core_heatmap_get_chip(&hm, 0, 1 + 3 * CORE_HEATMAP_HALF_LIFE_US + SECOND_US, &chip));
+    TEST_ASSERT_EQUAL(8, chip.cores[0]);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, core_heatmap_get_chip(&hm, CHIPS, 1, &chip));
+
+    stop();
+}
@@ -0,0 +1,59 @@
+#include "unity.h"
+
+#include "frequency_ramp.h"
+
+TEST_CASE("Frequency ramp speeds up while the core voltage holds", "[frequency_ramp]")
+{
+    frequency_ramp_t ramp;
+    frequency_ramp_init(&ramp, 1200);
+    TEST_ASSERT_TRUE(ramp.adaptive);
+    TEST_ASSERT_EQUAL(1, ramp.steps);
+    TEST_ASSERT_EQUAL(FREQUENCY_RAMP_DELAY_MS, ramp.delay_ms);
+
+    for (int i = 0; i < 10; i++) {
+        frequency_ramp_measured(&ramp, 1200 - i);
+    }
+    TEST_ASSERT_EQUAL(FREQUENCY_RAMP_MAX_STEPS, ramp.steps);
+    TEST_ASSERT_EQUAL(FREQUENCY_RAMP_MIN_DELAY_MS, ramp.delay_ms);
+
+    // 50 MHz to 600 MHz now takes about a tenth of the 9 s at the fixed pace
+    frequency_ramp_init(&ramp, 1200);
+    int steps = (600 - 50) / FREQUENCY_RAMP_STEP;
+    uint32_t elapsed_ms = 0;
+    while (steps > 0) {
+        steps -= steps < ramp.steps ? steps : ramp.steps;
+        elapsed_ms += ramp.delay_ms;
+        frequency_ramp_measured(&ramp, 1195);
+    }
+    TEST_ASSERT_TRUE(elapsed_ms < 1000);
+}
+
+TEST_CASE("Frequency ramp backs off when the core voltage sags", "[frequency_ramp]")
+{
+    frequency_ramp_t ramp;
+    frequency_ramp_init(&ramp, 1200);
+    frequency_ramp_measured(&ramp, 1200);
+    frequency_ramp_measured(&ramp, 1200);
+    frequency_ramp_measured(&ramp, 1200);
+    TEST_ASSERT_EQUAL(8, ramp.steps);
+
+    frequency_ramp_measured(&ramp, 1160);
+    TEST_ASSERT_EQUAL(4, ramp.steps);
+    TEST_ASSERT_EQUAL(2 * FREQUENCY_RAMP_MIN_DELAY_MS, ramp.delay_ms);
+    TEST_ASSERT_EQUAL(40, ramp.max_droop_mv);
+
+    // a shift between the two thresholds keeps the pace
+    frequency_ramp_measured(&ramp, 1175);
+    TEST_ASSERT_EQUAL(4, ramp.steps);
+}
+
+TEST_CASE("Frequency ramp keeps the fixed pace without a reading", "[frequency_ramp]")
+{
+    frequency_ramp_t ramp;
+    frequency_ramp_init(&ramp, 0);
+    TEST_ASSERT_FALSE(ramp.adaptive);
+
+    frequency_ramp_measured(&ramp, 1200);
+    TEST_ASSERT_EQUAL(1, ramp.steps);
+    TEST_ASSERT_EQUAL(FREQUENCY_RAMP_DELAY_MS, ramp.delay_ms);
+}
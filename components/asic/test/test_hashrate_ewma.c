@@ -0,0 +1,66 @@
+#include "unity.h"
+
+#include <math.h>
+
+#include "hashrate_ewma.h"
+
+static hashrate_ewma_t ewma;
+static int64_t now_us;
+
+static void feed(float hashrate, int seconds, int interval_s)
+{
+    for (int elapsed = 0; elapsed < seconds; elapsed += interval_s) {
+        now_us += interval_s * 1000000LL;
+        hashrate_ewma_update(&ewma, hashrate, now_us);
+    }
+}
+
+TEST_CASE("Hashrate EWMA reports the average so far before a horizon fills", "[hashrate_ewma]")
+{
+    hashrate_ewma_reset(&ewma);
+    now_us = 1;
+
+    TEST_ASSERT_EQUAL_FLOAT(0, hashrate_ewma_get(&ewma, HASHRATE_EWMA_1M));
+
+    feed(1000, 600, 1);
+    for (int i = 0; i < HASHRATE_EWMA_HORIZONS; i++) {
+        TEST_ASSERT_FLOAT_WITHIN(0.5f, 1000, hashrate_ewma_get(&ewma, i));
+    }
+}
+
+TEST_CASE("Hashrate EWMA weighs samples by the time between them", "[hashrate_ewma]")
+{
+    hashrate_ewma_reset(&ewma);
+    now_us = 1;
+    feed(1000, 3600, 1);
+
+    // one horizon after a step it has moved 1 - 1/e of the way, however it was polled
+    feed(2000, 30, 1);
+    feed(2000, 30, 5);
+    float expected = 2000 - 1000 * expf(-1);
+    TEST_ASSERT_FLOAT_WITHIN(2, expected, hashrate_ewma_get(&ewma, HASHRATE_EWMA_1M));
+    TEST_ASSERT_FLOAT_WITHIN(2, 2000, hashrate_ewma_get(&ewma, HASHRATE_EWMA_5S));
+
+    // a poll missed for a minute counts as a minute
+    hashrate_ewma_reset(&ewma);
+    now_us = 1;
+    feed(1000, 3600, 1);
+    feed(2000, 60, 60);
+    TEST_ASSERT_FLOAT_WITHIN(2, expected, hashrate_ewma_get(&ewma, HASHRATE_EWMA_1M));
+}
+
+TEST_CASE("Hashrate EWMA skips over a pause", "[hashrate_ewma]")
+{
+    hashrate_ewma_reset(&ewma);
+    now_us = 1;
+    feed(1000, 600, 1);
+    float before = hashrate_ewma_get(&ewma, HASHRATE_EWMA_5S);
+
+    hashrate_ewma_pause(&ewma);
+    now_us += 3600 * 1000000LL;
+    hashrate_ewma_update(&ewma, 1000, now_us);
+    TEST_ASSERT_EQUAL_FLOAT(before, hashrate_ewma_get(&ewma, HASHRATE_EWMA_5S));
+
+    feed(1000, 10, 1);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 1000, hashrate_ewma_get(&ewma, HASHRATE_EWMA_24H));
+}
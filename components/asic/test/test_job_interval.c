@@ -0,0 +1,100 @@
+#include "unity.h"
+
+#include <string.h>
+
+#include "job_interval.h"
+
+#define BASE_MS 100.0
+#define SECOND_US 1000000LL
+
+static job_interval_t ji;
+static bm_job job;
+
+static void start(void)
+{
+    job_interval_init(&ji);
+    memset(&job, 0, sizeof(job));
+    TEST_ASSERT_EQUAL_DOUBLE(BASE_MS, job_interval_update(&ji, BASE_MS, true, 1));
+}
+
+// one job per interval on a single chain, nonces at the given per mille of each job's life
+static int64_t mine(int64_t now_us, int jobs, const int * offsets, int offset_count, bool repeat_work)
+{
+    for (int i = 0; i < jobs; i++) {
+        uint8_t job_id = (i * 8) % ASIC_JOB_SLOTS;
+        int64_t interval_us = (int64_t)(job_interval_get_ms(&ji) * 1000);
+        job.ntime = repeat_work ? 0 : i;
+        job_interval_job_sent(&ji, 0, job_id, now_us);
+        for (int n = 0; n < offset_count; n++) {
+            job_interval_nonce(&ji, 0, job_id, &job, n, 0x20000000, now_us + interval_us * offsets[n] / 1000);
+        }
+        now_us += interval_us;
+    }
+    return now_us;
+}
+
+TEST_CASE("Job interval follows the static value when not adaptive", "[job_interval]")
+{
+    start();
+    static const int offsets[] = {100, 900};
+    int64_t now = mine(2, 200, offsets, 2, true);
+
+    TEST_ASSERT_EQUAL_DOUBLE(BASE_MS, job_interval_update(&ji, BASE_MS, false, now));
+    TEST_ASSERT_EQUAL(JOB_INTERVAL_BASELINE, job_interval_get_reason(&ji));
+    TEST_ASSERT_EQUAL_DOUBLE(250.0, job_interval_update(&ji, 250.0, false, now + 1));
+}
+
+TEST_CASE("Job interval waits for enough data", "[job_interval]")
+{
+    start();
+    static const int offsets[] = {100};
+    int64_t now = mine(2, 10, offsets, 1, true);
+
+    TEST_ASSERT_EQUAL_DOUBLE(BASE_MS, job_interval_update(&ji, BASE_MS, true, now + 11 * SECOND_US));
+    TEST_ASSERT_EQUAL(JOB_INTERVAL_BASELINE, job_interval_get_reason(&ji));
+}
+
+TEST_CASE("Job interval shortens on duplicate nonces", "[job_interval]")
+{
+    start();
+    static const int offsets[] = {100, 600};
+    int64_t now = mine(2, 120, offsets, 2, true);
+
+    TEST_ASSERT_EQUAL_DOUBLE(BASE_MS * 0.75, job_interval_update(&ji, BASE_MS, true, now));
+    TEST_ASSERT_EQUAL(JOB_INTERVAL_DUPLICATES, job_interval_get_reason(&ji));
+    TEST_ASSERT_EQUAL(1, ji.changes);
+}
+
+TEST_CASE("Job interval shortens when nonces dry up late in a job", "[job_interval]")
+{
+    start();
+    static const int offsets[] = {50, 200, 400};
+    int64_t now = mine(2, 120, offsets, 3, false);
+
+    TEST_ASSERT_EQUAL_DOUBLE(BASE_MS * 0.75, job_interval_update(&ji, BASE_MS, true, now));
+    TEST_ASSERT_EQUAL(JOB_INTERVAL_EXHAUSTED, job_interval_get_reason(&ji));
+}
+
+TEST_CASE("Job interval lengthens on slow job pickup", "[job_interval]")
+{
+    start();
+    // plenty of nonces, but never in the first 70% of a job
+    static const int offsets[] = {700, 750, 800, 850, 900, 950};
+    int64_t now = mine(2, 120, offsets, 6, false);
+
+    TEST_ASSERT_EQUAL_DOUBLE(BASE_MS * 1.25, job_interval_update(&ji, BASE_MS, true, now));
+    TEST_ASSERT_EQUAL(JOB_INTERVAL_SLOW_PICKUP, job_interval_get_reason(&ji));
+}
+
+TEST_CASE("Job interval grows while steady, up to its limit", "[job_interval]")
+{
+    start();
+    static const int offsets[] = {100, 300, 500, 700, 900};
+    int64_t now = 2;
+    for (int round = 0; round < 20; round++) {
+        now = mine(now, 200, offsets, 5, false);
+        job_interval_update(&ji, BASE_MS, true, now);
+        TEST_ASSERT_EQUAL(JOB_INTERVAL_STEADY, job_interval_get_reason(&ji));
+    }
+    TEST_ASSERT_EQUAL_DOUBLE(BASE_MS * 2, job_interval_get_ms(&ji));
+}
@@ -16,3 +16,27 @@ TEST_CASE("Check PLL frequency calculation", "[pll]")
     TEST_ASSERT_EQUAL_UINT8(1, postdiv2);
     TEST_ASSERT_FLOAT_WITHIN(0.01, 450.0, actual_freq);
 }
+
+TEST_CASE("PLL table matches the search on the ramp grid", "[pll]")
+{
+    const uint16_t ranges[][2] = {{60, 200}, {144, 235}, {160, 239}};
+
+    for (int r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+        for (float frequency = 50; frequency <= PLL_TABLE_MAX_FREQ; frequency += PLL_TABLE_STEP) {
+            uint8_t fb_divider, refdiv, postdiv1, postdiv2;
+            float actual_freq;
+            pll_get_parameters(frequency, ranges[r][0], ranges[r][1], &fb_divider, &refdiv, &postdiv1, &postdiv2, &actual_freq);
+
+            // off the grid by less than the lookup tolerance searches instead
+            uint8_t fb_divider2, refdiv2, postdiv12, postdiv22;
+            float actual_freq2;
+            pll_get_parameters(frequency + 0.001f, ranges[r][0], ranges[r][1], &fb_divider2, &refdiv2, &postdiv12, &postdiv22, &actual_freq2);
+
+            TEST_ASSERT_EQUAL_UINT8(fb_divider2, fb_divider);
+            TEST_ASSERT_EQUAL_UINT8(refdiv2, refdiv);
+            TEST_ASSERT_EQUAL_UINT8(postdiv12, postdiv1);
+            TEST_ASSERT_EQUAL_UINT8(postdiv22, postdiv2);
+            TEST_ASSERT_EQUAL_FLOAT(actual_freq2, actual_freq);
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#include "unity.h"
+
+#include <math.h>
+
+#include "power_governor.h"
+#include "asic_emulator.h"
+
+#define CHIPS 2
+#define CORE_VOLTAGE 1200
+#define POLL_US 100000LL
+
+static const asic_emulator_power_model_t MODEL = {
+    .static_w = 2,
+    .dynamic_w = 14,
+    .threshold_mv = 750,
+    .mhz_per_mv = 1.5,
+    .thermal_c_per_w = 2.5,
+    .ambient_c = 25,
+};
+
+static power_governor_t gov;
+static int64_t now_us;
+
+static float board_power(float frequency)
+{
+    asic_emulator_operating_point_t point;
+    asic_emulator_model(&MODEL, CHIPS, frequency, CORE_VOLTAGE, &point);
+    return point.power_w;
+}
+
+// polls like the power management task, returns the highest power seen in the last half
+static float run(float requested_frequency, int seconds)
+{
+    float peak = 0;
+    float frequency = requested_frequency;
+    int polls = seconds * 1000000LL / POLL_US;
+
+    for (int i = 0; i < polls; i++) {
+        now_us += POLL_US;
+        float power = board_power(frequency);
+        frequency = power_governor_update(&gov, power, requested_frequency, now_us);
+        if (i >= polls / 2 && power > peak) peak = power;
+    }
+    return peak;
+}
+
+TEST_CASE("Power governor settles just under the cap", "[power_governor]")
+{
+    now_us = 1;
+    power_governor_init(&gov, 30, 400);
+
+    // 625 MHz draws 39 W, 464 MHz is what fits in 30 W
+    float peak = run(625, 60);
+
+    TEST_ASSERT_TRUE(gov.limiting);
+    TEST_ASSERT_TRUE(peak <= 30);
+    TEST_ASSERT_TRUE(board_power(gov.frequency) >= 30 * (1 - POWER_GOVERNOR_HEADROOM) - 0.5f);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0, fmodf(gov.frequency, POWER_GOVERNOR_STEP));
+}
+
+TEST_CASE("Power governor gives the frequency back when the cap rises", "[power_governor]")
+{
+    now_us = 1;
+    power_governor_init(&gov, 30, 400);
+    run(625, 30);
+    TEST_ASSERT_TRUE(gov.frequency < 500);
+
+    // one step up per dwell, 464 MHz to 625 MHz is 26 of them
+    power_governor_set_cap(&gov, 50);
+    float frequency = gov.frequency;
+    run(625, 9);
+    TEST_ASSERT_TRUE(gov.frequency <= frequency + 2 * POWER_GOVERNOR_STEP);
+    run(625, 180);
+    TEST_ASSERT_FALSE(gov.limiting);
+    TEST_ASSERT_EQUAL_FLOAT(625, gov.frequency);
+}
+
+TEST_CASE("Power governor follows a lower request and its floor", "[power_governor]")
+{
+    now_us = 1;
+    power_governor_init(&gov, 30, 400);
+    run(625, 30);
+
+    // a request under the governed frequency takes effect on the next poll
+    now_us += POLL_US;
+    TEST_ASSERT_EQUAL_FLOAT(425, power_governor_update(&gov, board_power(464), 425, now_us));
+
+    // a cap nothing fits under stops at the floor rather than the chips
+    power_governor_set_cap(&gov, 5);
+    run(625, 30);
+    TEST_ASSERT_EQUAL_FLOAT(400, gov.frequency);
+
+    power_governor_set_cap(&gov, 0);
+    now_us += POLL_US;
+    TEST_ASSERT_EQUAL_FLOAT(625, power_governor_update(&gov, board_power(400), 625, now_us));
+}
@@ -0,0 +1,89 @@
+#include "unity.h"
+
+#include "register_poll.h"
+
+#define MS_US 1000LL
+
+// runs the poll in 1 ms ticks for a second, recording when each chip had each register read
+static int run(register_poll_t * poll, int64_t reads_us[][4][8], int counts[][4])
+{
+    int total = 0;
+    for (int64_t now_us = 0; now_us < 1000 * MS_US; now_us += MS_US) {
+        uint8_t address;
+        uint16_t asic_nr;
+        int this_tick = 0;
+        while (register_poll_next(poll, now_us, &address, &asic_nr)) {
+            int reg = address - 0x10;
+            if (counts[reg][asic_nr] < 8) {
+                reads_us[reg][asic_nr][counts[reg][asic_nr]] = now_us;
+            }
+            counts[reg][asic_nr]++;
+            this_tick++;
+            total++;
+        }
+        // never more than one read at a time
+        TEST_ASSERT_TRUE(this_tick <= 1);
+    }
+    return total;
+}
+
+TEST_CASE("Register poll spreads the reads over the period", "[register_poll]")
+{
+    register_poll_t poll;
+    register_poll_init(&poll, 4);
+    TEST_ASSERT_TRUE(register_poll_add(&poll, 0x10, 200));
+    TEST_ASSERT_TRUE(register_poll_add(&poll, 0x11, 400));
+    register_poll_start(&poll, 0);
+
+    int64_t reads_us[2][4][8] = {0};
+    int counts[2][4] = {0};
+    TEST_ASSERT_EQUAL(20 + 10, run(&poll, reads_us, counts));
+
+    for (int asic_nr = 0; asic_nr < 4; asic_nr++) {
+        TEST_ASSERT_EQUAL(5, counts[0][asic_nr]);
+        TEST_ASSERT_EQUAL(3, counts[1][asic_nr] + (asic_nr >= 2 ? 1 : 0));
+        // each chip a period apart, one chip a slot after the other
+        TEST_ASSERT_EQUAL(200 * MS_US, reads_us[0][asic_nr][1] - reads_us[0][asic_nr][0]);
+        TEST_ASSERT_EQUAL(asic_nr * 50 * MS_US, reads_us[0][asic_nr][0]);
+    }
+    // the second register sits between the slots of the first
+    TEST_ASSERT_EQUAL(25 * MS_US, reads_us[1][0][0]);
+}
+
+TEST_CASE("Register poll leaves the slots of skipped chips empty", "[register_poll]")
+{
+    register_poll_t poll;
+    register_poll_init(&poll, 4);
+    register_poll_add(&poll, 0x10, 200);
+    register_poll_skip(&poll, 1, true);
+    register_poll_skip(&poll, 3, true);
+    register_poll_start(&poll, 0);
+
+    int64_t reads_us[1][4][8] = {0};
+    int counts[1][4] = {0};
+    run(&poll, reads_us, counts);
+
+    TEST_ASSERT_EQUAL(5, counts[0][0]);
+    TEST_ASSERT_EQUAL(0, counts[0][1]);
+    TEST_ASSERT_EQUAL(5, counts[0][2]);
+    TEST_ASSERT_EQUAL(0, counts[0][3]);
+    TEST_ASSERT_EQUAL(100 * MS_US, reads_us[0][2][0]);
+}
+
+TEST_CASE("Register poll does not catch up in a burst", "[register_poll]")
+{
+    register_poll_t poll;
+    register_poll_init(&poll, 4);
+    register_poll_add(&poll, 0x10, 200);
+    register_poll_start(&poll, 0);
+
+    // stalled for a few periods
+    uint8_t address;
+    uint16_t asic_nr;
+    int reads = 0;
+    while (register_poll_next(&poll, 1000 * MS_US, &address, &asic_nr)) {
+        reads++;
+    }
+    TEST_ASSERT_TRUE(reads <= 4);
+    TEST_ASSERT_TRUE(register_poll_next_due_us(&poll) > 1000 * MS_US);
+}
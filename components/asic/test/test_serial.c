@@ -0,0 +1,238 @@
+#include "unity.h"
+
+#include "sdkconfig.h"
+#include "serial.h"
+#include "asic_common.h"
+#include "crc.h"
+
+#include <string.h>
+
+// pick the 5 crc bits of the last byte so the whole response checks out like a chip's would
+static void seal_response(uint8_t * response, int len)
+{
+    uint8_t flags = response[len - 1] & 0xE0;
+    for (uint8_t crc = 0; crc < 32; crc++) {
+        response[len - 1] = flags | crc;
+        if (crc5(response + 2, len - 2) == 0) return;
+    }
+    TEST_FAIL_MESSAGE("no valid crc5");
+}
+
+// chip side of an in-memory loopback: what the test queues is what the port receives
+typedef struct {
+    uint8_t rx[256];
+    int rx_head, rx_tail;
+    uint8_t tx[64];
+    int tx_len;
+} loopback_t;
+
+static loopback_t loopback;
+
+static int loopback_send(void * context, const uint8_t * data, int len)
+{
+    loopback_t * lb = context;
+    int n = len < (int) sizeof(lb->tx) - lb->tx_len ? len : (int) sizeof(lb->tx) - lb->tx_len;
+    memcpy(lb->tx + lb->tx_len, data, n);
+    lb->tx_len += n;
+    return n;
+}
+
+static int16_t loopback_receive(void * context, uint8_t * buf, uint16_t size, uint16_t timeout_ms)
+{
+    // nothing else writes while a test runs, so a short read is final without waiting out the timeout
+    loopback_t * lb = context;
+    int n = 0;
+    while (n < size && lb->rx_tail != lb->rx_head) {
+        buf[n++] = lb->rx[lb->rx_tail];
+        lb->rx_tail = (lb->rx_tail + 1) % sizeof(lb->rx);
+    }
+    return n;
+}
+
+static void loopback_queue(const uint8_t * data, int len)
+{
+    for (int i = 0; i < len; i++) {
+        loopback.rx[loopback.rx_head] = data[i];
+        loopback.rx_head = (loopback.rx_head + 1) % sizeof(loopback.rx);
+    }
+}
+
+static serial_port_t saved_port;
+
+static serial_port_t * attach_loopback(void)
+{
+    memset(&loopback, 0, sizeof(loopback));
+
+    serial_port_t * port = SERIAL_get_port(0);
+    saved_port = *port;
+
+    serial_stream_t stream = {
+        .send = loopback_send,
+        .receive = loopback_receive,
+        .context = &loopback,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_attach_stream(port, &stream));
+    TEST_ASSERT_FALSE(SERIAL_is_initialized(port));
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_init(port));
+    TEST_ASSERT_TRUE(SERIAL_is_initialized(port));
+    return port;
+}
+
+static void detach_loopback(serial_port_t * port)
+{
+    *port = saved_port;
+}
+
+TEST_CASE("Serial stream backend send and receive", "[serial]")
+{
+    serial_port_t * port = attach_loopback();
+
+    uint8_t tx[] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
+    TEST_ASSERT_EQUAL(sizeof(tx), SERIAL_send(port, tx, sizeof(tx), false));
+    TEST_ASSERT_EQUAL(sizeof(tx), loopback.tx_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(tx, loopback.tx, sizeof(tx));
+
+    uint8_t rx[sizeof(tx)];
+    loopback_queue(tx, sizeof(tx));
+    TEST_ASSERT_EQUAL(sizeof(tx), SERIAL_rx(port, rx, sizeof(rx), 50));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(tx, rx, sizeof(tx));
+
+    // a short frame is returned once the timeout expires
+    loopback_queue(tx, 3);
+    TEST_ASSERT_EQUAL(3, SERIAL_rx(port, rx, sizeof(rx), 50));
+
+    // nothing pending
+    TEST_ASSERT_EQUAL(0, SERIAL_rx(port, rx, sizeof(rx), 10));
+
+    // clearing drops whatever is still buffered
+    loopback_queue(tx, sizeof(tx));
+    SERIAL_clear_buffer(port);
+    TEST_ASSERT_EQUAL(0, SERIAL_rx(port, rx, sizeof(rx), 10));
+
+    detach_loopback(port);
+}
+
+TEST_CASE("Serial stream backend counts chips on a chain", "[serial]")
+{
+    serial_port_t * port = attach_loopback();
+
+    asic_chain_t chain = {
+        .index = 0,
+        .port = port,
+        .asic_count = 2,
+    };
+
+    // BM1370 CHIP_ID response: AA 55 13 70 <core num> <addr> 00 00 00 00 <crc5>
+    for (int i = 0; i < 2; i++) {
+        uint8_t response[11] = {0xAA, 0x55, 0x13, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        seal_response(response, sizeof(response));
+        loopback_queue(response, sizeof(response));
+    }
+
+    TEST_ASSERT_EQUAL(2, count_asic_chips(&chain, 0x1370, 11));
+    TEST_ASSERT_EQUAL(2, chain.chip_count);
+
+    detach_loopback(port);
+}
+
+TEST_CASE("Serial stream backend counts garbled responses", "[serial]")
+{
+    serial_port_t * port = attach_loopback();
+
+    asic_chain_t chain = {
+        .index = 0,
+        .port = port,
+        .asic_count = 1,
+    };
+    atomic_init(&chain.rx_collisions, 0);
+
+    uint8_t response[11] = {0xAA, 0x55, 0x13, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    seal_response(response, sizeof(response));
+
+    uint8_t buffer[11];
+    loopback_queue(response, sizeof(response));
+    TEST_ASSERT_EQUAL(ESP_OK, receive_work(&chain, buffer, sizeof(buffer), NULL));
+    TEST_ASSERT_EQUAL(0, atomic_load(&chain.rx_collisions));
+
+    // two replies running into each other break the crc
+    response[4] ^= 0x01;
+    loopback_queue(response, sizeof(response));
+    TEST_ASSERT_EQUAL(ESP_FAIL, receive_work(&chain, buffer, sizeof(buffer), NULL));
+    TEST_ASSERT_EQUAL(1, atomic_load(&chain.rx_collisions));
+
+    // a truncated reply counts too
+    loopback_queue(response, 5);
+    TEST_ASSERT_EQUAL(ESP_FAIL, receive_work(&chain, buffer, sizeof(buffer), NULL));
+    TEST_ASSERT_EQUAL(2, atomic_load(&chain.rx_collisions));
+
+    detach_loopback(port);
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+static serial_port_t * attach_socketpair(int * peer)
+{
+    int sv[2];
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+    serial_port_t * port = SERIAL_get_port(0);
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_attach_fd(port, sv[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_init(port));
+    TEST_ASSERT_TRUE(SERIAL_is_initialized(port));
+
+    *peer = sv[1];
+    return port;
+}
+
+TEST_CASE("Serial fd backend send and receive", "[serial]")
+{
+    int peer;
+    serial_port_t * port = attach_socketpair(&peer);
+
+    uint8_t tx[] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
+    TEST_ASSERT_EQUAL(sizeof(tx), SERIAL_send(port, tx, sizeof(tx), false));
+
+    uint8_t rx[sizeof(tx)];
+    TEST_ASSERT_EQUAL(sizeof(tx), read(peer, rx, sizeof(rx)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(tx, rx, sizeof(tx));
+
+    // a short frame is returned once the timeout expires
+    TEST_ASSERT_EQUAL(3, write(peer, tx, 3));
+    TEST_ASSERT_EQUAL(3, SERIAL_rx(port, rx, sizeof(rx), 50));
+
+    // nothing pending
+    TEST_ASSERT_EQUAL(0, SERIAL_rx(port, rx, sizeof(rx), 10));
+
+    close(peer);
+    close(port->fd);
+}
+
+TEST_CASE("Serial fd backend counts chips on a chain", "[serial]")
+{
+    int peer;
+    serial_port_t * port = attach_socketpair(&peer);
+
+    asic_chain_t chain = {
+        .index = 0,
+        .port = port,
+        .asic_count = 2,
+    };
+
+    // BM1370 CHIP_ID response: AA 55 13 70 <core num> <addr> 00 00 00 00 <crc5>
+    for (int i = 0; i < 2; i++) {
+        uint8_t response[11] = {0xAA, 0x55, 0x13, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        seal_response(response, sizeof(response));
+        TEST_ASSERT_EQUAL(sizeof(response), write(peer, response, sizeof(response)));
+    }
+
+    TEST_ASSERT_EQUAL(2, count_asic_chips(&chain, 0x1370, 11));
+    TEST_ASSERT_EQUAL(2, chain.chip_count);
+
+    close(peer);
+    close(port->fd);
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include "unity.h"
+
+#include "thermal_governor.h"
+#include "asic_emulator.h"
+
+#define LIMIT 75.0f
+#define CORE_VOLTAGE 1200
+#define POLL_US 100000LL
+// the die follows its power with this time constant
+#define THERMAL_TAU_S 20.0f
+
+// 625 MHz settles at 80°C, the limit is crossed without throttling
+static asic_emulator_power_model_t model = {
+    .static_w = 2,
+    .dynamic_w = 14,
+    .threshold_mv = 750,
+    .mhz_per_mv = 1.5,
+    .thermal_c_per_w = 2.8,
+    .ambient_c = 25,
+};
+
+static thermal_governor_t gov;
+static int64_t now_us;
+static float temp;
+static float frequency;
+
+// polls like the power management task, returns the hottest it got
+static float run(float requested_frequency, bool fan_headroom, int seconds)
+{
+    float peak = 0;
+    int polls = seconds * 1000000LL / POLL_US;
+
+    for (int i = 0; i < polls; i++) {
+        now_us += POLL_US;
+
+        asic_emulator_operating_point_t point;
+        asic_emulator_model(&model, 1, frequency, CORE_VOLTAGE, &point);
+        temp += (point.temp_c - temp) * (POLL_US / 1e6f) / THERMAL_TAU_S;
+        if (temp > peak) peak = temp;
+
+        frequency = thermal_governor_update(&gov, LIMIT - temp, fan_headroom, requested_frequency, now_us);
+    }
+    return peak;
+}
+
+static void start(void)
+{
+    thermal_governor_init(&gov, 400);
+    model.ambient_c = 25;
+    now_us = 1;
+    temp = 40;
+    frequency = 625;
+}
+
+TEST_CASE("Thermal governor slows down before the limit", "[thermal_governor]")
+{
+    start();
+
+    float peak = run(625, false, 600);
+
+    TEST_ASSERT_TRUE(gov.limiting);
+    TEST_ASSERT_TRUE(peak < LIMIT);
+    // settles between the margin and the margin plus hysteresis, 464-502 MHz here
+    TEST_ASSERT_TRUE(temp < LIMIT - THERMAL_GOVERNOR_MARGIN + 1);
+    TEST_ASSERT_TRUE(temp > LIMIT - THERMAL_GOVERNOR_MARGIN - THERMAL_GOVERNOR_HYSTERESIS - 1);
+    TEST_ASSERT_TRUE(frequency >= 450);
+}
+
+TEST_CASE("Thermal governor gives the frequency back when it cools down", "[thermal_governor]")
+{
+    start();
+    run(625, false, 600);
+    float throttled = frequency;
+
+    model.ambient_c = 10;
+    run(625, false, 900);
+
+    TEST_ASSERT_TRUE(frequency > throttled);
+    TEST_ASSERT_TRUE(temp < LIMIT);
+}
+
+TEST_CASE("Thermal governor leaves a fan with headroom to do its job", "[thermal_governor]")
+{
+    start();
+    model.thermal_c_per_w = 2.2;        // 625 MHz settles at 68°C
+
+    run(625, true, 600);
+    TEST_ASSERT_FALSE(gov.limiting);
+    TEST_ASSERT_EQUAL_FLOAT(625, frequency);
+
+    // a trend that would cross the limit is acted on regardless
+    model.thermal_c_per_w = 2.8;
+    float peak = run(625, true, 600);
+    TEST_ASSERT_TRUE(gov.limiting);
+    TEST_ASSERT_TRUE(peak < LIMIT);
+}
@@ -79,4 +79,44 @@ TEST_CASE("Check max asic timeout 1x BM1370", "[common]")
     double expected_ms = 305419.897;
 
     TEST_ASSERT_FLOAT_WITHIN(0.01, expected_ms, timeout_ms);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Job interval follows the chips hashing on each chain", "[common]")
+{
+    asic_job_timing_t timing = {
+        .default_timeout_ms = 2000,
+        .frequency_mhz = 525,
+        .cores = 128,
+        .small_cores = 2040,
+    };
+
+    // not enumerated yet, the expected count stands in
+    asic_chain_t full = { .asic_count = 4 };
+    TEST_ASSERT_EQUAL_FLOAT(500, asic_chain_job_interval_ms(&full, &timing));
+
+    // a chain that bypassed chips needs work less often than its neighbour
+    asic_chain_t bypassed = { .asic_count = 4, .chip_count = 4, .live_count = 2 };
+    TEST_ASSERT_EQUAL(2, asic_chain_hashing_chips(&bypassed));
+    TEST_ASSERT_EQUAL_FLOAT(1000, asic_chain_job_interval_ms(&bypassed, &timing));
+
+    // chip counts round up to a power of two like the address space does
+    bypassed.live_count = 3;
+    TEST_ASSERT_EQUAL_FLOAT(500, asic_chain_job_interval_ms(&bypassed, &timing));
+}
+
+TEST_CASE("BM1397 job interval follows the chips hashing on each chain", "[common]")
+{
+    asic_job_timing_t timing = {
+        .default_timeout_ms = 20,
+        .frequency_mhz = 450,
+        .cores = 168,
+        .small_cores = 672,
+        .split_between_cores = true,
+    };
+
+    asic_chain_t one = { .asic_count = 2, .chip_count = 2, .live_count = 1 };
+    asic_chain_t two = { .asic_count = 2, .chip_count = 2, .live_count = 2 };
+
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 37.283, asic_chain_job_interval_ms(&one, &timing));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 18.641, asic_chain_job_interval_ms(&two, &timing));
+}
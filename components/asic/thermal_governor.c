@@ -0,0 +1,106 @@
+#include <string.h>
+#include <math.h>
+
+#include "esp_log.h"
+
+#include "thermal_governor.h"
+
+// Temperature readings are smoothed before their trend is taken
+#define HEADROOM_TAU_US 3000000LL
+#define SLOPE_PERIOD_US 1000000LL
+#define SLOPE_TAU_US 10000000LL
+// A slope this close to zero counts as settled when stepping back up
+#define SLOPE_SETTLED 0.01f
+
+// Chips heat up over tens of seconds, so give every change time to show
+#define DOWN_INTERVAL_US 5000000LL
+#define UP_INTERVAL_US 15000000LL
+// Steps taken per degree the predicted headroom falls short of the margin
+#define STEPS_PER_DEGREE 1.0f
+#define MAX_STEPS_DOWN 8
+
+static const char * TAG = "thermal_governor";
+
+void thermal_governor_init(thermal_governor_t * gov, float min_frequency)
+{
+    memset(gov, 0, sizeof(*gov));
+    gov->min_frequency = min_frequency;
+}
+
+void thermal_governor_reset(thermal_governor_t * gov)
+{
+    gov->last_sample_us = 0;
+    gov->slope = 0;
+}
+
+static void filter(thermal_governor_t * gov, float headroom, int64_t now_us)
+{
+    if (gov->last_sample_us == 0) {
+        gov->headroom = headroom;
+        gov->slope = 0;
+        gov->last_slope_us = now_us;
+        gov->last_slope_headroom = headroom;
+    } else {
+        float dt = now_us - gov->last_sample_us;
+        gov->headroom += dt / (HEADROOM_TAU_US + dt) * (headroom - gov->headroom);
+    }
+    gov->last_sample_us = now_us;
+
+    int64_t period_us = now_us - gov->last_slope_us;
+    if (period_us >= SLOPE_PERIOD_US) {
+        float slope = (gov->headroom - gov->last_slope_headroom) / (period_us / 1e6f);
+        gov->slope += (float)period_us / (SLOPE_TAU_US + period_us) * (slope - gov->slope);
+        gov->last_slope_us = now_us;
+        gov->last_slope_headroom = gov->headroom;
+    }
+
+    // only a shrinking headroom is followed ahead, a growing one is not counted on
+    gov->predicted = gov->headroom + fminf(gov->slope, 0) * (THERMAL_GOVERNOR_HORIZON_US / 1e6f);
+}
+
+float thermal_governor_update(thermal_governor_t * gov, float headroom, bool fan_headroom,
+                              float requested_frequency, int64_t now_us)
+{
+    filter(gov, headroom, now_us);
+
+    // a lower request is followed at once
+    if (gov->frequency <= 0 || gov->frequency > requested_frequency) {
+        gov->frequency = requested_frequency;
+    }
+
+    float frequency = gov->frequency;
+    bool too_hot = gov->predicted < THERMAL_GOVERNOR_MARGIN
+        && (!fan_headroom || gov->predicted < 0 || gov->headroom < THERMAL_GOVERNOR_MARGIN);
+
+    if (too_hot && now_us - gov->last_change_us >= DOWN_INTERVAL_US) {
+        int steps = ceilf((THERMAL_GOVERNOR_MARGIN - gov->predicted) * STEPS_PER_DEGREE);
+        if (steps < 1) steps = 1;
+        if (steps > MAX_STEPS_DOWN) steps = MAX_STEPS_DOWN;
+        frequency = (ceilf(gov->frequency / THERMAL_GOVERNOR_STEP) - steps) * THERMAL_GOVERNOR_STEP;
+    } else if (!too_hot && gov->predicted > THERMAL_GOVERNOR_MARGIN + THERMAL_GOVERNOR_HYSTERESIS
+               && gov->slope > -SLOPE_SETTLED && gov->frequency < requested_frequency
+               && now_us - gov->last_change_us >= UP_INTERVAL_US) {
+        frequency = (floorf(gov->frequency / THERMAL_GOVERNOR_STEP) + 1) * THERMAL_GOVERNOR_STEP;
+    }
+
+    if (frequency < gov->min_frequency) frequency = gov->min_frequency;
+    if (frequency > requested_frequency) frequency = requested_frequency;
+
+    if (frequency != gov->frequency) {
+        ESP_LOGD(TAG, "%.1f°C headroom, %.1f°C ahead: %g MHz -> %g MHz", gov->headroom, gov->predicted, gov->frequency, frequency);
+        gov->frequency = frequency;
+        gov->last_change_us = now_us;
+    }
+
+    bool limiting = gov->frequency < requested_frequency;
+    if (limiting != gov->limiting) {
+        if (limiting) {
+            ESP_LOGW(TAG, "Limiting to %g MHz with %.1f°C of headroom left", gov->frequency, gov->headroom);
+        } else {
+            ESP_LOGI(TAG, "Back at the requested %g MHz", requested_frequency);
+        }
+        gov->limiting = limiting;
+    }
+
+    return gov->frequency;
+}
@@ -0,0 +1,371 @@
+#include <string.h>
+
+#include "history.h"
+
+#define MAX_VARINT_BYTES 10
+#define WIDTH_OFFSETS 0x80          // flags a column packed as offsets from its lowest value
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static uint8_t put_uvarint(uint8_t * out, uint64_t value)
+{
+    uint8_t length = 0;
+
+    while (value >= 0x80) {
+        out[length++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    return length;
+}
+
+static uint8_t uvarint_size(uint64_t value)
+{
+    uint8_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+static uint64_t get_uvarint(const uint8_t * in, uint32_t * position)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do {
+        byte = in[(*position)++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && shift < 64);
+
+    return value;
+}
+
+// out is zeroed beforehand
+static void put_bits(uint8_t * out, uint32_t * bit, uint64_t value, uint8_t width)
+{
+    while (width > 0) {
+        uint8_t shift = *bit % 8;
+        uint8_t count = 8 - shift < width ? 8 - shift : width;
+        out[*bit / 8] |= (value & ((1u << count) - 1)) << shift;
+        value >>= count;
+        width -= count;
+        *bit += count;
+    }
+}
+
+static uint64_t get_bits(const uint8_t * in, uint32_t * bit, uint8_t width)
+{
+    uint64_t value = 0;
+
+    for (uint8_t done = 0; done < width;) {
+        uint8_t shift = *bit % 8;
+        uint8_t count = 8 - shift < width - done ? 8 - shift : width - done;
+        value |= (uint64_t)((in[*bit / 8] >> shift) & ((1u << count) - 1)) << done;
+        done += count;
+        *bit += count;
+    }
+    return value;
+}
+
+// Steps kept as varints ahead of the packed ones: the first value, and for
+// the timestamps the first delta too, are far wider than what follows
+static uint8_t head_steps(uint8_t column)
+{
+    return 0 == column ? 2 : 1;
+}
+
+static void reset_open_block(history_t * history)
+{
+    memset(&history->open_block, 0, sizeof(history->open_block));
+    memset(history->open_length, 0, sizeof(history->open_length));
+    memset(history->open_previous, 0, sizeof(history->open_previous));
+    history->open_max_length = 0;
+    history->open_delta = 0;
+}
+
+void history_init(history_t * history, uint8_t columns, uint8_t * data, uint32_t size,
+                  history_block_t * blocks, uint16_t block_capacity, uint8_t * open)
+{
+    memset(history, 0, sizeof(*history));
+    history->columns = columns;
+    history->size = size;
+    history->data = data;
+    history->blocks = blocks;
+    history->block_capacity = block_capacity;
+    history->open = open;
+}
+
+static void drop_oldest_block(history_t * history)
+{
+    history->first_block = (history->first_block + 1) % history->block_capacity;
+    history->block_count--;
+    history->first_sequence++;
+}
+
+// Makes room for a block at the head, dropping the oldest ones in the way
+static void allocate_block(history_t * history, uint32_t length)
+{
+    while (true) {
+        if (0 == history->block_count) {
+            history->head = 0;
+            return;
+        }
+
+        uint32_t tail = history->blocks[history->first_block].offset;
+        if (history->block_count < history->block_capacity) {
+            if (tail < history->head) {
+                if (history->head + length <= history->size) return;
+                if (length <= tail) {
+                    history->head = 0;
+                    return;
+                }
+            } else if (history->head + length <= tail) {
+                return;
+            }
+        }
+
+        drop_oldest_block(history);
+    }
+}
+
+static uint8_t bit_width(uint64_t value)
+{
+    uint8_t width = 0;
+    while (width < 64 && (value >> width) != 0) {
+        width++;
+    }
+    return width;
+}
+
+static uint32_t packed_count(uint16_t points, uint8_t column, uint8_t width)
+{
+    if (width & WIDTH_OFFSETS) {
+        return points;
+    }
+    return points > head_steps(column) ? points - head_steps(column) : 0;
+}
+
+// Packs a staged column as steps, or as offsets from its lowest value when
+// that is smaller, as for noise around a level. Returns its width.
+static uint8_t plan_column(const history_t * history, uint8_t column, uint64_t heads[], uint64_t packed[])
+{
+    const uint8_t * in = history->open + column * HISTORY_COLUMN_BYTES;
+    uint16_t points = history->open_block.points;
+    uint8_t steps = head_steps(column);
+    uint32_t position = 0;
+    uint64_t widest = 0;
+    int64_t value = 0;
+    int64_t low = INT64_MAX;
+    int64_t high = INT64_MIN;
+
+    for (int i = 0; i < points; i++) {
+        uint64_t step = get_uvarint(in, &position);
+        if (i < steps) {
+            heads[i] = step;
+        } else {
+            packed[i - steps] = step;
+            widest |= step;
+        }
+
+        value += unzigzag(step);
+        if (value < low) low = value;
+        if (value > high) high = value;
+    }
+
+    uint8_t width = bit_width(widest);
+    if (0 == column || points <= steps) {
+        return width;
+    }
+
+    uint8_t offset_width = bit_width(high - low);
+    uint32_t step_bits = (points - steps) * width + 8 * uvarint_size(heads[0]);
+    uint32_t offset_bits = points * offset_width + 8 * uvarint_size(zigzag(low));
+    if (offset_bits >= step_bits) {
+        return width;
+    }
+
+    value = 0;
+    position = 0;
+    for (int i = 0; i < points; i++) {
+        value += unzigzag(get_uvarint(in, &position));
+        packed[i] = value - low;
+    }
+    heads[0] = zigzag(low);
+    return offset_width | WIDTH_OFFSETS;
+}
+
+void history_close_block(history_t * history)
+{
+    history_block_t * block = &history->open_block;
+    if (0 == block->points) {
+        return;
+    }
+
+    uint64_t heads[2];
+    uint64_t packed[HISTORY_BLOCK_POINTS];
+    uint8_t widths[HISTORY_MAX_COLUMNS];
+    uint32_t length = history->columns;
+    uint32_t bits = 0;
+    for (int column = 0; column < history->columns; column++) {
+        widths[column] = plan_column(history, column, heads, packed);
+        for (int i = 0; i < block->points && i < head_steps(column); i++) {
+            length += uvarint_size(heads[i]);
+        }
+        bits += packed_count(block->points, column, widths[column]) * (widths[column] & ~WIDTH_OFFSETS);
+    }
+    length += (bits + 7) / 8;
+
+    allocate_block(history, length);
+
+    // planned again column by column rather than held for all of them
+    uint8_t * out = history->data + history->head;
+    uint8_t * packed_out = out + length - (bits + 7) / 8;
+    uint32_t bit = 0;
+    memset(out, 0, length);
+    memcpy(out, widths, history->columns);
+    out += history->columns;
+    for (int column = 0; column < history->columns; column++) {
+        plan_column(history, column, heads, packed);
+        for (int i = 0; i < block->points && i < head_steps(column); i++) {
+            out += put_uvarint(out, heads[i]);
+        }
+        for (int i = 0; i < packed_count(block->points, column, widths[column]); i++) {
+            put_bits(packed_out, &bit, packed[i], widths[column] & ~WIDTH_OFFSETS);
+        }
+    }
+
+    block->offset = history->head;
+    block->length = length;
+    history->head += length;
+
+    history->blocks[(history->first_block + history->block_count) % history->block_capacity] = *block;
+    history->block_count++;
+    reset_open_block(history);
+}
+
+static void put_column(history_t * history, int column, int64_t step)
+{
+    uint8_t * out = history->open + column * HISTORY_COLUMN_BYTES + history->open_length[column];
+
+    history->open_length[column] += put_uvarint(out, zigzag(step));
+    if (history->open_length[column] > history->open_max_length) {
+        history->open_max_length = history->open_length[column];
+    }
+}
+
+void history_push(history_t * history, const int64_t values[])
+{
+    history_block_t * block = &history->open_block;
+
+    if (history->open_max_length + MAX_VARINT_BYTES > HISTORY_COLUMN_BYTES) {
+        history_close_block(history);
+    }
+
+    // the timestamps are regular, so their deltas hardly change
+    int64_t delta = values[0] - history->open_previous[0];
+    put_column(history, 0, delta - history->open_delta);
+    history->open_delta = 0 == block->points ? 0 : delta;
+    history->open_previous[0] = values[0];
+
+    for (int column = 1; column < history->columns; column++) {
+        put_column(history, column, values[column] - history->open_previous[column]);
+        history->open_previous[column] = values[column];
+    }
+
+    if (0 == block->points) {
+        block->first_timestamp = values[0];
+    }
+    block->last_timestamp = values[0];
+    if (++block->points == HISTORY_BLOCK_POINTS) {
+        history_close_block(history);
+    }
+}
+
+uint64_t history_oldest(const history_t * history)
+{
+    if (0 != history->block_count) {
+        return history->blocks[history->first_block].first_timestamp;
+    }
+    return 0 != history->open_block.points ? history->open_block.first_timestamp : UINT64_MAX;
+}
+
+const history_block_t * history_get_block(const history_t * history, uint32_t * sequence, bool * open)
+{
+    if (*sequence < history->first_sequence) {
+        *sequence = history->first_sequence;
+    }
+
+    uint32_t position = *sequence - history->first_sequence;
+    *open = position >= history->block_count;
+    if (*open) {
+        return &history->open_block;
+    }
+    return &history->blocks[(history->first_block + position) % history->block_capacity];
+}
+
+void history_decode(const history_t * history, const history_block_t * block, bool open, uint8_t column, int64_t values[])
+{
+    uint32_t position = 0;
+
+    // the steps first
+    if (open) {
+        const uint8_t * in = history->open + column * HISTORY_COLUMN_BYTES;
+        for (int i = 0; i < block->points; i++) {
+            values[i] = unzigzag(get_uvarint(in, &position));
+        }
+    } else {
+        // the widths, then the heads of all columns, then the packed ones of
+        // the columns before
+        const uint8_t * in = history->data + block->offset;
+        uint8_t width = in[column] & ~WIDTH_OFFSETS;
+        uint8_t steps = block->points < head_steps(column) ? block->points : head_steps(column);
+        uint32_t bit = 0;
+        position = history->columns;
+        for (int i = 0; i < history->columns; i++) {
+            for (int j = 0; j < block->points && j < head_steps(i); j++) {
+                uint64_t head = get_uvarint(in, &position);
+                if (i == column) {
+                    values[j] = unzigzag(head);
+                }
+            }
+            if (i < column) {
+                bit += packed_count(block->points, i, in[i]) * (in[i] & ~WIDTH_OFFSETS);
+            }
+        }
+
+        if (in[column] & WIDTH_OFFSETS) {
+            int64_t low = values[0];
+            for (int i = 0; i < block->points; i++) {
+                values[i] = low + get_bits(in + position, &bit, width);
+            }
+            return;
+        }
+        for (int i = steps; i < block->points; i++) {
+            values[i] = unzigzag(get_bits(in + position, &bit, width));
+        }
+    }
+
+    int64_t value = 0;
+    int64_t delta = 0;
+    for (int i = 0; i < block->points; i++) {
+        if (0 == column) {
+            delta = 1 == i ? values[i] : delta + values[i];
+            value += 0 == i ? values[i] : delta;
+        } else {
+            value += values[i];
+        }
+        values[i] = value;
+    }
+}
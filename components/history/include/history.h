@@ -0,0 +1,78 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A round-robin history of points of integer columns, column 0 being the
+// timestamp, packed into a byte ring.
+//
+// Points are stored column by column in blocks. Every column is delta coded
+// against the point before, the timestamps delta-of-delta coded. The block
+// being filled is staged apart as zigzag varints. When it closes, each column
+// is bit packed at the width its largest step needs, so a column that does
+// not change takes no bits at all, or as offsets from its lowest value where
+// those are narrower, as for noise around a level. A closed block holds the
+// width of each column, then the first steps of each as varints, then the
+// packed ones of all columns one after the other, so where a column starts
+// follows from the widths. When a closed block needs room the oldest ones are
+// dropped.
+
+#define HISTORY_BLOCK_POINTS 32
+#define HISTORY_COLUMN_BYTES 64     // staging for a column of the open block
+#define HISTORY_MAX_COLUMNS 55
+
+typedef struct
+{
+    uint32_t offset;                // of the column widths in the data
+    uint16_t length;                // bytes in the data
+    uint16_t points;
+    uint64_t first_timestamp;
+    uint64_t last_timestamp;
+} history_block_t;
+
+typedef struct
+{
+    uint8_t columns;
+    uint32_t size;                  // bytes of closed blocks
+
+    uint8_t * data;
+    uint32_t head;                  // where the next block goes
+    history_block_t * blocks;
+    uint16_t block_capacity;
+    uint16_t first_block;
+    uint16_t block_count;
+    uint32_t first_sequence;        // of the oldest block, counting since the init
+
+    // the block being filled
+    uint8_t * open;
+    history_block_t open_block;
+    uint8_t open_length[HISTORY_MAX_COLUMNS];
+    uint8_t open_max_length;
+    int64_t open_previous[HISTORY_MAX_COLUMNS];
+    int64_t open_delta;
+} history_t;
+
+// data holds size bytes, blocks block_capacity entries and open
+// HISTORY_COLUMN_BYTES for each column. The oldest blocks are dropped when
+// either the data or the block list is full.
+void history_init(history_t * history, uint8_t columns, uint8_t * data, uint32_t size,
+                  history_block_t * blocks, uint16_t block_capacity, uint8_t * open);
+
+// values has one entry per column, the timestamp first
+void history_push(history_t * history, const int64_t values[]);
+
+// Closes the open block early, dropping the oldest ones it needs room from
+void history_close_block(history_t * history);
+
+// Timestamp of the oldest point held, UINT64_MAX while empty
+uint64_t history_oldest(const history_t * history);
+
+// The block at sequence, moved on to the oldest one still held. Past the
+// closed blocks the open one is returned with open set.
+const history_block_t * history_get_block(const history_t * history, uint32_t * sequence, bool * open);
+
+// Decodes a column of a block into one value per point
+void history_decode(const history_t * history, const history_block_t * block, bool open, uint8_t column, int64_t values[]);
+
+#endif /* HISTORY_H_ */
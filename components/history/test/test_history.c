@@ -0,0 +1,185 @@
+#include "unity.h"
+
+#include <string.h>
+
+#include "history.h"
+
+#define COLUMNS 4
+#define MAX_BLOCKS 64
+
+static history_t history;
+static uint8_t data[4096];
+static history_block_t blocks[MAX_BLOCKS];
+static uint8_t open[COLUMNS * HISTORY_COLUMN_BYTES];
+
+// point i of a run: regular timestamps with some jitter, a slow ramp, a
+// column swinging between both signs and one that jumps now and then
+static int64_t value(int i, int column)
+{
+    switch (column) {
+        case 0: return 1000000 + 1000LL * i + i % 3;
+        case 1: return 2500 + i / 4;
+        case 2: return (i % 2 ? -1 : 1) * (int64_t)i * 37;
+        default: return i % 10 == 9 ? 1000000000000LL : -5;
+    }
+}
+
+static void init(uint32_t size, uint16_t block_capacity)
+{
+    memset(data, 0, sizeof(data));
+    history_init(&history, COLUMNS, data, size, blocks, block_capacity, open);
+}
+
+static void push(int count)
+{
+    static int next;
+    if (history.block_count == 0 && history.open_block.points == 0) next = 0;
+
+    for (int n = 0; n < count; n++, next++) {
+        int64_t values[COLUMNS];
+        for (int column = 0; column < COLUMNS; column++) {
+            values[column] = value(next, column);
+        }
+        history_push(&history, values);
+    }
+}
+
+// Decodes everything held, checks it against the values pushed and that
+// the closed blocks lie in the ring without overlapping. Returns the points.
+static int check(int last)
+{
+    int points = 0;
+    int first = -1;
+    uint32_t sequence = 0;
+    bool open_block = false;
+
+    for (int b = 0; !open_block; b++, sequence++) {
+        const history_block_t * block = history_get_block(&history, &sequence, &open_block);
+        TEST_ASSERT_TRUE(open_block || block->points > 0);
+
+        if (!open_block) {
+            TEST_ASSERT_TRUE(block->offset + block->length <= history.size);
+
+            for (int other = b + 1; other < history.block_count; other++) {
+                const history_block_t * later = &history.blocks[(history.first_block + other) % history.block_capacity];
+                TEST_ASSERT_TRUE(later->offset >= block->offset + block->length
+                                 || later->offset + later->length <= block->offset);
+            }
+        }
+
+        int64_t values[COLUMNS][HISTORY_BLOCK_POINTS];
+        for (int column = 0; column < COLUMNS; column++) {
+            history_decode(&history, block, open_block, column, values[column]);
+        }
+
+        for (int i = 0; i < block->points; i++) {
+            int index = values[0][i] / 1000 - 1000;
+            if (first < 0) first = index;
+            TEST_ASSERT_EQUAL(first + points, index);
+            for (int column = 0; column < COLUMNS; column++) {
+                TEST_ASSERT_EQUAL_INT64(value(index, column), values[column][i]);
+            }
+            points++;
+        }
+        if (block->points > 0) {
+            TEST_ASSERT_EQUAL_UINT64(values[0][0], block->first_timestamp);
+            TEST_ASSERT_EQUAL_UINT64(values[0][block->points - 1], block->last_timestamp);
+        }
+    }
+
+    // nothing newer was lost
+    TEST_ASSERT_EQUAL(last, first + points - 1);
+    TEST_ASSERT_EQUAL_UINT64(value(first, 0), history_oldest(&history));
+    return points;
+}
+
+TEST_CASE("History gives back the points it was given", "[history]")
+{
+    init(sizeof(data), MAX_BLOCKS);
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, history_oldest(&history));
+
+    push(10);
+    TEST_ASSERT_EQUAL(0, history.block_count);
+    TEST_ASSERT_EQUAL(10, check(9));
+
+    push(190);
+    TEST_ASSERT_EQUAL(200, check(199));
+    TEST_ASSERT_EQUAL(0, history.first_sequence);
+
+    // the occasional big jump fills its column's staging before the block is full
+    bool short_block = false;
+    for (int b = 0; b < history.block_count; b++) {
+        short_block |= history.blocks[b].points < HISTORY_BLOCK_POINTS;
+    }
+    TEST_ASSERT_TRUE(short_block);
+
+    // closing the open block early moves its points, not their values
+    history_close_block(&history);
+    TEST_ASSERT_EQUAL(0, history.open_block.points);
+    TEST_ASSERT_EQUAL(200, check(199));
+}
+
+TEST_CASE("History drops the oldest blocks as the ring wraps", "[history]")
+{
+    init(600, MAX_BLOCKS);
+
+    // a few blocks fit, every push after that lands somewhere else in the ring
+    for (int n = 0; n < 60; n++) {
+        push(7);
+        check(7 * n + 6);
+    }
+
+    TEST_ASSERT_TRUE(history.first_sequence > 0);
+    TEST_ASSERT_TRUE(history_oldest(&history) > (uint64_t)value(0, 0));
+}
+
+TEST_CASE("History drops the oldest blocks once its block list is full", "[history]")
+{
+    init(sizeof(data), 3);
+
+    push(10 * HISTORY_BLOCK_POINTS);
+    TEST_ASSERT_EQUAL(3, history.block_count);
+    TEST_ASSERT_TRUE(check(10 * HISTORY_BLOCK_POINTS - 1) < 4 * HISTORY_BLOCK_POINTS);
+
+    // a reader left behind picks up at the oldest block still held
+    uint32_t sequence = 0;
+    bool open_block;
+    const history_block_t * block = history_get_block(&history, &sequence, &open_block);
+    TEST_ASSERT_EQUAL(history.first_sequence, sequence);
+    TEST_ASSERT_FALSE(open_block);
+    TEST_ASSERT_EQUAL_UINT64(history_oldest(&history), block->first_timestamp);
+}
+
+TEST_CASE("History packs each column at the width its steps need", "[history]")
+{
+    init(sizeof(data), MAX_BLOCKS);
+
+    // regular timestamps, a constant, a column stepping by one and one
+    // swinging within +-7
+    for (int i = 0; i < HISTORY_BLOCK_POINTS; i++) {
+        int64_t values[COLUMNS] = { 1000000 + 1000LL * i, 2500, 40000 + i, 7 * (i % 3) - 7 };
+        history_push(&history, values);
+    }
+    TEST_ASSERT_EQUAL(1, history.block_count);
+
+    // a width per column, the first steps as varints, then the other 30 or
+    // 31 steps packed at 0, 0 and 2 bits. The swinging column is cheaper as
+    // offsets from its lowest value, all 32 of them at 4 bits.
+    uint32_t expected = 4
+        + (3 + 2) + 2 + 3 + 1
+        + (31 * 2 + 32 * 4 + 7) / 8;
+    TEST_ASSERT_EQUAL(expected, history.blocks[0].length);
+
+    uint32_t sequence = 0;
+    bool open_block;
+    const history_block_t * block = history_get_block(&history, &sequence, &open_block);
+    int64_t values[HISTORY_BLOCK_POINTS];
+    history_decode(&history, block, open_block, 2, values);
+    for (int i = 0; i < HISTORY_BLOCK_POINTS; i++) {
+        TEST_ASSERT_EQUAL_INT64(40000 + i, values[i]);
+    }
+    history_decode(&history, block, open_block, 3, values);
+    for (int i = 0; i < HISTORY_BLOCK_POINTS; i++) {
+        TEST_ASSERT_EQUAL_INT64(7 * (i % 3) - 7, values[i]);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Writes JSON straight into a buffer the caller owns, handing it to a sink
+// whenever it fills up, so a response of any size is sent without building
+// a tree of it first or allocating anything.
+//
+// The same calls can write CBOR (RFC 8949) instead, with maps and arrays of
+// indefinite length, for the binary live feed.
+//
+// Numbers keep seven decimals, rounded like cJSON_AddFloatToObject. Keys are
+// held until the value after them is written, so a value that turns out to
+// be missing leaves no trace.
+
+#define JSON_WRITER_MAX_DEPTH 32
+#define JSON_WRITER_NUMBER_SIZE 32
+#define JSON_WRITER_CHUNK_SIZE 1024     // of a response's buffer, on the handler's stack
+
+// Takes a full buffer, returns ESP_OK to carry on
+typedef esp_err_t (*json_writer_sink_t)(void * context, const char * data, size_t length);
+
+typedef struct
+{
+    char * buffer;
+    size_t size;
+    size_t length;
+    json_writer_sink_t sink;
+    void * context;
+    esp_err_t err;          // the first error, everything after it is dropped
+    bool cbor;
+    bool chunked;           // finishing ends the chunked HTTP response
+    uint8_t depth;
+    uint32_t has_items;     // one bit per depth, set once something was written there
+    const char * key;
+    int32_t key_id;         // CBOR only, -1 for none
+} json_writer_t;
+
+void json_writer_init(json_writer_t * w, char * buffer, size_t size, bool cbor, json_writer_sink_t sink, void * context);
+
+// Streams JSON as the chunks of an HTTP response
+void json_writer_init_chunked(json_writer_t * w, char * buffer, size_t size, httpd_req_t * req);
+
+// Flushes what is left, and ends the response if it is chunked
+esp_err_t json_writer_finish(json_writer_t * w);
+
+// Carries on inside an object whose opening was written by someone else
+void json_writer_continue_object(json_writer_t * w);
+
+void json_writer_object_begin(json_writer_t * w);
+void json_writer_object_end(json_writer_t * w);
+void json_writer_array_begin(json_writer_t * w);
+void json_writer_array_end(json_writer_t * w);
+
+// Names the next value, NULL forgets a key that got no value
+void json_writer_key(json_writer_t * w, const char * key);
+
+// Names the next value with an integer, for CBOR
+void json_writer_key_id(json_writer_t * w, int32_t id);
+
+void json_writer_string(json_writer_t * w, const char * string);
+void json_writer_number(json_writer_t * w, double number);
+void json_writer_float(json_writer_t * w, float number);
+void json_writer_bool(json_writer_t * w, bool value);
+void json_writer_null(json_writer_t * w);
+
+// A value already written in the writer's format
+void json_writer_raw(json_writer_t * w, const char * data, size_t length);
+
+// Members already written in the writer's format, without the braces
+void json_writer_raw_members(json_writer_t * w, const char * data, size_t length);
+
+// Like the cJSON_Add*ToObject functions
+void json_writer_add_string(json_writer_t * w, const char * key, const char * string);
+void json_writer_add_number(json_writer_t * w, const char * key, double number);
+void json_writer_add_float(json_writer_t * w, const char * key, float number);
+void json_writer_add_bool(json_writer_t * w, const char * key, bool value);
+
+// Prints a finite number the way the writer does, returns its length
+size_t json_writer_print_number(char text[JSON_WRITER_NUMBER_SIZE], double number);
+
+#endif /* JSON_WRITER_H_ */
@@ -0,0 +1,425 @@
+#include <string.h>
+#include <math.h>
+
+#include "json_writer.h"
+
+// cJSON_AddFloatToObject rounds the same way
+#define DECIMALS 7
+#define DECIMAL_FACTOR 10000000.0
+
+#define TWO_TO_THE_64 18446744073709551616.0
+
+static void flush(json_writer_t * w)
+{
+    if (ESP_OK == w->err && 0 != w->length) {
+        w->err = w->sink(w->context, w->buffer, w->length);
+    }
+    w->length = 0;
+}
+
+static void put(json_writer_t * w, const char * data, size_t length)
+{
+    while (0 != length && ESP_OK == w->err) {
+        if (w->length == w->size) {
+            flush(w);
+        }
+        size_t room = w->size - w->length;
+        size_t part = length < room ? length : room;
+
+        memcpy(w->buffer + w->length, data, part);
+        w->length += part;
+        data += part;
+        length -= part;
+    }
+}
+
+static void put_string(json_writer_t * w, const char * string)
+{
+    put(w, string, strlen(string));
+}
+
+static size_t print_digits(char * text, uint64_t value)
+{
+    char digits[20];
+    size_t count = 0;
+
+    do {
+        digits[sizeof(digits) - ++count] = '0' + value % 10;
+        value /= 10;
+    } while (0 != value);
+    memcpy(text, digits + sizeof(digits) - count, count);
+    return count;
+}
+
+// Seven decimals at most, the trailing zeros left out
+static size_t print_fixed(char * text, double magnitude, bool negative)
+{
+    uint64_t fixed = (uint64_t)round(magnitude * DECIMAL_FACTOR);
+    uint64_t fraction = fixed % (uint64_t)DECIMAL_FACTOR;
+    size_t length = 0;
+
+    if (negative && 0 != fixed) {
+        text[length++] = '-';
+    }
+    length += print_digits(text + length, fixed / (uint64_t)DECIMAL_FACTOR);
+
+    if (0 != fraction) {
+        int last = DECIMALS;
+        text[length] = '.';
+        for (int i = DECIMALS; i > 0; i--) {
+            text[length + i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        while ('0' == text[length + last]) last--;
+        length += last + 1;
+    }
+    return length;
+}
+
+size_t json_writer_print_number(char text[JSON_WRITER_NUMBER_SIZE], double number)
+{
+    bool negative = number < 0;
+    double magnitude = fabs(number);
+
+    if (magnitude < 1e12) {
+        return print_fixed(text, magnitude, negative);
+    }
+
+    // past what the decimals fit in, whole numbers are all that is left
+    size_t length = 0;
+    if (negative) {
+        text[length++] = '-';
+    }
+    if (magnitude < TWO_TO_THE_64) {
+        return length + print_digits(text + length, (uint64_t)magnitude);
+    }
+
+    int exponent = (int)floor(log10(magnitude));
+    length += print_fixed(text + length, magnitude / pow(10, exponent), false);
+    text[length++] = 'e';
+    return length + print_digits(text + length, exponent);
+}
+
+// CBOR (RFC 8949), only what the fields need
+
+static void cbor_head(json_writer_t * w, uint8_t major, uint64_t argument)
+{
+    uint8_t head[9];
+    size_t length;
+
+    if (argument < 24) {
+        head[0] = (major << 5) | argument;
+        length = 1;
+    } else if (argument <= UINT8_MAX) {
+        head[0] = (major << 5) | 24;
+        length = 2;
+    } else if (argument <= UINT16_MAX) {
+        head[0] = (major << 5) | 25;
+        length = 3;
+    } else if (argument <= UINT32_MAX) {
+        head[0] = (major << 5) | 26;
+        length = 5;
+    } else {
+        head[0] = (major << 5) | 27;
+        length = 9;
+    }
+    // big endian
+    for (size_t i = 1; i < length; i++) {
+        head[i] = argument >> (8 * (length - 1 - i));
+    }
+    put(w, (const char *)head, length);
+}
+
+static void cbor_byte(json_writer_t * w, uint8_t byte)
+{
+    put(w, (const char *)&byte, 1);
+}
+
+static void cbor_float(json_writer_t * w, float number)
+{
+    uint32_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    uint8_t bytes[5] = { 0xfa, bits >> 24, bits >> 16, bits >> 8, bits };
+    put(w, (const char *)bytes, sizeof(bytes));
+}
+
+// Whole numbers as integers, anything else at the float precision it was measured in
+static void cbor_number(json_writer_t * w, double number)
+{
+    if (number == floor(number) && fabs(number) < TWO_TO_THE_64) {
+        if (number >= 0) {
+            cbor_head(w, 0, (uint64_t)number);
+        } else if (number >= -9223372036854775808.0) {
+            cbor_head(w, 1, (uint64_t)(-1 - (int64_t)number));
+        } else {
+            cbor_float(w, number);
+        }
+        return;
+    }
+    cbor_float(w, number);
+}
+
+static void cbor_text(json_writer_t * w, const char * string)
+{
+    size_t length = strlen(string);
+    cbor_head(w, 3, length);
+    put(w, string, length);
+}
+
+static void put_quoted(json_writer_t * w, const char * string)
+{
+    static const char HEX[] = "0123456789abcdef";
+
+    put(w, "\"", 1);
+    for (const char * start = string; ; string++) {
+        unsigned char c = *string;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        put(w, start, string - start);
+        if ('\0' == c) break;
+
+        switch (c) {
+            case '"':  put_string(w, "\\\""); break;
+            case '\\': put_string(w, "\\\\"); break;
+            case '\n': put_string(w, "\\n"); break;
+            case '\r': put_string(w, "\\r"); break;
+            case '\t': put_string(w, "\\t"); break;
+            default: {
+                char escaped[6] = { '\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf] };
+                put(w, escaped, sizeof(escaped));
+                break;
+            }
+        }
+        start = string + 1;
+    }
+    put(w, "\"", 1);
+}
+
+// The comma and the key in front of a value
+static void begin_value(json_writer_t * w)
+{
+    uint32_t bit = 1u << w->depth;
+
+    if (w->cbor) {
+        if (w->key_id >= 0) {
+            cbor_head(w, 0, w->key_id);
+        } else if (w->key) {
+            cbor_text(w, w->key);
+        }
+    } else {
+        if (w->has_items & bit) {
+            put(w, ",", 1);
+        }
+        if (w->key) {
+            put_quoted(w, w->key);
+            put(w, ":", 1);
+        }
+    }
+    w->has_items |= bit;
+    w->key = NULL;
+    w->key_id = -1;
+}
+
+static void open_container(json_writer_t * w)
+{
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->err = ESP_ERR_INVALID_SIZE;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void close_container(json_writer_t * w, char end)
+{
+    if (0 == w->depth) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    if (w->cbor) {
+        cbor_byte(w, 0xff);
+    } else {
+        put(w, &end, 1);
+    }
+}
+
+static esp_err_t send_chunk(void * context, const char * data, size_t length)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)context, data, length);
+}
+
+void json_writer_init(json_writer_t * w, char * buffer, size_t size, bool cbor, json_writer_sink_t sink, void * context)
+{
+    memset(w, 0, sizeof(*w));
+    w->buffer = buffer;
+    w->size = size;
+    w->sink = sink;
+    w->context = context;
+    w->err = ESP_OK;
+    w->cbor = cbor;
+    w->key_id = -1;
+}
+
+void json_writer_init_chunked(json_writer_t * w, char * buffer, size_t size, httpd_req_t * req)
+{
+    json_writer_init(w, buffer, size, false, send_chunk, req);
+    w->chunked = true;
+}
+
+esp_err_t json_writer_finish(json_writer_t * w)
+{
+    flush(w);
+    if (ESP_OK == w->err && w->chunked) {
+        w->err = httpd_resp_send_chunk((httpd_req_t *)w->context, NULL, 0);
+    }
+    return w->err;
+}
+
+void json_writer_continue_object(json_writer_t * w)
+{
+    open_container(w);
+}
+
+void json_writer_object_begin(json_writer_t * w)
+{
+    begin_value(w);
+    if (w->cbor) {
+        cbor_byte(w, 0xbf);
+    } else {
+        put(w, "{", 1);
+    }
+    open_container(w);
+}
+
+void json_writer_object_end(json_writer_t * w)
+{
+    close_container(w, '}');
+}
+
+void json_writer_array_begin(json_writer_t * w)
+{
+    begin_value(w);
+    if (w->cbor) {
+        cbor_byte(w, 0x9f);
+    } else {
+        put(w, "[", 1);
+    }
+    open_container(w);
+}
+
+void json_writer_array_end(json_writer_t * w)
+{
+    close_container(w, ']');
+}
+
+void json_writer_key(json_writer_t * w, const char * key)
+{
+    w->key = key;
+    w->key_id = -1;
+}
+
+void json_writer_key_id(json_writer_t * w, int32_t id)
+{
+    w->key = NULL;
+    w->key_id = id;
+}
+
+void json_writer_string(json_writer_t * w, const char * string)
+{
+    if (NULL == string) {
+        json_writer_null(w);
+        return;
+    }
+    begin_value(w);
+    if (w->cbor) {
+        cbor_text(w, string);
+    } else {
+        put_quoted(w, string);
+    }
+}
+
+void json_writer_number(json_writer_t * w, double number)
+{
+    begin_value(w);
+    if (w->cbor) {
+        cbor_number(w, number);
+    } else if (isnan(number) || isinf(number)) {
+        put_string(w, "null");
+    } else {
+        char text[JSON_WRITER_NUMBER_SIZE];
+        put(w, text, json_writer_print_number(text, number));
+    }
+}
+
+void json_writer_float(json_writer_t * w, float number)
+{
+    if (w->cbor) {
+        begin_value(w);
+        cbor_float(w, number);
+    } else {
+        json_writer_number(w, number);
+    }
+}
+
+void json_writer_bool(json_writer_t * w, bool value)
+{
+    begin_value(w);
+    if (w->cbor) {
+        cbor_byte(w, value ? 0xf5 : 0xf4);
+    } else {
+        put_string(w, value ? "true" : "false");
+    }
+}
+
+void json_writer_null(json_writer_t * w)
+{
+    begin_value(w);
+    if (w->cbor) {
+        cbor_byte(w, 0xf6);
+    } else {
+        put_string(w, "null");
+    }
+}
+
+void json_writer_raw(json_writer_t * w, const char * data, size_t length)
+{
+    begin_value(w);
+    put(w, data, length);
+}
+
+void json_writer_raw_members(json_writer_t * w, const char * data, size_t length)
+{
+    if (0 == length) return;
+
+    uint32_t bit = 1u << w->depth;
+    if (!w->cbor && (w->has_items & bit)) {
+        put(w, ",", 1);
+    }
+    w->has_items |= bit;
+    put(w, data, length);
+}
+
+void json_writer_add_string(json_writer_t * w, const char * key, const char * string)
+{
+    json_writer_key(w, key);
+    json_writer_string(w, string);
+}
+
+void json_writer_add_number(json_writer_t * w, const char * key, double number)
+{
+    json_writer_key(w, key);
+    json_writer_number(w, number);
+}
+
+void json_writer_add_float(json_writer_t * w, const char * key, float number)
+{
+    json_writer_key(w, key);
+    json_writer_float(w, number);
+}
+
+void json_writer_add_bool(json_writer_t * w, const char * key, bool value)
+{
+    json_writer_key(w, key);
+    json_writer_bool(w, value);
+}
@@ -0,0 +1,198 @@
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "esp_heap_caps.h"
+
+#include "json_writer.h"
+
+// A live feed update: the measured values change every tick, the counters
+// now and then. Keyed by name in JSON and by index in CBOR, like the
+// telemetry registry writes them.
+typedef struct
+{
+    const char * name;
+    bool measured;
+    double value;
+} field_t;
+
+static const field_t FIELDS[] = {
+    {"power", true, 18.234561},
+    {"voltage", true, 5104.6875},
+    {"current", true, 3571.25},
+    {"temp", true, 61.375},
+    {"vrTemp", true, 52.5},
+    {"hashRate", true, 1034.5678},
+    {"hashRate_1m", true, 1029.1234},
+    {"errorPercentage", true, 0.1234},
+    {"responseTime", true, 34.5612},
+    {"fanspeed", true, 45.5},
+    {"expectedHashrate", true, 1048.32},
+    {"coreVoltageActual", false, 1148},
+    {"fanrpm", false, 3120},
+    {"wifiRSSI", false, -52},
+    {"freeHeap", false, 152340},
+    {"sharesAccepted", false, 1837},
+    {"sharesRejected", false, 3},
+    {"uptimeSeconds", false, 86412},
+    {"frequency", false, 525},
+    {"bestDiff", false, 5312345678.0},
+};
+#define FIELD_COUNT (sizeof(FIELDS) / sizeof(FIELDS[0]))
+
+static char output[2048];
+static size_t output_length;
+
+static esp_err_t collect(void * context, const char * data, size_t length)
+{
+    if (output_length + length > sizeof(output)) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(output + output_length, data, length);
+    output_length += length;
+    return ESP_OK;
+}
+
+static size_t write_update(bool cbor, char * buffer, size_t size)
+{
+    json_writer_t w;
+
+    output_length = 0;
+    json_writer_init(&w, buffer, size, cbor, collect, NULL);
+    json_writer_object_begin(&w);
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        if (cbor) {
+            json_writer_key_id(&w, i);
+        } else {
+            json_writer_key(&w, FIELDS[i].name);
+        }
+        if (FIELDS[i].measured) {
+            json_writer_float(&w, FIELDS[i].value);
+        } else {
+            json_writer_number(&w, FIELDS[i].value);
+        }
+    }
+    json_writer_object_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+
+    return output_length;
+}
+
+TEST_CASE("Writer output does not depend on the buffer size", "[json_writer]")
+{
+    char small[7];
+    char large[JSON_WRITER_CHUNK_SIZE];
+
+    for (int cbor = 0; cbor < 2; cbor++) {
+        char whole[sizeof(output)];
+        size_t length = write_update(cbor, large, sizeof(large));
+        memcpy(whole, output, length);
+
+        TEST_ASSERT_EQUAL(length, write_update(cbor, small, sizeof(small)));
+        TEST_ASSERT_EQUAL_MEMORY(whole, output, length);
+    }
+}
+
+TEST_CASE("Writer CBOR encodes floats, integers and key ids", "[json_writer]")
+{
+    char buffer[64];
+    json_writer_t w;
+
+    output_length = 0;
+    json_writer_init(&w, buffer, sizeof(buffer), true, collect, NULL);
+    json_writer_object_begin(&w);
+    json_writer_key_id(&w, 0);
+    json_writer_float(&w, 1.5f);
+    json_writer_key_id(&w, 24);
+    json_writer_number(&w, -52);
+    json_writer_key_id(&w, 1);
+    json_writer_number(&w, 152340);
+    json_writer_object_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+
+    static const uint8_t EXPECTED[] = {
+        0xbf,                                   // map of indefinite length
+        0x00, 0xfa, 0x3f, 0xc0, 0x00, 0x00,     // 0: float32 1.5
+        0x18, 0x18, 0x38, 0x33,                 // 24: -52
+        0x01, 0x1a, 0x00, 0x02, 0x53, 0x14,     // 1: 152340
+        0xff,
+    };
+    TEST_ASSERT_EQUAL(sizeof(EXPECTED), output_length);
+    TEST_ASSERT_EQUAL_MEMORY(EXPECTED, output, sizeof(EXPECTED));
+}
+
+TEST_CASE("Writer CBOR update is under a third of the JSON one", "[json_writer]")
+{
+    char buffer[JSON_WRITER_CHUNK_SIZE];
+
+    size_t json = write_update(false, buffer, sizeof(buffer));
+    size_t cbor = write_update(true, buffer, sizeof(buffer));
+    printf("%d fields: %u B JSON, %u B CBOR\n", (int)FIELD_COUNT, (unsigned)json, (unsigned)cbor);
+
+    // names against small integers, printed decimals against float32
+    TEST_ASSERT_EQUAL(408, json);
+    TEST_ASSERT_EQUAL(111, cbor);
+    TEST_ASSERT_TRUE(3 * cbor < json);
+}
+
+static int allocations;
+
+static void * counting_malloc(size_t size)
+{
+    allocations++;
+    return malloc(size);
+}
+
+// The same update the way the REST API and the feed used to build it
+static char * print_cjson(void)
+{
+    cJSON * root = cJSON_CreateObject();
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        cJSON_AddNumberToObject(root, FIELDS[i].name, FIELDS[i].value);
+    }
+    char * text = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return text;
+}
+
+static size_t write_numbers(char * buffer, size_t size)
+{
+    json_writer_t w;
+
+    output_length = 0;
+    json_writer_init(&w, buffer, size, false, collect, NULL);
+    json_writer_object_begin(&w);
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        json_writer_add_number(&w, FIELDS[i].name, FIELDS[i].value);
+    }
+    json_writer_object_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+    return output_length;
+}
+
+TEST_CASE("Writer prints what cJSON prints without allocating", "[json_writer]")
+{
+    char buffer[JSON_WRITER_CHUNK_SIZE];
+    cJSON_Hooks hooks = { .malloc_fn = counting_malloc, .free_fn = free };
+
+    cJSON_InitHooks(&hooks);
+    allocations = 0;
+    char * expected = print_cjson();
+    int cjson_allocations = allocations;
+    cJSON_InitHooks(NULL);
+    TEST_ASSERT_NOT_NULL(expected);
+
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    size_t length = write_numbers(buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(free_before, heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    TEST_ASSERT_EQUAL(strlen(expected), length);
+    TEST_ASSERT_EQUAL_MEMORY(expected, output, length);
+    free(expected);
+
+    // a node and a key copy per field, the object and the print buffer
+    printf("%d fields: %d cJSON allocations, none for the writer\n", (int)FIELD_COUNT, cjson_allocations);
+    TEST_ASSERT_TRUE(cjson_allocations >= 2 * FIELD_COUNT + 2);
+}
@@ -0,0 +1,38 @@
+#ifndef LOG_LEVELS_H_
+#define LOG_LEVELS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+// The per tag log levels, in a table that is only ever added to, so a hot
+// path can ask whether a line would be logged without the lock esp_log
+// takes. Setting a level here does not pass it on to esp_log.
+
+#define LOG_LEVELS_MAX 16
+#define LOG_LEVELS_TAG_MAX 24
+#define LOG_LEVEL_UNSET -1          // the tag follows the default level
+
+bool log_levels_enabled(const char * tag, esp_log_level_t level);
+
+/**
+ * Sets the level of a tag, "*" sets the default.
+ *
+ * @param level An esp_log_level_t, or LOG_LEVEL_UNSET to go back to the default.
+ * @return ESP_ERR_NO_MEM once LOG_LEVELS_MAX tags have a level.
+ */
+esp_err_t log_levels_set(const char * tag, int level);
+
+esp_log_level_t log_levels_get_default(void);
+
+/**
+ * The tags that were given a level, false past the last one.
+ */
+bool log_levels_get_at(size_t index, const char ** tag, int * level);
+
+// Forgets every tag and the default. Entries are reused after this, so only
+// while nothing else looks at the levels.
+void log_levels_clear(void);
+
+#endif /* LOG_LEVELS_H_ */
@@ -0,0 +1,91 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "log_levels.h"
+
+typedef struct {
+    char tag[LOG_LEVELS_TAG_MAX];
+    _Atomic int8_t level;       // LOG_LEVEL_UNSET follows the default
+} tag_level_t;
+
+static tag_level_t s_levels[LOG_LEVELS_MAX];
+static _Atomic size_t s_level_count = 0;
+static _Atomic int8_t s_default_level = CONFIG_LOG_DEFAULT_LEVEL;
+
+static tag_level_t * find_level(const char * tag)
+{
+    size_t count = atomic_load_explicit(&s_level_count, memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        if (0 == strcmp(s_levels[i].tag, tag)) {
+            return &s_levels[i];
+        }
+    }
+    return NULL;
+}
+
+bool log_levels_enabled(const char * tag, esp_log_level_t level)
+{
+    int threshold = atomic_load_explicit(&s_default_level, memory_order_relaxed);
+    tag_level_t * entry = find_level(tag);
+    if (entry) {
+        int tag_level = atomic_load_explicit(&entry->level, memory_order_relaxed);
+        if (LOG_LEVEL_UNSET != tag_level) {
+            threshold = tag_level;
+        }
+    }
+    return (int)level <= threshold;
+}
+
+esp_log_level_t log_levels_get_default(void)
+{
+    return atomic_load(&s_default_level);
+}
+
+bool log_levels_get_at(size_t index, const char ** tag, int * level)
+{
+    if (index >= atomic_load_explicit(&s_level_count, memory_order_acquire)) {
+        return false;
+    }
+    *tag = s_levels[index].tag;
+    *level = atomic_load(&s_levels[index].level);
+    return true;
+}
+
+esp_err_t log_levels_set(const char * tag, int level)
+{
+    if (NULL == tag || '\0' == tag[0] || strlen(tag) >= LOG_LEVELS_TAG_MAX
+        || strpbrk(tag, ":,") || level < LOG_LEVEL_UNSET || level > ESP_LOG_VERBOSE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (0 == strcmp(tag, "*")) {
+        atomic_store(&s_default_level, LOG_LEVEL_UNSET == level ? CONFIG_LOG_DEFAULT_LEVEL : level);
+        return ESP_OK;
+    }
+
+    // only the HTTP server and startup change levels, one at a time
+    tag_level_t * entry = find_level(tag);
+    if (NULL == entry) {
+        if (LOG_LEVEL_UNSET == level) {
+            return ESP_OK;
+        }
+        size_t count = atomic_load(&s_level_count);
+        if (LOG_LEVELS_MAX == count) {
+            return ESP_ERR_NO_MEM;
+        }
+        entry = &s_levels[count];
+        strcpy(entry->tag, tag);
+        atomic_store(&entry->level, level);
+        atomic_store_explicit(&s_level_count, count + 1, memory_order_release);
+    } else {
+        atomic_store(&entry->level, level);
+    }
+    return ESP_OK;
+}
+
+void log_levels_clear(void)
+{
+    atomic_store(&s_level_count, 0);
+    atomic_store(&s_default_level, CONFIG_LOG_DEFAULT_LEVEL);
+}
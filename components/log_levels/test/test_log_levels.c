@@ -0,0 +1,114 @@
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "log_levels.h"
+
+TEST_CASE("Log levels follow the default until a tag is given one", "[log_levels]")
+{
+    log_levels_clear();
+    TEST_ASSERT_EQUAL(CONFIG_LOG_DEFAULT_LEVEL, log_levels_get_default());
+
+    TEST_ASSERT_EQUAL(ESP_OK, log_levels_set("*", ESP_LOG_WARN));
+    TEST_ASSERT_TRUE(log_levels_enabled("asic_result", ESP_LOG_WARN));
+    TEST_ASSERT_FALSE(log_levels_enabled("asic_result", ESP_LOG_INFO));
+
+    TEST_ASSERT_EQUAL(ESP_OK, log_levels_set("asic_result", ESP_LOG_DEBUG));
+    TEST_ASSERT_TRUE(log_levels_enabled("asic_result", ESP_LOG_DEBUG));
+    TEST_ASSERT_FALSE(log_levels_enabled("asic_result", ESP_LOG_VERBOSE));
+    TEST_ASSERT_FALSE(log_levels_enabled("stratum_api", ESP_LOG_INFO));
+
+    // unset keeps the entry, which follows the default again
+    TEST_ASSERT_EQUAL(ESP_OK, log_levels_set("asic_result", LOG_LEVEL_UNSET));
+    TEST_ASSERT_FALSE(log_levels_enabled("asic_result", ESP_LOG_INFO));
+
+    const char * tag;
+    int level;
+    TEST_ASSERT_TRUE(log_levels_get_at(0, &tag, &level));
+    TEST_ASSERT_EQUAL_STRING("asic_result", tag);
+    TEST_ASSERT_EQUAL(LOG_LEVEL_UNSET, level);
+    TEST_ASSERT_FALSE(log_levels_get_at(1, &tag, &level));
+
+    TEST_ASSERT_EQUAL(ESP_OK, log_levels_set("*", LOG_LEVEL_UNSET));
+    TEST_ASSERT_EQUAL(CONFIG_LOG_DEFAULT_LEVEL, log_levels_get_default());
+}
+
+TEST_CASE("Log levels reject what cannot be saved", "[log_levels]")
+{
+    char long_tag[LOG_LEVELS_TAG_MAX + 1];
+    memset(long_tag, 'a', LOG_LEVELS_TAG_MAX);
+    long_tag[LOG_LEVELS_TAG_MAX] = '\0';
+
+    log_levels_clear();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, log_levels_set(NULL, ESP_LOG_INFO));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, log_levels_set("", ESP_LOG_INFO));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, log_levels_set("a:b", ESP_LOG_INFO));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, log_levels_set("a,b", ESP_LOG_INFO));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, log_levels_set(long_tag, ESP_LOG_INFO));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, log_levels_set("asic_result", LOG_LEVEL_UNSET - 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, log_levels_set("asic_result", ESP_LOG_VERBOSE + 1));
+
+    // unsetting a tag without a level takes no entry
+    TEST_ASSERT_EQUAL(ESP_OK, log_levels_set("asic_result", LOG_LEVEL_UNSET));
+
+    const char * tag;
+    int level;
+    TEST_ASSERT_FALSE(log_levels_get_at(0, &tag, &level));
+}
+
+TEST_CASE("Log levels hold LOG_LEVELS_MAX tags", "[log_levels]")
+{
+    char tag[LOG_LEVELS_TAG_MAX];
+
+    log_levels_clear();
+    for (int i = 0; i < LOG_LEVELS_MAX; i++) {
+        snprintf(tag, sizeof(tag), "tag%d", i);
+        TEST_ASSERT_EQUAL(ESP_OK, log_levels_set(tag, ESP_LOG_ERROR));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, log_levels_set("one_more", ESP_LOG_ERROR));
+
+    // tags already held can still be changed
+    TEST_ASSERT_EQUAL(ESP_OK, log_levels_set("tag0", ESP_LOG_DEBUG));
+    TEST_ASSERT_TRUE(log_levels_enabled("tag0", ESP_LOG_DEBUG));
+
+    log_levels_clear();
+    TEST_ASSERT_EQUAL(ESP_OK, log_levels_set("one_more", ESP_LOG_ERROR));
+}
+
+TEST_CASE("Log level check is cheaper than formatting the line", "[log_levels][benchmark][not-on-qemu]")
+{
+    char line[192];
+    const int runs = 10000;
+    volatile int enabled = 0;
+
+    // the nonce line with every other tag the table can hold ahead of it
+    log_levels_clear();
+    for (int i = 0; i < LOG_LEVELS_MAX - 1; i++) {
+        snprintf(line, sizeof(line), "tag%d", i);
+        log_levels_set(line, ESP_LOG_INFO);
+    }
+    log_levels_set("asic_result", ESP_LOG_WARN);
+
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < runs; i++) {
+        enabled += log_levels_enabled("asic_result", ESP_LOG_INFO);
+    }
+    int64_t check_us = esp_timer_get_time() - start_us;
+
+    start_us = esp_timer_get_time();
+    for (int i = 0; i < runs; i++) {
+        snprintf(line, sizeof(line), "ID: %s, ASIC nr: %d, Core: %d/%d, ver: %08X Nonce %08X diff %.1f of %g.",
+                 "6a1c2f0b", i % 4, 87, 3, 0x20a00000u, 0x1b2c3d4eu + i, 1234.5678, 8192.0);
+    }
+    int64_t format_us = esp_timer_get_time() - start_us;
+
+    printf("quieted tag: check %.3f us, formatting %.3f us per line\n",
+           (double)check_us / runs, (double)format_us / runs);
+    TEST_ASSERT_EQUAL(0, enabled);
+    TEST_ASSERT_TRUE(10 * check_us < format_us);
+
+    log_levels_clear();
+}
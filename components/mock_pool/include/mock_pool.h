@@ -0,0 +1,62 @@
+#ifndef MOCK_POOL_H_
+#define MOCK_POOL_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Local stand-in for a mining pool, on a device or the Linux host target.
+// It listens on a loopback TCP port and serves either Stratum V1 JSON-RPC or
+// Stratum V2 (Noise NX handshake, standard and extended channels).
+//
+// Jobs come from a synthetic block template, so every submitted share is
+// checked by rebuilding the coinbase and header the miner must have hashed.
+// Latency, rejects, dropped connections, outages and extranonce changes can
+// be injected to exercise the reconnect and failover paths.
+
+typedef enum
+{
+    MOCK_POOL_SV1,
+    MOCK_POOL_SV2,
+} mock_pool_protocol_t;
+
+typedef struct
+{
+    mock_pool_protocol_t protocol;
+    uint16_t port;                      // 0 binds an ephemeral port
+    double difficulty;                  // share difficulty
+    uint32_t notify_interval_ms;        // new job on the current block, 0 disables
+    uint32_t block_interval_ms;         // new prev hash and clean jobs, 0 disables
+    uint16_t latency_ms;                // delay before everything the pool sends
+    uint16_t reject_permille;           // valid shares answered with a reject
+    uint32_t reconnect_interval_ms;     // drop every client, 0 disables
+    uint32_t outage_ms;                 // refuse connections for this long after a drop
+    uint32_t extranonce_interval_ms;    // Stratum V1 mining.set_extranonce, 0 disables
+} mock_pool_config_t;
+
+typedef struct
+{
+    uint32_t connections;
+    uint32_t connections_refused;       // during an outage or with every slot taken
+    uint32_t notifies_sent;             // jobs sent, counted per client
+    uint32_t blocks;                    // prev hash changes
+    uint32_t shares_accepted;
+    uint32_t shares_rejected;           // valid, but answered with an injected reject
+    uint32_t shares_invalid;            // unknown job, stale, duplicate or below difficulty
+    uint32_t reconnects;
+    uint32_t extranonces_sent;
+    uint64_t first_share_us_total;      // sum over jobs of the time from sending it to its first share
+    uint32_t first_share_count;
+} mock_pool_stats_t;
+
+typedef struct mock_pool mock_pool_t;
+
+esp_err_t mock_pool_start(const mock_pool_config_t * config, mock_pool_t ** out);
+void mock_pool_stop(mock_pool_t * pool);
+uint16_t mock_pool_get_port(mock_pool_t * pool);
+void mock_pool_get_stats(mock_pool_t * pool, mock_pool_stats_t * stats);
+
+// x-only key the Stratum V2 certificate is signed with, to configure as the
+// authority pubkey of the miner
+void mock_pool_get_authority_pubkey(mock_pool_t * pool, uint8_t pubkey[32]);
+
+#endif /* MOCK_POOL_H_ */
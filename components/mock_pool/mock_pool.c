@@ -0,0 +1,593 @@
+#include "sdkconfig.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "mock_pool.h"
+
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/random.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_netif.h"
+#endif
+
+#include "mining.h"
+#include "utils.h"
+
+#include "mock_pool_internal.h"
+
+#define START_HEIGHT 900000
+#define COINBASE_VALUE 312500000ULL     // 3.125 BTC
+#define MAX_POLL_US 10000
+#define THREAD_STACK_SIZE 16384         // Noise handshake and secp256k1 signing, also PTHREAD_STACK_MIN on glibc
+
+static const char * TAG = "mock_pool";
+
+// The coinbase is a plain one-in, one-out transaction:
+//   prefix: version, input count, null outpoint, script length, BIP34 height, tag
+//   <extranonce prefix><extranonce 2>
+//   suffix: sequence, output count, value, P2WPKH script, locktime
+static void build_coinbase(mock_pool_t * pool)
+{
+    static const uint8_t tag[] = {0x08, 'm', 'o', 'c', 'k', 'p', 'o', 'o', 'l'};
+    uint8_t * p = pool->coinbase_prefix;
+
+    memcpy(p, (uint8_t[]){0x01, 0x00, 0x00, 0x00, 0x01}, 5);
+    memset(p + 5, 0x00, 32);
+    memset(p + 37, 0xff, 4);
+    p[41] = 4 + sizeof(tag) + EXTRANONCE_LEN;
+    p[42] = 0x03;
+    p[43] = pool->height & 0xff;
+    p[44] = (pool->height >> 8) & 0xff;
+    p[45] = (pool->height >> 16) & 0xff;
+    memcpy(p + 46, tag, sizeof(tag));
+
+    uint8_t * s = pool->coinbase_suffix;
+    memset(s, 0xff, 4);
+    s[4] = 0x01;
+    for (int i = 0; i < 8; i++) {
+        s[5 + i] = (COINBASE_VALUE >> (i * 8)) & 0xff;
+    }
+    s[13] = 22;
+    s[14] = 0x00;
+    s[15] = 20;
+    memset(s + 16, 0x42, 20);
+    memset(s + 36, 0x00, 4);
+}
+
+uint32_t pool_random(mock_pool_t * pool)
+{
+    // xorshift32, plenty for job contents and fault injection
+    pool->rng ^= pool->rng << 13;
+    pool->rng ^= pool->rng >> 17;
+    pool->rng ^= pool->rng << 5;
+    return pool->rng;
+}
+
+void pool_fill_random(void * buf, size_t len)
+{
+    uint8_t * p = buf;
+    while (len > 0) {
+        ssize_t n = getrandom(p, len, 0);
+        if (n <= 0) continue;
+        p += n;
+        len -= n;
+    }
+}
+
+void pool_next_extranonce(mock_pool_t * pool, uint8_t extranonce[EXTRANONCE_PREFIX_LEN])
+{
+    uint32_t value = pool->next_extranonce++;
+    for (int i = 0; i < EXTRANONCE_PREFIX_LEN; i++) {
+        extranonce[i] = (value >> (24 - i * 8)) & 0xff;
+    }
+}
+
+pool_job_t * pool_current_job(mock_pool_t * pool)
+{
+    return &pool->jobs[(pool->next_job_id - 1) % JOB_HISTORY];
+}
+
+pool_job_t * pool_find_job(mock_pool_t * pool, uint32_t id)
+{
+    if (id == 0 || id >= pool->next_job_id || pool->next_job_id - id > JOB_HISTORY) {
+        return NULL;
+    }
+    return &pool->jobs[id % JOB_HISTORY];
+}
+
+void pool_job_sent(mock_pool_t * pool, pool_job_t * job)
+{
+    if (job->sent_us == 0) {
+        job->sent_us = esp_timer_get_time() + pool->config.latency_ms * 1000;
+    }
+
+    pthread_mutex_lock(&pool->stats_lock);
+    pool->stats.notifies_sent++;
+    pthread_mutex_unlock(&pool->stats_lock);
+}
+
+void pool_merkle_root(mock_pool_t * pool, const pool_job_t * job, const uint8_t extranonce[EXTRANONCE_LEN], uint8_t merkle_root[32])
+{
+    uint8_t coinbase_tx_hash[32];
+    calculate_coinbase_tx_hash_bin(pool->coinbase_prefix, COINBASE_PREFIX_LEN,
+                                   extranonce, EXTRANONCE_PREFIX_LEN,
+                                   extranonce + EXTRANONCE_PREFIX_LEN, EXTRANONCE_2_LEN,
+                                   pool->coinbase_suffix, COINBASE_SUFFIX_LEN,
+                                   coinbase_tx_hash);
+    calculate_merkle_root_hash(coinbase_tx_hash, job->merkle_branches, MERKLE_BRANCHES, merkle_root);
+}
+
+double pool_share_difficulty(mock_pool_t * pool, const pool_job_t * job, const uint8_t extranonce[EXTRANONCE_LEN],
+                             uint32_t ntime, uint32_t nonce, uint32_t version, uint8_t hash[32])
+{
+    uint8_t header[80];
+    memcpy(header, &version, 4);
+    memcpy(header + 4, pool->prev_hash, 32);
+    pool_merkle_root(pool, job, extranonce, header + 36);
+    memcpy(header + 68, &ntime, 4);
+    memcpy(header + 72, &(uint32_t){POOL_NBITS}, 4);
+    memcpy(header + 76, &nonce, 4);
+
+    double_sha256_bin(header, 80, hash);
+    return truediffone / le256todouble(hash);
+}
+
+pool_share_result_t pool_judge_share(mock_pool_t * pool, pool_job_t * job, uint32_t ntime, uint32_t version,
+                                     double difficulty, const uint8_t hash[32])
+{
+    pool_share_result_t result = SHARE_ACCEPTED;
+    uint64_t fingerprint;
+    memcpy(&fingerprint, hash, sizeof(fingerprint));
+
+    if (job == NULL) {
+        result = SHARE_UNKNOWN_JOB;
+    } else if (job->block != pool->block) {
+        result = SHARE_STALE;
+    } else if (ntime < job->ntime || ntime > job->ntime + POOL_NTIME_ROLL) {
+        result = SHARE_BAD_NTIME;
+    } else if (((version ^ job->version) & ~POOL_VERSION_MASK) != 0) {
+        result = SHARE_BAD_VERSION;
+    } else if (difficulty < pool->config.difficulty) {
+        result = SHARE_LOW_DIFFICULTY;
+    } else {
+        for (int i = 0; i < RECENT_SHARES; i++) {
+            if (pool->recent_shares[i] == fingerprint) {
+                result = SHARE_DUPLICATE;
+                break;
+            }
+        }
+    }
+
+    if (result == SHARE_ACCEPTED) {
+        pool->recent_shares[pool->recent_head] = fingerprint;
+        pool->recent_head = (pool->recent_head + 1) % RECENT_SHARES;
+        if (pool_random(pool) % 1000 < pool->config.reject_permille) {
+            result = SHARE_REJECTED;
+        }
+    }
+
+    pthread_mutex_lock(&pool->stats_lock);
+    switch (result) {
+        case SHARE_ACCEPTED:
+            pool->stats.shares_accepted++;
+            if (!job->has_share) {
+                job->has_share = true;
+                int64_t elapsed_us = esp_timer_get_time() - job->sent_us;
+                pool->stats.first_share_us_total += elapsed_us > 0 ? elapsed_us : 0;
+                pool->stats.first_share_count++;
+            }
+            break;
+        case SHARE_REJECTED:
+            pool->stats.shares_rejected++;
+            break;
+        default:
+            pool->stats.shares_invalid++;
+            break;
+    }
+    pthread_mutex_unlock(&pool->stats_lock);
+
+    if (result != SHARE_ACCEPTED) {
+        ESP_LOGD(TAG, "Share not accepted (%d), difficulty %.4f", result, difficulty);
+    }
+    return result;
+}
+
+void pool_send(mock_pool_t * pool, pool_client_t * client, const void * data, size_t len)
+{
+    pool_msg_t * msg = malloc(sizeof(pool_msg_t) + len);
+    if (msg == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate message, closing client");
+        client->closing = true;
+        return;
+    }
+    msg->next = NULL;
+    msg->due_us = esp_timer_get_time() + pool->config.latency_ms * 1000;
+    msg->len = len;
+    memcpy(msg->data, data, len);
+
+    if (client->tx_tail != NULL) {
+        client->tx_tail->next = msg;
+    } else {
+        client->tx_head = msg;
+    }
+    client->tx_tail = msg;
+}
+
+static void close_client(mock_pool_t * pool, pool_client_t * client)
+{
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (pool->clients[i] == client) {
+            pool->clients[i] = NULL;
+        }
+    }
+
+    close(client->fd);
+    while (client->tx_head != NULL) {
+        pool_msg_t * next = client->tx_head->next;
+        free(client->tx_head);
+        client->tx_head = next;
+    }
+    free(client);
+}
+
+static bool client_ready(mock_pool_t * pool, pool_client_t * client)
+{
+    return !client->closing && (pool->config.protocol == MOCK_POOL_SV1 ? client->authorized : client->channel_open);
+}
+
+static void new_job(mock_pool_t * pool, bool new_block)
+{
+    if (new_block) {
+        pool->block++;
+        pool->height++;
+        for (int i = 0; i < 32; i += 4) {
+            uint32_t r = pool_random(pool);
+            memcpy(pool->prev_hash + i, &r, 4);
+        }
+        // keep it looking like a real block hash
+        memset(pool->prev_hash + 24, 0, 8);
+        build_coinbase(pool);
+
+        pthread_mutex_lock(&pool->stats_lock);
+        pool->stats.blocks++;
+        pthread_mutex_unlock(&pool->stats_lock);
+    }
+
+    pool_job_t * job = &pool->jobs[pool->next_job_id % JOB_HISTORY];
+    memset(job, 0, sizeof(pool_job_t));
+    job->id = pool->next_job_id++;
+    job->block = pool->block;
+    job->version = POOL_VERSION;
+    job->ntime = (uint32_t)time(NULL);
+    for (int b = 0; b < MERKLE_BRANCHES; b++) {
+        for (int i = 0; i < 32; i += 4) {
+            uint32_t r = pool_random(pool);
+            memcpy(job->merkle_branches[b] + i, &r, 4);
+        }
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        pool_client_t * client = pool->clients[i];
+        if (client == NULL || !client_ready(pool, client)) continue;
+
+        if (pool->config.protocol == MOCK_POOL_SV1) {
+            sv1_notify(pool, client, job, new_block);
+        } else {
+            sv2_notify(pool, client, job, new_block);
+        }
+    }
+}
+
+static void drop_clients(mock_pool_t * pool)
+{
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        pool_client_t * client = pool->clients[i];
+        if (client == NULL) continue;
+
+        if (pool->config.protocol == MOCK_POOL_SV1) {
+            sv1_reconnect(pool, client);
+        } else {
+            client->closing = true;
+        }
+    }
+    pool->outage_until_us = esp_timer_get_time() + (int64_t)pool->config.outage_ms * 1000;
+
+    pthread_mutex_lock(&pool->stats_lock);
+    pool->stats.reconnects++;
+    pthread_mutex_unlock(&pool->stats_lock);
+}
+
+static int64_t schedule(uint32_t interval_ms, int64_t now)
+{
+    return interval_ms > 0 ? now + (int64_t)interval_ms * 1000 : INT64_MAX;
+}
+
+static void run_timers(mock_pool_t * pool, int64_t now)
+{
+    if (now >= pool->next_block_us) {
+        new_job(pool, true);
+        pool->next_block_us = schedule(pool->config.block_interval_ms, now);
+        pool->next_notify_us = schedule(pool->config.notify_interval_ms, now);
+    } else if (now >= pool->next_notify_us) {
+        new_job(pool, false);
+        pool->next_notify_us = schedule(pool->config.notify_interval_ms, now);
+    }
+
+    if (now >= pool->next_extranonce_us) {
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            pool_client_t * client = pool->clients[i];
+            if (client != NULL && client_ready(pool, client)) {
+                sv1_set_extranonce(pool, client);
+            }
+        }
+        pool->next_extranonce_us = schedule(pool->config.extranonce_interval_ms, now);
+    }
+
+    if (now >= pool->next_reconnect_us) {
+        drop_clients(pool);
+        pool->next_reconnect_us = schedule(pool->config.reconnect_interval_ms, now);
+    }
+}
+
+// Write whatever is due, returns false once the client is gone
+static bool flush_client(mock_pool_t * pool, pool_client_t * client, int64_t now)
+{
+    while (client->tx_head != NULL && client->tx_head->due_us <= now) {
+        pool_msg_t * msg = client->tx_head;
+        ssize_t n = send(client->fd, msg->data + client->tx_offset, msg->len - client->tx_offset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            close_client(pool, client);
+            return false;
+        }
+
+        client->tx_offset += n;
+        if (client->tx_offset < msg->len) return true;
+
+        client->tx_head = msg->next;
+        if (client->tx_head == NULL) {
+            client->tx_tail = NULL;
+        }
+        client->tx_offset = 0;
+        free(msg);
+    }
+
+    if (client->closing && client->tx_head == NULL) {
+        close_client(pool, client);
+        return false;
+    }
+    return true;
+}
+
+static void accept_client(mock_pool_t * pool)
+{
+    int fd = accept(pool->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    int slot = -1;
+    for (int i = 0; i < MAX_CLIENTS && slot < 0; i++) {
+        if (pool->clients[i] == NULL) slot = i;
+    }
+
+    pool_client_t * client = NULL;
+    if (slot >= 0 && esp_timer_get_time() >= pool->outage_until_us) {
+        client = calloc(1, sizeof(pool_client_t));
+    }
+    if (client == NULL) {
+        close(fd);
+        pthread_mutex_lock(&pool->stats_lock);
+        pool->stats.connections_refused++;
+        pthread_mutex_unlock(&pool->stats_lock);
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+
+    client->fd = fd;
+    pool_next_extranonce(pool, client->extranonce);
+    pool->clients[slot] = client;
+
+    pthread_mutex_lock(&pool->stats_lock);
+    pool->stats.connections++;
+    pthread_mutex_unlock(&pool->stats_lock);
+}
+
+static void receive_client(mock_pool_t * pool, pool_client_t * client)
+{
+    ssize_t n = recv(client->fd, client->rx + client->rx_len, RX_BUFFER_SIZE - client->rx_len, 0);
+    if (n <= 0) {
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        close_client(pool, client);
+        return;
+    }
+    client->rx_len += n;
+
+    if (pool->config.protocol == MOCK_POOL_SV1) {
+        sv1_receive(pool, client);
+    } else {
+        sv2_receive(pool, client);
+    }
+}
+
+static void * mock_pool_thread(void * arg)
+{
+    mock_pool_t * pool = arg;
+
+    while (pool->running) {
+        int64_t now = esp_timer_get_time();
+        run_timers(pool, now);
+
+        int64_t wake_us = now + MAX_POLL_US;
+        if (pool->next_notify_us < wake_us) wake_us = pool->next_notify_us;
+        if (pool->next_block_us < wake_us) wake_us = pool->next_block_us;
+        if (pool->next_reconnect_us < wake_us) wake_us = pool->next_reconnect_us;
+        if (pool->next_extranonce_us < wake_us) wake_us = pool->next_extranonce_us;
+
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(pool->listen_fd, &rfds);
+        int max_fd = pool->listen_fd;
+
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            pool_client_t * client = pool->clients[i];
+            if (client == NULL || !flush_client(pool, client, now)) continue;
+
+            if (!client->closing && client->rx_len < RX_BUFFER_SIZE) {
+                FD_SET(client->fd, &rfds);
+            }
+            if (client->tx_head != NULL) {
+                if (client->tx_head->due_us <= now) {
+                    FD_SET(client->fd, &wfds);
+                } else if (client->tx_head->due_us < wake_us) {
+                    wake_us = client->tx_head->due_us;
+                }
+            }
+            if (client->fd > max_fd) max_fd = client->fd;
+        }
+
+        int64_t timeout_us = wake_us > now ? wake_us - now : 0;
+        struct timeval tv = {
+            .tv_sec = timeout_us / 1000000,
+            .tv_usec = timeout_us % 1000000,
+        };
+        if (select(max_fd + 1, &rfds, &wfds, NULL, &tv) <= 0) continue;
+
+        if (FD_ISSET(pool->listen_fd, &rfds)) {
+            accept_client(pool);
+        }
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            pool_client_t * client = pool->clients[i];
+            if (client != NULL && FD_ISSET(client->fd, &rfds)) {
+                receive_client(pool, client);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+esp_err_t mock_pool_start(const mock_pool_config_t * config, mock_pool_t ** out)
+{
+    mock_pool_t * pool = calloc(1, sizeof(mock_pool_t));
+    if (pool == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    pool->config = *config;
+    pool->height = START_HEIGHT;
+    pool->next_job_id = 1;
+    pool->next_channel_id = 1;
+    pool_fill_random(&pool->rng, sizeof(pool->rng));
+    pool->rng |= 1;
+    pthread_mutex_init(&pool->stats_lock, NULL);
+
+    if (config->protocol == MOCK_POOL_SV2 && sv2_identity_init(pool) != ESP_OK) {
+        goto fail;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    // loopback needs the TCP/IP stack even with no interface up, a no-op once Wi-Fi started it
+    if (esp_netif_init() != ESP_OK) {
+        goto fail;
+    }
+#endif
+
+    pool->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (pool->listen_fd < 0) {
+        ESP_LOGE(TAG, "socket failed: %d", errno);
+        goto fail;
+    }
+    setsockopt(pool->listen_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(pool->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(pool->listen_fd, MAX_CLIENTS) != 0 ||
+        getsockname(pool->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %u: %d", config->port, errno);
+        close(pool->listen_fd);
+        goto fail;
+    }
+    pool->port = ntohs(addr.sin_port);
+
+    // the first block is created by the first pass of the worker
+    int64_t now = esp_timer_get_time();
+    pool->next_block_us = now;
+    pool->next_notify_us = INT64_MAX;
+    pool->next_reconnect_us = schedule(config->reconnect_interval_ms, now);
+    pool->next_extranonce_us = config->protocol == MOCK_POOL_SV1 ? schedule(config->extranonce_interval_ms, now) : INT64_MAX;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+
+    pool->running = true;
+    int err = pthread_create(&pool->thread, &attr, mock_pool_thread, pool);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        close(pool->listen_fd);
+        goto fail;
+    }
+
+    ESP_LOGI(TAG, "Serving Stratum %s on 127.0.0.1:%u at difficulty %g",
+             config->protocol == MOCK_POOL_SV1 ? "V1" : "V2", pool->port, config->difficulty);
+    *out = pool;
+    return ESP_OK;
+
+fail:
+    sv2_identity_free(pool);
+    free(pool);
+    return ESP_FAIL;
+}
+
+void mock_pool_stop(mock_pool_t * pool)
+{
+    pool->running = false;
+    pthread_join(pool->thread, NULL);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (pool->clients[i] != NULL) {
+            close_client(pool, pool->clients[i]);
+        }
+    }
+    close(pool->listen_fd);
+    sv2_identity_free(pool);
+    pthread_mutex_destroy(&pool->stats_lock);
+    free(pool);
+}
+
+uint16_t mock_pool_get_port(mock_pool_t * pool)
+{
+    return pool->port;
+}
+
+void mock_pool_get_stats(mock_pool_t * pool, mock_pool_stats_t * stats)
+{
+    pthread_mutex_lock(&pool->stats_lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->stats_lock);
+}
+
+void mock_pool_get_authority_pubkey(mock_pool_t * pool, uint8_t pubkey[32])
+{
+    memcpy(pubkey, pool->authority_pub, 32);
+}
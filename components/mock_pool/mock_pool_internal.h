@@ -0,0 +1,167 @@
+#ifndef MOCK_POOL_INTERNAL_H_
+#define MOCK_POOL_INTERNAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "secp256k1.h"
+
+#include "mock_pool.h"
+
+#define MAX_CLIENTS 8
+#define JOB_HISTORY 16
+#define RECENT_SHARES 256
+#define MERKLE_BRANCHES 2
+#define RX_BUFFER_SIZE 4096
+
+// The coinbase script ends with the extranonce: a per client prefix the pool
+// assigns (Stratum V1 extranonce1, SV2 extended channel prefix) followed by
+// the part the miner rolls. SV2 standard channels get all of it assigned.
+#define EXTRANONCE_PREFIX_LEN 4
+#define EXTRANONCE_2_LEN 8
+#define EXTRANONCE_LEN (EXTRANONCE_PREFIX_LEN + EXTRANONCE_2_LEN)
+
+#define COINBASE_PREFIX_LEN 55
+#define COINBASE_SUFFIX_LEN 40
+
+#define POOL_VERSION 0x20000000
+#define POOL_VERSION_MASK 0x1fffe000
+#define POOL_NBITS 0x17023a04
+#define POOL_NTIME_ROLL 7200            // seconds a share's ntime may run ahead of its job
+
+typedef enum
+{
+    SHARE_ACCEPTED,
+    SHARE_REJECTED,                     // injected
+    SHARE_UNKNOWN_JOB,
+    SHARE_STALE,
+    SHARE_DUPLICATE,
+    SHARE_LOW_DIFFICULTY,
+    SHARE_BAD_NTIME,
+    SHARE_BAD_VERSION,
+} pool_share_result_t;
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t block;
+    uint32_t version;
+    uint32_t ntime;
+    uint8_t merkle_branches[MERKLE_BRANCHES][32];
+    int64_t sent_us;
+    bool has_share;
+} pool_job_t;
+
+typedef struct pool_msg
+{
+    struct pool_msg * next;
+    int64_t due_us;
+    size_t len;
+    uint8_t data[];
+} pool_msg_t;
+
+typedef struct
+{
+    int fd;
+    bool closing;                       // close once everything queued is written
+
+    uint8_t rx[RX_BUFFER_SIZE];
+    size_t rx_len;
+
+    pool_msg_t * tx_head;
+    pool_msg_t * tx_tail;
+    size_t tx_offset;                   // bytes of tx_head already written
+
+    // Stratum V1
+    bool authorized;
+    uint8_t extranonce[EXTRANONCE_PREFIX_LEN];
+    uint8_t previous_extranonce[EXTRANONCE_PREFIX_LEN];
+    bool has_previous_extranonce;       // shares may still be built on the old one
+
+    // Stratum V2
+    bool handshake_complete;
+    uint8_t send_key[32];
+    uint8_t recv_key[32];
+    uint64_t send_nonce;
+    uint64_t recv_nonce;
+    uint8_t frame_header[6];            // decrypted header waiting for its payload
+    bool has_frame_header;
+    bool channel_open;
+    bool extended;
+    uint32_t channel_id;
+    uint8_t channel_extranonce[EXTRANONCE_LEN];
+} pool_client_t;
+
+struct mock_pool
+{
+    mock_pool_config_t config;
+    int listen_fd;
+    uint16_t port;
+    pthread_t thread;
+    volatile bool running;
+
+    pthread_mutex_t stats_lock;
+    mock_pool_stats_t stats;
+
+    pool_client_t * clients[MAX_CLIENTS];
+
+    // block template
+    uint32_t block;
+    uint32_t height;
+    uint8_t prev_hash[32];              // block header byte order
+    uint8_t coinbase_prefix[COINBASE_PREFIX_LEN];
+    uint8_t coinbase_suffix[COINBASE_SUFFIX_LEN];
+
+    pool_job_t jobs[JOB_HISTORY];
+    uint32_t next_job_id;
+    uint32_t next_extranonce;
+    uint32_t next_channel_id;
+
+    uint64_t recent_shares[RECENT_SHARES];
+    int recent_head;
+
+    int64_t next_notify_us;
+    int64_t next_block_us;
+    int64_t next_reconnect_us;
+    int64_t next_extranonce_us;
+    int64_t outage_until_us;
+
+    uint32_t rng;
+
+    // Stratum V2 identity
+    secp256k1_context * secp_ctx;
+    uint8_t static_priv[32];
+    uint8_t static_pub[64];             // ElligatorSwift encoded
+    uint8_t authority_pub[32];
+    uint8_t certificate[74];
+};
+
+// mock_pool.c
+void pool_send(mock_pool_t * pool, pool_client_t * client, const void * data, size_t len);
+pool_job_t * pool_current_job(mock_pool_t * pool);
+pool_job_t * pool_find_job(mock_pool_t * pool, uint32_t id);
+void pool_job_sent(mock_pool_t * pool, pool_job_t * job);
+void pool_next_extranonce(mock_pool_t * pool, uint8_t extranonce[EXTRANONCE_PREFIX_LEN]);
+void pool_merkle_root(mock_pool_t * pool, const pool_job_t * job, const uint8_t extranonce[EXTRANONCE_LEN], uint8_t merkle_root[32]);
+double pool_share_difficulty(mock_pool_t * pool, const pool_job_t * job, const uint8_t extranonce[EXTRANONCE_LEN],
+                             uint32_t ntime, uint32_t nonce, uint32_t version, uint8_t hash[32]);
+pool_share_result_t pool_judge_share(mock_pool_t * pool, pool_job_t * job, uint32_t ntime, uint32_t version,
+                                     double difficulty, const uint8_t hash[32]);
+uint32_t pool_random(mock_pool_t * pool);
+void pool_fill_random(void * buf, size_t len);
+
+// mock_pool_sv1.c
+void sv1_receive(mock_pool_t * pool, pool_client_t * client);
+void sv1_notify(mock_pool_t * pool, pool_client_t * client, pool_job_t * job, bool clean_jobs);
+void sv1_set_extranonce(mock_pool_t * pool, pool_client_t * client);
+void sv1_reconnect(mock_pool_t * pool, pool_client_t * client);
+
+// mock_pool_sv2.c
+esp_err_t sv2_identity_init(mock_pool_t * pool);
+void sv2_identity_free(mock_pool_t * pool);
+void sv2_receive(mock_pool_t * pool, pool_client_t * client);
+void sv2_notify(mock_pool_t * pool, pool_client_t * client, pool_job_t * job, bool new_block);
+
+#endif /* MOCK_POOL_INTERNAL_H_ */
@@ -0,0 +1,233 @@
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "cJSON.h"
+#include "esp_log.h"
+
+#include "utils.h"
+
+#include "mock_pool_internal.h"
+
+#define LINE_BUFFER_SIZE 2048
+
+static const char * TAG = "mock_pool_sv1";
+
+static const char * share_error(pool_share_result_t result)
+{
+    switch (result) {
+        case SHARE_REJECTED:        return "[20,\"Injected reject\",null]";
+        case SHARE_UNKNOWN_JOB:     return "[21,\"Job not found\",null]";
+        case SHARE_STALE:           return "[21,\"Stale share\",null]";
+        case SHARE_DUPLICATE:       return "[22,\"Duplicate share\",null]";
+        case SHARE_LOW_DIFFICULTY:  return "[23,\"Low difficulty share\",null]";
+        case SHARE_BAD_NTIME:       return "[20,\"Invalid ntime\",null]";
+        case SHARE_BAD_VERSION:     return "[20,\"Invalid version bits\",null]";
+        default:                    return "[20,\"Other/Unknown\",null]";
+    }
+}
+
+static void send_line(mock_pool_t * pool, pool_client_t * client, const char * line)
+{
+    pool_send(pool, client, line, strlen(line));
+}
+
+static void send_result(mock_pool_t * pool, pool_client_t * client, int id, const char * result)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "{\"id\":%d,\"result\":%s,\"error\":null}\n", id, result);
+    send_line(pool, client, line);
+}
+
+static void send_error(mock_pool_t * pool, pool_client_t * client, int id, const char * error)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "{\"id\":%d,\"result\":null,\"error\":%s}\n", id, error);
+    send_line(pool, client, line);
+}
+
+void sv1_notify(mock_pool_t * pool, pool_client_t * client, pool_job_t * job, bool clean_jobs)
+{
+    // the stratum prev hash is the header bytes with every word swapped
+    uint8_t prev_hash[32];
+    memcpy(prev_hash, pool->prev_hash, 32);
+    reverse_endianness_per_word(prev_hash);
+
+    char prev_hash_hex[65], coinbase_1[COINBASE_PREFIX_LEN * 2 + 1], coinbase_2[COINBASE_SUFFIX_LEN * 2 + 1];
+    bin2hex(prev_hash, 32, prev_hash_hex, sizeof(prev_hash_hex));
+    bin2hex(pool->coinbase_prefix, COINBASE_PREFIX_LEN, coinbase_1, sizeof(coinbase_1));
+    bin2hex(pool->coinbase_suffix, COINBASE_SUFFIX_LEN, coinbase_2, sizeof(coinbase_2));
+
+    char branches[MERKLE_BRANCHES * 67 + 1] = "";
+    for (int i = 0; i < MERKLE_BRANCHES; i++) {
+        char branch[65];
+        bin2hex(job->merkle_branches[i], 32, branch, sizeof(branch));
+        snprintf(branches + strlen(branches), sizeof(branches) - strlen(branches), "%s\"%s\"", i > 0 ? "," : "", branch);
+    }
+
+    char line[LINE_BUFFER_SIZE];
+    snprintf(line, sizeof(line),
+             "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"%" PRIx32 "\",\"%s\",\"%s\",\"%s\",[%s],\"%08" PRIx32 "\",\"%08" PRIx32 "\",\"%08" PRIx32 "\",%s]}\n",
+             job->id, prev_hash_hex, coinbase_1, coinbase_2, branches,
+             job->version, (uint32_t)POOL_NBITS, job->ntime, clean_jobs ? "true" : "false");
+    send_line(pool, client, line);
+    pool_job_sent(pool, job);
+}
+
+void sv1_set_extranonce(mock_pool_t * pool, pool_client_t * client)
+{
+    memcpy(client->previous_extranonce, client->extranonce, EXTRANONCE_PREFIX_LEN);
+    client->has_previous_extranonce = true;
+    pool_next_extranonce(pool, client->extranonce);
+
+    char extranonce[EXTRANONCE_PREFIX_LEN * 2 + 1];
+    bin2hex(client->extranonce, EXTRANONCE_PREFIX_LEN, extranonce, sizeof(extranonce));
+
+    char line[128];
+    snprintf(line, sizeof(line), "{\"id\":null,\"method\":\"mining.set_extranonce\",\"params\":[\"%s\",%d]}\n",
+             extranonce, EXTRANONCE_2_LEN);
+    send_line(pool, client, line);
+
+    pthread_mutex_lock(&pool->stats_lock);
+    pool->stats.extranonces_sent++;
+    pthread_mutex_unlock(&pool->stats_lock);
+
+    // the new extranonce applies from the next job on
+    sv1_notify(pool, client, pool_current_job(pool), true);
+}
+
+void sv1_reconnect(mock_pool_t * pool, pool_client_t * client)
+{
+    send_line(pool, client, "{\"id\":null,\"method\":\"client.reconnect\",\"params\":[]}\n");
+    client->closing = true;
+}
+
+static bool param_hex_u32(cJSON * params, int index, uint32_t * value)
+{
+    cJSON * item = cJSON_GetArrayItem(params, index);
+    if (!cJSON_IsString(item) || strlen(item->valuestring) != 8) {
+        return false;
+    }
+    *value = strtoul(item->valuestring, NULL, 16);
+    return true;
+}
+
+static void handle_submit(mock_pool_t * pool, pool_client_t * client, int id, cJSON * params)
+{
+    // [worker, job_id, extranonce2, ntime, nonce, version_bits]
+    cJSON * job_id = cJSON_GetArrayItem(params, 1);
+    cJSON * extranonce_2 = cJSON_GetArrayItem(params, 2);
+    uint32_t ntime, nonce, version_bits = 0;
+
+    if (!cJSON_IsString(job_id) || !cJSON_IsString(extranonce_2) ||
+        strlen(extranonce_2->valuestring) != EXTRANONCE_2_LEN * 2 ||
+        !param_hex_u32(params, 3, &ntime) || !param_hex_u32(params, 4, &nonce) ||
+        (cJSON_GetArraySize(params) > 5 && !param_hex_u32(params, 5, &version_bits))) {
+        send_error(pool, client, id, "[20,\"Malformed submit\",null]");
+        return;
+    }
+
+    pool_job_t * job = pool_find_job(pool, strtoul(job_id->valuestring, NULL, 16));
+    uint32_t version = job != NULL ? job->version ^ version_bits : 0;
+
+    uint8_t extranonce[EXTRANONCE_LEN];
+    uint8_t hash[32] = {0};
+    double difficulty = 0;
+    if (job != NULL) {
+        memcpy(extranonce, client->extranonce, EXTRANONCE_PREFIX_LEN);
+        hex2bin(extranonce_2->valuestring, extranonce + EXTRANONCE_PREFIX_LEN, EXTRANONCE_2_LEN);
+        difficulty = pool_share_difficulty(pool, job, extranonce, ntime, nonce, version, hash);
+
+        // work generated just before a set_extranonce arrived is still honest work
+        if (difficulty < pool->config.difficulty && client->has_previous_extranonce) {
+            uint8_t previous_hash[32];
+            memcpy(extranonce, client->previous_extranonce, EXTRANONCE_PREFIX_LEN);
+            double previous = pool_share_difficulty(pool, job, extranonce, ntime, nonce, version, previous_hash);
+            if (previous > difficulty) {
+                difficulty = previous;
+                memcpy(hash, previous_hash, 32);
+            }
+        }
+    }
+
+    pool_share_result_t result = pool_judge_share(pool, job, ntime, version, difficulty, hash);
+    if (result == SHARE_ACCEPTED) {
+        send_result(pool, client, id, "true");
+    } else {
+        send_error(pool, client, id, share_error(result));
+    }
+}
+
+static void handle_line(mock_pool_t * pool, pool_client_t * client, const char * line)
+{
+    cJSON * json = cJSON_Parse(line);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "Unparsable line: %s", line);
+        client->closing = true;
+        return;
+    }
+
+    cJSON * id_json = cJSON_GetObjectItem(json, "id");
+    cJSON * method = cJSON_GetObjectItem(json, "method");
+    cJSON * params = cJSON_GetObjectItem(json, "params");
+    int id = cJSON_IsNumber(id_json) ? id_json->valueint : -1;
+
+    // responses (e.g. to mining.ping) carry no method
+    if (!cJSON_IsString(method)) {
+        cJSON_Delete(json);
+        return;
+    }
+
+    if (strcmp(method->valuestring, "mining.configure") == 0) {
+        char result[96];
+        snprintf(result, sizeof(result), "{\"version-rolling\":true,\"version-rolling.mask\":\"%08x\"}", POOL_VERSION_MASK);
+        send_result(pool, client, id, result);
+    } else if (strcmp(method->valuestring, "mining.subscribe") == 0) {
+        char extranonce[EXTRANONCE_PREFIX_LEN * 2 + 1];
+        bin2hex(client->extranonce, EXTRANONCE_PREFIX_LEN, extranonce, sizeof(extranonce));
+        char result[128];
+        snprintf(result, sizeof(result), "[[[\"mining.notify\",\"%s\"]],\"%s\",%d]", extranonce, extranonce, EXTRANONCE_2_LEN);
+        send_result(pool, client, id, result);
+    } else if (strcmp(method->valuestring, "mining.authorize") == 0) {
+        send_result(pool, client, id, "true");
+        if (!client->authorized) {
+            client->authorized = true;
+            char line[96];
+            snprintf(line, sizeof(line), "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%.17g]}\n", pool->config.difficulty);
+            send_line(pool, client, line);
+            sv1_notify(pool, client, pool_current_job(pool), true);
+        }
+    } else if (strcmp(method->valuestring, "mining.submit") == 0 && cJSON_IsArray(params)) {
+        handle_submit(pool, client, id, params);
+    } else if (strcmp(method->valuestring, "mining.extranonce.subscribe") == 0 ||
+               strcmp(method->valuestring, "mining.suggest_difficulty") == 0) {
+        send_result(pool, client, id, "true");
+    } else if (id >= 0) {
+        send_error(pool, client, id, "[20,\"Unknown method\",null]");
+    }
+
+    cJSON_Delete(json);
+}
+
+void sv1_receive(mock_pool_t * pool, pool_client_t * client)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < client->rx_len && !client->closing; i++) {
+        if (client->rx[i] != '\n') continue;
+
+        client->rx[i] = '\0';
+        handle_line(pool, client, (const char *)client->rx + start);
+        start = i + 1;
+    }
+
+    memmove(client->rx, client->rx + start, client->rx_len - start);
+    client->rx_len -= start;
+
+    if (client->rx_len == RX_BUFFER_SIZE) {
+        ESP_LOGW(TAG, "Line too long, closing client");
+        client->closing = true;
+    }
+}
@@ -0,0 +1,526 @@
+#include "sdkconfig.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "esp_log.h"
+
+#include "mbedtls/sha256.h"
+#include "mbedtls/md.h"
+#include "mbedtls/chachapoly.h"
+
+#include "secp256k1.h"
+#include "secp256k1_ellswift.h"
+#include "secp256k1_schnorrsig.h"
+#include "secp256k1_extrakeys.h"
+
+#include "sv2_protocol.h"
+#include "utils.h"
+
+#include "mock_pool_internal.h"
+
+#define HANDSHAKE_REQUEST_LEN 64
+#define HANDSHAKE_RESPONSE_LEN 234
+#define ENCRYPTED_HEADER_LEN (SV2_FRAME_HEADER_SIZE + 16)
+#define MAX_PAYLOAD 512
+#define CERTIFICATE_VALIDITY (365 * 24 * 3600)
+
+static const char * TAG = "mock_pool_sv2";
+
+static const char NOISE_PROTOCOL_NAME[] = "Noise_NX_Secp256k1+EllSwift_ChaChaPoly_SHA256";
+
+// --- Noise, the responder half of sv2_noise.c ---
+
+static void mix_hash(uint8_t h[32], const uint8_t * data, size_t len)
+{
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    mbedtls_sha256_update(&sha, h, 32);
+    mbedtls_sha256_update(&sha, data, len);
+    mbedtls_sha256_finish(&sha, h);
+    mbedtls_sha256_free(&sha);
+}
+
+static void hmac_sha256(const uint8_t * key, size_t key_len, const uint8_t * data, size_t data_len, uint8_t out[32])
+{
+    mbedtls_md_context_t md;
+    mbedtls_md_init(&md);
+    mbedtls_md_setup(&md, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+    mbedtls_md_hmac_starts(&md, key, key_len);
+    mbedtls_md_hmac_update(&md, data, data_len);
+    mbedtls_md_hmac_finish(&md, out);
+    mbedtls_md_free(&md);
+}
+
+static void hkdf2(uint8_t ck[32], const uint8_t * ikm, size_t ikm_len, uint8_t out1[32], uint8_t out2[32])
+{
+    uint8_t prk[32];
+    hmac_sha256(ck, 32, ikm, ikm_len, prk);
+
+    uint8_t one = 0x01;
+    hmac_sha256(prk, 32, &one, 1, out1);
+
+    uint8_t buf[33];
+    memcpy(buf, out1, 32);
+    buf[32] = 0x02;
+    hmac_sha256(prk, 32, buf, 33, out2);
+}
+
+static void build_nonce(uint64_t counter, uint8_t nonce[12])
+{
+    memset(nonce, 0, 4);
+    for (int i = 0; i < 8; i++) {
+        nonce[4 + i] = (uint8_t)(counter >> (i * 8));
+    }
+}
+
+// out receives len + 16 bytes
+static int noise_encrypt(const uint8_t key[32], uint64_t counter, const uint8_t * aad, size_t aad_len,
+                         const uint8_t * plaintext, size_t len, uint8_t * out)
+{
+    uint8_t nonce[12];
+    build_nonce(counter, nonce);
+
+    mbedtls_chachapoly_context ctx;
+    mbedtls_chachapoly_init(&ctx);
+    mbedtls_chachapoly_setkey(&ctx, key);
+    int ret = mbedtls_chachapoly_encrypt_and_tag(&ctx, len, nonce, aad, aad_len, plaintext, out, out + len);
+    mbedtls_chachapoly_free(&ctx);
+    return ret;
+}
+
+// ciphertext carries its 16 byte tag, out receives len - 16 bytes
+static int noise_decrypt(const uint8_t key[32], uint64_t counter, const uint8_t * ciphertext, size_t len, uint8_t * out)
+{
+    uint8_t nonce[12];
+    build_nonce(counter, nonce);
+
+    mbedtls_chachapoly_context ctx;
+    mbedtls_chachapoly_init(&ctx);
+    mbedtls_chachapoly_setkey(&ctx, key);
+    int ret = mbedtls_chachapoly_auth_decrypt(&ctx, len - 16, nonce, NULL, 0, ciphertext + len - 16, ciphertext, out);
+    mbedtls_chachapoly_free(&ctx);
+    return ret;
+}
+
+esp_err_t sv2_identity_init(mock_pool_t * pool)
+{
+    pool->secp_ctx = secp256k1_context_create(SECP256K1_CONTEXT_NONE);
+    if (pool->secp_ctx == NULL) {
+        return ESP_FAIL;
+    }
+
+    uint8_t seed[32], authority_priv[32];
+    pool_fill_random(seed, sizeof(seed));
+    pool_fill_random(pool->static_priv, sizeof(pool->static_priv));
+    pool_fill_random(authority_priv, sizeof(authority_priv));
+
+    secp256k1_keypair static_keypair, authority_keypair;
+    secp256k1_xonly_pubkey static_xonly, authority_xonly;
+    if (!secp256k1_context_randomize(pool->secp_ctx, seed) ||
+        !secp256k1_ellswift_create(pool->secp_ctx, pool->static_pub, pool->static_priv, seed) ||
+        !secp256k1_keypair_create(pool->secp_ctx, &static_keypair, pool->static_priv) ||
+        !secp256k1_keypair_xonly_pub(pool->secp_ctx, &static_xonly, NULL, &static_keypair) ||
+        !secp256k1_keypair_create(pool->secp_ctx, &authority_keypair, authority_priv) ||
+        !secp256k1_keypair_xonly_pub(pool->secp_ctx, &authority_xonly, NULL, &authority_keypair)) {
+        ESP_LOGE(TAG, "Failed to create pool keys");
+        return ESP_FAIL;
+    }
+    secp256k1_xonly_pubkey_serialize(pool->secp_ctx, pool->authority_pub, &authority_xonly);
+
+    // certificate: version(u16) valid_from(u32) not_valid_after(u32) schnorr_sig(64),
+    // signed by the authority over the first 10 bytes and the x-only static key
+    uint32_t now = (uint32_t)time(NULL);
+    uint32_t valid_from = now - 3600;
+    uint32_t not_valid_after = now + CERTIFICATE_VALIDITY;
+    memset(pool->certificate, 0, 2);
+    memcpy(pool->certificate + 2, &valid_from, 4);
+    memcpy(pool->certificate + 6, &not_valid_after, 4);
+
+    uint8_t static_xonly_bytes[32], sig_hash[32];
+    secp256k1_xonly_pubkey_serialize(pool->secp_ctx, static_xonly_bytes, &static_xonly);
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    mbedtls_sha256_update(&sha, pool->certificate, 10);
+    mbedtls_sha256_update(&sha, static_xonly_bytes, 32);
+    mbedtls_sha256_finish(&sha, sig_hash);
+    mbedtls_sha256_free(&sha);
+
+    pool_fill_random(seed, sizeof(seed));
+    if (!secp256k1_schnorrsig_sign32(pool->secp_ctx, pool->certificate + 10, sig_hash, &authority_keypair, seed)) {
+        ESP_LOGE(TAG, "Failed to sign certificate");
+        return ESP_FAIL;
+    }
+
+    memset(authority_priv, 0, sizeof(authority_priv));
+    return ESP_OK;
+}
+
+void sv2_identity_free(mock_pool_t * pool)
+{
+    if (pool->secp_ctx != NULL) {
+        secp256k1_context_destroy(pool->secp_ctx);
+        pool->secp_ctx = NULL;
+    }
+}
+
+// <- e
+// -> e, ee, s, es
+static bool respond_handshake(mock_pool_t * pool, pool_client_t * client, const uint8_t initiator_e[64])
+{
+    uint8_t h[32], ck[32];
+    mbedtls_sha256((const uint8_t *)NOISE_PROTOCOL_NAME, strlen(NOISE_PROTOCOL_NAME), h, 0);
+    memcpy(ck, h, 32);
+    mix_hash(h, (const uint8_t *)"", 0);
+
+    mix_hash(h, initiator_e, 64);
+    mix_hash(h, (const uint8_t *)"", 0);
+
+    uint8_t response[HANDSHAKE_RESPONSE_LEN];
+    uint8_t e_priv[32], auxrand[32], shared[32], temp_k[32];
+    pool_fill_random(e_priv, sizeof(e_priv));
+    pool_fill_random(auxrand, sizeof(auxrand));
+    if (!secp256k1_ellswift_create(pool->secp_ctx, response, e_priv, auxrand)) {
+        return false;
+    }
+    mix_hash(h, response, 64);
+
+    if (!secp256k1_ellswift_xdh(pool->secp_ctx, shared, initiator_e, response, e_priv, 1,
+                                secp256k1_ellswift_xdh_hash_function_bip324, NULL)) {
+        return false;
+    }
+    hkdf2(ck, shared, 32, ck, temp_k);
+
+    noise_encrypt(temp_k, 0, h, 32, pool->static_pub, 64, response + 64);
+    mix_hash(h, response + 64, 80);
+
+    if (!secp256k1_ellswift_xdh(pool->secp_ctx, shared, initiator_e, pool->static_pub, pool->static_priv, 1,
+                                secp256k1_ellswift_xdh_hash_function_bip324, NULL)) {
+        return false;
+    }
+    hkdf2(ck, shared, 32, ck, temp_k);
+
+    noise_encrypt(temp_k, 0, h, 32, pool->certificate, sizeof(pool->certificate), response + 144);
+
+    // the initiator sends with the first key of the split
+    hkdf2(ck, (const uint8_t *)"", 0, client->recv_key, client->send_key);
+    client->send_nonce = 0;
+    client->recv_nonce = 0;
+    client->handshake_complete = true;
+
+    memset(e_priv, 0, sizeof(e_priv));
+    pool_send(pool, client, response, sizeof(response));
+    return true;
+}
+
+// --- Framing ---
+
+static void write_u16_le(uint8_t * p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void write_u32_le(uint8_t * p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (i * 8)) & 0xff;
+    }
+}
+
+static uint32_t read_u32_le(const uint8_t * p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void send_frame(mock_pool_t * pool, pool_client_t * client, uint16_t extension_type, uint8_t msg_type,
+                       const uint8_t * payload, size_t len)
+{
+    uint8_t header[SV2_FRAME_HEADER_SIZE];
+    sv2_encode_frame_header(header, extension_type, msg_type, len);
+
+    uint8_t frame[ENCRYPTED_HEADER_LEN + MAX_PAYLOAD + 16];
+    noise_encrypt(client->send_key, client->send_nonce++, NULL, 0, header, sizeof(header), frame);
+    size_t frame_len = ENCRYPTED_HEADER_LEN;
+    if (len > 0) {
+        noise_encrypt(client->send_key, client->send_nonce++, NULL, 0, payload, len, frame + frame_len);
+        frame_len += len + 16;
+    }
+    pool_send(pool, client, frame, frame_len);
+}
+
+// U256 little endian target for a share difficulty
+static void difficulty_to_target(double difficulty, uint8_t target[32])
+{
+    double value = truediffone / difficulty;
+    for (int i = 31; i >= 0; i--) {
+        double scale = ldexp(1.0, i * 8);
+        double byte = floor(value / scale);
+        if (byte > 255) byte = 255;
+        target[i] = (uint8_t)byte;
+        value -= byte * scale;
+    }
+}
+
+static void send_channel_error(mock_pool_t * pool, pool_client_t * client, uint32_t request_id, const char * code)
+{
+    uint8_t payload[64];
+    size_t code_len = strlen(code);
+    write_u32_le(payload, request_id);
+    payload[4] = code_len;
+    memcpy(payload + 5, code, code_len);
+    send_frame(pool, client, 0, SV2_MSG_OPEN_MINING_CHANNEL_ERROR, payload, 5 + code_len);
+}
+
+void sv2_notify(mock_pool_t * pool, pool_client_t * client, pool_job_t * job, bool new_block)
+{
+    uint8_t payload[MAX_PAYLOAD];
+    size_t pos = 0;
+
+    // a job for a new block is a future job activated by SetNewPrevHash,
+    // one on the current block is active right away through min_ntime
+    write_u32_le(payload + pos, client->channel_id);    pos += 4;
+    write_u32_le(payload + pos, job->id);               pos += 4;
+    if (new_block) {
+        payload[pos++] = 0x00;
+    } else {
+        payload[pos++] = 0x01;
+        write_u32_le(payload + pos, job->ntime);        pos += 4;
+    }
+    write_u32_le(payload + pos, job->version);          pos += 4;
+
+    if (client->extended) {
+        payload[pos++] = 1;     // version rolling allowed
+        payload[pos++] = MERKLE_BRANCHES;
+        memcpy(payload + pos, job->merkle_branches, MERKLE_BRANCHES * 32);
+        pos += MERKLE_BRANCHES * 32;
+        write_u16_le(payload + pos, COINBASE_PREFIX_LEN);   pos += 2;
+        memcpy(payload + pos, pool->coinbase_prefix, COINBASE_PREFIX_LEN);
+        pos += COINBASE_PREFIX_LEN;
+        write_u16_le(payload + pos, COINBASE_SUFFIX_LEN);   pos += 2;
+        memcpy(payload + pos, pool->coinbase_suffix, COINBASE_SUFFIX_LEN);
+        pos += COINBASE_SUFFIX_LEN;
+        send_frame(pool, client, SV2_CHANNEL_MSG_FLAG, SV2_MSG_NEW_EXTENDED_MINING_JOB, payload, pos);
+    } else {
+        pool_merkle_root(pool, job, client->channel_extranonce, payload + pos);
+        pos += 32;
+        send_frame(pool, client, SV2_CHANNEL_MSG_FLAG, SV2_MSG_NEW_MINING_JOB, payload, pos);
+    }
+
+    if (new_block) {
+        pos = 0;
+        write_u32_le(payload + pos, client->channel_id);    pos += 4;
+        write_u32_le(payload + pos, job->id);               pos += 4;
+        memcpy(payload + pos, pool->prev_hash, 32);         pos += 32;
+        write_u32_le(payload + pos, job->ntime);            pos += 4;
+        write_u32_le(payload + pos, POOL_NBITS);            pos += 4;
+        send_frame(pool, client, SV2_CHANNEL_MSG_FLAG, SV2_MSG_SET_NEW_PREV_HASH, payload, pos);
+    }
+
+    pool_job_sent(pool, job);
+}
+
+static void open_channel(mock_pool_t * pool, pool_client_t * client, bool extended, const uint8_t * payload, uint32_t len)
+{
+    // request_id(u32) user_identity(STR0_255) nominal_hash_rate(f32) max_target(U256) [min_extranonce_size(u16)]
+    if (len < 5 || len < 5u + payload[4] + 36 + (extended ? 2 : 0)) {
+        client->closing = true;
+        return;
+    }
+    uint32_t request_id = read_u32_le(payload);
+
+    if (client->channel_open) {
+        send_channel_error(pool, client, request_id, "max-channels-reached");
+        return;
+    }
+    if (extended) {
+        const uint8_t * min_size = payload + 5 + payload[4] + 36;
+        if ((min_size[0] | (min_size[1] << 8)) > EXTRANONCE_2_LEN) {
+            send_channel_error(pool, client, request_id, "min-extranonce-size-too-large");
+            return;
+        }
+    }
+
+    client->channel_open = true;
+    client->extended = extended;
+    client->channel_id = pool->next_channel_id++;
+    memcpy(client->channel_extranonce, client->extranonce, EXTRANONCE_PREFIX_LEN);
+    write_u32_le(client->channel_extranonce + EXTRANONCE_PREFIX_LEN, client->channel_id);
+    memset(client->channel_extranonce + EXTRANONCE_PREFIX_LEN + 4, 0, EXTRANONCE_2_LEN - 4);
+
+    uint8_t response[96];
+    size_t pos = 0;
+    write_u32_le(response + pos, request_id);           pos += 4;
+    write_u32_le(response + pos, client->channel_id);   pos += 4;
+    difficulty_to_target(pool->config.difficulty, response + pos);
+    pos += 32;
+    if (extended) {
+        write_u16_le(response + pos, EXTRANONCE_2_LEN); pos += 2;
+        response[pos++] = EXTRANONCE_PREFIX_LEN;
+        memcpy(response + pos, client->extranonce, EXTRANONCE_PREFIX_LEN);
+        pos += EXTRANONCE_PREFIX_LEN;
+    } else {
+        response[pos++] = EXTRANONCE_LEN;
+        memcpy(response + pos, client->channel_extranonce, EXTRANONCE_LEN);
+        pos += EXTRANONCE_LEN;
+    }
+    write_u32_le(response + pos, 0);                    pos += 4;   // group channel
+    send_frame(pool, client, 0,
+               extended ? SV2_MSG_OPEN_EXTENDED_MINING_CHANNEL_SUCCESS : SV2_MSG_OPEN_STANDARD_MINING_CHANNEL_SUCCESS,
+               response, pos);
+
+    sv2_notify(pool, client, pool_current_job(pool), true);
+}
+
+static const char * share_error(pool_share_result_t result)
+{
+    switch (result) {
+        case SHARE_REJECTED:        return "injected-reject";
+        case SHARE_UNKNOWN_JOB:     return "invalid-job-id";
+        case SHARE_STALE:           return "stale-share";
+        case SHARE_DUPLICATE:       return "duplicate-share";
+        case SHARE_LOW_DIFFICULTY:  return "difficulty-too-low";
+        case SHARE_BAD_NTIME:       return "invalid-timestamp";
+        case SHARE_BAD_VERSION:     return "invalid-version";
+        default:                    return "invalid-share";
+    }
+}
+
+static void submit_shares(mock_pool_t * pool, pool_client_t * client, bool extended, const uint8_t * payload, uint32_t len)
+{
+    // channel_id sequence_number job_id nonce ntime version [extranonce(B0_32)]
+    if (len < 24 || (extended && (len < 25 || payload[24] != EXTRANONCE_2_LEN || len < 25u + EXTRANONCE_2_LEN))) {
+        client->closing = true;
+        return;
+    }
+
+    uint32_t channel_id = read_u32_le(payload);
+    uint32_t sequence_number = read_u32_le(payload + 4);
+    uint32_t nonce = read_u32_le(payload + 12);
+    uint32_t ntime = read_u32_le(payload + 16);
+    uint32_t version = read_u32_le(payload + 20);
+
+    uint8_t extranonce[EXTRANONCE_LEN];
+    memcpy(extranonce, client->channel_extranonce, EXTRANONCE_LEN);
+    if (extended) {
+        memcpy(extranonce + EXTRANONCE_PREFIX_LEN, payload + 25, EXTRANONCE_2_LEN);
+    }
+
+    pool_job_t * job = NULL;
+    if (client->channel_open && extended == client->extended && channel_id == client->channel_id) {
+        job = pool_find_job(pool, read_u32_le(payload + 8));
+    }
+
+    uint8_t hash[32] = {0};
+    double difficulty = job != NULL ? pool_share_difficulty(pool, job, extranonce, ntime, nonce, version, hash) : 0;
+    pool_share_result_t result = pool_judge_share(pool, job, ntime, version, difficulty, hash);
+
+    uint8_t response[64];
+    size_t pos = 0;
+    write_u32_le(response + pos, channel_id);       pos += 4;
+    write_u32_le(response + pos, sequence_number);  pos += 4;
+    if (result == SHARE_ACCEPTED) {
+        write_u32_le(response + pos, 1);            pos += 4;
+        uint64_t shares_sum = (uint64_t)pool->config.difficulty;
+        write_u32_le(response + pos, shares_sum);   pos += 4;
+        write_u32_le(response + pos, shares_sum >> 32); pos += 4;
+        send_frame(pool, client, SV2_CHANNEL_MSG_FLAG, SV2_MSG_SUBMIT_SHARES_SUCCESS, response, pos);
+    } else {
+        const char * code = share_error(result);
+        response[pos++] = strlen(code);
+        memcpy(response + pos, code, strlen(code));
+        pos += strlen(code);
+        send_frame(pool, client, SV2_CHANNEL_MSG_FLAG, SV2_MSG_SUBMIT_SHARES_ERROR, response, pos);
+    }
+}
+
+static void handle_message(mock_pool_t * pool, pool_client_t * client, const sv2_frame_header_t * header,
+                           const uint8_t * payload)
+{
+    switch (header->msg_type) {
+        case SV2_MSG_SETUP_CONNECTION: {
+            // used_version(u16) flags(u32)
+            uint8_t response[6];
+            write_u16_le(response, 2);
+            write_u32_le(response + 2, 0);
+            send_frame(pool, client, 0, SV2_MSG_SETUP_CONNECTION_SUCCESS, response, sizeof(response));
+            break;
+        }
+        case SV2_MSG_OPEN_STANDARD_MINING_CHANNEL:
+            open_channel(pool, client, false, payload, header->msg_length);
+            break;
+        case SV2_MSG_OPEN_EXTENDED_MINING_CHANNEL:
+            open_channel(pool, client, true, payload, header->msg_length);
+            break;
+        case SV2_MSG_SUBMIT_SHARES_STANDARD:
+            submit_shares(pool, client, false, payload, header->msg_length);
+            break;
+        case SV2_MSG_SUBMIT_SHARES_EXTENDED:
+            submit_shares(pool, client, true, payload, header->msg_length);
+            break;
+        default:
+            ESP_LOGD(TAG, "Ignoring message type 0x%02x", header->msg_type);
+            break;
+    }
+}
+
+void sv2_receive(mock_pool_t * pool, pool_client_t * client)
+{
+    size_t pos = 0;
+
+    while (!client->closing) {
+        size_t available = client->rx_len - pos;
+        const uint8_t * data = client->rx + pos;
+
+        if (!client->handshake_complete) {
+            if (available < HANDSHAKE_REQUEST_LEN) break;
+            if (!respond_handshake(pool, client, data)) {
+                ESP_LOGW(TAG, "Handshake failed");
+                client->closing = true;
+                break;
+            }
+            pos += HANDSHAKE_REQUEST_LEN;
+            continue;
+        }
+
+        if (!client->has_frame_header) {
+            if (available < ENCRYPTED_HEADER_LEN) break;
+            if (noise_decrypt(client->recv_key, client->recv_nonce++, data, ENCRYPTED_HEADER_LEN, client->frame_header) != 0) {
+                ESP_LOGW(TAG, "Failed to decrypt frame header");
+                client->closing = true;
+                break;
+            }
+            client->has_frame_header = true;
+            pos += ENCRYPTED_HEADER_LEN;
+            continue;
+        }
+
+        sv2_frame_header_t header;
+        sv2_parse_frame_header(client->frame_header, &header);
+        if (header.msg_length > MAX_PAYLOAD) {
+            ESP_LOGW(TAG, "Payload too large: %lu", (unsigned long)header.msg_length);
+            client->closing = true;
+            break;
+        }
+
+        uint8_t payload[MAX_PAYLOAD];
+        if (header.msg_length > 0) {
+            if (available < header.msg_length + 16) break;
+            if (noise_decrypt(client->recv_key, client->recv_nonce++, data, header.msg_length + 16, payload) != 0) {
+                ESP_LOGW(TAG, "Failed to decrypt payload");
+                client->closing = true;
+                break;
+            }
+            pos += header.msg_length + 16;
+        }
+        client->has_frame_header = false;
+        handle_message(pool, client, &header, payload);
+    }
+
+    memmove(client->rx, client->rx + pos, client->rx_len - pos);
+    client->rx_len -= pos;
+}
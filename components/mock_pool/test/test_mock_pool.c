@@ -0,0 +1,436 @@
+#include "unity.h"
+
+#include "mock_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "esp_transport.h"
+#include "esp_transport_tcp.h"
+
+#include "mining.h"
+#include "stratum_api.h"
+#include "sv2_noise.h"
+#include "sv2_protocol.h"
+#include "utils.h"
+
+// 8 leading zero bits, cheap enough to search on the device under test
+#define SHARE_DIFFICULTY (1.0 / (1 << 24))
+#define VERSION_MASK 0x1fffe000
+
+static mock_pool_config_t default_config(mock_pool_protocol_t protocol)
+{
+    return (mock_pool_config_t){
+        .protocol = protocol,
+        .difficulty = SHARE_DIFFICULTY,
+    };
+}
+
+// --- Stratum V1 ---
+
+static int connect_pool(mock_pool_t * pool)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+
+    struct timeval timeout = {.tv_sec = 2};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(mock_pool_get_port(pool)),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+    return fd;
+}
+
+static void send_line(int fd, const char * line)
+{
+    TEST_ASSERT_EQUAL(strlen(line), write(fd, line, strlen(line)));
+}
+
+// returns false once the pool closed the connection
+static bool receive_message(int fd, StratumApiV1Message * message)
+{
+    char line[2048];
+    size_t len = 0;
+    while (len < sizeof(line) - 1) {
+        if (read(fd, line + len, 1) != 1) return false;
+        if (line[len] == '\n') break;
+        len++;
+    }
+    line[len] = '\0';
+    STRATUM_V1_parse(message, line);
+    return true;
+}
+
+static void receive_method(int fd, StratumApiV1Message * message, stratum_method method)
+{
+    TEST_ASSERT_TRUE(receive_message(fd, message));
+    TEST_ASSERT_EQUAL(method, message->method);
+}
+
+// subscribe and authorize, returns the first job
+static mining_notify * start_session(int fd, StratumApiV1Message * message, char ** extranonce, int * extranonce_2_len)
+{
+    send_line(fd, "{\"id\":1,\"method\":\"mining.configure\",\"params\":[[\"version-rolling\"],{\"version-rolling.mask\":\"ffffffff\"}]}\n");
+    send_line(fd, "{\"id\":2,\"method\":\"mining.subscribe\",\"params\":[\"bitaxe\"]}\n");
+    send_line(fd, "{\"id\":3,\"method\":\"mining.authorize\",\"params\":[\"user\",\"x\"]}\n");
+
+    receive_method(fd, message, STRATUM_RESULT_VERSION_MASK);
+    TEST_ASSERT_EQUAL_HEX32(VERSION_MASK, message->version_mask);
+
+    receive_method(fd, message, STRATUM_RESULT_SUBSCRIBE);
+    *extranonce = strdup(message->extranonce_str);
+    *extranonce_2_len = message->extranonce_2_len;
+
+    receive_method(fd, message, STRATUM_RESULT_SETUP);
+    TEST_ASSERT_TRUE(message->response_success);
+
+    receive_method(fd, message, MINING_SET_DIFFICULTY);
+    TEST_ASSERT_EQUAL_DOUBLE(SHARE_DIFFICULTY, message->new_difficulty);
+
+    receive_method(fd, message, MINING_NOTIFY);
+    TEST_ASSERT_TRUE(message->mining_notification->clean_jobs);
+    mining_notify * notify = message->mining_notification;
+    message->mining_notification = NULL;
+    return notify;
+}
+
+static void build_job_v1(mining_notify * notify, const char * extranonce, const char * extranonce_2, bm_job * job)
+{
+    uint8_t coinbase_tx_hash[32], merkle_root[32];
+    calculate_coinbase_tx_hash(notify->coinbase_1, notify->coinbase_2, extranonce, extranonce_2, coinbase_tx_hash);
+    calculate_merkle_root_hash(coinbase_tx_hash, (uint8_t(*)[32])notify->merkle_branches, notify->n_merkle_branches, merkle_root);
+    construct_bm_job(notify, merkle_root, 0, SHARE_DIFFICULTY, job);
+}
+
+// search the job like the miner would, returns the nonce
+static uint32_t mine_v1(mining_notify * notify, const char * extranonce, const char * extranonce_2)
+{
+    bm_job job;
+    build_job_v1(notify, extranonce, extranonce_2, &job);
+    for (uint32_t nonce = 0;; nonce++) {
+        if (test_nonce_value(&job, nonce, job.version) >= SHARE_DIFFICULTY) return nonce;
+    }
+}
+
+static bool is_share_v1(mining_notify * notify, const char * extranonce, const char * extranonce_2, uint32_t nonce)
+{
+    bm_job job;
+    build_job_v1(notify, extranonce, extranonce_2, &job);
+    return test_nonce_value(&job, nonce, job.version) >= SHARE_DIFFICULTY;
+}
+
+static void submit_v1(int fd, int id, mining_notify * notify, const char * extranonce_2, uint32_t nonce)
+{
+    char line[256];
+    snprintf(line, sizeof(line),
+             "{\"id\":%d,\"method\":\"mining.submit\",\"params\":[\"user\",\"%s\",\"%s\",\"%08lx\",\"%08lx\",\"00000000\"]}\n",
+             id, notify->job_id, extranonce_2, (unsigned long)notify->ntime, (unsigned long)nonce);
+    send_line(fd, line);
+}
+
+TEST_CASE("Mock pool validates Stratum V1 shares", "[mock_pool]")
+{
+    mock_pool_config_t config = default_config(MOCK_POOL_SV1);
+    mock_pool_t * pool;
+    TEST_ASSERT_EQUAL(ESP_OK, mock_pool_start(&config, &pool));
+
+    int fd = connect_pool(pool);
+    StratumApiV1Message message = {};
+    char * extranonce;
+    int extranonce_2_len;
+    mining_notify * notify = start_session(fd, &message, &extranonce, &extranonce_2_len);
+
+    char extranonce_2[MAX_EXTRANONCE_2_LEN * 2 + 1];
+    extranonce_2_generate(7, extranonce_2_len, extranonce_2);
+    uint32_t nonce = mine_v1(notify, extranonce, extranonce_2);
+
+    submit_v1(fd, 5, notify, extranonce_2, nonce);
+    receive_method(fd, &message, STRATUM_RESULT);
+    TEST_ASSERT_TRUE(message.response_success);
+
+    submit_v1(fd, 6, notify, extranonce_2, nonce);
+    receive_method(fd, &message, STRATUM_RESULT);
+    TEST_ASSERT_FALSE(message.response_success);
+    TEST_ASSERT_EQUAL_STRING("Duplicate share", message.error_str);
+
+    // the same nonce on another extranonce 2 hashes to something else entirely,
+    // skipping the odd one it still happens to be a share for
+    uint64_t other = 8;
+    do {
+        extranonce_2_generate(other++, extranonce_2_len, extranonce_2);
+    } while (is_share_v1(notify, extranonce, extranonce_2, nonce));
+    submit_v1(fd, 7, notify, extranonce_2, nonce);
+    receive_method(fd, &message, STRATUM_RESULT);
+    TEST_ASSERT_FALSE(message.response_success);
+
+    mock_pool_stats_t stats;
+    mock_pool_get_stats(pool, &stats);
+    TEST_ASSERT_EQUAL(1, stats.shares_accepted);
+    TEST_ASSERT_EQUAL(2, stats.shares_invalid);
+    TEST_ASSERT_EQUAL(1, stats.first_share_count);
+
+    STRATUM_V1_reset_message(&message);
+    STRATUM_V1_free_mining_notify(notify);
+    free(extranonce);
+    close(fd);
+    mock_pool_stop(pool);
+}
+
+TEST_CASE("Mock pool injects extranonce changes and rejects", "[mock_pool]")
+{
+    mock_pool_config_t config = default_config(MOCK_POOL_SV1);
+    config.extranonce_interval_ms = 500;
+    config.reject_permille = 1000;
+    mock_pool_t * pool;
+    TEST_ASSERT_EQUAL(ESP_OK, mock_pool_start(&config, &pool));
+
+    int fd = connect_pool(pool);
+    StratumApiV1Message message = {};
+    char * extranonce;
+    int extranonce_2_len;
+    STRATUM_V1_free_mining_notify(start_session(fd, &message, &extranonce, &extranonce_2_len));
+
+    receive_method(fd, &message, MINING_SET_EXTRANONCE);
+    TEST_ASSERT_NOT_EQUAL(0, strcmp(extranonce, message.extranonce_str));
+    free(extranonce);
+    extranonce = strdup(message.extranonce_str);
+
+    receive_method(fd, &message, MINING_NOTIFY);
+    mining_notify * notify = message.mining_notification;
+    message.mining_notification = NULL;
+
+    char extranonce_2[MAX_EXTRANONCE_2_LEN * 2 + 1];
+    extranonce_2_generate(1, extranonce_2_len, extranonce_2);
+    submit_v1(fd, 5, notify, extranonce_2, mine_v1(notify, extranonce, extranonce_2));
+
+    // skip further extranonce changes until the answer arrives
+    do {
+        TEST_ASSERT_TRUE(receive_message(fd, &message));
+    } while (message.method != STRATUM_RESULT);
+    TEST_ASSERT_FALSE(message.response_success);
+    TEST_ASSERT_EQUAL_STRING("Injected reject", message.error_str);
+
+    mock_pool_stats_t stats;
+    mock_pool_get_stats(pool, &stats);
+    TEST_ASSERT_EQUAL(1, stats.shares_rejected);
+    TEST_ASSERT_EQUAL(0, stats.shares_invalid);
+
+    STRATUM_V1_reset_message(&message);
+    STRATUM_V1_free_mining_notify(notify);
+    free(extranonce);
+    close(fd);
+    mock_pool_stop(pool);
+}
+
+TEST_CASE("Mock pool drops clients and refuses them during an outage", "[mock_pool]")
+{
+    mock_pool_config_t config = default_config(MOCK_POOL_SV1);
+    config.reconnect_interval_ms = 100;
+    config.outage_ms = 2000;
+    mock_pool_t * pool;
+    TEST_ASSERT_EQUAL(ESP_OK, mock_pool_start(&config, &pool));
+
+    int fd = connect_pool(pool);
+    StratumApiV1Message message = {};
+    receive_method(fd, &message, CLIENT_RECONNECT);
+    TEST_ASSERT_FALSE(receive_message(fd, &message));
+    close(fd);
+
+    fd = connect_pool(pool);
+    TEST_ASSERT_FALSE(receive_message(fd, &message));
+    close(fd);
+
+    mock_pool_stats_t stats;
+    mock_pool_get_stats(pool, &stats);
+    TEST_ASSERT_EQUAL(1, stats.connections);
+    TEST_ASSERT_EQUAL(1, stats.connections_refused);
+
+    STRATUM_V1_reset_message(&message);
+    mock_pool_stop(pool);
+}
+
+// --- Stratum V2 ---
+
+typedef struct
+{
+    esp_transport_handle_t transport;
+    sv2_noise_ctx_t * noise;
+    uint8_t frame[512];
+    uint8_t header[SV2_FRAME_HEADER_SIZE];
+    uint8_t payload[512];
+    int payload_len;
+} sv2_client_t;
+
+static int sv2_connect(sv2_client_t * client, mock_pool_t * pool, const uint8_t * authority_pubkey)
+{
+    client->transport = esp_transport_tcp_init();
+    TEST_ASSERT_GREATER_OR_EQUAL(0, esp_transport_connect(client->transport, "127.0.0.1", mock_pool_get_port(pool), 1000));
+    client->noise = sv2_noise_create();
+    return sv2_noise_handshake(client->noise, client->transport, authority_pubkey);
+}
+
+static void sv2_disconnect(sv2_client_t * client)
+{
+    sv2_noise_destroy(client->noise);
+    esp_transport_close(client->transport);
+    esp_transport_destroy(client->transport);
+}
+
+static void sv2_send(sv2_client_t * client, int frame_len)
+{
+    TEST_ASSERT_GREATER_THAN(0, frame_len);
+    TEST_ASSERT_EQUAL(0, sv2_noise_send(client->noise, client->transport, client->frame, frame_len));
+}
+
+static void sv2_receive(sv2_client_t * client, uint8_t msg_type)
+{
+    TEST_ASSERT_EQUAL(0, sv2_noise_recv(client->noise, client->transport, client->header, client->payload,
+                                        sizeof(client->payload), &client->payload_len));
+    sv2_frame_header_t header;
+    sv2_parse_frame_header(client->header, &header);
+    TEST_ASSERT_EQUAL_HEX8(msg_type, header.msg_type);
+}
+
+static void sv2_setup(sv2_client_t * client)
+{
+    sv2_send(client, sv2_build_setup_connection(client->frame, sizeof(client->frame), "127.0.0.1", 3333,
+                                                "bitaxe", "test", "", "", 0x01));
+    sv2_receive(client, SV2_MSG_SETUP_CONNECTION_SUCCESS);
+}
+
+// search a header whose merkle root and prev hash are in internal byte order
+static uint32_t mine_v2(uint32_t version, const uint8_t prev_hash[32], const uint8_t merkle_root[32], uint32_t ntime, uint32_t nbits)
+{
+    uint8_t header[80], hash[32];
+    memcpy(header, &version, 4);
+    memcpy(header + 4, prev_hash, 32);
+    memcpy(header + 36, merkle_root, 32);
+    memcpy(header + 68, &ntime, 4);
+    memcpy(header + 72, &nbits, 4);
+    for (uint32_t nonce = 0;; nonce++) {
+        memcpy(header + 76, &nonce, 4);
+        double_sha256_bin(header, 80, hash);
+        if (truediffone / le256todouble(hash) >= SHARE_DIFFICULTY) return nonce;
+    }
+}
+
+TEST_CASE("Mock pool serves Stratum V2 standard channels", "[mock_pool]")
+{
+    mock_pool_config_t config = default_config(MOCK_POOL_SV2);
+    mock_pool_t * pool;
+    TEST_ASSERT_EQUAL(ESP_OK, mock_pool_start(&config, &pool));
+
+    // the certificate only verifies against the pool's own authority
+    sv2_client_t client;
+    uint8_t authority[32] = {0x01};
+    TEST_ASSERT_NOT_EQUAL(0, sv2_connect(&client, pool, authority));
+    sv2_disconnect(&client);
+
+    mock_pool_get_authority_pubkey(pool, authority);
+    TEST_ASSERT_EQUAL(0, sv2_connect(&client, pool, authority));
+    sv2_setup(&client);
+
+    sv2_send(&client, sv2_build_open_standard_mining_channel(client.frame, sizeof(client.frame), 1, "user", 1e12));
+    sv2_receive(&client, SV2_MSG_OPEN_STANDARD_MINING_CHANNEL_SUCCESS);
+    uint32_t request_id, channel_id, group_channel_id;
+    uint8_t target[32], extranonce_prefix[32], extranonce_prefix_len;
+    TEST_ASSERT_EQUAL(0, sv2_parse_open_channel_success(client.payload, client.payload_len, &request_id, &channel_id, target,
+                                                        extranonce_prefix, &extranonce_prefix_len, &group_channel_id));
+    TEST_ASSERT_EQUAL(1, request_id);
+    TEST_ASSERT_EQUAL_DOUBLE(truediffone / SHARE_DIFFICULTY, le256todouble(target));
+
+    // a future job, activated by the prev hash that follows
+    sv2_receive(&client, SV2_MSG_NEW_MINING_JOB);
+    uint32_t job_channel_id, job_id, min_ntime, version;
+    bool has_min_ntime;
+    uint8_t merkle_root[32];
+    TEST_ASSERT_EQUAL(0, sv2_parse_new_mining_job(client.payload, client.payload_len, &job_channel_id, &job_id,
+                                                  &has_min_ntime, &min_ntime, &version, merkle_root));
+    TEST_ASSERT_EQUAL(channel_id, job_channel_id);
+    TEST_ASSERT_FALSE(has_min_ntime);
+
+    sv2_receive(&client, SV2_MSG_SET_NEW_PREV_HASH);
+    uint32_t prev_hash_job_id, ntime, nbits;
+    uint8_t prev_hash[32];
+    TEST_ASSERT_EQUAL(0, sv2_parse_set_new_prev_hash(client.payload, client.payload_len, &job_channel_id, &prev_hash_job_id,
+                                                     prev_hash, &ntime, &nbits));
+    TEST_ASSERT_EQUAL(job_id, prev_hash_job_id);
+
+    // roll a version bit and the ntime like a second chain would
+    version |= 0x2000;
+    uint32_t nonce = mine_v2(version, prev_hash, merkle_root, ntime + 1, nbits);
+    sv2_send(&client, sv2_build_submit_shares_standard(client.frame, sizeof(client.frame), channel_id, 1, job_id, nonce, ntime + 1, version));
+    sv2_receive(&client, SV2_MSG_SUBMIT_SHARES_SUCCESS);
+
+    sv2_send(&client, sv2_build_submit_shares_standard(client.frame, sizeof(client.frame), channel_id, 2, job_id, nonce, ntime + 1, version));
+    sv2_receive(&client, SV2_MSG_SUBMIT_SHARES_ERROR);
+    uint32_t seq_num;
+    char error_code[32];
+    TEST_ASSERT_EQUAL(0, sv2_parse_submit_shares_error(client.payload, client.payload_len, &channel_id, &seq_num,
+                                                       error_code, sizeof(error_code)));
+    TEST_ASSERT_EQUAL(2, seq_num);
+    TEST_ASSERT_EQUAL_STRING("duplicate-share", error_code);
+
+    sv2_disconnect(&client);
+    mock_pool_stop(pool);
+}
+
+TEST_CASE("Mock pool serves Stratum V2 extended channels", "[mock_pool]")
+{
+    mock_pool_config_t config = default_config(MOCK_POOL_SV2);
+    mock_pool_t * pool;
+    TEST_ASSERT_EQUAL(ESP_OK, mock_pool_start(&config, &pool));
+
+    sv2_client_t client;
+    TEST_ASSERT_EQUAL(0, sv2_connect(&client, pool, NULL));
+    sv2_setup(&client);
+
+    sv2_send(&client, sv2_build_open_extended_mining_channel(client.frame, sizeof(client.frame), 1, "user", 1e12, 6));
+    sv2_receive(&client, SV2_MSG_OPEN_EXTENDED_MINING_CHANNEL_SUCCESS);
+    uint32_t request_id, channel_id, group_channel_id;
+    uint16_t extranonce_size;
+    uint8_t target[32], extranonce_prefix[32], extranonce_prefix_len;
+    TEST_ASSERT_EQUAL(0, sv2_parse_open_extended_channel_success(client.payload, client.payload_len, &request_id, &channel_id,
+                                                                 target, &extranonce_size, extranonce_prefix,
+                                                                 &extranonce_prefix_len, &group_channel_id));
+    TEST_ASSERT_GREATER_OR_EQUAL(6, extranonce_size);
+
+    sv2_receive(&client, SV2_MSG_NEW_EXTENDED_MINING_JOB);
+    sv2_ext_job_t * job = sv2_parse_new_extended_mining_job(client.payload, client.payload_len, NULL);
+    TEST_ASSERT_NOT_NULL(job);
+    TEST_ASSERT_TRUE(job->version_rolling_allowed);
+
+    sv2_receive(&client, SV2_MSG_SET_NEW_PREV_HASH);
+    uint32_t job_channel_id, prev_hash_job_id, ntime, nbits;
+    uint8_t prev_hash[32];
+    TEST_ASSERT_EQUAL(0, sv2_parse_set_new_prev_hash(client.payload, client.payload_len, &job_channel_id, &prev_hash_job_id,
+                                                     prev_hash, &ntime, &nbits));
+    TEST_ASSERT_EQUAL(job->job_id, prev_hash_job_id);
+
+    uint8_t extranonce[32] = {0x5a};
+    uint8_t coinbase_tx_hash[32], merkle_root[32];
+    calculate_coinbase_tx_hash_bin(job->coinbase_prefix, job->coinbase_prefix_len, extranonce_prefix, extranonce_prefix_len,
+                                   extranonce, extranonce_size, job->coinbase_suffix, job->coinbase_suffix_len, coinbase_tx_hash);
+    calculate_merkle_root_hash(coinbase_tx_hash, job->merkle_path, job->merkle_path_count, merkle_root);
+
+    uint32_t nonce = mine_v2(job->version, prev_hash, merkle_root, ntime, nbits);
+    sv2_send(&client, sv2_build_submit_shares_extended(client.frame, sizeof(client.frame), channel_id, 1, job->job_id,
+                                                       nonce, ntime, job->version, extranonce, extranonce_size));
+    sv2_receive(&client, SV2_MSG_SUBMIT_SHARES_SUCCESS);
+
+    mock_pool_stats_t stats;
+    mock_pool_get_stats(pool, &stats);
+    TEST_ASSERT_EQUAL(1, stats.shares_accepted);
+
+    sv2_ext_job_free(job);
+    sv2_disconnect(&client);
+    mock_pool_stop(pool);
+}
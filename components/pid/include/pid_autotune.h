@@ -0,0 +1,73 @@
+#ifndef PID_AUTOTUNE_H
+#define PID_AUTOTUNE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Relay feedback autotune for a reverse acting loop such as the fan: the
+// output is switched between bias + amplitude and bias - amplitude whenever
+// the input crosses the setpoint, which makes the loop oscillate at its
+// ultimate period. The size of that oscillation gives the ultimate gain and
+// the plant's gain, the time from a switch to the turn of the input gives
+// its dead time.
+
+typedef enum {
+    PID_AUTOTUNE_IDLE,
+    PID_AUTOTUNE_RUNNING,
+    PID_AUTOTUNE_DONE,
+    PID_AUTOTUNE_FAILED,
+} pid_autotune_state_t;
+
+typedef struct {
+    float kp;
+    float ki;           // per second
+    float kd;           // seconds
+} pid_gains_t;
+
+typedef struct {
+    float setpoint;
+    float bias;
+    float amplitude;
+    float hysteresis;       // noise band around the setpoint
+    float max_deviation;    // gives up when the input strays further
+    int64_t timeout_us;
+} pid_autotune_config_t;
+
+typedef struct {
+    pid_autotune_state_t state;
+    pid_autotune_config_t config;
+
+    int64_t start_us;
+    bool high;              // output at bias + amplitude
+    int cycles;
+    int64_t last_switch_us;
+    int64_t last_high_us;   // start of the current cycle
+    float peak;             // extreme of the input since the last switch
+    int64_t peak_us;
+    float last_max;
+    float last_min;
+    float last_lag_s;
+
+    float period_sum;
+    float amplitude_sum;
+    float dead_time_sum;
+    int measured;
+
+    // results, once done
+    float ultimate_gain;    // output per unit of input
+    float ultimate_period;  // seconds
+    float dead_time;        // seconds
+    float plant_gain;       // input per second per unit of output
+    pid_gains_t gains;
+} pid_autotune_t;
+
+void pid_autotune_start(pid_autotune_t * tune, const pid_autotune_config_t * config, int64_t now_us);
+
+// Feeds the input, returns the output to apply
+float pid_autotune_update(pid_autotune_t * tune, float input, int64_t now_us);
+
+void pid_autotune_abort(pid_autotune_t * tune);
+
+const char * pid_autotune_state_to_string(pid_autotune_state_t state);
+
+#endif
@@ -0,0 +1,142 @@
+#include <math.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "pid_autotune.h"
+
+// The first cycle starts wherever the input happened to be, the rest are averaged
+#define SKIP_CYCLES 1
+#define MEASURE_CYCLES 3
+// Below this the sampling hides the dead time
+#define MIN_DEAD_TIME_S 1.0f
+
+static const char * TAG = "pid_autotune";
+
+void pid_autotune_start(pid_autotune_t * tune, const pid_autotune_config_t * config, int64_t now_us)
+{
+    memset(tune, 0, sizeof(*tune));
+    tune->state = PID_AUTOTUNE_RUNNING;
+    tune->config = *config;
+    tune->start_us = now_us;
+}
+
+void pid_autotune_abort(pid_autotune_t * tune)
+{
+    if (tune->state == PID_AUTOTUNE_RUNNING) {
+        tune->state = PID_AUTOTUNE_FAILED;
+    }
+}
+
+static void finish(pid_autotune_t * tune)
+{
+    float a = tune->amplitude_sum / tune->measured;
+    float d = tune->config.amplitude;
+
+    tune->ultimate_gain = 4 * d / ((float)M_PI * a);
+    tune->ultimate_period = tune->period_sum / tune->measured;
+    tune->dead_time = tune->dead_time_sum / tune->measured;
+
+    if (!isfinite(tune->ultimate_gain) || tune->ultimate_gain <= 0 || tune->ultimate_period <= 0) {
+        ESP_LOGW(TAG, "No usable oscillation, %.2f wide over %.1f s", a, tune->ultimate_period);
+        tune->state = PID_AUTOTUNE_FAILED;
+        return;
+    }
+
+    // Over a cycle this short the fan acts on how fast the temperature moves
+    // rather than where it settles: it covers the swing twice per period at a
+    // rate of plant gain times the relay amplitude
+    tune->plant_gain = 4 * a / (d * tune->ultimate_period);
+
+    // SIMC for such an integrating plant, with the closed loop as fast as the
+    // dead time allows: next to no overshoot, and no derivative to pass the
+    // sensor noise on to the fan
+    float dead_time = fmaxf(tune->dead_time, MIN_DEAD_TIME_S);
+    float tc = dead_time;
+    tune->gains.kp = 1 / (tune->plant_gain * (tc + dead_time));
+    tune->gains.ki = tune->gains.kp / (4 * (tc + dead_time));
+    tune->gains.kd = 0;
+
+    ESP_LOGI(TAG, "Plant gain %.4f/s, dead time %.1f s (Ku %.2f, Tu %.1f s)",
+             tune->plant_gain, tune->dead_time, tune->ultimate_gain, tune->ultimate_period);
+    ESP_LOGI(TAG, "Kp %.2f, Ki %.3f, Kd %.2f", tune->gains.kp, tune->gains.ki, tune->gains.kd);
+    tune->state = PID_AUTOTUNE_DONE;
+}
+
+static void relay_switch(pid_autotune_t * tune, float input, int64_t now_us)
+{
+    float lag_s = (tune->peak_us - tune->last_switch_us) / 1e6f;
+
+    if (tune->high) {
+        tune->last_max = tune->peak;
+        tune->last_lag_s = lag_s;
+    } else {
+        tune->last_min = tune->peak;
+
+        // a full cycle, high then low, ends here
+        if (tune->last_high_us != 0 && ++tune->cycles > SKIP_CYCLES) {
+            tune->period_sum += (now_us - tune->last_high_us) / 1e6f;
+            tune->amplitude_sum += (tune->last_max - tune->last_min) / 2;
+            tune->dead_time_sum += (tune->last_lag_s + lag_s) / 2;
+            tune->measured++;
+        }
+        tune->last_high_us = now_us;
+    }
+
+    tune->high = !tune->high;
+    tune->last_switch_us = now_us;
+    tune->peak = input;
+    tune->peak_us = now_us;
+}
+
+float pid_autotune_update(pid_autotune_t * tune, float input, int64_t now_us)
+{
+    if (tune->state != PID_AUTOTUNE_RUNNING) {
+        return tune->config.bias;
+    }
+
+    if (tune->config.max_deviation > 0 && fabsf(input - tune->config.setpoint) > tune->config.max_deviation) {
+        ESP_LOGW(TAG, "Gave up, %.1f is too far from %.1f", input, tune->config.setpoint);
+        tune->state = PID_AUTOTUNE_FAILED;
+        return tune->config.bias;
+    }
+    if (tune->config.timeout_us > 0 && now_us - tune->start_us > tune->config.timeout_us) {
+        ESP_LOGW(TAG, "Gave up after %d cycles", tune->cycles);
+        tune->state = PID_AUTOTUNE_FAILED;
+        return tune->config.bias;
+    }
+
+    if (tune->last_switch_us == 0) {
+        tune->high = input > tune->config.setpoint;
+        tune->last_switch_us = now_us;
+        tune->peak = input;
+        tune->peak_us = now_us;
+    }
+
+    // the input keeps going the old way for the dead time after a switch
+    if (tune->high ? input > tune->peak : input < tune->peak) {
+        tune->peak = input;
+        tune->peak_us = now_us;
+    }
+
+    if (tune->high ? input < tune->config.setpoint - tune->config.hysteresis : input > tune->config.setpoint + tune->config.hysteresis) {
+        relay_switch(tune, input, now_us);
+        if (tune->measured >= MEASURE_CYCLES) {
+            finish(tune);
+            return tune->config.bias;
+        }
+    }
+
+    return tune->high ? tune->config.bias + tune->config.amplitude : tune->config.bias - tune->config.amplitude;
+}
+
+const char * pid_autotune_state_to_string(pid_autotune_state_t state)
+{
+    switch (state) {
+        case PID_AUTOTUNE_IDLE: return "idle";
+        case PID_AUTOTUNE_RUNNING: return "running";
+        case PID_AUTOTUNE_DONE: return "done";
+        case PID_AUTOTUNE_FAILED: return "failed";
+    }
+    return "unknown";
+}
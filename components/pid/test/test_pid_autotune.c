@@ -0,0 +1,120 @@
+#include "unity.h"
+
+#include "pid_autotune.h"
+
+#define SETPOINT 60.0f
+#define BIAS 50.0f
+#define AMPLITUDE 20.0f
+#define HYSTERESIS 0.2f
+#define POLL_US 100000LL
+
+// The fan as the autotune sees it: the temperature falls in proportion to the
+// fan output above the bias, a dead time after the output changed
+#define PLANT_GAIN 0.05f        // °C per second per % of fan
+#define DEAD_TIME_S 4.0f
+#define DELAY_POLLS 40          // DEAD_TIME_S in polls
+
+static pid_autotune_t tune;
+static int64_t now_us;
+static float temp;
+static float outputs[DELAY_POLLS];
+static int polls;
+
+static void start(float max_deviation, int64_t timeout_us)
+{
+    pid_autotune_config_t config = {
+        .setpoint = SETPOINT,
+        .bias = BIAS,
+        .amplitude = AMPLITUDE,
+        .hysteresis = HYSTERESIS,
+        .max_deviation = max_deviation,
+        .timeout_us = timeout_us,
+    };
+
+    now_us = 1;
+    temp = SETPOINT;
+    polls = 0;
+    for (int i = 0; i < DELAY_POLLS; i++) outputs[i] = BIAS;
+    pid_autotune_start(&tune, &config, now_us);
+}
+
+// polls like the fan controller until the autotune ends, returns the last output
+static float run(float gain, int seconds)
+{
+    float output = BIAS;
+
+    for (int i = 0; i < seconds * 1000000LL / POLL_US && tune.state == PID_AUTOTUNE_RUNNING; i++) {
+        now_us += POLL_US;
+
+        float delayed = outputs[polls % DELAY_POLLS];
+        temp -= gain * (delayed - BIAS) * (POLL_US / 1e6f);
+
+        output = pid_autotune_update(&tune, temp, now_us);
+        outputs[polls++ % DELAY_POLLS] = output;
+    }
+    return output;
+}
+
+TEST_CASE("Autotune identifies an integrating plant with dead time", "[pid_autotune]")
+{
+    start(0, 0);
+    // start off the setpoint so the first switch comes from the relay
+    temp = SETPOINT + 1;
+
+    TEST_ASSERT_EQUAL_FLOAT(BIAS, run(PLANT_GAIN, 600));
+    TEST_ASSERT_EQUAL(PID_AUTOTUNE_DONE, tune.state);
+
+    TEST_ASSERT_FLOAT_WITHIN(PLANT_GAIN * 0.05f, PLANT_GAIN, tune.plant_gain);
+    TEST_ASSERT_FLOAT_WITHIN(2 * POLL_US / 1e6f, DEAD_TIME_S, tune.dead_time);
+
+    // the oscillation is HYSTERESIS + PLANT_GAIN * AMPLITUDE * DEAD_TIME_S wide
+    float a = HYSTERESIS + PLANT_GAIN * AMPLITUDE * DEAD_TIME_S;
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 4 * AMPLITUDE / (3.14159265f * a), tune.ultimate_gain);
+
+    // SIMC with the closed loop time constant at the dead time
+    float kp = 1 / (PLANT_GAIN * 2 * DEAD_TIME_S);
+    TEST_ASSERT_FLOAT_WITHIN(kp * 0.1f, kp, tune.gains.kp);
+    TEST_ASSERT_FLOAT_WITHIN(kp / (8 * DEAD_TIME_S) * 0.15f, kp / (8 * DEAD_TIME_S), tune.gains.ki);
+    TEST_ASSERT_EQUAL_FLOAT(0, tune.gains.kd);
+}
+
+TEST_CASE("Autotune gives up when the input strays too far", "[pid_autotune]")
+{
+    start(5, 0);
+    temp = SETPOINT + 1;
+
+    // a plant four times as slow to stop swings past the allowed deviation
+    TEST_ASSERT_EQUAL_FLOAT(BIAS, run(4 * PLANT_GAIN, 600));
+    TEST_ASSERT_EQUAL(PID_AUTOTUNE_FAILED, tune.state);
+    TEST_ASSERT_TRUE(temp > SETPOINT + 5 || temp < SETPOINT - 5);
+
+    // and stays out of the loop from then on
+    now_us += POLL_US;
+    TEST_ASSERT_EQUAL_FLOAT(BIAS, pid_autotune_update(&tune, SETPOINT, now_us));
+    TEST_ASSERT_EQUAL(PID_AUTOTUNE_FAILED, tune.state);
+}
+
+TEST_CASE("Autotune gives up when no oscillation comes in time", "[pid_autotune]")
+{
+    start(0, 60 * 1000000LL);
+
+    // a plant the fan has no effect on never crosses back
+    TEST_ASSERT_EQUAL_FLOAT(BIAS, run(0, 600));
+    TEST_ASSERT_EQUAL(PID_AUTOTUNE_FAILED, tune.state);
+    TEST_ASSERT_EQUAL(0, tune.measured);
+    TEST_ASSERT_TRUE(now_us - 1 > 60 * 1000000LL);
+    TEST_ASSERT_TRUE(now_us - 1 <= 60 * 1000000LL + POLL_US);
+}
+
+TEST_CASE("Autotune abort only ends a running tune", "[pid_autotune]")
+{
+    start(0, 0);
+    pid_autotune_abort(&tune);
+    TEST_ASSERT_EQUAL(PID_AUTOTUNE_FAILED, tune.state);
+
+    start(0, 0);
+    temp = SETPOINT + 1;
+    run(PLANT_GAIN, 600);
+    pid_autotune_abort(&tune);
+    TEST_ASSERT_EQUAL(PID_AUTOTUNE_DONE, tune.state);
+}
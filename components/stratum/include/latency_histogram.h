@@ -0,0 +1,30 @@
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Counts latencies into fixed buckets, for the share pipeline. One task
+// records, any other may read at the same time without a lock; a reading
+// taken while a latency is being recorded may be one latency behind in
+// places, never torn.
+
+#define LATENCY_HISTOGRAM_BUCKETS 12
+
+// Upper bounds of the buckets in ms, the last bucket takes everything above
+extern const float LATENCY_HISTOGRAM_BOUNDS_MS[LATENCY_HISTOGRAM_BUCKETS - 1];
+
+typedef struct
+{
+    _Atomic uint32_t counts[LATENCY_HISTOGRAM_BUCKETS];
+    _Atomic uint64_t sum_us;
+} latency_histogram_t;
+
+void latency_histogram_reset(latency_histogram_t * histogram);
+
+void latency_histogram_record(latency_histogram_t * histogram, float latency_ms);
+
+// Fills counts with the number of latencies in each bucket, returns their sum in ms
+double latency_histogram_read(const latency_histogram_t * histogram, uint32_t counts[LATENCY_HISTOGRAM_BUCKETS]);
+
+#endif /* LATENCY_HISTOGRAM_H_ */
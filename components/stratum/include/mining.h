@@ -21,6 +21,7 @@ typedef struct
     double pool_diff;
     char *jobid;
     char *extranonce2;
+    uint32_t epoch; // chain job epoch of the work it was built from, 0 takes the epoch it is stored in
 } bm_job;
 
 void free_bm_job(bm_job *job);
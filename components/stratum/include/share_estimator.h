@@ -0,0 +1,52 @@
+#ifndef SHARE_ESTIMATOR_H_
+#define SHARE_ESTIMATOR_H_
+
+#include <stdint.h>
+
+// Hashrate as the pool sees it: the difficulty of the shares found over the
+// time spent mining, each share standing for difficulty * 2^32 hashes.
+//
+// Shares and time are both decayed over SHARE_ESTIMATOR_TAU_S, so the
+// estimate follows the last hour or so. Shares arrive at random, the count
+// behind the estimate gives its 95% confidence interval: a few shares leave
+// it wide, it narrows as they add up. Time spent paused is not counted.
+
+#define SHARE_ESTIMATOR_TAU_S 3600.0f
+
+typedef enum
+{
+    SHARE_ESTIMATOR_ACCEPTED,   // acknowledged by the pool
+    SHARE_ESTIMATOR_LOCAL,      // met the pool difficulty here and were submitted
+    SHARE_ESTIMATOR_SOURCES,
+} share_estimator_source_t;
+
+typedef struct
+{
+    double difficulty[SHARE_ESTIMATOR_SOURCES];         // decayed sum of share difficulty
+    float shares[SHARE_ESTIMATOR_SOURCES];              // decayed share count
+    double last_difficulty[SHARE_ESTIMATOR_SOURCES];    // bounds the estimate before the first share
+    float exposure_s;                                   // decayed time spent mining
+    int64_t last_us;                                    // 0 after a reset or pause
+} share_estimator_t;
+
+typedef struct
+{
+    float hashrate;     // GH/s
+    float low;          // 95% confidence interval, GH/s
+    float high;
+    float shares;       // effective number of shares behind it
+} share_estimate_t;
+
+void share_estimator_reset(share_estimator_t * est);
+
+// Stops counting time until the next share_estimator_advance()
+void share_estimator_pause(share_estimator_t * est);
+
+// Counts the time up to now as spent mining
+void share_estimator_advance(share_estimator_t * est, int64_t now_us);
+
+void share_estimator_add(share_estimator_t * est, share_estimator_source_t source, double difficulty, int64_t now_us);
+
+void share_estimator_get(const share_estimator_t * est, share_estimator_source_t source, share_estimate_t * estimate);
+
+#endif /* SHARE_ESTIMATOR_H_ */
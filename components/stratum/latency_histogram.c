@@ -0,0 +1,34 @@
+#include "latency_histogram.h"
+
+const float LATENCY_HISTOGRAM_BOUNDS_MS[LATENCY_HISTOGRAM_BUCKETS - 1] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000,
+};
+
+void latency_histogram_reset(latency_histogram_t * histogram)
+{
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        atomic_store(&histogram->counts[i], 0);
+    }
+    atomic_store(&histogram->sum_us, 0);
+}
+
+void latency_histogram_record(latency_histogram_t * histogram, float latency_ms)
+{
+    if (latency_ms < 0) latency_ms = 0;
+
+    int bucket = 0;
+    while (bucket < LATENCY_HISTOGRAM_BUCKETS - 1 && latency_ms > LATENCY_HISTOGRAM_BOUNDS_MS[bucket]) {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&histogram->counts[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum_us, (uint64_t)(latency_ms * 1000.0f), memory_order_relaxed);
+}
+
+double latency_histogram_read(const latency_histogram_t * histogram, uint32_t counts[LATENCY_HISTOGRAM_BUCKETS])
+{
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+    }
+    return atomic_load_explicit(&histogram->sum_us, memory_order_relaxed) / 1000.0;
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+#include <math.h>
+
+#include "share_estimator.h"
+
+// Two sided 95%
+#define Z_95 1.96
+
+// Hashes per share of difficulty 1, in GH
+#define GH_PER_DIFFICULTY (4294967296.0 / 1e9)
+
+void share_estimator_reset(share_estimator_t * est)
+{
+    memset(est, 0, sizeof(*est));
+}
+
+void share_estimator_pause(share_estimator_t * est)
+{
+    est->last_us = 0;
+}
+
+void share_estimator_advance(share_estimator_t * est, int64_t now_us)
+{
+    int64_t last_us = est->last_us;
+
+    if (last_us == 0 || now_us <= last_us) {
+        if (last_us == 0) est->last_us = now_us;
+        return;
+    }
+    est->last_us = now_us;
+
+    float decay = expf(-(now_us - last_us) / 1e6f / SHARE_ESTIMATOR_TAU_S);
+    for (int i = 0; i < SHARE_ESTIMATOR_SOURCES; i++) {
+        est->difficulty[i] *= decay;
+        est->shares[i] *= decay;
+    }
+    est->exposure_s = est->exposure_s * decay + SHARE_ESTIMATOR_TAU_S * (1 - decay);
+}
+
+void share_estimator_add(share_estimator_t * est, share_estimator_source_t source, double difficulty, int64_t now_us)
+{
+    if (source >= SHARE_ESTIMATOR_SOURCES || difficulty <= 0) {
+        return;
+    }
+
+    // a share that comes in while paused still counts, but does not restart the clock
+    if (est->last_us != 0) {
+        share_estimator_advance(est, now_us);
+    }
+
+    est->difficulty[source] += difficulty;
+    est->shares[source] += 1;
+    est->last_difficulty[source] = difficulty;
+}
+
+// Wilson-Hilferty approximation of the Poisson quantile for n events
+static double poisson_bound(double n, double z)
+{
+    if (n <= 0) return 0;
+
+    double c = fmax(1 - 1 / (9 * n) + z / (3 * sqrt(n)), 0);
+    return n * c * c * c;
+}
+
+void share_estimator_get(const share_estimator_t * est, share_estimator_source_t source, share_estimate_t * estimate)
+{
+    memset(estimate, 0, sizeof(*estimate));
+
+    if (source >= SHARE_ESTIMATOR_SOURCES || est->exposure_s <= 0) {
+        return;
+    }
+
+    double n = est->shares[source];
+    double difficulty_per_share = n > 0 ? est->difficulty[source] / n : est->last_difficulty[source];
+    double gh_per_share = difficulty_per_share * GH_PER_DIFFICULTY / est->exposure_s;
+
+    estimate->shares = n;
+    estimate->hashrate = est->difficulty[source] * GH_PER_DIFFICULTY / est->exposure_s;
+    estimate->low = poisson_bound(n, -Z_95) * gh_per_share;
+    estimate->high = poisson_bound(n + 1, Z_95) * gh_per_share;
+}
@@ -0,0 +1,28 @@
+#include "unity.h"
+#include "latency_histogram.h"
+
+TEST_CASE("Latency histogram counts into the bucket bounding the latency", "[latency_histogram]")
+{
+    latency_histogram_t histogram;
+    latency_histogram_reset(&histogram);
+
+    latency_histogram_record(&histogram, 0.5f);
+    latency_histogram_record(&histogram, 1.0f);     // bounds are inclusive
+    latency_histogram_record(&histogram, 1.5f);
+    latency_histogram_record(&histogram, 150.0f);
+    latency_histogram_record(&histogram, 60000.0f);
+    latency_histogram_record(&histogram, -3.0f);
+
+    uint32_t counts[LATENCY_HISTOGRAM_BUCKETS];
+    double sum_ms = latency_histogram_read(&histogram, counts);
+
+    TEST_ASSERT_EQUAL(3, counts[0]);
+    TEST_ASSERT_EQUAL(1, counts[1]);
+    TEST_ASSERT_EQUAL(1, counts[7]);
+    TEST_ASSERT_EQUAL(1, counts[LATENCY_HISTOGRAM_BUCKETS - 1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 60153.0, sum_ms);
+
+    latency_histogram_reset(&histogram);
+    TEST_ASSERT_EQUAL(0, latency_histogram_read(&histogram, counts));
+    TEST_ASSERT_EQUAL(0, counts[0]);
+}
@@ -0,0 +1,82 @@
+#include "unity.h"
+#include "share_estimator.h"
+
+#define SECOND_US 1000000LL
+
+// difficulty 1000 at 2^32 * 1000 / 4.294967296e12 = 1 share per second at 4.3 TH/s
+#define DIFFICULTY 1000
+#define HASHRATE (DIFFICULTY * 4.294967296)
+
+TEST_CASE("Share estimator follows a steady share rate", "[share_estimator]")
+{
+    share_estimator_t est;
+    share_estimator_reset(&est);
+
+    int64_t now_us = SECOND_US;
+    share_estimator_advance(&est, now_us);
+    for (int i = 0; i < 3600; i++) {
+        now_us += SECOND_US;
+        share_estimator_advance(&est, now_us);
+        share_estimator_add(&est, SHARE_ESTIMATOR_ACCEPTED, DIFFICULTY, now_us);
+        if (i % 2 == 0) {
+            share_estimator_add(&est, SHARE_ESTIMATOR_LOCAL, DIFFICULTY, now_us);
+        }
+    }
+
+    share_estimate_t accepted;
+    share_estimator_get(&est, SHARE_ESTIMATOR_ACCEPTED, &accepted);
+    TEST_ASSERT_FLOAT_WITHIN(HASHRATE * 0.01, HASHRATE, accepted.hashrate);
+    TEST_ASSERT_TRUE(accepted.low < accepted.hashrate && accepted.hashrate < accepted.high);
+    // some 2300 effective shares, about +-4%
+    TEST_ASSERT_TRUE(accepted.high - accepted.low < HASHRATE * 0.1);
+
+    share_estimate_t local;
+    share_estimator_get(&est, SHARE_ESTIMATOR_LOCAL, &local);
+    TEST_ASSERT_FLOAT_WITHIN(HASHRATE * 0.01, HASHRATE / 2, local.hashrate);
+}
+
+TEST_CASE("Share estimator is unsure with few shares", "[share_estimator]")
+{
+    share_estimator_t est;
+    share_estimator_reset(&est);
+
+    share_estimator_advance(&est, SECOND_US);
+    share_estimator_add(&est, SHARE_ESTIMATOR_ACCEPTED, DIFFICULTY, 2 * SECOND_US);
+    share_estimator_advance(&est, 4 * SECOND_US);
+
+    share_estimate_t estimate;
+    share_estimator_get(&est, SHARE_ESTIMATOR_ACCEPTED, &estimate);
+    TEST_ASSERT_TRUE(estimate.low < estimate.hashrate / 10);
+    TEST_ASSERT_TRUE(estimate.high > estimate.hashrate * 4);
+
+    // without a single share there is nothing to go by
+    share_estimator_get(&est, SHARE_ESTIMATOR_LOCAL, &estimate);
+    TEST_ASSERT_EQUAL_FLOAT(0, estimate.hashrate);
+    TEST_ASSERT_EQUAL_FLOAT(0, estimate.low);
+    TEST_ASSERT_EQUAL_FLOAT(0, estimate.high);
+}
+
+TEST_CASE("Share estimator skips paused time", "[share_estimator]")
+{
+    share_estimator_t est;
+    share_estimator_reset(&est);
+
+    int64_t now_us = SECOND_US;
+    share_estimator_advance(&est, now_us);
+    for (int i = 0; i < 600; i++) {
+        now_us += SECOND_US;
+        share_estimator_add(&est, SHARE_ESTIMATOR_ACCEPTED, DIFFICULTY, now_us);
+    }
+
+    share_estimate_t before;
+    share_estimator_get(&est, SHARE_ESTIMATOR_ACCEPTED, &before);
+
+    share_estimator_pause(&est);
+    now_us += 600 * SECOND_US;
+    share_estimator_advance(&est, now_us);
+
+    share_estimate_t after;
+    share_estimator_get(&est, SHARE_ESTIMATOR_ACCEPTED, &after);
+    TEST_ASSERT_EQUAL_FLOAT(before.hashrate, after.hashrate);
+    TEST_ASSERT_FLOAT_WITHIN(HASHRATE * 0.02, HASHRATE, after.hashrate);
+}
@@ -4,11 +4,15 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "asic_common.h"
+#include "job_interval.h"
+#include "core_heatmap.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/portmacro.h"
 #include "power_management_task.h"
 #include "hashrate_monitor_task.h"
+#include "autotune_task.h"
+#include "fan_controller_task.h"
 #include "serial.h"
 #include "stratum_api.h"
 #include "mining.h"
@@ -17,6 +21,8 @@
 #include "device_config.h"
 #include "display.h"
 #include "scoreboard.h"
+#include "share_estimator.h"
+#include "latency_histogram.h"
 #include "esp_transport.h"
 
 // Protocol selection (V1 = JSON-RPC, V2 = binary SV2)
@@ -34,6 +40,7 @@ struct sv2_noise_ctx;
 
 #define HISTORY_LENGTH 100
 #define DIFF_STRING_SIZE 10
+#define POOL_COUNT 2  // primary and fallback
 #define MAX_BLOCK_SIGNALS 8
 #define MAX_BLOCK_SIGNAL_LEN 16
 
@@ -45,13 +52,17 @@ typedef struct {
 typedef struct
 {
     float current_hashrate;
+    float hashrate_5s;
     float hashrate_1m;
     float hashrate_10m;
+    float hashrate_15m;
     float hashrate_1h;
+    float hashrate_24h;
     float error_percentage;
     int64_t start_time;
     uint64_t shares_accepted;
     uint64_t shares_rejected;
+    share_estimator_t share_estimators[POOL_COUNT];
     uint64_t work_received;
     RejectedReasonStat rejected_reason_stats[10];
     int rejected_reason_stats_count;
@@ -87,6 +98,8 @@ typedef struct
     float response_time;
     uint16_t response_share_batch;
     float process_time;
+    latency_histogram_t response_time_histogram;    // share submitted to the pool's answer
+    latency_histogram_t process_time_histogram;     // nonce received to share submitted
     float cpu_usage;
     bool use_fallback_stratum;
     uint16_t pool_is_tls;
@@ -127,16 +140,21 @@ typedef struct
 
 typedef struct
 {
-    // ASIC may not return the nonce in the same order as the jobs were sent
-    // it also may return a previous nonce under some circumstances
-    // so we keep a list of jobs indexed by the job id
-    bm_job **active_jobs;
     // Current job to be processed (replaces ASIC_jobs_queue)
     bm_job *current_job;
     //semaphone
     SemaphoreHandle_t semaphore;
 } AsicTaskModule;
 
+typedef struct
+{
+    asic_chain_t chain;
+    // jobs generated by create_jobs_task waiting to be written to this chain
+    work_queue job_queue;
+    // handed to the per-chain dispatch and result tasks as pvParameters
+    void * global_state;
+} AsicChainModule;
+
 typedef struct
 {
     work_queue stratum_queue;
@@ -145,16 +163,19 @@ typedef struct
     DeviceConfig DEVICE_CONFIG;
     DisplayConfig DISPLAY_CONFIG;
     AsicTaskModule ASIC_TASK_MODULE;
+    AsicChainModule ASIC_CHAINS[ASIC_MAX_CHAINS];
+    uint8_t asic_chain_count;
+    job_interval_t job_interval;
+    core_heatmap_t core_heatmap;
     PowerManagementModule POWER_MANAGEMENT_MODULE;
     SelfTestModule SELF_TEST_MODULE;
     HashrateMonitorModule HASHRATE_MONITOR_MODULE;
+    AutotuneModule AUTOTUNE_MODULE;
+    FanControllerModule FAN_CONTROLLER_MODULE;
 
     char * extranonce_str;
     int extranonce_2_len;
 
-    uint8_t * valid_jobs;
-    pthread_mutex_t valid_jobs_lock;
-
     double pool_difficulty;
     bool new_set_mining_difficulty_msg;
     uint32_t version_mask;
@@ -162,6 +183,7 @@ typedef struct
 
     esp_transport_handle_t transport;
     portMUX_TYPE stratum_mux;
+    portMUX_TYPE share_estimator_mux;
     
     // A message ID that must be unique per request that expects a response.
     // For requests not expecting a response (called notifications), this is null.
@@ -1,12 +1,16 @@
+#include <stdlib.h>
 #include <string.h>
 #include "esp_log.h"
 #include "esp_http_server.h"
+#include "esp_timer.h"
 #include "cJSON.h"
 #include "global_state.h"
 #include "asic.h"
 #include "http_server.h"
+#include "cjson_utils.h"
+#include "json_writer.h"
 
-static int system_asic_prebuffer_len = 256;
+static int system_asic_cores_prebuffer_len = 2048;
 
 // static const char *TAG = "asic_settings";
 static GlobalState *GLOBAL_STATE = NULL;
@@ -35,37 +39,115 @@ esp_err_t GET_system_asic(httpd_req_t *req)
         return ESP_OK;
     }
 
-    cJSON *root = cJSON_CreateObject();
+    const DeviceConfig *config = &GLOBAL_STATE->DEVICE_CONFIG;
+
+    char buffer[JSON_WRITER_CHUNK_SIZE];
+    json_writer_t writer;
+    json_writer_init_chunked(&writer, buffer, sizeof(buffer), req);
+
+    json_writer_object_begin(&writer);
 
     // Add ASIC model to the JSON object
-    cJSON_AddStringToObject(root, "ASICModel", GLOBAL_STATE->DEVICE_CONFIG.family.asic.name);
-    cJSON_AddStringToObject(root, "deviceModel", GLOBAL_STATE->DEVICE_CONFIG.family.name);
-    cJSON_AddStringToObject(root, "swarmColor", GLOBAL_STATE->DEVICE_CONFIG.family.swarm_color);
-    cJSON_AddNumberToObject(root, "asicCount", GLOBAL_STATE->DEVICE_CONFIG.family.asic_count);
-    cJSON_AddNumberToObject(root, "hashDomains", GLOBAL_STATE->DEVICE_CONFIG.family.asic.hash_domains);
-
-    cJSON_AddNumberToObject(root, "defaultFrequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.default_frequency_mhz);
-
-    // Create arrays for frequency and voltage options based on ASIC model
-    cJSON *freqOptions = cJSON_CreateArray();
-    size_t count = 0;
-    while (GLOBAL_STATE->DEVICE_CONFIG.family.asic.frequency_options[count] != 0) {
-        cJSON_AddItemToArray(freqOptions, cJSON_CreateNumber(GLOBAL_STATE->DEVICE_CONFIG.family.asic.frequency_options[count]));
-        count++;
+    json_writer_add_string(&writer, "ASICModel", config->family.asic.name);
+    json_writer_add_string(&writer, "deviceModel", config->family.name);
+    json_writer_add_string(&writer, "swarmColor", config->family.swarm_color);
+    json_writer_add_number(&writer, "asicCount", config->family.asic_count);
+    json_writer_add_number(&writer, "hashDomains", config->family.asic.hash_domains);
+
+    json_writer_add_number(&writer, "defaultFrequency", config->family.asic.default_frequency_mhz);
+
+    // Arrays for frequency and voltage options based on ASIC model
+    json_writer_key(&writer, "frequencyOptions");
+    json_writer_array_begin(&writer);
+    for (size_t i = 0; config->family.asic.frequency_options[i] != 0; i++) {
+        json_writer_number(&writer, config->family.asic.frequency_options[i]);
+    }
+    json_writer_array_end(&writer);
+
+    json_writer_add_number(&writer, "defaultVoltage", config->family.asic.default_voltage_mv);
+
+    json_writer_key(&writer, "voltageOptions");
+    json_writer_array_begin(&writer);
+    for (size_t i = 0; config->family.asic.voltage_options[i] != 0; i++) {
+        json_writer_number(&writer, config->family.asic.voltage_options[i]);
+    }
+    json_writer_array_end(&writer);
+
+    json_writer_object_end(&writer);
+
+    return json_writer_finish(&writer);
+}
+
+static void add_flagged(cJSON *flagged, const char *key, int index, const uint16_t *counts, const uint8_t *health)
+{
+    if (health[index] != CORE_WEAK && health[index] != CORE_DEAD) return;
+
+    cJSON *entry = cJSON_CreateObject();
+    cJSON_AddNumberToObject(entry, key, index);
+    cJSON_AddStringToObject(entry, "health", core_heatmap_health_to_string(health[index]));
+    cJSON_AddNumberToObject(entry, "nonces", counts[index]);
+    cJSON_AddItemToArray(flagged, entry);
+}
+
+/* Handler for the per core nonce heatmap */
+esp_err_t GET_system_asic_cores(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
-    cJSON_AddItemToObject(root, "frequencyOptions", freqOptions);
 
-    cJSON_AddNumberToObject(root, "defaultVoltage", GLOBAL_STATE->DEVICE_CONFIG.family.asic.default_voltage_mv);
+    httpd_resp_set_type(req, "application/json");
 
-    cJSON *voltageOptions = cJSON_CreateArray();
-    count = 0;
-    while (GLOBAL_STATE->DEVICE_CONFIG.family.asic.voltage_options[count] != 0) {
-        cJSON_AddItemToArray(voltageOptions, cJSON_CreateNumber(GLOBAL_STATE->DEVICE_CONFIG.family.asic.voltage_options[count]));
-        count++;
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    core_heatmap_t *heatmap = &GLOBAL_STATE->core_heatmap;
+    core_heatmap_chip_t *chip = malloc(sizeof(core_heatmap_chip_t));
+    if (chip == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "coreCount", heatmap->core_count);
+    cJSON_AddNumberToObject(root, "smallCoreCount", heatmap->small_core_count);
+    cJSON_AddNumberToObject(root, "halfLife", CORE_HEATMAP_HALF_LIFE_US / 1000000);
+    cJSON_AddNumberToObject(root, "dropped", heatmap->dropped);
+
+    cJSON *asics = cJSON_AddArrayToObject(root, "asics");
+    int64_t now_us = esp_timer_get_time();
+    for (int asic_nr = 0; asic_nr < heatmap->chip_count; asic_nr++) {
+        if (core_heatmap_get_chip(heatmap, asic_nr, now_us, chip) != ESP_OK) break;
+
+        cJSON *asic = cJSON_CreateObject();
+        cJSON_AddNumberToObject(asic, "total", chip->total);
+        cJSON_AddFloatToObject(asic, "expected", chip->expected);
+        cJSON_AddFloatToObject(asic, "chiSquare", chip->chi_square);
+        cJSON_AddFloatToObject(asic, "chiSquareLimit", chip->chi_square_limit);
+        cJSON_AddNumberToObject(asic, "weakCores", chip->weak_cores);
+        cJSON_AddNumberToObject(asic, "deadCores", chip->dead_cores);
+
+        cJSON *cores = cJSON_AddArrayToObject(asic, "cores");
+        cJSON *flagged = cJSON_AddArrayToObject(asic, "flagged");
+        for (int core = 0; core < heatmap->core_count; core++) {
+            cJSON_AddItemToArray(cores, cJSON_CreateNumber(chip->cores[core]));
+            add_flagged(flagged, "core", core, chip->cores, chip->core_health);
+        }
+
+        cJSON *small_cores = cJSON_AddArrayToObject(asic, "smallCores");
+        for (int small_core = 0; small_core < heatmap->small_core_count; small_core++) {
+            cJSON_AddItemToArray(small_cores, cJSON_CreateNumber(chip->small_cores[small_core]));
+            add_flagged(flagged, "smallCore", small_core, chip->small_cores, chip->small_core_health);
+        }
+
+        cJSON_AddItemToArray(asics, asic);
     }
-    cJSON_AddItemToObject(root, "voltageOptions", voltageOptions);
+    free(chip);
 
-    esp_err_t res = HTTP_send_json(req, root, &system_asic_prebuffer_len);
+    esp_err_t res = HTTP_send_json(req, root, &system_asic_cores_prebuffer_len);
 
     cJSON_Delete(root);
 
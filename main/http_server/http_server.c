@@ -1,6 +1,7 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <string.h>
+#include <stdlib.h>
 #include <limits.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -28,7 +29,9 @@
 #include "nvs_config.h"
 #include "connect.h"
 #include "statistics_task.h"
+#include "statistics_stream.h"
 #include "theme_api.h"
+#include "log_levels_api.h"
 #include "axe-os/api/system/asic_settings.h"
 #include "display.h"
 #include "http_server.h"
@@ -36,6 +39,8 @@
 #include "websocket_log.h"
 #include "websocket_api.h"
 #include "system_api_json.h"
+#include "metrics.h"
+#include "json_writer.h"
 #include "log_buffer.h"
 #include "cjson_utils.h"
 #include "utils.h"
@@ -43,31 +48,11 @@
 static const char * TAG = "http_server";
 static const char * CORS_TAG = "CORS";
 
-static const char * STATS_LABEL_HASHRATE = "hashrate";
-static const char * STATS_LABEL_HASHRATE_1m = "hashrate_1m";
-static const char * STATS_LABEL_HASHRATE_10m = "hashrate_10m";
-static const char * STATS_LABEL_HASHRATE_1h = "hashrate_1h";
-static const char * STATS_LABEL_ERROR_PERCENTAGE = "errorPercentage";
-static const char * STATS_LABEL_TIMESTAMP = "timestamp";
-static const char * STATS_LABEL_ASIC_TEMP = "asicTemp";
-static const char * STATS_LABEL_ASIC_TEMP2 = "asicTemp2";
-static const char * STATS_LABEL_VR_TEMP = "vrTemp";
-static const char * STATS_LABEL_ASIC_VOLTAGE = "asicVoltage";
-static const char * STATS_LABEL_VOLTAGE = "voltage";
-static const char * STATS_LABEL_POWER = "power";
-static const char * STATS_LABEL_CURRENT = "current";
-static const char * STATS_LABEL_FAN_SPEED = "fanSpeed";
-static const char * STATS_LABEL_FAN_RPM = "fanRpm";
-static const char * STATS_LABEL_FAN2_RPM = "fan2Rpm";
-static const char * STATS_LABEL_WIFI_RSSI = "wifiRssi";
-static const char * STATS_LABEL_FREE_HEAP = "freeHeap";
-static const char * STATS_LABEL_RESPONSE_TIME = "responseTime";
-
-static int system_info_prebuffer_len = 256;
-static int system_statistics_prebuffer_len = 256;
 static int system_wifi_scan_prebuffer_len = 256;
+static int telemetry_schema_prebuffer_len = 256;
 static int api_common_prebuffer_len = 256;
 
+// Same order as the statistics history columns
 typedef enum
 {
     SRC_HASHRATE,
@@ -90,28 +75,35 @@ typedef enum
     SRC_RESPONSE_TIME,
     SRC_NONE // last
 } DataSource;
+_Static_assert((int)SRC_NONE == (int)STATISTICS_FIELD_COUNT, "DataSource must match StatisticsField");
+
+static const char * const STATS_LABELS[SRC_NONE] = {
+    [SRC_HASHRATE] = "hashrate",
+    [SRC_HASHRATE_1m] = "hashrate_1m",
+    [SRC_HASHRATE_10m] = "hashrate_10m",
+    [SRC_HASHRATE_1h] = "hashrate_1h",
+    [SRC_ERROR_PERCENTAGE] = "errorPercentage",
+    [SRC_ASIC_TEMP] = "asicTemp",
+    [SRC_ASIC_TEMP2] = "asicTemp2",
+    [SRC_VR_TEMP] = "vrTemp",
+    [SRC_ASIC_VOLTAGE] = "asicVoltage",
+    [SRC_VOLTAGE] = "voltage",
+    [SRC_POWER] = "power",
+    [SRC_CURRENT] = "current",
+    [SRC_FAN_SPEED] = "fanSpeed",
+    [SRC_FAN_RPM] = "fanRpm",
+    [SRC_FAN2_RPM] = "fan2Rpm",
+    [SRC_WIFI_RSSI] = "wifiRssi",
+    [SRC_FREE_HEAP] = "freeHeap",
+    [SRC_RESPONSE_TIME] = "responseTime",
+};
 
 DataSource strToDataSource(const char * sourceStr)
 {
     if (NULL != sourceStr) {
-        if (strcmp(sourceStr, STATS_LABEL_HASHRATE) == 0)     return SRC_HASHRATE;
-        if (strcmp(sourceStr, STATS_LABEL_HASHRATE_1m) == 0)  return SRC_HASHRATE_1m;
-        if (strcmp(sourceStr, STATS_LABEL_HASHRATE_10m) == 0) return SRC_HASHRATE_10m;
-        if (strcmp(sourceStr, STATS_LABEL_HASHRATE_1h) == 0)  return SRC_HASHRATE_1h;
-        if (strcmp(sourceStr, STATS_LABEL_ERROR_PERCENTAGE) == 0)  return SRC_ERROR_PERCENTAGE;
-        if (strcmp(sourceStr, STATS_LABEL_VOLTAGE) == 0)      return SRC_VOLTAGE;
-        if (strcmp(sourceStr, STATS_LABEL_POWER) == 0)        return SRC_POWER;
-        if (strcmp(sourceStr, STATS_LABEL_CURRENT) == 0)      return SRC_CURRENT;
-        if (strcmp(sourceStr, STATS_LABEL_ASIC_TEMP) == 0)    return SRC_ASIC_TEMP;
-        if (strcmp(sourceStr, STATS_LABEL_ASIC_TEMP2) == 0)   return SRC_ASIC_TEMP2;
-        if (strcmp(sourceStr, STATS_LABEL_VR_TEMP) == 0)      return SRC_VR_TEMP;
-        if (strcmp(sourceStr, STATS_LABEL_ASIC_VOLTAGE) == 0) return SRC_ASIC_VOLTAGE;
-        if (strcmp(sourceStr, STATS_LABEL_FAN_SPEED) == 0)    return SRC_FAN_SPEED;
-        if (strcmp(sourceStr, STATS_LABEL_FAN_RPM) == 0)      return SRC_FAN_RPM;
-        if (strcmp(sourceStr, STATS_LABEL_FAN2_RPM) == 0)     return SRC_FAN2_RPM;
-        if (strcmp(sourceStr, STATS_LABEL_WIFI_RSSI) == 0)    return SRC_WIFI_RSSI;
-        if (strcmp(sourceStr, STATS_LABEL_FREE_HEAP) == 0)    return SRC_FREE_HEAP;
-        if (strcmp(sourceStr, STATS_LABEL_RESPONSE_TIME) == 0) return SRC_RESPONSE_TIME;
+        for (int i = 0; i < SRC_NONE; i++) {
+            if (strcmp(sourceStr, STATS_LABELS[i]) == 0) return i;
+        }
     }
     return SRC_NONE;
 }
@@ -739,6 +731,8 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
         }
     }
 
+    websocket_api_mark_dirty();
+
     cJSON_Delete(root);
     httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
@@ -907,6 +901,88 @@ static esp_err_t POST_mining_resume(httpd_req_t * req)
     return res;
 }
 
+static esp_err_t POST_autotune_start(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    if (autotune_task_start(GLOBAL_STATE) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Autotune already running or mining not active");
+    }
+    ESP_LOGI(TAG, "Autotune started by API request");
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON * resp = cJSON_CreateObject();
+    if (resp == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Internal error");
+        return ESP_OK;
+    }
+    cJSON_AddStringToObject(resp, "message", "Autotune started");
+    esp_err_t res = HTTP_send_json(req, resp, &api_common_prebuffer_len);
+    cJSON_Delete(resp);
+    return res;
+}
+
+static esp_err_t POST_autotune_stop(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    autotune_task_stop(GLOBAL_STATE);
+    ESP_LOGI(TAG, "Autotune stopped by API request");
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON * resp = cJSON_CreateObject();
+    if (resp == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Internal error");
+        return ESP_OK;
+    }
+    cJSON_AddStringToObject(resp, "message", "Autotune stopped");
+    esp_err_t res = HTTP_send_json(req, resp, &api_common_prebuffer_len);
+    cJSON_Delete(resp);
+    return res;
+}
+
+static esp_err_t POST_fan_autotune(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    if (FAN_CONTROLLER_autotune_start(GLOBAL_STATE) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Fan autotune already running or fan not on auto");
+    }
+    ESP_LOGI(TAG, "Fan autotune started by API request");
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON * resp = cJSON_CreateObject();
+    if (resp == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Internal error");
+        return ESP_OK;
+    }
+    cJSON_AddStringToObject(resp, "message", "Fan autotune started");
+    esp_err_t res = HTTP_send_json(req, resp, &api_common_prebuffer_len);
+    cJSON_Delete(resp);
+    return res;
+}
+
 /* Simple handler for getting system handler */
 static esp_err_t GET_system_info(httpd_req_t * req)
 {
@@ -922,22 +998,116 @@ static esp_err_t GET_system_info(httpd_req_t * req)
         return ESP_OK;
     }
 
-    cJSON * root = system_api_get_full_json(GLOBAL_STATE);
+    char buffer[JSON_WRITER_CHUNK_SIZE];
+    json_writer_t writer;
+    json_writer_init_chunked(&writer, buffer, sizeof(buffer), req);
+
+    system_api_write_json(GLOBAL_STATE, &writer);
+
+    return json_writer_finish(&writer);
+}
+
+#ifdef CONFIG_ENABLE_TASK_MONITOR
+static esp_err_t GET_system_tasks(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    char buffer[JSON_WRITER_CHUNK_SIZE];
+    json_writer_t writer;
+    json_writer_init_chunked(&writer, buffer, sizeof(buffer), req);
+
+    system_api_write_tasks(GLOBAL_STATE, &writer);
+
+    return json_writer_finish(&writer);
+}
+#endif
+
+static esp_err_t GET_telemetry_schema(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    // The ids the binary websocket feed uses instead of the names
+    cJSON * root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "subprotocol", WEBSOCKET_API_CBOR_SUBPROTOCOL);
+    cJSON_AddStringToObject(root, "version", GLOBAL_STATE->SYSTEM_MODULE.version ? GLOBAL_STATE->SYSTEM_MODULE.version : "Unknown");
+
+    cJSON * fields = cJSON_AddArrayToObject(root, "fields");
+    for (int i = 0; i < SYSTEM_API_FIELD_COUNT; i++) {
+        cJSON * field = cJSON_CreateObject();
+        cJSON_AddNumberToObject(field, "id", i);
+        cJSON_AddStringToObject(field, "name", SYSTEM_API_FIELDS[i].name);
+        cJSON_AddStringToObject(field, "type", telemetry_type_to_string(SYSTEM_API_FIELDS[i].type));
+        cJSON_AddItemToArray(fields, field);
+    }
 
-    esp_err_t res = HTTP_send_json(req, root, &system_info_prebuffer_len);
+    esp_err_t res = HTTP_send_json(req, root, &telemetry_schema_prebuffer_len);
 
     cJSON_Delete(root);
 
     return res;
 }
 
-static esp_err_t GET_system_statistics(httpd_req_t * req)
+static esp_err_t GET_metrics(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
         return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
 
-    httpd_resp_set_type(req, "application/json");
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    return metrics_send(req, GLOBAL_STATE);
+}
+
+typedef struct
+{
+    statistics_stream_t * stream;
+    const bool * dataSelection;
+} StatisticsRows;
+
+static void add_statistics_row(const struct StatisticsData * statsData, void * context)
+{
+    StatisticsRows * rows = context;
+    float values[SRC_NONE];
+    int count = 0;
+
+    for (int i = 0; i < SRC_NONE; i++) {
+        if (rows->dataSelection[i]) {
+            values[count++] = getStatisticValue(statsData, i);
+        }
+    }
+
+    statistics_stream_row(rows->stream, values, count, statsData->timestamp);
+}
+
+static esp_err_t GET_system_statistics(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
 
     // Set CORS headers
     if (set_cors_headers(req) != ESP_OK) {
@@ -948,6 +1118,12 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
     size_t bufLen = httpd_req_get_url_query_len(req) + 1;
     bool dataSelection[SRC_NONE] = {false};
     bool selectionCheck = false;
+    // by default as far back as the configured frequency used to reach
+    uint32_t window = (uint32_t)MAX_STATISTICS_COUNT * nvs_config_get_u16(NVS_CONFIG_STATISTICS_FREQUENCY);
+    StatisticsConsolidation consolidation = STATISTICS_AVG;
+    statistics_format_t format = STATISTICS_FORMAT_JSON;
+    bool incremental = false;
+    uint64_t since = 0;
 
     // Check query parameters
     if (1 < bufLen) {
@@ -967,6 +1143,25 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
                     param = strtok(NULL, ",");
                 }
             }
+            char param[24];
+            if (httpd_query_key_value(buf, "window", param, sizeof(param)) == ESP_OK) {
+                window = strtoul(param, NULL, 10);
+            }
+            if (httpd_query_key_value(buf, "consolidation", param, sizeof(param)) == ESP_OK) {
+                if (strcmp(param, "min") == 0) {
+                    consolidation = STATISTICS_MIN;
+                } else if (strcmp(param, "max") == 0) {
+                    consolidation = STATISTICS_MAX;
+                }
+            }
+            if (httpd_query_key_value(buf, "format", param, sizeof(param)) == ESP_OK) {
+                format = statistics_format_from_string(param);
+            }
+            // only the points after the last one the client has
+            if (httpd_query_key_value(buf, "since", param, sizeof(param)) == ESP_OK) {
+                since = strtoull(param, NULL, 10) + 1;
+                incremental = true;
+            }
         }
     }
 
@@ -977,69 +1172,51 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
         }
     }
 
-    // Create object for statistics
-    cJSON * root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "currentTimestamp", (esp_timer_get_time() / 1000));
-
-    cJSON * labelArray = cJSON_CreateArray();
-    if (dataSelection[SRC_HASHRATE]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_HASHRATE)); }
-    if (dataSelection[SRC_HASHRATE_1m]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_HASHRATE_1m)); }
-    if (dataSelection[SRC_HASHRATE_10m]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_HASHRATE_10m)); }
-    if (dataSelection[SRC_HASHRATE_1h]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_HASHRATE_1h)); }
-    if (dataSelection[SRC_ERROR_PERCENTAGE]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_ERROR_PERCENTAGE)); }
-    if (dataSelection[SRC_ASIC_TEMP]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_ASIC_TEMP)); }
-    if (dataSelection[SRC_ASIC_TEMP2]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_ASIC_TEMP2)); }
-    if (dataSelection[SRC_VR_TEMP]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_VR_TEMP)); }
-    if (dataSelection[SRC_ASIC_VOLTAGE]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_ASIC_VOLTAGE)); }
-    if (dataSelection[SRC_VOLTAGE]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_VOLTAGE)); }
-    if (dataSelection[SRC_POWER]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_POWER)); }
-    if (dataSelection[SRC_CURRENT]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_CURRENT)); }
-    if (dataSelection[SRC_FAN_SPEED]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_FAN_SPEED)); }
-    if (dataSelection[SRC_FAN_RPM]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_FAN_RPM)); }
-    if (dataSelection[SRC_FAN2_RPM]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_FAN2_RPM)); }
-    if (dataSelection[SRC_WIFI_RSSI]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_WIFI_RSSI)); }
-    if (dataSelection[SRC_FREE_HEAP]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_FREE_HEAP)); }
-    if (dataSelection[SRC_RESPONSE_TIME]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_RESPONSE_TIME)); }
-    cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_TIMESTAMP));
-
-    cJSON_AddItemToObject(root, "labels", labelArray);
-
-    cJSON * statsArray = cJSON_AddArrayToObject(root, "statistics");
-    struct StatisticsData statsData;
-    uint16_t index = 0;
-
-    while (getStatisticData(index++, &statsData)) {
-        cJSON * valueArray = cJSON_CreateArray();
-        if (dataSelection[SRC_HASHRATE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate)); }
-        if (dataSelection[SRC_HASHRATE_1m]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate_1m)); }
-        if (dataSelection[SRC_HASHRATE_10m]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate_10m)); }
-        if (dataSelection[SRC_HASHRATE_1h]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate_1h)); }
-        if (dataSelection[SRC_ERROR_PERCENTAGE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.errorPercentage)); }
-        if (dataSelection[SRC_ASIC_TEMP]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.chipTemperature)); }
-        if (dataSelection[SRC_ASIC_TEMP2]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.chipTemperature2)); }
-        if (dataSelection[SRC_VR_TEMP]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.vrTemperature)); }
-        if (dataSelection[SRC_ASIC_VOLTAGE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.coreVoltageActual)); }
-        if (dataSelection[SRC_VOLTAGE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.voltage)); }
-        if (dataSelection[SRC_POWER]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.power)); }
-        if (dataSelection[SRC_CURRENT]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.current)); }
-        if (dataSelection[SRC_FAN_SPEED]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.fanSpeed)); }
-        if (dataSelection[SRC_FAN_RPM]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.fanRPM)); }
-        if (dataSelection[SRC_FAN2_RPM]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.fan2RPM)); }
-        if (dataSelection[SRC_WIFI_RSSI]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.wifiRSSI)); }
-        if (dataSelection[SRC_FREE_HEAP]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.freeHeap)); }
-        if (dataSelection[SRC_RESPONSE_TIME]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.responseTime)); }
-        cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.timestamp));
-
-        cJSON_AddItemToArray(statsArray, valueArray);
-    }
-
-    esp_err_t res = HTTP_send_json(req, root, &system_statistics_prebuffer_len);
+    const char * labels[SRC_NONE];
+    int labelCount = 0;
+    for (int i = 0; i < SRC_NONE; i++) {
+        if (dataSelection[i]) {
+            labels[labelCount++] = STATS_LABELS[i];
+        }
+    }
 
-    cJSON_Delete(root);
+    uint8_t tier = getStatisticTier(window);
+    uint64_t currentTimestamp = esp_timer_get_time() / 1000;
+    uint64_t window_ms = (uint64_t)window * 1000;
+    if (!incremental) {
+        since = currentTimestamp > window_ms ? currentTimestamp - window_ms : 0;
+    }
+
+    statistics_stream_t * stream = malloc(sizeof(statistics_stream_t));
+    if (NULL == stream) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    statistics_stream_begin(stream, req, format, currentTimestamp, getStatisticTierInterval(tier), labels, labelCount);
+
+    StatisticsRows rows = {
+        .stream = stream,
+        .dataSelection = dataSelection,
+    };
+    readStatisticData(tier, consolidation, dataSelection, since, add_statistics_row, &rows);
+
+    esp_err_t res = statistics_stream_end(stream);
+    free(stream);
 
     return res;
 }
 
+typedef struct
+{
+    double difficulty;
+    char job_id[32];
+    char extranonce2[32];
+    uint32_t ntime;
+    uint32_t nonce;
+    uint32_t version_bits;
+} ScoreboardRow;
+
 static esp_err_t GET_scoreboard(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -1054,42 +1231,54 @@ static esp_err_t GET_scoreboard(httpd_req_t * req)
         return ESP_OK;
     }
 
+    // Copied out, so a slow client does not hold up the shares
     Scoreboard *scoreboard = &GLOBAL_STATE->SYSTEM_MODULE.scoreboard;
-    cJSON * root = cJSON_CreateArray();
+    ScoreboardRow rows[MAX_SCOREBOARD];
+    int count = 0;
 
     if (xSemaphoreTake(scoreboard->mutex, portMAX_DELAY) == pdTRUE) {
-        for (int i = 0; i < scoreboard->count; i++) {
-            const ScoreboardEntry *e = &scoreboard->entries[i];
-            cJSON *entry = cJSON_CreateObject();
-
-            char nonce_str[9], version_bits_str[9];
-            snprintf(nonce_str, sizeof(nonce_str), "%08X", (unsigned int)e->nonce);
-            snprintf(version_bits_str, sizeof(version_bits_str), "%08X", (unsigned int)e->version_bits);
-
-            cJSON_AddNumberToObject(entry, "difficulty", e->difficulty);
-            cJSON_AddStringToObject(entry, "job_id", e->job_id);
-            cJSON_AddStringToObject(entry, "extranonce2", e->extranonce2);
-            cJSON_AddNumberToObject(entry, "ntime", e->ntime);
-            cJSON_AddStringToObject(entry, "nonce", nonce_str);
-            cJSON_AddStringToObject(entry, "version_bits", version_bits_str);
-
-            cJSON_AddItemToArray(root, entry);
+        for (count = 0; count < scoreboard->count; count++) {
+            const ScoreboardEntry *e = &scoreboard->entries[count];
+            ScoreboardRow *row = &rows[count];
+
+            row->difficulty = e->difficulty;
+            strlcpy(row->job_id, e->job_id, sizeof(row->job_id));
+            strlcpy(row->extranonce2, e->extranonce2, sizeof(row->extranonce2));
+            row->ntime = e->ntime;
+            row->nonce = e->nonce;
+            row->version_bits = e->version_bits;
         }
         xSemaphoreGive(scoreboard->mutex);
     } else {
         ESP_LOGE(TAG, "Failed to take mutex for JSON conversion");
-        cJSON_Delete(root);
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to take mutex for JSON conversion");
         return ESP_OK;
     }
 
-    const char *response = cJSON_Print(root);
-    httpd_resp_sendstr(req, response);
+    char buffer[JSON_WRITER_CHUNK_SIZE];
+    json_writer_t writer;
+    json_writer_init_chunked(&writer, buffer, sizeof(buffer), req);
 
-    free((void *)response);
-    cJSON_Delete(root);
+    json_writer_array_begin(&writer);
+    for (int i = 0; i < count; i++) {
+        const ScoreboardRow *row = &rows[i];
 
-    return ESP_OK;
+        char nonce_str[9], version_bits_str[9];
+        snprintf(nonce_str, sizeof(nonce_str), "%08X", (unsigned int)row->nonce);
+        snprintf(version_bits_str, sizeof(version_bits_str), "%08X", (unsigned int)row->version_bits);
+
+        json_writer_object_begin(&writer);
+        json_writer_add_number(&writer, "difficulty", row->difficulty);
+        json_writer_add_string(&writer, "job_id", row->job_id);
+        json_writer_add_string(&writer, "extranonce2", row->extranonce2);
+        json_writer_add_number(&writer, "ntime", row->ntime);
+        json_writer_add_string(&writer, "nonce", nonce_str);
+        json_writer_add_string(&writer, "version_bits", version_bits_str);
+        json_writer_object_end(&writer);
+    }
+    json_writer_array_end(&writer);
+
+    return json_writer_finish(&writer);
 }
 
 esp_err_t POST_WWW_update(httpd_req_t * req)
@@ -1285,7 +1474,7 @@ esp_err_t start_rest_server(void * pvParameters)
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.stack_size = 8192;
     config.max_open_sockets = 20;
-    config.max_uri_handlers = 25;
+    config.max_uri_handlers = 33;
     config.close_fn = websocket_close_fn;
     config.lru_purge_enable = true;
 
@@ -1314,6 +1503,9 @@ esp_err_t start_rest_server(void * pvParameters)
     // Register theme API endpoints
     ESP_ERROR_CHECK(register_theme_api_endpoints(server, rest_context));
 
+    // Register log level API endpoints
+    ESP_ERROR_CHECK(register_log_levels_api_endpoints(server, rest_context));
+
     /* URI handler for fetching system info */
     httpd_uri_t system_info_get_uri = {
         .uri = "/api/system/info", 
@@ -1332,6 +1524,44 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &system_asic_get_uri);
 
+    /* URI handler for fetching the per core nonce heatmap */
+    httpd_uri_t system_asic_cores_get_uri = {
+        .uri = "/api/system/asic/cores", 
+        .method = HTTP_GET, 
+        .handler = GET_system_asic_cores, 
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_asic_cores_get_uri);
+
+#ifdef CONFIG_ENABLE_TASK_MONITOR
+    /* URI handler for fetching the CPU, stack and latency of the tasks */
+    httpd_uri_t system_tasks_get_uri = {
+        .uri = "/api/system/tasks", 
+        .method = HTTP_GET, 
+        .handler = GET_system_tasks, 
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_tasks_get_uri);
+#endif
+
+    /* URI handler for fetching the field ids of the binary live feed */
+    httpd_uri_t telemetry_schema_get_uri = {
+        .uri = "/api/system/telemetry/schema", 
+        .method = HTTP_GET, 
+        .handler = GET_telemetry_schema, 
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &telemetry_schema_get_uri);
+
+    /* URI handler for scraping the OpenMetrics exposition */
+    httpd_uri_t metrics_get_uri = {
+        .uri = "/metrics", 
+        .method = HTTP_GET, 
+        .handler = GET_metrics, 
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &metrics_get_uri);
+
     /* URI handler for fetching system statistic values */
     httpd_uri_t system_statistics_get_uri = {
         .uri = "/api/system/statistics", 
@@ -1397,6 +1627,30 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &system_mining_resume_uri);
 
+    httpd_uri_t system_autotune_start_uri = {
+        .uri = "/api/system/autotune/start",
+        .method = HTTP_POST,
+        .handler = POST_autotune_start,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_autotune_start_uri);
+
+    httpd_uri_t system_autotune_stop_uri = {
+        .uri = "/api/system/autotune/stop",
+        .method = HTTP_POST,
+        .handler = POST_autotune_stop,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_autotune_stop_uri);
+
+    httpd_uri_t system_fan_autotune_uri = {
+        .uri = "/api/system/fan/autotune",
+        .method = HTTP_POST,
+        .handler = POST_fan_autotune,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_fan_autotune_uri);
+
     httpd_uri_t system_dismiss_block_found_uri = {
         .uri = "/api/system/blockFound/dismiss",
         .method = HTTP_POST, 
@@ -1443,7 +1697,8 @@ esp_err_t start_rest_server(void * pvParameters)
         .method = HTTP_GET, 
         .handler = websocket_handler, 
         .user_ctx = (void *)WS_TYPE_API, 
-        .is_websocket = true
+        .is_websocket = true,
+        .supported_subprotocol = WEBSOCKET_API_CBOR_SUBPROTOCOL
     };
     httpd_register_uri_handler(server, &ws_live);
 
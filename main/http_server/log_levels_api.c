@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "log_levels_api.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "http_server.h"
+#include "json_writer.h"
+#include "log_buffer.h"
+
+static const char * TAG = "log_levels_api";
+
+// By esp_log_level_t
+static const char * const LEVEL_NAMES[] = { "none", "error", "warn", "info", "debug", "verbose" };
+
+static esp_err_t set_cors_headers(httpd_req_t *req)
+{
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "GET, PATCH, OPTIONS");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type");
+    return ESP_OK;
+}
+
+static int parse_level(const cJSON * item)
+{
+    if (cJSON_IsNull(item)) {
+        return LOG_LEVEL_UNSET;
+    }
+    if (cJSON_IsString(item)) {
+        for (int level = ESP_LOG_NONE; level <= ESP_LOG_VERBOSE; level++) {
+            if (0 == strcmp(item->valuestring, LEVEL_NAMES[level])) {
+                return level;
+            }
+        }
+    }
+    return LOG_LEVEL_UNSET - 1;
+}
+
+// GET /api/system/loglevels handler
+static esp_err_t log_levels_get_handler(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    set_cors_headers(req);
+
+    char buffer[JSON_WRITER_CHUNK_SIZE];
+    json_writer_t w;
+    json_writer_init_chunked(&w, buffer, sizeof(buffer), req);
+
+    json_writer_object_begin(&w);
+    json_writer_add_string(&w, "default", LEVEL_NAMES[log_levels_get_default()]);
+    json_writer_key(&w, "tags");
+    json_writer_object_begin(&w);
+    const char * tag;
+    int level;
+    for (size_t i = 0; log_levels_get_at(i, &tag, &level); i++) {
+        if (LOG_LEVEL_UNSET != level) {
+            json_writer_add_string(&w, tag, LEVEL_NAMES[level]);
+        }
+    }
+    json_writer_object_end(&w);
+    json_writer_object_end(&w);
+
+    return json_writer_finish(&w);
+}
+
+// PATCH /api/system/loglevels handler
+static esp_err_t log_levels_patch_handler(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    set_cors_headers(req);
+
+    char content[1024];
+    if (req->content_len >= sizeof(content)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Content too long");
+    }
+    int received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, content + received, req->content_len - received);
+        if (ret <= 0) {
+            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read request");
+        }
+        received += ret;
+    }
+    content[received] = '\0';
+
+    cJSON *root = cJSON_Parse(content);
+    if (!cJSON_IsObject(root)) {
+        cJSON_Delete(root);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+
+    // check everything first, so a bad request changes nothing
+    cJSON *default_level = cJSON_GetObjectItem(root, "default");
+    cJSON *tags = cJSON_GetObjectItem(root, "tags");
+    bool valid = (!default_level || parse_level(default_level) >= LOG_LEVEL_UNSET)
+                 && (!tags || cJSON_IsObject(tags));
+    cJSON *item;
+    cJSON_ArrayForEach(item, tags) {
+        valid = valid && parse_level(item) >= LOG_LEVEL_UNSET
+                && item->string[0] && strlen(item->string) < LOG_LEVELS_TAG_MAX && !strpbrk(item->string, ":,");
+    }
+    if (!valid) {
+        cJSON_Delete(root);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Wrong API input");
+    }
+
+    esp_err_t err = ESP_OK;
+    if (default_level) {
+        err = log_buffer_set_level("*", parse_level(default_level));
+    }
+    cJSON_ArrayForEach(item, tags) {
+        if (err == ESP_OK) {
+            err = log_buffer_set_level(item->string, parse_level(item));
+        }
+    }
+    log_buffer_save_levels();
+    cJSON_Delete(root);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set log levels: %s", esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, err == ESP_ERR_NO_MEM ? "Too many tags" : "Wrong API input");
+    }
+
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+esp_err_t register_log_levels_api_endpoints(httpd_handle_t server, void* ctx)
+{
+    httpd_uri_t log_levels_get = {
+        .uri = "/api/system/loglevels",
+        .method = HTTP_GET,
+        .handler = log_levels_get_handler,
+        .user_ctx = ctx
+    };
+
+    httpd_uri_t log_levels_patch = {
+        .uri = "/api/system/loglevels",
+        .method = HTTP_PATCH,
+        .handler = log_levels_patch_handler,
+        .user_ctx = ctx
+    };
+
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &log_levels_get));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &log_levels_patch));
+
+    return ESP_OK;
+}
@@ -0,0 +1,9 @@
+#ifndef LOG_LEVELS_API_H
+#define LOG_LEVELS_API_H
+
+#include "esp_http_server.h"
+
+// GET and PATCH /api/system/loglevels, the per tag log levels
+esp_err_t register_log_levels_api_endpoints(httpd_handle_t server, void* ctx);
+
+#endif // LOG_LEVELS_API_H
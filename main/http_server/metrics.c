@@ -0,0 +1,385 @@
+#include <string.h>
+#include <math.h>
+
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "connect.h"
+#include "metrics.h"
+#include "json_writer.h"
+
+#define PREFIX "espminer_"
+
+typedef struct
+{
+    httpd_req_t * req;
+    esp_err_t err;
+    size_t length;
+    bool labels;        // a label set is open on the current sample
+    char buffer[METRICS_BUFFER];
+} metrics_writer_t;
+
+static void flush(metrics_writer_t * w)
+{
+    if (ESP_OK == w->err && 0 != w->length) {
+        w->err = httpd_resp_send_chunk(w->req, w->buffer, w->length);
+    }
+    w->length = 0;
+}
+
+static void write_bytes(metrics_writer_t * w, const char * data, size_t length)
+{
+    while (0 != length) {
+        if (METRICS_BUFFER == w->length) {
+            flush(w);
+        }
+        size_t room = METRICS_BUFFER - w->length;
+        size_t part = length < room ? length : room;
+
+        memcpy(w->buffer + w->length, data, part);
+        w->length += part;
+        data += part;
+        length -= part;
+    }
+}
+
+static void write_string(metrics_writer_t * w, const char * string)
+{
+    write_bytes(w, string, strlen(string));
+}
+
+static void write_uint(metrics_writer_t * w, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+
+    do {
+        digits[sizeof(digits) - ++count] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    write_bytes(w, digits + sizeof(digits) - count, count);
+}
+
+static void write_value(metrics_writer_t * w, double value)
+{
+    if (isnan(value)) {
+        write_string(w, "NaN");
+        return;
+    }
+    if (isinf(value)) {
+        write_string(w, value > 0 ? "+Inf" : "-Inf");
+        return;
+    }
+
+    char text[JSON_WRITER_NUMBER_SIZE];
+    write_bytes(w, text, json_writer_print_number(text, value));
+}
+
+static void family(metrics_writer_t * w, const char * name, const char * type, const char * help)
+{
+    write_string(w, "# TYPE " PREFIX);
+    write_string(w, name);
+    write_string(w, " ");
+    write_string(w, type);
+    write_string(w, "\n# HELP " PREFIX);
+    write_string(w, name);
+    write_string(w, " ");
+    write_string(w, help);
+    write_string(w, "\n");
+}
+
+// A sample is sample_begin, any labels, then sample_end with its value
+static void sample_begin(metrics_writer_t * w, const char * name, const char * suffix)
+{
+    write_string(w, PREFIX);
+    write_string(w, name);
+    if (suffix) write_string(w, suffix);
+    w->labels = false;
+}
+
+static void label_begin(metrics_writer_t * w, const char * key)
+{
+    write_string(w, w->labels ? "," : "{");
+    write_string(w, key);
+    write_string(w, "=\"");
+    w->labels = true;
+}
+
+static void label(metrics_writer_t * w, const char * key, const char * value)
+{
+    label_begin(w, key);
+    for (const char * c = value ? value : ""; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            write_bytes(w, "\\", 1);
+            write_bytes(w, c, 1);
+        } else if (*c == '\n') {
+            write_string(w, "\\n");
+        } else {
+            write_bytes(w, c, 1);
+        }
+    }
+    write_string(w, "\"");
+}
+
+static void label_uint(metrics_writer_t * w, const char * key, uint64_t value)
+{
+    label_begin(w, key);
+    write_uint(w, value);
+    write_string(w, "\"");
+}
+
+static void sample_end(metrics_writer_t * w, double value)
+{
+    if (w->labels) write_string(w, "}");
+    write_string(w, " ");
+    write_value(w, value);
+    write_string(w, "\n");
+}
+
+static void gauge(metrics_writer_t * w, const char * name, const char * help, double value)
+{
+    family(w, name, "gauge", help);
+    sample_begin(w, name, NULL);
+    sample_end(w, value);
+}
+
+static void counter(metrics_writer_t * w, const char * name, const char * help, double value)
+{
+    family(w, name, "counter", help);
+    sample_begin(w, name, "_total");
+    sample_end(w, value);
+}
+
+static void histogram(metrics_writer_t * w, const char * name, const char * help, const latency_histogram_t * latencies)
+{
+    uint32_t counts[LATENCY_HISTOGRAM_BUCKETS];
+    double sum_ms = latency_histogram_read(latencies, counts);
+    uint64_t cumulative = 0;
+
+    family(w, name, "histogram", help);
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        cumulative += counts[i];
+        sample_begin(w, name, "_bucket");
+        if (i < LATENCY_HISTOGRAM_BUCKETS - 1) {
+            label_begin(w, "le");
+            write_value(w, LATENCY_HISTOGRAM_BOUNDS_MS[i] / 1000.0);
+            write_string(w, "\"");
+        } else {
+            label(w, "le", "+Inf");
+        }
+        sample_end(w, cumulative);
+    }
+    sample_begin(w, name, "_count");
+    sample_end(w, cumulative);
+    sample_begin(w, name, "_sum");
+    sample_end(w, sum_ms / 1000.0);
+}
+
+static void write_system(metrics_writer_t * w, GlobalState * g)
+{
+    family(w, "info", "gauge", "Firmware and hardware, in the labels");
+    sample_begin(w, "info", NULL);
+    label(w, "version", g->SYSTEM_MODULE.version);
+    label(w, "board", g->DEVICE_CONFIG.board_version);
+    label(w, "asic", g->DEVICE_CONFIG.family.asic.name);
+    sample_end(w, 1);
+
+    gauge(w, "uptime_seconds", "Time since boot", (esp_timer_get_time() - g->SYSTEM_MODULE.start_time) / 1e6);
+
+    family(w, "free_heap_bytes", "gauge", "Free heap");
+    sample_begin(w, "free_heap_bytes", NULL);
+    label(w, "region", "total");
+    sample_end(w, esp_get_free_heap_size());
+    sample_begin(w, "free_heap_bytes", NULL);
+    label(w, "region", "internal");
+    sample_end(w, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    sample_begin(w, "free_heap_bytes", NULL);
+    label(w, "region", "spiram");
+    sample_end(w, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+
+    int8_t rssi = -90;
+    get_wifi_current_rssi(&rssi);
+    gauge(w, "wifi_rssi_dbm", "Signal strength of the WiFi station", rssi);
+    gauge(w, "cpu_usage_ratio", "Share of the CPU in use", g->SYSTEM_MODULE.cpu_usage / 100.0);
+    gauge(w, "mining_paused", "1 while mining is paused", g->SYSTEM_MODULE.mining_paused);
+}
+
+static void write_power(metrics_writer_t * w, GlobalState * g)
+{
+    PowerManagementModule * power = &g->POWER_MANAGEMENT_MODULE;
+
+    gauge(w, "power_watts", "Power drawn by the board", power->power);
+    gauge(w, "input_voltage_volts", "Input voltage", power->voltage / 1000.0);
+    gauge(w, "input_current_amps", "Input current", power->current / 1000.0);
+    gauge(w, "core_voltage_volts", "Measured ASIC core voltage", power->core_voltage / 1000.0);
+    gauge(w, "frequency_mhz", "ASIC frequency", power->actual_frequency);
+
+    family(w, "temperature_celsius", "gauge", "Temperatures");
+    sample_begin(w, "temperature_celsius", NULL);
+    label(w, "sensor", "asic");
+    sample_end(w, power->chip_temp_avg);
+    sample_begin(w, "temperature_celsius", NULL);
+    label(w, "sensor", "asic2");
+    sample_end(w, power->chip_temp2_avg);
+    sample_begin(w, "temperature_celsius", NULL);
+    label(w, "sensor", "vr");
+    sample_end(w, power->vr_temp);
+
+    gauge(w, "fan_speed_ratio", "Fan duty cycle", power->fan_perc / 100.0);
+
+    family(w, "fan_rpm", "gauge", "Fan speed");
+    sample_begin(w, "fan_rpm", NULL);
+    label(w, "fan", "1");
+    sample_end(w, power->fan_rpm);
+    sample_begin(w, "fan_rpm", NULL);
+    label(w, "fan", "2");
+    sample_end(w, power->fan2_rpm);
+
+    gauge(w, "power_limited", "1 while the power cap holds the frequency back", power->power_governor.limiting);
+    gauge(w, "thermal_limited", "1 while the thermal governor holds the frequency back", power->thermal_governor.limiting);
+}
+
+static void write_hashrate(metrics_writer_t * w, GlobalState * g)
+{
+    SystemModule * module = &g->SYSTEM_MODULE;
+
+    family(w, "hashrate_ghs", "gauge", "Hashrate in GH/s, averaged over the window");
+    const struct { const char * window; float hashrate; } windows[] = {
+        { "current", module->current_hashrate },
+        { "5s", module->hashrate_5s },
+        { "1m", module->hashrate_1m },
+        { "10m", module->hashrate_10m },
+        { "15m", module->hashrate_15m },
+        { "1h", module->hashrate_1h },
+        { "24h", module->hashrate_24h },
+    };
+    for (int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+        sample_begin(w, "hashrate_ghs", NULL);
+        label(w, "window", windows[i].window);
+        sample_end(w, windows[i].hashrate);
+    }
+
+    gauge(w, "expected_hashrate_ghs", "Hashrate expected from the frequency", g->POWER_MANAGEMENT_MODULE.expected_hashrate);
+    gauge(w, "error_ratio", "Share of the hashrate lost to errors", module->error_percentage / 100.0);
+
+    HashrateMonitorModule * monitor = &g->HASHRATE_MONITOR_MODULE;
+    if (!monitor->is_initialized) return;
+
+    int asic_count = g->DEVICE_CONFIG.family.asic_count;
+    int hash_domains = g->DEVICE_CONFIG.family.asic.hash_domains;
+
+    family(w, "chip_hashrate_ghs", "gauge", "Hashrate of each chip, from its counters");
+    for (int i = 0; i < asic_count; i++) {
+        sample_begin(w, "chip_hashrate_ghs", NULL);
+        label_uint(w, "chip", i);
+        sample_end(w, monitor->total_measurement[i].hashrate);
+    }
+
+    family(w, "chip_domain_hashrate_ghs", "gauge", "Hashrate of each hash domain of each chip");
+    for (int i = 0; i < asic_count; i++) {
+        for (int j = 0; j < hash_domains; j++) {
+            sample_begin(w, "chip_domain_hashrate_ghs", NULL);
+            label_uint(w, "chip", i);
+            label_uint(w, "domain", j);
+            sample_end(w, monitor->domain_measurements[i][j].hashrate);
+        }
+    }
+
+    family(w, "chip_error_hashrate_ghs", "gauge", "Hashrate of each chip lost to errors");
+    for (int i = 0; i < asic_count; i++) {
+        sample_begin(w, "chip_error_hashrate_ghs", NULL);
+        label_uint(w, "chip", i);
+        sample_end(w, monitor->error_measurement[i].hashrate);
+    }
+}
+
+static void write_chains(metrics_writer_t * w, GlobalState * g)
+{
+    uint32_t stale_nonces = 0;
+    uint32_t rx_collisions = 0;
+    uint32_t chain_resets = 0;
+    uint32_t bypassed = 0;
+    for (int c = 0; c < g->asic_chain_count; c++) {
+        asic_chain_t * chain = &g->ASIC_CHAINS[c].chain;
+        stale_nonces += atomic_load_explicit(&chain->stale_nonces, memory_order_relaxed);
+        rx_collisions += atomic_load_explicit(&chain->rx_collisions, memory_order_relaxed);
+        chain_resets += chain->health.resets;
+        for (int i = 0; i < chain->health.chip_count; i++) {
+            bypassed += chain->health.chips[i].state == CHIP_HEALTH_BYPASSED;
+        }
+    }
+    counter(w, "stale_nonces", "Nonces for jobs that were already replaced", stale_nonces);
+    counter(w, "rx_collisions", "Responses garbled by chips answering at once", rx_collisions);
+    counter(w, "chain_resets", "Soft resets of stalled chains", chain_resets);
+    gauge(w, "chips_bypassed", "Chips given up on and bypassed", bypassed);
+}
+
+static void write_shares(metrics_writer_t * w, GlobalState * g)
+{
+    SystemModule * module = &g->SYSTEM_MODULE;
+
+    counter(w, "shares_accepted", "Shares accepted by the pool", module->shares_accepted);
+
+    family(w, "shares_rejected", "counter", "Shares rejected by the pool, by reason");
+    for (int i = 0; i < module->rejected_reason_stats_count; i++) {
+        sample_begin(w, "shares_rejected", "_total");
+        label(w, "reason", module->rejected_reason_stats[i].message);
+        sample_end(w, module->rejected_reason_stats[i].count);
+    }
+
+    family(w, "best_difficulty", "gauge", "Best share difficulty found");
+    sample_begin(w, "best_difficulty", NULL);
+    label(w, "scope", "all");
+    sample_end(w, module->best_nonce_diff);
+    sample_begin(w, "best_difficulty", NULL);
+    label(w, "scope", "session");
+    sample_end(w, module->best_session_nonce_diff);
+
+    gauge(w, "pool_difficulty", "Difficulty the pool asks for", g->pool_difficulty);
+    gauge(w, "blocks_found", "Blocks found", module->block_found);
+
+    share_estimator_t estimators[POOL_COUNT];
+    taskENTER_CRITICAL(&g->share_estimator_mux);
+    memcpy(estimators, module->share_estimators, sizeof(estimators));
+    taskEXIT_CRITICAL(&g->share_estimator_mux);
+
+    family(w, "share_hashrate_ghs", "gauge", "Hashrate estimated from the share difficulty, over about an hour");
+    for (int i = 0; i < POOL_COUNT; i++) {
+        for (int source = 0; source < SHARE_ESTIMATOR_SOURCES; source++) {
+            share_estimate_t estimate;
+            share_estimator_get(&estimators[i], source, &estimate);
+            sample_begin(w, "share_hashrate_ghs", NULL);
+            label(w, "pool", i == 0 ? "primary" : "fallback");
+            label(w, "source", source == SHARE_ESTIMATOR_ACCEPTED ? "accepted" : "local");
+            sample_end(w, estimate.hashrate);
+        }
+    }
+
+    histogram(w, "share_process_seconds", "Time from a nonce coming in to its share being submitted",
+              &module->process_time_histogram);
+    histogram(w, "share_response_seconds", "Time from a share being submitted to the pool's answer",
+              &module->response_time_histogram);
+}
+
+esp_err_t metrics_send(httpd_req_t * req, GlobalState * g)
+{
+    metrics_writer_t w = {
+        .req = req,
+        .err = ESP_OK,
+    };
+
+    httpd_resp_set_type(req, "application/openmetrics-text; version=1.0.0; charset=utf-8");
+
+    write_system(&w, g);
+    write_power(&w, g);
+    write_hashrate(&w, g);
+    write_chains(&w, g);
+    write_shares(&w, g);
+    write_string(&w, "# EOF\n");
+
+    flush(&w);
+    if (ESP_OK != w.err) {
+        return w.err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
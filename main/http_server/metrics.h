@@ -0,0 +1,16 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <esp_http_server.h>
+#include "global_state.h"
+
+// Serves the state of the miner in the OpenMetrics text format, for
+// Prometheus and the like. Everything is written straight off GlobalState
+// through a small buffer on the stack and sent in chunks, without touching
+// the heap, since a fleet gets scraped every few seconds.
+
+#define METRICS_BUFFER 1024
+
+esp_err_t metrics_send(httpd_req_t * req, GlobalState * g);
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "statistics_stream.h"
+
+// cJSON_CreateFloat rounds the same way
+#define FLOAT_FACTOR 10000000.0
+
+static void flush(statistics_stream_t * stream)
+{
+    if (ESP_OK == stream->err && 0 != stream->length) {
+        stream->err = httpd_resp_send_chunk(stream->req, stream->buffer, stream->length);
+    }
+    stream->length = 0;
+}
+
+static void write_bytes(statistics_stream_t * stream, const void * data, size_t length)
+{
+    const char * bytes = data;
+
+    while (0 != length) {
+        if (STATISTICS_STREAM_BUFFER == stream->length) {
+            flush(stream);
+        }
+        size_t room = STATISTICS_STREAM_BUFFER - stream->length;
+        size_t part = length < room ? length : room;
+
+        memcpy(stream->buffer + stream->length, bytes, part);
+        stream->length += part;
+        bytes += part;
+        length -= part;
+    }
+}
+
+static void write_string(statistics_stream_t * stream, const char * string)
+{
+    write_bytes(stream, string, strlen(string));
+}
+
+static void write_number(statistics_stream_t * stream, double value)
+{
+    char number[32];
+
+    if (isnan(value) || isinf(value)) {
+        write_string(stream, STATISTICS_FORMAT_JSON == stream->format ? "null" : "");
+        return;
+    }
+    snprintf(number, sizeof(number), "%.15g", round(value * FLOAT_FACTOR) / FLOAT_FACTOR);
+    write_string(stream, number);
+}
+
+statistics_format_t statistics_format_from_string(const char * format)
+{
+    if (NULL != format) {
+        if (strcmp(format, "csv") == 0) return STATISTICS_FORMAT_CSV;
+        if (strcmp(format, "binary") == 0) return STATISTICS_FORMAT_BINARY;
+    }
+    return STATISTICS_FORMAT_JSON;
+}
+
+void statistics_stream_begin(statistics_stream_t * stream, httpd_req_t * req, statistics_format_t format,
+                             uint64_t current_timestamp, uint32_t interval, const char * const labels[], int label_count)
+{
+    stream->req = req;
+    stream->format = format;
+    stream->rows = 0;
+    stream->err = ESP_OK;
+    stream->length = 0;
+
+    switch (format) {
+        case STATISTICS_FORMAT_JSON:
+            httpd_resp_set_type(req, "application/json");
+            write_string(stream, "{\"currentTimestamp\":");
+            write_number(stream, current_timestamp);
+            write_string(stream, ",\"interval\":");
+            write_number(stream, interval);
+            write_string(stream, ",\"labels\":[");
+            for (int i = 0; i < label_count; i++) {
+                write_string(stream, "\"");
+                write_string(stream, labels[i]);
+                write_string(stream, "\",");
+            }
+            write_string(stream, "\"timestamp\"],\"statistics\":[");
+            break;
+        case STATISTICS_FORMAT_CSV:
+            httpd_resp_set_type(req, "text/csv");
+            for (int i = 0; i < label_count; i++) {
+                write_string(stream, labels[i]);
+                write_string(stream, ",");
+            }
+            write_string(stream, "timestamp\n");
+            break;
+        case STATISTICS_FORMAT_BINARY: {
+            httpd_resp_set_type(req, "application/octet-stream");
+            uint8_t header[] = {'S', 'T', 'A', 'T', 1, label_count + 1};
+            write_bytes(stream, header, sizeof(header));
+            write_bytes(stream, &interval, sizeof(interval));
+            write_bytes(stream, &current_timestamp, sizeof(current_timestamp));
+            for (int i = 0; i < label_count; i++) {
+                write_bytes(stream, labels[i], strlen(labels[i]) + 1);
+            }
+            write_bytes(stream, "timestamp", sizeof("timestamp"));
+            break;
+        }
+    }
+}
+
+void statistics_stream_row(statistics_stream_t * stream, const float values[], int count, uint64_t timestamp)
+{
+    if (ESP_OK != stream->err) {
+        return;
+    }
+
+    switch (stream->format) {
+        case STATISTICS_FORMAT_JSON:
+            write_string(stream, 0 == stream->rows ? "[" : ",[");
+            for (int i = 0; i < count; i++) {
+                write_number(stream, values[i]);
+                write_string(stream, ",");
+            }
+            write_number(stream, timestamp);
+            write_string(stream, "]");
+            break;
+        case STATISTICS_FORMAT_CSV:
+            for (int i = 0; i < count; i++) {
+                write_number(stream, values[i]);
+                write_string(stream, ",");
+            }
+            write_number(stream, timestamp);
+            write_string(stream, "\n");
+            break;
+        case STATISTICS_FORMAT_BINARY:
+            write_bytes(stream, values, sizeof(float) * count);
+            write_bytes(stream, &timestamp, sizeof(timestamp));
+            break;
+    }
+    stream->rows++;
+}
+
+esp_err_t statistics_stream_end(statistics_stream_t * stream)
+{
+    if (STATISTICS_FORMAT_JSON == stream->format) {
+        write_string(stream, "]}");
+    }
+    flush(stream);
+
+    if (ESP_OK == stream->err) {
+        stream->err = httpd_resp_send_chunk(stream->req, NULL, 0);
+    }
+    return stream->err;
+}
@@ -0,0 +1,47 @@
+#ifndef STATISTICS_STREAM_H_
+#define STATISTICS_STREAM_H_
+
+#include <stdint.h>
+#include <esp_http_server.h>
+
+// Writes statistics rows straight into chunks of the response, through a
+// small scratch buffer, rather than building the whole document first.
+//
+// The binary format is little endian: "STAT", a version byte, the number of
+// columns including the timestamp, the interval in seconds as uint32, the
+// current timestamp in ms as uint64, then the labels, each NUL terminated.
+// Every row that follows is a float32 per column and the timestamp as uint64.
+
+#define STATISTICS_STREAM_BUFFER 1024
+#define STATISTICS_STREAM_MAX_COLUMNS 32
+
+typedef enum
+{
+    STATISTICS_FORMAT_JSON,
+    STATISTICS_FORMAT_CSV,
+    STATISTICS_FORMAT_BINARY,
+} statistics_format_t;
+
+typedef struct
+{
+    httpd_req_t * req;
+    statistics_format_t format;
+    uint32_t rows;
+    esp_err_t err;
+    size_t length;
+    char buffer[STATISTICS_STREAM_BUFFER];
+} statistics_stream_t;
+
+statistics_format_t statistics_format_from_string(const char * format);
+
+// Sets the content type, so it goes before anything else is sent. The labels
+// are those of the values, the timestamp column is added at the end.
+void statistics_stream_begin(statistics_stream_t * stream, httpd_req_t * req, statistics_format_t format,
+                             uint64_t current_timestamp, uint32_t interval, const char * const labels[], int label_count);
+
+// values are in the order of the labels, the timestamp goes last
+void statistics_stream_row(statistics_stream_t * stream, const float values[], int count, uint64_t timestamp);
+
+esp_err_t statistics_stream_end(statistics_stream_t * stream);
+
+#endif /* STATISTICS_STREAM_H_ */
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include "esp_wifi.h"
 #include "esp_ota_ops.h"
 #include "esp_system.h"
@@ -9,9 +11,9 @@
 #include "vcore.h"
 #include "connect.h"
 #include "hashrate_monitor_task.h"
-#include "cjson_utils.h"
 #include "statistics_task.h"
 #include "stratum_v2_task.h"
+#include "task_monitor.h"
 
 static const char * stratum_protocol_to_string(uint16_t v)
 {
@@ -46,146 +48,183 @@ static const char *get_reset_reason_str(esp_reset_reason_t reason)
     }
 }
 
-static void system_api_add_telemetry(cJSON *root, GlobalState *g) {
-    if (!root || !g) return;
-
-    // Power Group
-    cJSON_AddFloatToObject(root, "power", g->POWER_MANAGEMENT_MODULE.power);
-    cJSON_AddFloatToObject(root, "voltage", g->POWER_MANAGEMENT_MODULE.voltage);
-    cJSON_AddFloatToObject(root, "current", g->POWER_MANAGEMENT_MODULE.current);
-    cJSON_AddFloatToObject(root, "temp", g->POWER_MANAGEMENT_MODULE.chip_temp_avg);
-    cJSON_AddFloatToObject(root, "temp2", g->POWER_MANAGEMENT_MODULE.chip_temp2_avg);
-    cJSON_AddFloatToObject(root, "vrTemp", g->POWER_MANAGEMENT_MODULE.vr_temp);
-    cJSON_AddFloatToObject(root, "coreVoltageActual", g->POWER_MANAGEMENT_MODULE.core_voltage);
-    cJSON_AddFloatToObject(root, "actualFrequency", g->POWER_MANAGEMENT_MODULE.actual_frequency);
-    cJSON_AddFloatToObject(root, "expectedHashrate", g->POWER_MANAGEMENT_MODULE.expected_hashrate);
-    cJSON_AddNumberToObject(root, "fanspeed", g->POWER_MANAGEMENT_MODULE.fan_perc);
-    cJSON_AddNumberToObject(root, "fanrpm", g->POWER_MANAGEMENT_MODULE.fan_rpm);
-    cJSON_AddNumberToObject(root, "fan2rpm", g->POWER_MANAGEMENT_MODULE.fan2_rpm);
-
-    // Hashrate / Mining Group
-    cJSON_AddFloatToObject(root, "hashRate", g->SYSTEM_MODULE.current_hashrate);
-    cJSON_AddFloatToObject(root, "hashRate_1m", g->SYSTEM_MODULE.hashrate_1m);
-    cJSON_AddFloatToObject(root, "hashRate_10m", g->SYSTEM_MODULE.hashrate_10m);
-    cJSON_AddFloatToObject(root, "hashRate_1h", g->SYSTEM_MODULE.hashrate_1h);
-    cJSON_AddFloatToObject(root, "errorPercentage", g->SYSTEM_MODULE.error_percentage);
-    cJSON_AddNumberToObject(root, "sharesAccepted", g->SYSTEM_MODULE.shares_accepted);
-    cJSON_AddNumberToObject(root, "sharesRejected", g->SYSTEM_MODULE.shares_rejected);
-    cJSON_AddNumberToObject(root, "bestDiff", g->SYSTEM_MODULE.best_nonce_diff);
-    cJSON_AddNumberToObject(root, "bestSessionDiff", g->SYSTEM_MODULE.best_session_nonce_diff);
-    cJSON_AddNumberToObject(root, "poolDifficulty", g->pool_difficulty);
-    cJSON_AddFloatToObject(root, "responseTime", g->SYSTEM_MODULE.response_time);
-    cJSON_AddNumberToObject(root, "responseShareBatch", g->SYSTEM_MODULE.response_share_batch);
-    cJSON_AddFloatToObject(root, "processTime", g->SYSTEM_MODULE.process_time);
+// The telemetry fields, one getter each for the registry
+#define SYSTEM_API_NUMBER(getter, expr) \
+    static bool getter(GlobalState *g, telemetry_value_t *value) { value->number = (expr); return true; }
+#define SYSTEM_API_NUMBER_IF(getter, condition, expr) \
+    static bool getter(GlobalState *g, telemetry_value_t *value) { value->number = (expr); return (condition); }
+#define SYSTEM_API_STRING(getter, expr) \
+    static bool getter(GlobalState *g, telemetry_value_t *value) { value->string = (expr); return true; }
+#define SYSTEM_API_STRING_IF(getter, condition, expr) \
+    static bool getter(GlobalState *g, telemetry_value_t *value) { if (!(condition)) return false; value->string = (expr); return true; }
+
+// Power Group
+SYSTEM_API_NUMBER(get_power, g->POWER_MANAGEMENT_MODULE.power)
+SYSTEM_API_NUMBER(get_voltage, g->POWER_MANAGEMENT_MODULE.voltage)
+SYSTEM_API_NUMBER(get_current, g->POWER_MANAGEMENT_MODULE.current)
+SYSTEM_API_NUMBER(get_temp, g->POWER_MANAGEMENT_MODULE.chip_temp_avg)
+SYSTEM_API_NUMBER(get_temp2, g->POWER_MANAGEMENT_MODULE.chip_temp2_avg)
+SYSTEM_API_NUMBER(get_vr_temp, g->POWER_MANAGEMENT_MODULE.vr_temp)
+SYSTEM_API_NUMBER(get_core_voltage_actual, g->POWER_MANAGEMENT_MODULE.core_voltage)
+SYSTEM_API_NUMBER(get_actual_frequency, g->POWER_MANAGEMENT_MODULE.actual_frequency)
+SYSTEM_API_NUMBER(get_expected_hashrate, g->POWER_MANAGEMENT_MODULE.expected_hashrate)
+SYSTEM_API_NUMBER(get_fan_speed, g->POWER_MANAGEMENT_MODULE.fan_perc)
+SYSTEM_API_NUMBER(get_fan_rpm, g->POWER_MANAGEMENT_MODULE.fan_rpm)
+SYSTEM_API_NUMBER(get_fan2_rpm, g->POWER_MANAGEMENT_MODULE.fan2_rpm)
+
+// Hashrate / Mining Group
+SYSTEM_API_NUMBER(get_hashrate, g->SYSTEM_MODULE.current_hashrate)
+SYSTEM_API_NUMBER(get_hashrate_1m, g->SYSTEM_MODULE.hashrate_1m)
+SYSTEM_API_NUMBER(get_hashrate_10m, g->SYSTEM_MODULE.hashrate_10m)
+SYSTEM_API_NUMBER(get_hashrate_1h, g->SYSTEM_MODULE.hashrate_1h)
+SYSTEM_API_NUMBER(get_hashrate_5s, g->SYSTEM_MODULE.hashrate_5s)
+SYSTEM_API_NUMBER(get_hashrate_15m, g->SYSTEM_MODULE.hashrate_15m)
+SYSTEM_API_NUMBER(get_hashrate_24h, g->SYSTEM_MODULE.hashrate_24h)
+SYSTEM_API_NUMBER(get_error_percentage, g->SYSTEM_MODULE.error_percentage)
+SYSTEM_API_NUMBER(get_shares_accepted, g->SYSTEM_MODULE.shares_accepted)
+SYSTEM_API_NUMBER(get_shares_rejected, g->SYSTEM_MODULE.shares_rejected)
+SYSTEM_API_NUMBER(get_best_diff, g->SYSTEM_MODULE.best_nonce_diff)
+SYSTEM_API_NUMBER(get_best_session_diff, g->SYSTEM_MODULE.best_session_nonce_diff)
+SYSTEM_API_NUMBER(get_pool_difficulty, g->pool_difficulty)
+SYSTEM_API_NUMBER(get_response_time, g->SYSTEM_MODULE.response_time)
+SYSTEM_API_NUMBER(get_response_share_batch, g->SYSTEM_MODULE.response_share_batch)
+SYSTEM_API_NUMBER(get_process_time, g->SYSTEM_MODULE.process_time)
+SYSTEM_API_NUMBER(get_job_interval, job_interval_get_ms(&g->job_interval))
+SYSTEM_API_STRING(get_job_interval_reason, job_interval_reason_to_string(job_interval_get_reason(&g->job_interval)))
+SYSTEM_API_NUMBER(get_job_interval_changes, g->job_interval.changes)
+
+static bool get_stale_nonces(GlobalState *g, telemetry_value_t *value) {
+    uint32_t stale_nonces = 0;
+    for (int c = 0; c < g->asic_chain_count; c++) {
+        stale_nonces += atomic_load_explicit(&g->ASIC_CHAINS[c].chain.stale_nonces, memory_order_relaxed);
+    }
+    value->number = stale_nonces;
+    return true;
+}
 
-    // Dynamic Block Info
-    cJSON_AddNumberToObject(root, "blockFound", g->SYSTEM_MODULE.block_found);
-    cJSON_AddBoolToObject(root, "showNewBlock", g->SYSTEM_MODULE.show_new_block);
-    if (g->block_height > 0) {
-        cJSON_AddNumberToObject(root, "blockHeight", g->block_height);
-        cJSON_AddStringToObject(root, "scriptsig", g->scriptsig);
-        cJSON_AddNumberToObject(root, "networkDifficulty", g->network_nonce_diff);
-        cJSON_AddNumberToObject(root, "coinbaseValueTotalSatoshis", g->coinbase_value_total_satoshis);
-        cJSON_AddNumberToObject(root, "coinbaseValueUserSatoshis", g->coinbase_value_user_satoshis);
+static bool get_rx_collisions(GlobalState *g, telemetry_value_t *value) {
+    uint32_t rx_collisions = 0;
+    for (int c = 0; c < g->asic_chain_count; c++) {
+        rx_collisions += atomic_load_explicit(&g->ASIC_CHAINS[c].chain.rx_collisions, memory_order_relaxed);
     }
+    value->number = rx_collisions;
+    return true;
+}
 
-    // Dynamic System Stats
-    cJSON_AddNumberToObject(root, "freeHeap", esp_get_free_heap_size());
-    cJSON_AddNumberToObject(root, "freeHeapInternal", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
-    cJSON_AddNumberToObject(root, "freeHeapSpiram", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
-    cJSON_AddNumberToObject(root, "uptimeSeconds", (uint32_t)((esp_timer_get_time() - g->SYSTEM_MODULE.start_time) / 1000000));
-    cJSON_AddFloatToObject(root, "cpuUsage", g->SYSTEM_MODULE.cpu_usage);
-    cJSON_AddBoolToObject(root, "miningPaused", g->SYSTEM_MODULE.mining_paused);
-    cJSON_AddNumberToObject(root, "overheat_mode", g->SYSTEM_MODULE.overheat_mode ? 1 : 0);
-    cJSON_AddStringToObject(root, "wifiStatus", g->SYSTEM_MODULE.wifi_status);
+static bool get_chain_resets(GlobalState *g, telemetry_value_t *value) {
+    uint32_t chain_resets = 0;
+    for (int c = 0; c < g->asic_chain_count; c++) {
+        chain_resets += g->ASIC_CHAINS[c].chain.health.resets;
+    }
+    value->number = chain_resets;
+    return true;
+}
 
+// Dynamic Block Info
+SYSTEM_API_NUMBER(get_block_found, g->SYSTEM_MODULE.block_found)
+SYSTEM_API_NUMBER(get_show_new_block, g->SYSTEM_MODULE.show_new_block)
+SYSTEM_API_NUMBER_IF(get_block_height, g->block_height > 0, g->block_height)
+SYSTEM_API_STRING_IF(get_scriptsig, g->block_height > 0, g->scriptsig)
+SYSTEM_API_NUMBER_IF(get_network_difficulty, g->block_height > 0, g->network_nonce_diff)
+SYSTEM_API_NUMBER_IF(get_coinbase_value_total, g->block_height > 0, g->coinbase_value_total_satoshis)
+SYSTEM_API_NUMBER_IF(get_coinbase_value_user, g->block_height > 0, g->coinbase_value_user_satoshis)
+
+// Dynamic System Stats
+SYSTEM_API_NUMBER(get_free_heap, esp_get_free_heap_size())
+SYSTEM_API_NUMBER(get_free_heap_internal, heap_caps_get_free_size(MALLOC_CAP_INTERNAL))
+SYSTEM_API_NUMBER(get_free_heap_spiram, heap_caps_get_free_size(MALLOC_CAP_SPIRAM))
+SYSTEM_API_NUMBER(get_uptime_seconds, (uint32_t)((esp_timer_get_time() - g->SYSTEM_MODULE.start_time) / 1000000))
+SYSTEM_API_NUMBER(get_cpu_usage, g->SYSTEM_MODULE.cpu_usage)
+SYSTEM_API_NUMBER(get_mining_paused, g->SYSTEM_MODULE.mining_paused)
+SYSTEM_API_NUMBER(get_power_limited, g->POWER_MANAGEMENT_MODULE.power_governor.limiting)
+SYSTEM_API_NUMBER(get_thermal_limited, g->POWER_MANAGEMENT_MODULE.thermal_governor.limiting)
+SYSTEM_API_NUMBER(get_overheat_mode, g->SYSTEM_MODULE.overheat_mode ? 1 : 0)
+SYSTEM_API_STRING(get_wifi_status, g->SYSTEM_MODULE.wifi_status)
+
+static bool get_wifi_rssi(GlobalState *g, telemetry_value_t *value) {
     int8_t rssi = -90;
     get_wifi_current_rssi(&rssi);
-    cJSON_AddNumberToObject(root, "wifiRSSI", rssi);
-
-    // Faults
-    if (g->SYSTEM_MODULE.power_fault > 0) {
-        cJSON_AddStringToObject(root, "power_fault", VCORE_get_fault_string(g));
-    }
-    if (g->SYSTEM_MODULE.hardware_fault) {
-        cJSON_AddStringToObject(root, "hardware_fault", g->SYSTEM_MODULE.hardware_fault_msg);
-    }
+    value->number = rssi;
+    return true;
 }
 
-static void system_api_add_config(cJSON *root, GlobalState *g) {
-    if (!root || !g) return;
+// Faults
+SYSTEM_API_STRING_IF(get_power_fault, g->SYSTEM_MODULE.power_fault > 0, VCORE_get_fault_string(g))
+SYSTEM_API_STRING_IF(get_hardware_fault, g->SYSTEM_MODULE.hardware_fault, g->SYSTEM_MODULE.hardware_fault_msg)
+
+static bool system_api_write_config(GlobalState *g, json_writer_t *w) {
 
     // Versions
-    cJSON_AddStringToObject(root, "version", g->SYSTEM_MODULE.version ? g->SYSTEM_MODULE.version : "Unknown");
-    cJSON_AddStringToObject(root, "axeOSVersion", g->SYSTEM_MODULE.axeOSVersion ? g->SYSTEM_MODULE.axeOSVersion : "Unknown");
-    cJSON_AddStringToObject(root, "idfVersion", esp_get_idf_version());
-    cJSON_AddStringToObject(root, "boardVersion", g->DEVICE_CONFIG.board_version ? g->DEVICE_CONFIG.board_version : "Unknown");
+    json_writer_add_string(w, "version", g->SYSTEM_MODULE.version ? g->SYSTEM_MODULE.version : "Unknown");
+    json_writer_add_string(w, "axeOSVersion", g->SYSTEM_MODULE.axeOSVersion ? g->SYSTEM_MODULE.axeOSVersion : "Unknown");
+    json_writer_add_string(w, "idfVersion", esp_get_idf_version());
+    json_writer_add_string(w, "boardVersion", g->DEVICE_CONFIG.board_version ? g->DEVICE_CONFIG.board_version : "Unknown");
 
     // Hardware Details
-    cJSON_AddNumberToObject(root, "maxPower", g->DEVICE_CONFIG.family.max_power);
-    cJSON_AddNumberToObject(root, "nominalVoltage", g->DEVICE_CONFIG.family.nominal_voltage);
-    cJSON_AddNumberToObject(root, "smallCoreCount", g->DEVICE_CONFIG.family.asic.small_core_count);
-    cJSON_AddStringToObject(root, "ASICModel", g->DEVICE_CONFIG.family.asic.name ? g->DEVICE_CONFIG.family.asic.name : "Unknown");
-    cJSON_AddNumberToObject(root, "isPSRAMAvailable", g->psram_is_available ? 1 : 0);
-    cJSON_AddStringToObject(root, "resetReason", get_reset_reason_str(esp_reset_reason()));
+    json_writer_add_number(w, "maxPower", g->DEVICE_CONFIG.family.max_power);
+    json_writer_add_number(w, "nominalVoltage", g->DEVICE_CONFIG.family.nominal_voltage);
+    json_writer_add_number(w, "smallCoreCount", g->DEVICE_CONFIG.family.asic.small_core_count);
+    json_writer_add_string(w, "ASICModel", g->DEVICE_CONFIG.family.asic.name ? g->DEVICE_CONFIG.family.asic.name : "Unknown");
+    json_writer_add_number(w, "isPSRAMAvailable", g->psram_is_available ? 1 : 0);
+    json_writer_add_string(w, "resetReason", get_reset_reason_str(esp_reset_reason()));
     
     const esp_partition_t *running = esp_ota_get_running_partition();
-    cJSON_AddStringToObject(root, "runningPartition", running ? running->label : "Unknown");
+    json_writer_add_string(w, "runningPartition", running ? running->label : "Unknown");
 
     uint8_t mac[6];
     esp_wifi_get_mac(WIFI_IF_STA, mac);
     char formattedMac[18];
     snprintf(formattedMac, sizeof(formattedMac), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    cJSON_AddStringToObject(root, "macAddr", formattedMac);
+    json_writer_add_string(w, "macAddr", formattedMac);
 
     char *hostname = nvs_config_get_string(NVS_CONFIG_HOSTNAME);
-    cJSON_AddStringToObject(root, "hostname", hostname ? hostname : "Unknown");
+    json_writer_add_string(w, "hostname", hostname ? hostname : "Unknown");
     free(hostname);
 
     // Network Config
     char *ssid = nvs_config_get_string(NVS_CONFIG_WIFI_SSID);
-    cJSON_AddStringToObject(root, "ssid", ssid ? ssid : "Unknown");
+    json_writer_add_string(w, "ssid", ssid ? ssid : "Unknown");
     free(ssid);
 
-    cJSON_AddStringToObject(root, "ipv4", g->SYSTEM_MODULE.ip_addr_str);
-    cJSON_AddStringToObject(root, "ipv6", g->SYSTEM_MODULE.ipv6_addr_str);
-    cJSON_AddNumberToObject(root, "apEnabled", g->SYSTEM_MODULE.ap_enabled ? 1 : 0);
+    json_writer_add_string(w, "ipv4", g->SYSTEM_MODULE.ip_addr_str);
+    json_writer_add_string(w, "ipv6", g->SYSTEM_MODULE.ipv6_addr_str);
+    json_writer_add_number(w, "apEnabled", g->SYSTEM_MODULE.ap_enabled ? 1 : 0);
 
     // Pool Configuration
-    cJSON_AddStringToObject(root, "poolConnectionInfo", g->SYSTEM_MODULE.pool_connection_info);
-    cJSON_AddNumberToObject(root, "isUsingFallbackStratum", g->SYSTEM_MODULE.is_using_fallback ? 1 : 0);
+    json_writer_add_string(w, "poolConnectionInfo", g->SYSTEM_MODULE.pool_connection_info);
+    json_writer_add_number(w, "isUsingFallbackStratum", g->SYSTEM_MODULE.is_using_fallback ? 1 : 0);
     
     char *s_url = nvs_config_get_string(NVS_CONFIG_STRATUM_URL);
-    cJSON_AddStringToObject(root, "stratumURL", s_url ? s_url : "");
+    json_writer_add_string(w, "stratumURL", s_url ? s_url : "");
     free(s_url);
-    cJSON_AddNumberToObject(root, "stratumPort", nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT));
+    json_writer_add_number(w, "stratumPort", nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT));
     char *s_user = nvs_config_get_string(NVS_CONFIG_STRATUM_USER);
-    cJSON_AddStringToObject(root, "stratumUser", s_user ? s_user : "");
+    json_writer_add_string(w, "stratumUser", s_user ? s_user : "");
     free(s_user);
-    cJSON_AddNumberToObject(root, "stratumSuggestedDifficulty", nvs_config_get_u16(NVS_CONFIG_STRATUM_DIFFICULTY));
-    cJSON_AddBoolToObject(root, "stratumExtranonceSubscribe", nvs_config_get_bool(NVS_CONFIG_STRATUM_EXTRANONCE_SUBSCRIBE));
-    cJSON_AddNumberToObject(root, "stratumTLS", nvs_config_get_u16(NVS_CONFIG_STRATUM_TLS));
+    json_writer_add_number(w, "stratumSuggestedDifficulty", nvs_config_get_u16(NVS_CONFIG_STRATUM_DIFFICULTY));
+    json_writer_add_bool(w, "stratumExtranonceSubscribe", nvs_config_get_bool(NVS_CONFIG_STRATUM_EXTRANONCE_SUBSCRIBE));
+    json_writer_add_number(w, "stratumTLS", nvs_config_get_u16(NVS_CONFIG_STRATUM_TLS));
     char *s_cert = nvs_config_get_string(NVS_CONFIG_STRATUM_CERT);
-    cJSON_AddStringToObject(root, "stratumCert", s_cert ? s_cert : "");
+    json_writer_add_string(w, "stratumCert", s_cert ? s_cert : "");
     free(s_cert);
-    cJSON_AddBoolToObject(root, "stratumDecodeCoinbase", nvs_config_get_bool(NVS_CONFIG_STRATUM_DECODE_COINBASE_TX));
+    json_writer_add_bool(w, "stratumDecodeCoinbase", nvs_config_get_bool(NVS_CONFIG_STRATUM_DECODE_COINBASE_TX));
 
     char *f_url = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_URL);
-    cJSON_AddStringToObject(root, "fallbackStratumURL", f_url ? f_url : "");
+    json_writer_add_string(w, "fallbackStratumURL", f_url ? f_url : "");
     free(f_url);
-    cJSON_AddNumberToObject(root, "fallbackStratumPort", nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT));
+    json_writer_add_number(w, "fallbackStratumPort", nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT));
     char *f_user = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER);
-    cJSON_AddStringToObject(root, "fallbackStratumUser", f_user ? f_user : "");
+    json_writer_add_string(w, "fallbackStratumUser", f_user ? f_user : "");
     free(f_user);
-    cJSON_AddNumberToObject(root, "fallbackStratumSuggestedDifficulty", nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_DIFFICULTY));
-    cJSON_AddBoolToObject(root, "fallbackStratumExtranonceSubscribe", nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_EXTRANONCE_SUBSCRIBE));
-    cJSON_AddNumberToObject(root, "fallbackStratumTLS", nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_TLS));
+    json_writer_add_number(w, "fallbackStratumSuggestedDifficulty", nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_DIFFICULTY));
+    json_writer_add_bool(w, "fallbackStratumExtranonceSubscribe", nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_EXTRANONCE_SUBSCRIBE));
+    json_writer_add_number(w, "fallbackStratumTLS", nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_TLS));
     char *f_cert = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_CERT);
-    cJSON_AddStringToObject(root, "fallbackStratumCert", f_cert ? f_cert : "");
+    json_writer_add_string(w, "fallbackStratumCert", f_cert ? f_cert : "");
     free(f_cert);
-    cJSON_AddBoolToObject(root, "fallbackStratumDecodeCoinbase", nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_DECODE_COINBASE_TX));
+    json_writer_add_bool(w, "fallbackStratumDecodeCoinbase", nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_DECODE_COINBASE_TX));
 
-    cJSON_AddStringToObject(root, "stratumProtocol",
+    json_writer_add_string(w, "stratumProtocol",
                             stratum_protocol_to_string(nvs_config_get_u16(NVS_CONFIG_STRATUM_PROTOCOL)));
 
     const char *protocol_label = "SV1";
@@ -193,123 +232,389 @@ static void system_api_add_config(cJSON *root, GlobalState *g) {
         protocol_label = stratum_v2_is_extended_channel(g)
             ? "SV2 Extended Channel" : "SV2 Standard Channel";
     }
-    cJSON_AddStringToObject(root, "activeProtocolLabel", protocol_label);
+    json_writer_add_string(w, "activeProtocolLabel", protocol_label);
 
     char *sv2AuthPubkey = nvs_config_get_string(NVS_CONFIG_SV2_AUTHORITY_PUBKEY);
-    cJSON_AddStringToObject(root, "stratumV2AuthorityPubkey", sv2AuthPubkey ? sv2AuthPubkey : "");
+    json_writer_add_string(w, "stratumV2AuthorityPubkey", sv2AuthPubkey ? sv2AuthPubkey : "");
     free(sv2AuthPubkey);
 
-    cJSON_AddStringToObject(root, "stratumV2ChannelType",
+    json_writer_add_string(w, "stratumV2ChannelType",
                             sv2_channel_type_to_string(nvs_config_get_u16(NVS_CONFIG_SV2_CHANNEL_TYPE)));
 
     char *fallbackSv2AuthPubkey = nvs_config_get_string(NVS_CONFIG_FALLBACK_SV2_AUTHORITY_PUBKEY);
-    cJSON_AddStringToObject(root, "fallbackStratumV2AuthorityPubkey", fallbackSv2AuthPubkey ? fallbackSv2AuthPubkey : "");
+    json_writer_add_string(w, "fallbackStratumV2AuthorityPubkey", fallbackSv2AuthPubkey ? fallbackSv2AuthPubkey : "");
     free(fallbackSv2AuthPubkey);
 
-    cJSON_AddStringToObject(root, "fallbackStratumV2ChannelType",
+    json_writer_add_string(w, "fallbackStratumV2ChannelType",
                             sv2_channel_type_to_string(nvs_config_get_u16(NVS_CONFIG_FALLBACK_SV2_CHANNEL_TYPE)));
 
-    cJSON_AddStringToObject(root, "fallbackStratumProtocol",
+    json_writer_add_string(w, "fallbackStratumProtocol",
                             stratum_protocol_to_string(nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_PROTOCOL)));
 
     // User Preferences
-    cJSON_AddNumberToObject(root, "overclockEnabled", nvs_config_get_bool(NVS_CONFIG_OVERCLOCK_ENABLED) ? 1 : 0);
+    json_writer_add_number(w, "overclockEnabled", nvs_config_get_bool(NVS_CONFIG_OVERCLOCK_ENABLED) ? 1 : 0);
+    json_writer_add_number(w, "adaptiveJobInterval", nvs_config_get_bool(NVS_CONFIG_ADAPTIVE_JOB_INTERVAL) ? 1 : 0);
+    json_writer_add_number(w, "autotuneObjective", nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_OBJECTIVE));
+    json_writer_add_number(w, "autotuneMaxTemp", nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_MAX_TEMP));
+    json_writer_add_number(w, "powerCap", g->POWER_MANAGEMENT_MODULE.power_governor.cap);
     char *disp_name = nvs_config_get_string(NVS_CONFIG_DISPLAY);
-    cJSON_AddStringToObject(root, "display", disp_name ? disp_name : "");
+    json_writer_add_string(w, "display", disp_name ? disp_name : "");
     free(disp_name);
-    cJSON_AddNumberToObject(root, "rotation", nvs_config_get_u16(NVS_CONFIG_ROTATION));
-    cJSON_AddNumberToObject(root, "invertscreen", nvs_config_get_bool(NVS_CONFIG_INVERT_SCREEN) ? 1 : 0);
-    cJSON_AddNumberToObject(root, "displayTimeout", nvs_config_get_i32(NVS_CONFIG_DISPLAY_TIMEOUT));
-    cJSON_AddNumberToObject(root, "autofanspeed", nvs_config_get_bool(NVS_CONFIG_AUTO_FAN_SPEED) ? 1 : 0);
-    cJSON_AddNumberToObject(root, "manualFanSpeed", nvs_config_get_u16(NVS_CONFIG_MANUAL_FAN_SPEED));
-    cJSON_AddNumberToObject(root, "minFanSpeed", nvs_config_get_u16(NVS_CONFIG_MIN_FAN_SPEED));
-    cJSON_AddNumberToObject(root, "temptarget", nvs_config_get_u16(NVS_CONFIG_TEMP_TARGET));
-    cJSON_AddNumberToObject(root, "coreVoltage", nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE));
-    cJSON_AddFloatToObject(root, "frequency", nvs_config_get_float(NVS_CONFIG_ASIC_FREQUENCY));
-    cJSON_AddNumberToObject(root, "statsFrequency", nvs_config_get_u16(NVS_CONFIG_STATISTICS_FREQUENCY));
-    cJSON_AddNumberToObject(root, "statsLimit", MAX_STATISTICS_COUNT);
+    json_writer_add_number(w, "rotation", nvs_config_get_u16(NVS_CONFIG_ROTATION));
+    json_writer_add_number(w, "invertscreen", nvs_config_get_bool(NVS_CONFIG_INVERT_SCREEN) ? 1 : 0);
+    json_writer_add_number(w, "displayTimeout", nvs_config_get_i32(NVS_CONFIG_DISPLAY_TIMEOUT));
+    json_writer_add_number(w, "autofanspeed", nvs_config_get_bool(NVS_CONFIG_AUTO_FAN_SPEED) ? 1 : 0);
+    json_writer_add_number(w, "manualFanSpeed", nvs_config_get_u16(NVS_CONFIG_MANUAL_FAN_SPEED));
+    json_writer_add_number(w, "minFanSpeed", nvs_config_get_u16(NVS_CONFIG_MIN_FAN_SPEED));
+    json_writer_add_number(w, "temptarget", nvs_config_get_u16(NVS_CONFIG_TEMP_TARGET));
+    json_writer_add_number(w, "coreVoltage", nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE));
+    json_writer_add_float(w, "frequency", nvs_config_get_float(NVS_CONFIG_ASIC_FREQUENCY));
+    json_writer_add_number(w, "statsFrequency", nvs_config_get_u16(NVS_CONFIG_STATISTICS_FREQUENCY));
+    json_writer_add_number(w, "statsLimit", MAX_STATISTICS_COUNT);
+    return true;
 }
 
-static void system_api_add_hashrate_monitor(cJSON *root, GlobalState *g) {
-    if (!root || !g || !g->HASHRATE_MONITOR_MODULE.is_initialized) return;
+static void system_api_write_averages(json_writer_t *w, hashrate_ewma_t *ewma) {
+    json_writer_object_begin(w);
+    for (int i = 0; i < HASHRATE_EWMA_HORIZONS; i++) {
+        json_writer_add_number(w, hashrate_ewma_horizon_name(i), hashrate_ewma_get(ewma, i));
+    }
+    json_writer_object_end(w);
+}
 
-    cJSON *monitor = cJSON_CreateObject();
-    cJSON_AddItemToObject(root, "hashrateMonitor", monitor);
-    
-    cJSON *asics = cJSON_CreateArray();
-    cJSON_AddItemToObject(monitor, "asics", asics);
+// Chips are numbered board-wide, the chains each know their own
+static const char *system_api_chip_health(GlobalState *g, int asic_nr) {
+    for (int c = g->asic_chain_count - 1; c >= 0; c--) {
+        const asic_chain_t *chain = &g->ASIC_CHAINS[c].chain;
+        if (asic_nr >= chain->asic_offset && asic_nr - chain->asic_offset < chain->health.chip_count) {
+            return chip_health_state_to_string(chain->health.chips[asic_nr - chain->asic_offset].state);
+        }
+    }
+    return chip_health_state_to_string(CHIP_HEALTH_OK);
+}
+
+static bool system_api_write_hashrate_monitor(GlobalState *g, json_writer_t *w) {
+    if (!g->HASHRATE_MONITOR_MODULE.is_initialized) return false;
+
+    json_writer_object_begin(w);
+
+    json_writer_key(w, "asics");
+    json_writer_array_begin(w);
 
     int asic_count = g->DEVICE_CONFIG.family.asic_count;
     int hash_domains = g->DEVICE_CONFIG.family.asic.hash_domains;
 
     for (int i = 0; i < asic_count; i++) {
-        cJSON *asic = cJSON_CreateObject();
-        cJSON_AddItemToArray(asics, asic);
-        
-        cJSON_AddNumberToObject(asic, "total", g->HASHRATE_MONITOR_MODULE.total_measurement[i].hashrate);
-        cJSON_AddNumberToObject(asic, "errorCount", g->HASHRATE_MONITOR_MODULE.error_measurement[i].value);
-        
-        cJSON *domains = cJSON_CreateArray();
-        cJSON_AddItemToObject(asic, "domains", domains);
+        json_writer_object_begin(w);
+
+        json_writer_add_number(w, "total", g->HASHRATE_MONITOR_MODULE.total_measurement[i].hashrate);
+        json_writer_add_number(w, "errorCount", g->HASHRATE_MONITOR_MODULE.error_measurement[i].value);
+        json_writer_add_string(w, "health", system_api_chip_health(g, i));
+
+        json_writer_key(w, "domains");
+        json_writer_array_begin(w);
+        for (int j = 0; j < hash_domains; j++) {
+            json_writer_number(w, g->HASHRATE_MONITOR_MODULE.domain_measurements[i][j].hashrate);
+        }
+        json_writer_array_end(w);
+
+        json_writer_key(w, "averages");
+        system_api_write_averages(w, &g->HASHRATE_MONITOR_MODULE.asic_ewma[i]);
+
+        json_writer_key(w, "domainAverages");
+        json_writer_array_begin(w);
         for (int j = 0; j < hash_domains; j++) {
-            cJSON_AddItemToArray(domains, cJSON_CreateNumber(g->HASHRATE_MONITOR_MODULE.domain_measurements[i][j].hashrate));
+            system_api_write_averages(w, &g->HASHRATE_MONITOR_MODULE.domain_ewma[i][j]);
         }
+        json_writer_array_end(w);
+
+        json_writer_object_end(w);
     }
+
+    json_writer_array_end(w);
+    json_writer_object_end(w);
+    return true;
 }
 
-static void system_api_add_rejected_reasons(cJSON *root, GlobalState *g) {
-    if (!root || !g) return;
-    cJSON *rejected_reasons = cJSON_CreateArray();
-    if (rejected_reasons) {
-        cJSON_AddItemToObject(root, "sharesRejectedReasons", rejected_reasons);
-        for (int i = 0; i < g->SYSTEM_MODULE.rejected_reason_stats_count; i++) {
-            cJSON *obj = cJSON_CreateObject();
-            if (obj) {
-                cJSON_AddStringToObject(obj, "message", g->SYSTEM_MODULE.rejected_reason_stats[i].message);
-                cJSON_AddNumberToObject(obj, "count", g->SYSTEM_MODULE.rejected_reason_stats[i].count);
-                cJSON_AddItemToArray(rejected_reasons, obj);
-            }
-        }
+static void system_api_write_share_estimate(json_writer_t *w, const share_estimator_t *est, share_estimator_source_t source) {
+    share_estimate_t estimate;
+    share_estimator_get(est, source, &estimate);
+
+    json_writer_object_begin(w);
+    json_writer_add_float(w, "hashrate", estimate.hashrate);
+    json_writer_add_float(w, "low", estimate.low);
+    json_writer_add_float(w, "high", estimate.high);
+    json_writer_add_float(w, "shares", estimate.shares);
+    json_writer_object_end(w);
+}
+
+static bool system_api_write_share_hashrate(GlobalState *g, json_writer_t *w) {
+    SystemModule *module = &g->SYSTEM_MODULE;
+
+    share_estimator_t estimators[POOL_COUNT];
+    taskENTER_CRITICAL(&g->share_estimator_mux);
+    memcpy(estimators, module->share_estimators, sizeof(estimators));
+    taskEXIT_CRITICAL(&g->share_estimator_mux);
+
+    json_writer_object_begin(w);
+
+    // against the chips' own count over the same hour, below 1 is work lost
+    // on the way to the pool or rejected by it
+    share_estimate_t accepted, local;
+    share_estimator_get(&estimators[module->is_using_fallback], SHARE_ESTIMATOR_ACCEPTED, &accepted);
+    share_estimator_get(&estimators[module->is_using_fallback], SHARE_ESTIMATOR_LOCAL, &local);
+    float hashrate = module->hashrate_1h;
+    json_writer_add_float(w, "ratio", hashrate > 0 ? accepted.hashrate / hashrate : 0);
+    json_writer_add_float(w, "localRatio", hashrate > 0 ? local.hashrate / hashrate : 0);
+
+    json_writer_key(w, "pools");
+    json_writer_array_begin(w);
+    for (int i = 0; i < POOL_COUNT; i++) {
+        json_writer_object_begin(w);
+        json_writer_add_string(w, "url", i == 0 ? module->pool_url : module->fallback_pool_url);
+        json_writer_add_bool(w, "active", i == module->is_using_fallback);
+        json_writer_key(w, "accepted");
+        system_api_write_share_estimate(w, &estimators[i], SHARE_ESTIMATOR_ACCEPTED);
+        json_writer_key(w, "local");
+        system_api_write_share_estimate(w, &estimators[i], SHARE_ESTIMATOR_LOCAL);
+        json_writer_object_end(w);
     }
+    json_writer_array_end(w);
+
+    json_writer_object_end(w);
+    return true;
 }
 
-static void system_api_add_block_info(cJSON *root, GlobalState *g) {
-    if (!root || !g || g->block_height <= 0) return;
+static bool system_api_write_autotune(GlobalState *g, json_writer_t *w) {
+    AutotuneModule *autotune = &g->AUTOTUNE_MODULE;
+
+    json_writer_object_begin(w);
+
+    json_writer_add_string(w, "state", autotune_state_to_string(autotune->state));
+    json_writer_add_string(w, "objective", autotune_objective_to_string(autotune->objective));
+    json_writer_add_number(w, "progress", autotune->progress);
+    json_writer_add_number(w, "tested", autotune->tested);
+    json_writer_add_float(w, "frequency", autotune->frequency);
+    json_writer_add_number(w, "coreVoltage", autotune->voltage);
+
+    if (autotune->has_best) {
+        json_writer_key(w, "best");
+        json_writer_object_begin(w);
+        json_writer_add_float(w, "frequency", autotune->best.frequency);
+        json_writer_add_number(w, "coreVoltage", autotune->best.voltage);
+        json_writer_add_float(w, "hashrate", autotune->best.sample.hashrate);
+        json_writer_add_float(w, "power", autotune->best.sample.power);
+        json_writer_add_float(w, "temp", autotune->best.sample.temp);
+        json_writer_add_float(w, "efficiency", autotune_efficiency(&autotune->best.sample));
+        json_writer_object_end(w);
+    }
 
-    cJSON *signals = cJSON_CreateArray();
-    if (signals) {
-        for (int i = 0; i < g->block_signals_count; i++) {
-            cJSON_AddItemToArray(signals, cJSON_CreateString(g->block_signals[i]));
-        }
-        cJSON_AddItemToObject(root, "blockSignals", signals);
+    // the last run that finished, kept across reboots
+    uint16_t voltage = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_VOLTAGE);
+    if (voltage != 0) {
+        autotune_sample_t sample = {
+            .hashrate = nvs_config_get_float(NVS_CONFIG_AUTOTUNE_HASHRATE),
+            .power = nvs_config_get_float(NVS_CONFIG_AUTOTUNE_POWER),
+        };
+        json_writer_key(w, "result");
+        json_writer_object_begin(w);
+        json_writer_add_float(w, "frequency", nvs_config_get_float(NVS_CONFIG_AUTOTUNE_FREQUENCY));
+        json_writer_add_number(w, "coreVoltage", voltage);
+        json_writer_add_float(w, "hashrate", sample.hashrate);
+        json_writer_add_float(w, "power", sample.power);
+        json_writer_add_float(w, "efficiency", autotune_efficiency(&sample));
+        json_writer_object_end(w);
     }
 
-    cJSON *outputs = cJSON_CreateArray();
-    if (outputs) {
-        for (int i = 0; i < g->coinbase_output_count; i++) {
-            cJSON *obj = cJSON_CreateObject();
-            if (obj) {
-                cJSON_AddNumberToObject(obj, "value", g->coinbase_outputs[i].value_satoshis);
-                cJSON_AddStringToObject(obj, "address", g->coinbase_outputs[i].address);
-                cJSON_AddItemToArray(outputs, obj);
-            }
-        }
-        cJSON_AddItemToObject(root, "coinbaseOutputs", outputs);
+    json_writer_object_end(w);
+    return true;
+}
+
+static bool system_api_write_fan_controller(GlobalState *g, json_writer_t *w) {
+    FanControllerModule *fan = &g->FAN_CONTROLLER_MODULE;
+
+    json_writer_object_begin(w);
+
+    json_writer_add_string(w, "region", fan_region_to_string(fan->region));
+    json_writer_add_bool(w, "tuned", fan->tuned);
+    json_writer_add_float(w, "kp", fan->gains.kp);
+    json_writer_add_float(w, "ki", fan->gains.ki);
+    json_writer_add_float(w, "kd", fan->gains.kd);
+    json_writer_add_string(w, "autotune", pid_autotune_state_to_string(fan->autotune.state));
+
+    if (fan->autotune.state == PID_AUTOTUNE_DONE) {
+        json_writer_add_float(w, "plantGain", fan->autotune.plant_gain);
+        json_writer_add_float(w, "deadTime", fan->autotune.dead_time);
     }
+
+    json_writer_object_end(w);
+    return true;
 }
 
-cJSON* system_api_get_full_json(GlobalState *g) {
-    if (!g) return NULL;
-    cJSON *root = cJSON_CreateObject();
-    if (root == NULL) return NULL;
+static bool system_api_write_rejected_reasons(GlobalState *g, json_writer_t *w) {
+    json_writer_array_begin(w);
+    for (int i = 0; i < g->SYSTEM_MODULE.rejected_reason_stats_count; i++) {
+        json_writer_object_begin(w);
+        json_writer_add_string(w, "message", g->SYSTEM_MODULE.rejected_reason_stats[i].message);
+        json_writer_add_number(w, "count", g->SYSTEM_MODULE.rejected_reason_stats[i].count);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+    return true;
+}
 
-    system_api_add_telemetry(root, g);
-    system_api_add_config(root, g);
-    system_api_add_hashrate_monitor(root, g);
+static bool system_api_write_block_signals(GlobalState *g, json_writer_t *w) {
+    if (g->block_height <= 0) return false;
 
-    // Arrays that involve global state loops (not simple addition)
-    system_api_add_rejected_reasons(root, g);
-    system_api_add_block_info(root, g);
+    json_writer_array_begin(w);
+    for (int i = 0; i < g->block_signals_count; i++) {
+        json_writer_string(w, g->block_signals[i]);
+    }
+    json_writer_array_end(w);
+    return true;
+}
+
+static bool system_api_write_coinbase_outputs(GlobalState *g, json_writer_t *w) {
+    if (g->block_height <= 0) return false;
+
+    json_writer_array_begin(w);
+    for (int i = 0; i < g->coinbase_output_count; i++) {
+        json_writer_object_begin(w);
+        json_writer_add_number(w, "value", g->coinbase_outputs[i].value_satoshis);
+        json_writer_add_string(w, "address", g->coinbase_outputs[i].address);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+    return true;
+}
 
-    return root;
+bool system_api_write_tasks(GlobalState *g, json_writer_t *w) {
+    task_stats_t tasks[TASK_MONITOR_MAX_TASKS];
+    task_latency_t latencies[TASK_MONITOR_PROBE_COUNT];
+    size_t task_count = task_monitor_get_tasks(tasks, TASK_MONITOR_MAX_TASKS);
+    size_t latency_count = task_monitor_get_latencies(latencies, TASK_MONITOR_PROBE_COUNT);
+
+    json_writer_object_begin(w);
+
+    json_writer_key(w, "tasks");
+    json_writer_array_begin(w);
+    for (size_t i = 0; i < task_count; i++) {
+        json_writer_object_begin(w);
+        json_writer_add_string(w, "name", tasks[i].name);
+        json_writer_add_float(w, "cpu", roundf(tasks[i].cpu * 10.0f) / 10.0f);
+        json_writer_add_number(w, "stackFree", tasks[i].stack_free);
+        json_writer_add_number(w, "priority", tasks[i].priority);
+        json_writer_add_number(w, "core", tasks[i].core);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+
+    json_writer_key(w, "latency");
+    json_writer_array_begin(w);
+    for (size_t i = 0; i < latency_count; i++) {
+        json_writer_object_begin(w);
+        json_writer_add_string(w, "task", latencies[i].name);
+        json_writer_add_number(w, "priority", latencies[i].priority);
+        json_writer_add_number(w, "core", latencies[i].core);
+        json_writer_add_number(w, "averageUs", latencies[i].average_us);
+        json_writer_add_number(w, "maxUs", latencies[i].max_us);
+        json_writer_add_number(w, "samples", latencies[i].samples);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+
+    json_writer_object_end(w);
+    return true;
+}
+
+const telemetry_field_t SYSTEM_API_FIELDS[] = {
+    // Power Group
+    { "power", TELEMETRY_FLOAT, get_power, 0.01f },
+    { "voltage", TELEMETRY_FLOAT, get_voltage, 1.0f },
+    { "current", TELEMETRY_FLOAT, get_current, 1.0f },
+    { "temp", TELEMETRY_FLOAT, get_temp, 0.1f },
+    { "temp2", TELEMETRY_FLOAT, get_temp2, 0.1f },
+    { "vrTemp", TELEMETRY_FLOAT, get_vr_temp, 0.1f },
+    { "coreVoltageActual", TELEMETRY_FLOAT, get_core_voltage_actual, 1.0f },
+    { "actualFrequency", TELEMETRY_FLOAT, get_actual_frequency, 0.01f },
+    { "expectedHashrate", TELEMETRY_FLOAT, get_expected_hashrate, 0.01f },
+    { "fanspeed", TELEMETRY_NUMBER, get_fan_speed },
+    { "fanrpm", TELEMETRY_NUMBER, get_fan_rpm, 10.0f },
+    { "fan2rpm", TELEMETRY_NUMBER, get_fan2_rpm, 10.0f },
+
+    // Hashrate / Mining Group
+    { "hashRate", TELEMETRY_FLOAT, get_hashrate, 0.01f },
+    { "hashRate_1m", TELEMETRY_FLOAT, get_hashrate_1m, 0.01f },
+    { "hashRate_10m", TELEMETRY_FLOAT, get_hashrate_10m, 0.01f },
+    { "hashRate_1h", TELEMETRY_FLOAT, get_hashrate_1h, 0.01f },
+    { "hashRate_5s", TELEMETRY_FLOAT, get_hashrate_5s, 0.01f },
+    { "hashRate_15m", TELEMETRY_FLOAT, get_hashrate_15m, 0.01f },
+    { "hashRate_24h", TELEMETRY_FLOAT, get_hashrate_24h, 0.01f },
+    { "errorPercentage", TELEMETRY_FLOAT, get_error_percentage, 0.01f },
+    { "sharesAccepted", TELEMETRY_NUMBER, get_shares_accepted },
+    { "sharesRejected", TELEMETRY_NUMBER, get_shares_rejected },
+    { "bestDiff", TELEMETRY_NUMBER, get_best_diff },
+    { "bestSessionDiff", TELEMETRY_NUMBER, get_best_session_diff },
+    { "poolDifficulty", TELEMETRY_NUMBER, get_pool_difficulty },
+    { "responseTime", TELEMETRY_FLOAT, get_response_time, 0.1f },
+    { "responseShareBatch", TELEMETRY_NUMBER, get_response_share_batch },
+    { "processTime", TELEMETRY_FLOAT, get_process_time, 0.1f },
+    { "jobInterval", TELEMETRY_FLOAT, get_job_interval, 0.1f },
+    { "jobIntervalReason", TELEMETRY_STRING, get_job_interval_reason },
+    { "jobIntervalChanges", TELEMETRY_NUMBER, get_job_interval_changes },
+    { "staleNonces", TELEMETRY_NUMBER, get_stale_nonces },
+    { "rxCollisions", TELEMETRY_NUMBER, get_rx_collisions },
+    { "chainResets", TELEMETRY_NUMBER, get_chain_resets },
+
+    // Dynamic Block Info
+    { "blockFound", TELEMETRY_NUMBER, get_block_found },
+    { "showNewBlock", TELEMETRY_BOOL, get_show_new_block },
+    { "blockHeight", TELEMETRY_NUMBER, get_block_height },
+    { "scriptsig", TELEMETRY_STRING, get_scriptsig },
+    { "networkDifficulty", TELEMETRY_NUMBER, get_network_difficulty },
+    { "coinbaseValueTotalSatoshis", TELEMETRY_NUMBER, get_coinbase_value_total },
+    { "coinbaseValueUserSatoshis", TELEMETRY_NUMBER, get_coinbase_value_user },
+
+    // Dynamic System Stats
+    { "freeHeap", TELEMETRY_NUMBER, get_free_heap, 1024.0f },
+    { "freeHeapInternal", TELEMETRY_NUMBER, get_free_heap_internal, 1024.0f },
+    { "freeHeapSpiram", TELEMETRY_NUMBER, get_free_heap_spiram, 1024.0f },
+    { "uptimeSeconds", TELEMETRY_NUMBER, get_uptime_seconds },
+    { "cpuUsage", TELEMETRY_FLOAT, get_cpu_usage, 0.1f },
+    { "miningPaused", TELEMETRY_BOOL, get_mining_paused },
+    { "powerLimited", TELEMETRY_BOOL, get_power_limited },
+    { "thermalLimited", TELEMETRY_BOOL, get_thermal_limited },
+    { "overheat_mode", TELEMETRY_NUMBER, get_overheat_mode },
+    { "wifiStatus", TELEMETRY_STRING, get_wifi_status },
+    { "wifiRSSI", TELEMETRY_NUMBER, get_wifi_rssi },
+
+    // Faults
+    { "power_fault", TELEMETRY_STRING, get_power_fault },
+    { "hardware_fault", TELEMETRY_STRING, get_hardware_fault },
+
+    // Settings and versions rarely change, and cost NVS reads
+    { "config", TELEMETRY_MEMBERS, .every = SYSTEM_API_CONFIG_EVERY, .write = system_api_write_config },
+
+    { "hashrateMonitor", TELEMETRY_JSON, .write = system_api_write_hashrate_monitor },
+    { "shareHashrate", TELEMETRY_JSON, .write = system_api_write_share_hashrate },
+    { "autotune", TELEMETRY_JSON, .write = system_api_write_autotune },
+    { "fanController", TELEMETRY_JSON, .write = system_api_write_fan_controller },
+
+    // Arrays that involve global state loops (not simple addition)
+    { "sharesRejectedReasons", TELEMETRY_JSON, .write = system_api_write_rejected_reasons },
+    { "blockSignals", TELEMETRY_JSON, .write = system_api_write_block_signals },
+    { "coinbaseOutputs", TELEMETRY_JSON, .write = system_api_write_coinbase_outputs },
+
+#ifdef CONFIG_ENABLE_TASK_MONITOR
+    // Only changes once per task sample
+    { "tasks", TELEMETRY_JSON, .every = SYSTEM_API_TASKS_EVERY, .write = system_api_write_tasks },
+#endif
+};
+
+const int SYSTEM_API_FIELD_COUNT = sizeof(SYSTEM_API_FIELDS) / sizeof(SYSTEM_API_FIELDS[0]);
+
+void system_api_write_json(GlobalState *g, json_writer_t *w) {
+    json_writer_object_begin(w);
+    telemetry_write_members(SYSTEM_API_FIELDS, SYSTEM_API_FIELD_COUNT, g, w);
+    json_writer_object_end(w);
 }
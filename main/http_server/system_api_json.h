@@ -3,16 +3,38 @@
 
 #include "cJSON.h"
 #include "global_state.h"
+#include "telemetry.h"
+#include "json_writer.h"
+
+// Updates between looks at the settings when nothing marked them dirty
+#define SYSTEM_API_CONFIG_EVERY 20
+
+// Updates between looks at the task sample, about as often as it is taken
+#define SYSTEM_API_TASKS_EVERY 10
+
+/**
+ * @brief The fields of the system JSON, in the order they appear in it.
+ */
+extern const telemetry_field_t SYSTEM_API_FIELDS[];
+extern const int SYSTEM_API_FIELD_COUNT;
 
 /**
- * @brief Generates a full system information JSON object.
+ * @brief Writes the full system information JSON object.
  * 
  * This is the single source of truth for both the REST API and the WebSocket initial handshake.
  * 
  * @param g Pointer to the GlobalState structure.
- * @return cJSON* The root JSON object. Caller is responsible for cJSON_Delete().
+ * @param w Writer the object is streamed through.
+ */
+void system_api_write_json(GlobalState *g, json_writer_t *w);
+
+/**
+ * @brief Writes the per task CPU, stack and priority of the last task sample,
+ * and the wake up latency of the mining tasks' probes.
+ *
+ * Served on its own by /api/system/tasks, and as the tasks section of the system JSON.
  */
-cJSON* system_api_get_full_json(GlobalState *g);
+bool system_api_write_tasks(GlobalState *g, json_writer_t *w);
 
 /**
  * @brief Custom helper to create a JSON number from a float with fixed decimal precision.
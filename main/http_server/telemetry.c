@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "telemetry.h"
+
+esp_err_t telemetry_init(telemetry_t * telemetry, const telemetry_field_t * fields, int field_count)
+{
+    memset(telemetry, 0, sizeof(*telemetry));
+    telemetry->state = calloc(field_count, sizeof(telemetry_state_t));
+    if (NULL == telemetry->state) {
+        return ESP_ERR_NO_MEM;
+    }
+    telemetry->fields = fields;
+    telemetry->field_count = field_count;
+    telemetry->dirty = true;
+    return ESP_OK;
+}
+
+void telemetry_free(telemetry_t * telemetry)
+{
+    free(telemetry->state);
+    telemetry->state = NULL;
+    telemetry_buffer_free(&telemetry->scratch);
+}
+
+void telemetry_mark_dirty(telemetry_t * telemetry)
+{
+    telemetry->dirty = true;
+}
+
+bool telemetry_buffer_append(telemetry_buffer_t * buffer, const char * data, size_t length)
+{
+    if (buffer->length + length + 1 > buffer->size) {
+        size_t size = buffer->size ? buffer->size : 256;
+        while (buffer->length + length + 1 > size) size *= 2;
+
+        char * data_new = realloc(buffer->data, size);
+        if (NULL == data_new) {
+            return false;
+        }
+        buffer->data = data_new;
+        buffer->size = size;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+    return true;
+}
+
+void telemetry_buffer_free(telemetry_buffer_t * buffer)
+{
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+static esp_err_t append_to_buffer(void * context, const char * data, size_t length)
+{
+    return telemetry_buffer_append(context, data, length) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// Writes into the buffer, inside the object or map begun before it
+static void writer_init(json_writer_t * w, char * chunk, size_t size, telemetry_format_t format, telemetry_buffer_t * buffer)
+{
+    json_writer_init(w, chunk, size, format == TELEMETRY_FORMAT_CBOR, append_to_buffer, buffer);
+    json_writer_continue_object(w);
+}
+
+static uint32_t hash_text(const char * text, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool is_number(telemetry_type_t type)
+{
+    return type == TELEMETRY_FLOAT || type == TELEMETRY_NUMBER || type == TELEMETRY_BOOL;
+}
+
+static void write_scalar(json_writer_t * w, const telemetry_field_t * field, const telemetry_value_t * value)
+{
+    switch (field->type) {
+        case TELEMETRY_FLOAT:
+            json_writer_float(w, value->number);
+            break;
+        case TELEMETRY_NUMBER:
+            json_writer_number(w, value->number);
+            break;
+        case TELEMETRY_BOOL:
+            json_writer_bool(w, value->number != 0);
+            break;
+        case TELEMETRY_STRING:
+            json_writer_string(w, value->string ? value->string : "");
+            break;
+        case TELEMETRY_JSON:
+        case TELEMETRY_MEMBERS:
+            break;
+    }
+}
+
+static void write_key(json_writer_t * w, int id, const telemetry_field_t * field)
+{
+    if (w->cbor) {
+        json_writer_key_id(w, id);
+    } else {
+        json_writer_key(w, field->name);
+    }
+}
+
+// Writes a section straight from its getter, returns false when it is left out
+static bool write_section(json_writer_t * w, int id, const telemetry_field_t * field, GlobalState * g)
+{
+    bool present;
+
+    if (field->type == TELEMETRY_MEMBERS && !w->cbor) {
+        return field->write(g, w);
+    }
+
+    write_key(w, id, field);
+    if (field->type == TELEMETRY_MEMBERS) {
+        // a map of their own in CBOR, as they are under an id
+        json_writer_object_begin(w);
+        present = field->write(g, w);
+        json_writer_object_end(w);
+    } else {
+        present = field->write(g, w);
+        json_writer_key(w, NULL);
+    }
+    return present;
+}
+
+// Writes a section's JSON into the scratch buffer, to compare it
+static bool print_section(telemetry_t * telemetry, const telemetry_field_t * field, GlobalState * g)
+{
+    char chunk[128];
+    json_writer_t w;
+
+    telemetry->scratch.length = 0;
+    json_writer_init(&w, chunk, sizeof(chunk), false, append_to_buffer, &telemetry->scratch);
+    if (field->type == TELEMETRY_MEMBERS) {
+        json_writer_continue_object(&w);
+    }
+    bool present = field->write(g, &w);
+    return json_writer_finish(&w) == ESP_OK && present;
+}
+
+int telemetry_update(telemetry_t * telemetry, GlobalState * g, telemetry_buffer_t * buffers[TELEMETRY_FORMAT_COUNT])
+{
+    char chunks[TELEMETRY_FORMAT_COUNT][128];
+    json_writer_t writers[TELEMETRY_FORMAT_COUNT];
+    int written = 0;
+
+    for (int f = 0; f < TELEMETRY_FORMAT_COUNT; f++) {
+        if (buffers[f]) {
+            writer_init(&writers[f], chunks[f], sizeof(chunks[f]), f, buffers[f]);
+        }
+    }
+
+    telemetry->updates++;
+
+    for (int i = 0; i < telemetry->field_count; i++) {
+        const telemetry_field_t * field = &telemetry->fields[i];
+        telemetry_state_t * state = &telemetry->state[i];
+
+        if (!telemetry->dirty && field->every > 1 && telemetry->updates % field->every != 0) {
+            continue;
+        }
+
+        bool section = field->type == TELEMETRY_JSON || field->type == TELEMETRY_MEMBERS;
+        telemetry_value_t value = {0};
+        bool present = section ? print_section(telemetry, field, g) : field->get(g, &value);
+        if (!present) {
+            // there is no taking a member back from the client, it just goes stale
+            state->present = false;
+            continue;
+        }
+
+        bool changed;
+        if (is_number(field->type)) {
+            if (!state->present || !isnan(value.number) != !isnan(state->number)) {
+                changed = true;
+            } else if (isnan(value.number)) {
+                changed = false;
+            } else if (field->threshold > 0) {
+                changed = fabs(value.number - state->number) > field->threshold;
+            } else {
+                changed = value.number != state->number;
+            }
+            state->number = changed ? value.number : state->number;
+        } else {
+            const char * text = section ? telemetry->scratch.data : value.string;
+            size_t length = section ? telemetry->scratch.length : (text ? strlen(text) : 0);
+            uint32_t hash = text ? hash_text(text, length) : 0;
+            changed = !state->present || hash != state->hash;
+            state->hash = hash;
+        }
+
+        if (!changed) {
+            continue;
+        }
+
+        for (int f = 0; f < TELEMETRY_FORMAT_COUNT; f++) {
+            if (!buffers[f]) continue;
+            json_writer_t * w = &writers[f];
+
+            if (!section) {
+                write_key(w, i, field);
+                write_scalar(w, field, &value);
+            } else if (f == TELEMETRY_FORMAT_CBOR) {
+                // written again, the scratch only holds JSON
+                write_section(w, i, field, g);
+            } else if (field->type == TELEMETRY_MEMBERS) {
+                json_writer_raw_members(w, telemetry->scratch.data, telemetry->scratch.length);
+            } else {
+                json_writer_key(w, field->name);
+                json_writer_raw(w, telemetry->scratch.data, telemetry->scratch.length);
+            }
+        }
+        state->present = true;
+        state->version = telemetry->version + 1;
+        written++;
+    }
+
+    for (int f = 0; f < TELEMETRY_FORMAT_COUNT; f++) {
+        if (buffers[f]) {
+            json_writer_finish(&writers[f]);
+        }
+    }
+
+    if (written > 0) {
+        telemetry->version++;
+    }
+    telemetry->dirty = false;
+    return written;
+}
+
+void telemetry_write_members(const telemetry_field_t * fields, int field_count, GlobalState * g, json_writer_t * w)
+{
+    for (int i = 0; i < field_count; i++) {
+        const telemetry_field_t * field = &fields[i];
+
+        if (field->type == TELEMETRY_JSON || field->type == TELEMETRY_MEMBERS) {
+            write_section(w, i, field, g);
+            continue;
+        }
+
+        telemetry_value_t value = {0};
+        if (field->get(g, &value)) {
+            write_key(w, i, field);
+            write_scalar(w, field, &value);
+        }
+    }
+}
+
+esp_err_t telemetry_write_all(const telemetry_field_t * fields, int field_count, GlobalState * g,
+                              telemetry_format_t format, telemetry_buffer_t * buffer)
+{
+    char chunk[256];
+    json_writer_t w;
+
+    writer_init(&w, chunk, sizeof(chunk), format, buffer);
+    telemetry_write_members(fields, field_count, g, &w);
+    return json_writer_finish(&w);
+}
+
+const char * telemetry_type_to_string(telemetry_type_t type)
+{
+    switch (type) {
+        case TELEMETRY_FLOAT: return "float";
+        case TELEMETRY_NUMBER: return "number";
+        case TELEMETRY_BOOL: return "bool";
+        case TELEMETRY_STRING: return "string";
+        case TELEMETRY_JSON: return "json";
+        case TELEMETRY_MEMBERS: return "members";
+    }
+    return "unknown";
+}
@@ -0,0 +1,118 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "global_state.h"
+#include "json_writer.h"
+
+// A registry of the fields of the system JSON, so the websocket feed only
+// has to look at each field to know whether it changed, and only writes out
+// the ones that did, instead of building and diffing the whole tree.
+//
+// Numbers count as changed once they moved more than their threshold away
+// from the value last sent, strings and sections once their text differs.
+// Every field keeps the version it last changed in.
+//
+// The same changes can be written as JSON members, or as CBOR (RFC 8949)
+// pairs keyed by the index of the field in the table instead of its name.
+// Floats go out as float32, whole numbers as integers, sections as maps and
+// arrays with their names kept. Everything is written through a json_writer,
+// so neither the feed nor the REST API build a cJSON tree of it.
+
+typedef enum
+{
+    TELEMETRY_FLOAT,        // rounded like cJSON_AddFloatToObject
+    TELEMETRY_NUMBER,
+    TELEMETRY_BOOL,
+    TELEMETRY_STRING,
+    TELEMETRY_JSON,         // a section, written under the name
+    TELEMETRY_MEMBERS,      // a section whose members go in the root
+} telemetry_type_t;
+
+typedef enum
+{
+    TELEMETRY_FORMAT_JSON,
+    TELEMETRY_FORMAT_CBOR,
+    TELEMETRY_FORMAT_COUNT,
+} telemetry_format_t;
+
+typedef struct
+{
+    double number;          // FLOAT, NUMBER and BOOL
+    const char * string;    // STRING
+} telemetry_value_t;
+
+// Returns false when the field is left out, like the block info before the first job
+typedef bool (*telemetry_getter_t)(GlobalState * g, telemetry_value_t * value);
+
+// Writes a section, one value for JSON, the members for MEMBERS. Returns
+// false without writing anything when the section is left out.
+typedef bool (*telemetry_section_t)(GlobalState * g, json_writer_t * w);
+
+typedef struct
+{
+    const char * name;
+    telemetry_type_t type;
+    telemetry_getter_t get;
+    float threshold;        // numbers only, 0 for any change
+    uint8_t every;          // looked at every so many updates, 0 or 1 for each
+    telemetry_section_t write;  // JSON and MEMBERS, instead of get
+} telemetry_field_t;
+
+typedef struct
+{
+    bool present;
+    double number;
+    uint32_t hash;          // of the string, or of the section's JSON
+    uint32_t version;
+} telemetry_state_t;
+
+// Grows to the largest message once, then is reused
+typedef struct
+{
+    char * data;
+    size_t length;
+    size_t size;
+} telemetry_buffer_t;
+
+typedef struct
+{
+    const telemetry_field_t * fields;
+    int field_count;
+    telemetry_state_t * state;
+    telemetry_buffer_t scratch;  // a section's JSON, to compare it
+    uint32_t version;       // of the last update that changed anything
+    uint32_t updates;
+    bool dirty;             // look at every field on the next update
+} telemetry_t;
+
+esp_err_t telemetry_init(telemetry_t * telemetry, const telemetry_field_t * fields, int field_count);
+
+void telemetry_free(telemetry_t * telemetry);
+
+// Makes the next update look at the fields that are not looked at every time,
+// for when the settings changed
+void telemetry_mark_dirty(telemetry_t * telemetry);
+
+// Writes the fields that changed since the last update into the buffers of
+// the formats wanted, the others are NULL, and remembers them as sent. JSON
+// gets "name":value pairs separated by commas without the braces, CBOR the
+// id/value pairs without the map head. Returns the number of fields written.
+int telemetry_update(telemetry_t * telemetry, GlobalState * g, telemetry_buffer_t * buffers[TELEMETRY_FORMAT_COUNT]);
+
+// Writes every field, leaving the state alone, for a new client
+esp_err_t telemetry_write_all(const telemetry_field_t * fields, int field_count, GlobalState * g,
+                              telemetry_format_t format, telemetry_buffer_t * buffer);
+
+// Writes every field as members of the object the writer is in
+void telemetry_write_members(const telemetry_field_t * fields, int field_count, GlobalState * g, json_writer_t * w);
+
+const char * telemetry_type_to_string(telemetry_type_t type);
+
+bool telemetry_buffer_append(telemetry_buffer_t * buffer, const char * data, size_t length);
+
+void telemetry_buffer_free(telemetry_buffer_t * buffer);
+
+#endif /* TELEMETRY_H_ */
@@ -153,14 +153,21 @@ esp_err_t websocket_handler(httpd_req_t *req)
         }
 
         uint32_t type = (uint32_t)(uintptr_t)req->user_ctx;
+        char subprotocol[32];
+        if (type == WS_TYPE_API &&
+            httpd_req_get_hdr_value_str(req, "Sec-WebSocket-Protocol", subprotocol, sizeof(subprotocol)) == ESP_OK &&
+            strcmp(subprotocol, WEBSOCKET_API_CBOR_SUBPROTOCOL) == 0) {
+            type = WS_TYPE_API_CBOR;
+        }
+
         int fd = httpd_req_to_sockfd(req);
         if (websocket_add_client(fd, type) != ESP_OK) {
             ESP_LOGE(TAG, "Unexpected failure adding client, fd: %d", fd);
             return ESP_FAIL;
         }
 
-        if (type == WS_TYPE_API) {
-            websocket_api_on_connect(fd);
+        if (type == WS_TYPE_API || type == WS_TYPE_API_CBOR) {
+            websocket_api_on_connect(fd, type == WS_TYPE_API_CBOR);
         }
 
         return ESP_OK;
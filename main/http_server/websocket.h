@@ -17,6 +17,7 @@ void websocket_set_log_task_handle(TaskHandle_t task_handle);
 typedef enum {
     WS_TYPE_LOGS,
     WS_TYPE_API,
+    WS_TYPE_API_CBOR,   // the same feed as WS_TYPE_API, negotiated as binary
     WS_TYPE_MAX
 } WebSocketClientType;
 
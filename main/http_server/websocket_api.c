@@ -4,88 +4,95 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
-#include "cJSON.h"
 #include "websocket_api.h"
 #include "websocket.h"
 #include "global_state.h"
 #include "system_api_json.h"
-#include "cjson_utils.h"
+#include "telemetry.h"
 
 #define WEBSOCKET_API_RATE_LIMIT_MS 500
 
 static const char *TAG = "websocket_api";
 static GlobalState *GLOBAL_STATE = NULL;
 
-static int prebuffer_len = 256;
+static telemetry_t telemetry;
+static bool telemetry_ready = false;
+
+static const char MESSAGE_START[] = "{\"event\":\"update\",\"data\":{";
+static const char MESSAGE_END[] = "}}";
+
+// A CBOR map of indefinite length, from field id to value
+static const char CBOR_START[] = "\xbf";
+static const char CBOR_END[] = "\xff";
+
+static const WebSocketClientType CLIENT_TYPES[TELEMETRY_FORMAT_COUNT] = {
+    [TELEMETRY_FORMAT_JSON] = WS_TYPE_API,
+    [TELEMETRY_FORMAT_CBOR] = WS_TYPE_API_CBOR,
+};
+
+static void begin_update(telemetry_buffer_t *buffer, telemetry_format_t format)
+{
+    buffer->length = 0;
+    if (format == TELEMETRY_FORMAT_CBOR) {
+        telemetry_buffer_append(buffer, CBOR_START, sizeof(CBOR_START) - 1);
+    } else {
+        telemetry_buffer_append(buffer, MESSAGE_START, sizeof(MESSAGE_START) - 1);
+    }
+}
 
 /**
- * @brief Builds the JSON update message and broadcasts it.
- * 
- * @param last_state The previous full JSON state (will be used for diffing).
+ * @brief Closes and sends an update message begun with begin_update.
+ *
+ * @param buffer Holds the start of the message followed by the fields.
  * @param fd Client file descriptor (-1 for broadcast).
- * @return cJSON* The new full JSON state that should track current reality.
  */
-static cJSON* process_and_send_update(cJSON *last_state, int fd)
+static void send_update(telemetry_buffer_t *buffer, telemetry_format_t format, int fd)
 {
-    cJSON *current_full = system_api_get_full_json(GLOBAL_STATE);
-    if (!current_full) return last_state; // Keep last state if we failed to generate new one
-
-    cJSON *diff = cJSON_GetDiff(last_state, current_full);
-    
-    // If no changes found, nothing to send
-    if (diff == NULL) {
-        if (fd != -1) {
-             // For specific client connection, we MUST send something.
-             // If Diff against null, it will be the full house. 
-             // If last_state was null, diff won't be null.
-        } else {
-            return current_full;
-        }
+    bool ok = format == TELEMETRY_FORMAT_CBOR
+        ? telemetry_buffer_append(buffer, CBOR_END, sizeof(CBOR_END) - 1)
+        : telemetry_buffer_append(buffer, MESSAGE_END, sizeof(MESSAGE_END) - 1);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to allocate the update message");
+        return;
     }
 
-    if (diff) {
-        cJSON *msg = cJSON_CreateObject();
-        if (msg) {
-            cJSON_AddStringToObject(msg, "event", "update");
-            cJSON_AddItemToObject(msg, "data", diff);
-
-            const char * json_str = cJSON_PrintBuffered(msg, prebuffer_len, false);
-            if (json_str != NULL) {
-                int len = strlen(json_str);
-                if (len > prebuffer_len) prebuffer_len = len * 1.2;
-
-                httpd_ws_frame_t ws_pkt;
-                memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-                ws_pkt.payload = (uint8_t *)json_str;
-                ws_pkt.len = strlen(json_str);
-                ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-
-                if (fd == -1) {
-                    websocket_broadcast(WS_TYPE_API, &ws_pkt);
-                } else {
-                    websocket_send_to_client(fd, &ws_pkt);
-                }
-                free((void *)json_str);
-            }
-            cJSON_Delete(msg);
-        } else {
-            cJSON_Delete(diff);
-        }
-    }
+    httpd_ws_frame_t ws_pkt;
+    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+    ws_pkt.payload = (uint8_t *)buffer->data;
+    ws_pkt.len = buffer->length;
+    ws_pkt.type = format == TELEMETRY_FORMAT_CBOR ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
 
-    return current_full;
+    if (fd == -1) {
+        websocket_broadcast(CLIENT_TYPES[format], &ws_pkt);
+    } else {
+        websocket_send_to_client(fd, &ws_pkt);
+    }
 }
 
-void websocket_api_on_connect(int fd)
+void websocket_api_on_connect(int fd, bool binary)
 {
     if (GLOBAL_STATE == NULL) {
         ESP_LOGW(TAG, "Cannot send initial state, GLOBAL_STATE not yet initialized");
         return;
     }
 
-    // On connect, we diff against NULL to send the full current state
-    cJSON *full = process_and_send_update(NULL, fd);
-    cJSON_Delete(full);
+    // A new client gets every field, the registry is left to the task
+    telemetry_format_t format = binary ? TELEMETRY_FORMAT_CBOR : TELEMETRY_FORMAT_JSON;
+    telemetry_buffer_t buffer = {0};
+    begin_update(&buffer, format);
+    if (telemetry_write_all(SYSTEM_API_FIELDS, SYSTEM_API_FIELD_COUNT, GLOBAL_STATE, format, &buffer) == ESP_OK) {
+        send_update(&buffer, format, fd);
+    } else {
+        ESP_LOGE(TAG, "Failed to allocate the initial state");
+    }
+    telemetry_buffer_free(&buffer);
+}
+
+void websocket_api_mark_dirty(void)
+{
+    if (telemetry_ready) {
+        telemetry_mark_dirty(&telemetry);
+    }
 }
 
 void websocket_api_task(void *pvParameters)
@@ -93,37 +100,50 @@ void websocket_api_task(void *pvParameters)
     GLOBAL_STATE = (GlobalState *)pvParameters;
     ESP_LOGI(TAG, "websocket_api_task starting");
 
+    if (telemetry_init(&telemetry, SYSTEM_API_FIELDS, SYSTEM_API_FIELD_COUNT) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate the telemetry registry");
+        vTaskDelete(NULL);
+        return;
+    }
+    telemetry_ready = true;
+
     // Wait until network is connected before proceeding
     while (!GLOBAL_STATE->SYSTEM_MODULE.is_connected) {
         vTaskDelay(pdMS_TO_TICKS(100));
     }
 
-    // Initialize the baseline state
-    cJSON *last_full_json = system_api_get_full_json(GLOBAL_STATE);
+    // Reused for every update, each grows to the largest one
+    telemetry_buffer_t buffers[TELEMETRY_FORMAT_COUNT] = {0};
 
     while (true) {
         vTaskDelay(pdMS_TO_TICKS(WEBSOCKET_API_RATE_LIMIT_MS));
 
-        // If no clients are connected, hibernate to save CPU/Memory churn
-        if (websocket_get_active_client_count(WS_TYPE_API) == 0) {
-            if (last_full_json) {
-                cJSON_Delete(last_full_json);
-                last_full_json = NULL;
+        // Only write the formats someone is listening to
+        telemetry_buffer_t *wanted[TELEMETRY_FORMAT_COUNT] = {0};
+        int clients = 0;
+        for (int format = 0; format < TELEMETRY_FORMAT_COUNT; format++) {
+            if (websocket_get_active_client_count(CLIENT_TYPES[format]) > 0) {
+                wanted[format] = &buffers[format];
+                begin_update(wanted[format], format);
+                clients++;
             }
-            continue;
         }
 
-        // We have clients. If we were hibernating, initialize the baseline now
-        if (last_full_json == NULL) {
-            last_full_json = system_api_get_full_json(GLOBAL_STATE);
+        // If no clients are connected, hibernate to save CPU/Memory churn
+        if (clients == 0) {
+            continue;
         }
 
-        // Process diff and rotate state
-        cJSON *new_full_json = process_and_send_update(last_full_json, -1);
-        
-        if (new_full_json != last_full_json) {
-            cJSON_Delete(last_full_json);
-            last_full_json = new_full_json;
+        // After hibernating this is against what was sent before, so it
+        // repeats part of what a new client got on connect, but nothing
+        // that changed since is lost
+        int changed = telemetry_update(&telemetry, GLOBAL_STATE, wanted);
+        if (changed > 0) {
+            for (int format = 0; format < TELEMETRY_FORMAT_COUNT; format++) {
+                if (wanted[format]) {
+                    send_update(wanted[format], format, -1);
+                }
+            }
         }
     }
 }
@@ -1,7 +1,15 @@
 #ifndef WEBSOCKET_API_H_
 #define WEBSOCKET_API_H_
 
+#include <stdbool.h>
+
+// Offered by clients that want the feed as CBOR, see telemetry.h
+#define WEBSOCKET_API_CBOR_SUBPROTOCOL "axeos-telemetry-cbor"
+
 void websocket_api_task(void *pvParameters);
-void websocket_api_on_connect(int fd);
+void websocket_api_on_connect(int fd, bool binary);
+
+// Makes the next update look at the settings, after they were changed
+void websocket_api_mark_dirty(void);
 
 #endif /* WEBSOCKET_API_H_ */
@@ -18,7 +18,7 @@ void websocket_log_task(void *pvParameters)
     ESP_LOGI(TAG, "websocket_log_task starting");
 
     // Initialize position to the current end of buffer to start with "live" logs
-    uint64_t last_read_abs = log_buffer_get_total_written();
+    uint64_t last_read_abs = log_buffer_get_end();
     char *scratch_buf = (char *)malloc(WS_LOG_CHUNK_SIZE);
     if (!scratch_buf) {
         ESP_LOGE(TAG, "Failed to allocate scratch buffer");
@@ -34,7 +34,7 @@ void websocket_log_task(void *pvParameters)
         // Only drain if we actually have clients interested
         if (websocket_get_active_client_count(WS_TYPE_LOGS) == 0) {
             // Keep up with current pointer so we don't dump everything when someone connects
-            last_read_abs = log_buffer_get_total_written();
+            last_read_abs = log_buffer_get_end();
             continue;
         }
 
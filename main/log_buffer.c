@@ -1,4 +1,6 @@
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,224 +8,909 @@
 
 #include "esp_log.h"
 #include "esp_attr.h"
-#include "esp_heap_caps.h"
+#include "esp_app_desc.h"
+#include "esp_cache.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 
 #include "log_buffer.h"
+#include "nvs_config.h"
 #include "websocket.h"
-#include "esp_cache.h"
 
 static const char * TAG = "log_buffer";
 
-// Increment this when log_buffer_header_t struct changes
-#define LOG_BUFFER_MAGIC 0xB17A5E10 
+// Log lines are kept as binary records: the format string, which lives in
+// flash, and the arguments it was called with. Formatting them is left to
+// whoever reads the log, so an ESP_LOG call only scans its format, copies
+// the arguments and never waits on a lock.
+//
+// Each core has a ring of its own, so the cores do not fight over its head.
+// Space is claimed by moving the head forward with a compare-and-swap, and a
+// record counts once its header holds the position it was written at.
+// Readers check that the head has not come round again after they are done
+// with a record, and merge the rings by time.
+//
+// The serial console is fed by a low priority task, except for errors,
+// which print everything up to them before the call returns. How far the
+// console got is kept with the heads, so what it had not printed when the
+// device went down is printed after the restart.
+
+// Increment this when the header or the records change
+#define LOG_BUFFER_MAGIC 0xB17A5E12
+
+#define RING_COUNT portNUM_PROCESSORS
+#define SLOT_SIZE 64
+#define RING_SLOTS (LOG_BUFFER_SIZE / RING_COUNT / SLOT_SIZE)
+#define RECORD_MAX_SLOTS 64                 // 4 KB, longer lines are cut short
+#define RESYNC_MARGIN (RING_SLOTS / 16)     // room left to the writers when a reader is lapped
+#define STRING_MAX 1024                     // of one string argument
+#define ERROR_BACKLOG_MAX 1024              // printed ahead of an error, about 90 ms at 115200 baud
+
+_Static_assert((RING_SLOTS & (RING_SLOTS - 1)) == 0, "ring positions wrap, so the ring size must be a power of two");
+_Static_assert(RING_COUNT <= 2, "a read position holds two rings");
+
+enum {
+    RECORD_PADDING = 1,     // fills the end of the ring when a record does not fit there
+    RECORD_FORMAT,          // a format in flash and its arguments
+    RECORD_TEXT,            // a line formatted when it was logged
+};
+
+enum {
+    STRING_FLASH,           // a pointer to a string in flash follows
+    STRING_COPY,            // the length and the characters follow
+};
+
+typedef struct {
+    _Atomic uint32_t position;  // written last, once the rest is in place
+    uint16_t slots;
+    uint8_t kind;
+    uint8_t boot;               // orders records from before a restart
+    int64_t time;
+    const char * format;
+    uint16_t length;            // of the arguments or the text after the record
+} record_t;
+
+typedef union {
+    record_t record;
+    uint8_t bytes[SLOT_SIZE];
+} slot_t;
 
 typedef struct {
     uint32_t magic;
     uint32_t checksum;
-    uint64_t total_written;
+    uint8_t elf_sha256[8];      // of the firmware the format pointers belong to
+    uint8_t boot;
+    _Atomic uint32_t heads[RING_COUNT];
+    uint64_t console_position;  // read position of the serial console
 } log_buffer_header_t;
 
 static uint32_t calculate_header_checksum(const log_buffer_header_t *h)
 {
-    uint32_t checksum = h->magic;
-    checksum ^= (uint32_t)(h->total_written & 0xFFFFFFFF);
-    checksum ^= (uint32_t)(h->total_written >> 32);
+    uint32_t checksum = h->magic ^ h->boot;
+    for (int i = 0; i < sizeof(h->elf_sha256); i++) {
+        checksum = (checksum << 5 | checksum >> 27) ^ h->elf_sha256[i];
+    }
     return checksum;
 }
 
-static EXT_RAM_NOINIT_ATTR log_buffer_header_t s_header;
-static EXT_RAM_NOINIT_ATTR char s_buffer[LOG_BUFFER_SIZE];
+// The heads are compared and swapped, which PSRAM does not support
+static __NOINIT_ATTR log_buffer_header_t s_header;
+static EXT_RAM_NOINIT_ATTR slot_t s_slots[RING_COUNT][RING_SLOTS] __attribute__((aligned(SLOT_SIZE)));
+
+static EXT_RAM_BSS_ATTR char s_console_buffer[RECORD_MAX_SLOTS * SLOT_SIZE];
+static TaskHandle_t s_console_task = NULL;
+static SemaphoreHandle_t s_console_mutex = NULL;
+static bool s_ready = false;
+
+// Conversions
 
-static SemaphoreHandle_t s_log_mutex = NULL;
-static char s_vprintf_buffer[2048];
+enum {
+    LENGTH_NONE,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_Z,
+    LENGTH_J,
+    LENGTH_T,
+};
 
-static void ring_write(const char *data, size_t len)
+static const char * const LENGTH_MODIFIERS[] = { "", "hh", "h", "l", "ll", "z", "j", "t" };
+
+typedef struct {
+    const char * flags;
+    uint8_t flags_length;
+    bool width_argument;
+    bool precision_argument;
+    int width;              // -1 when not given
+    int precision;          // -1 when not given
+    uint8_t length;
+    char conversion;
+    const char * end;
+} conversion_t;
+
+static bool is_digit(char c)
 {
-    if (len == 0) return;
+    return c >= '0' && c <= '9';
+}
 
-    size_t write_offset = s_header.total_written % LOG_BUFFER_SIZE;
-    size_t till_end = LOG_BUFFER_SIZE - write_offset;
+static int parse_int(const char ** p)
+{
+    int value = 0;
+    while (is_digit(**p) && value < 100000) {
+        value = value * 10 + (*(*p)++ - '0');
+    }
+    return value;
+}
 
-    if (len <= till_end) {
-        memcpy(&s_buffer[write_offset], data, len);
-        esp_cache_msync(&s_buffer[write_offset], len, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
-    } else {
-        memcpy(&s_buffer[write_offset], data, till_end);
-        esp_cache_msync(&s_buffer[write_offset], till_end, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
-        memcpy(s_buffer, data + till_end, len - till_end);
-        esp_cache_msync(s_buffer, len - till_end, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+// Reads the conversion after a '%', false for any the records can not hold
+static bool parse_conversion(const char * p, conversion_t * c)
+{
+    memset(c, 0, sizeof(*c));
+    c->width = -1;
+    c->precision = -1;
+
+    c->flags = p;
+    while (*p && strchr("-+ #0", *p)) p++;
+    c->flags_length = p - c->flags;
+    if (c->flags_length > 5) return false;
+
+    if ('*' == *p) {
+        c->width_argument = true;
+        p++;
+    } else if (is_digit(*p)) {
+        c->width = parse_int(&p);
+        if ('$' == *p) return false;    // numbered arguments
+    }
+
+    if ('.' == *p) {
+        p++;
+        if ('*' == *p) {
+            c->precision_argument = true;
+            p++;
+        } else {
+            c->precision = parse_int(&p);
+        }
+    }
+
+    switch (*p) {
+        case 'h': c->length = ('h' == p[1]) ? LENGTH_HH : LENGTH_H; break;
+        case 'l': c->length = ('l' == p[1]) ? LENGTH_LL : LENGTH_L; break;
+        case 'z': c->length = LENGTH_Z; break;
+        case 'j': c->length = LENGTH_J; break;
+        case 't': c->length = LENGTH_T; break;
     }
+    p += strlen(LENGTH_MODIFIERS[c->length]);
+
+    c->conversion = *p;
+    c->end = p + 1;
+    switch (c->conversion) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        case 'p': case '%':
+            return true;
+        case 'c':
+        case 's':
+            return LENGTH_NONE == c->length;    // no wide characters
+        default:
+            return false;
+    }
+}
 
-    s_header.total_written += len;
-    
-    // Update header checksum and flush header
-    s_header.checksum = calculate_header_checksum(&s_header);
-    esp_cache_msync(&s_header, sizeof(s_header), ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+static bool is_float(char conversion)
+{
+    return NULL != strchr("fFeEgGaA", conversion);
 }
 
-static int log_buffer_vprintf(const char *format, va_list args)
+// The size an integer conversion takes its argument at
+static size_t integer_size(uint8_t length)
 {
-    if (s_log_mutex == NULL) {
-        /* Fallback before init completes – just print to stdout */
-        return vprintf(format, args);
+    switch (length) {
+        case LENGTH_L:  return sizeof(long);
+        case LENGTH_LL: return sizeof(long long);
+        case LENGTH_Z:  return sizeof(size_t);
+        case LENGTH_J:  return sizeof(intmax_t);
+        case LENGTH_T:  return sizeof(ptrdiff_t);
+        default:        return sizeof(int);
+    }
+}
+
+// Writing records
+
+typedef struct {
+    uint8_t * data;         // NULL only measures
+    size_t size;
+    size_t length;
+    bool full;
+} packer_t;
+
+static void pack(packer_t * p, const void * value, size_t size)
+{
+    if (p->full || (p->data && p->length + size > p->size)) {
+        p->full = true;
+        return;
+    }
+    if (p->data) {
+        memcpy(p->data + p->length, value, size);
+    }
+    p->length += size;
+}
+
+static void pack_string(packer_t * p, const char * string, int precision)
+{
+    if (NULL == string) {
+        string = "(null)";
+    }
+    if (esp_ptr_in_drom(string)) {
+        uint8_t kind = STRING_FLASH;
+        pack(p, &kind, 1);
+        pack(p, &string, sizeof(string));
+        return;
     }
 
-    if (xSemaphoreTakeRecursive(s_log_mutex, portMAX_DELAY) != pdTRUE) {
+    size_t limit = (precision >= 0 && precision < STRING_MAX) ? precision : STRING_MAX;
+    if (p->data) {
+        size_t left = p->size - p->length;
+        left = left > 3 ? left - 3 : 0;
+        if (limit > left) limit = left;
+    }
+    uint16_t length = strnlen(string, limit);
+    uint8_t kind = STRING_COPY;
+    pack(p, &kind, 1);
+    pack(p, &length, sizeof(length));
+    pack(p, string, length);
+}
+
+// Packs the arguments of a format as its conversions take them, false if
+// the format has one the records can not hold
+static bool pack_arguments(packer_t * p, const char * format, va_list args)
+{
+    conversion_t c;
+
+    for (format = strchr(format, '%'); format; format = strchr(c.end, '%')) {
+        if (!parse_conversion(format + 1, &c)) return false;
+        if ('%' == c.conversion) continue;
+
+        int precision = c.precision;
+        if (c.width_argument) {
+            int width = va_arg(args, int);
+            pack(p, &width, sizeof(width));
+        }
+        if (c.precision_argument) {
+            precision = va_arg(args, int);
+            pack(p, &precision, sizeof(precision));
+        }
+
+        if ('s' == c.conversion) {
+            pack_string(p, va_arg(args, const char *), precision);
+        } else if ('p' == c.conversion) {
+            void * value = va_arg(args, void *);
+            pack(p, &value, sizeof(value));
+        } else if (is_float(c.conversion)) {
+            double value = va_arg(args, double);
+            pack(p, &value, sizeof(value));
+        } else {
+            switch (integer_size(c.length)) {
+                case sizeof(int): {
+                    int value = va_arg(args, int);
+                    pack(p, &value, sizeof(value));
+                    break;
+                }
+                default: {
+                    // every wider integer is long long sized here
+                    long long value = va_arg(args, long long);
+                    pack(p, &value, sizeof(value));
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static slot_t * slot_at(int ring, uint32_t position)
+{
+    return &s_slots[ring][position % RING_SLOTS];
+}
+
+static void commit(record_t * record, uint32_t position)
+{
+    atomic_store_explicit(&record->position, position, memory_order_release);
+    esp_cache_msync(record, record->slots * SLOT_SIZE, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+}
+
+// Claims room for a record in one piece, padding out the end of the ring
+// when it does not fit there
+static record_t * reserve(int ring, size_t length, uint8_t kind, uint32_t * position)
+{
+    size_t bytes = sizeof(record_t) + length;
+    uint16_t slots = (bytes + SLOT_SIZE - 1) / SLOT_SIZE;
+    uint32_t head = atomic_load_explicit(&s_header.heads[ring], memory_order_relaxed);
+    uint32_t start;
+
+    do {
+        uint32_t index = head % RING_SLOTS;
+        start = head;
+        if (index + slots > RING_SLOTS) {
+            start += RING_SLOTS - index;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&s_header.heads[ring], &head, start + slots,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+    // a reader that sees anything written from here on sees the head past it
+    atomic_thread_fence(memory_order_release);
+
+    if (start != head) {
+        record_t * padding = &slot_at(ring, head)->record;
+        padding->slots = start - head;
+        padding->kind = RECORD_PADDING;
+        commit(padding, head);
+    }
+
+    record_t * record = &slot_at(ring, start)->record;
+    record->slots = slots;
+    record->kind = kind;
+    record->boot = s_header.boot;
+    record->time = esp_timer_get_time();
+    record->format = NULL;
+    record->length = length;
+    *position = start;
+    return record;
+}
+
+static void notify(void)
+{
+    websocket_log_notify();
+    if (s_console_task != NULL && !xPortInIsrContext()) {
+        xTaskNotifyGive(s_console_task);
+    }
+}
+
+// ESP_LOGE formats start with the level letter, after the color if any
+static bool is_error(const char * format)
+{
+    if ('\033' == format[0]) {
+        format = strchr(format, 'm');
+        if (NULL == format) return false;
+        format++;
+    }
+    return 'E' == format[0] && ' ' == format[1];
+}
+
+static void console_flush(int ring, uint32_t position);
+
+static int log_buffer_vprintf(const char *format, va_list args)
+{
+    if (!s_ready) {
+        /* Fallback before init completes – just print to stdout */
         return vprintf(format, args);
     }
 
-    char *output = NULL;
+    const size_t max_length = RECORD_MAX_SLOTS * SLOT_SIZE - sizeof(record_t);
+    int ring = xPortGetCoreID();
+    uint32_t position;
+    record_t * record;
     va_list args_copy;
 
-    // Try using static buffer first to avoid malloc
+    if (esp_ptr_in_drom(format)) {
+        packer_t measure = { .data = NULL };
+        va_copy(args_copy, args);
+        bool packable = pack_arguments(&measure, format, args_copy);
+        va_end(args_copy);
+
+        if (packable) {
+            size_t length = measure.length < max_length ? measure.length : max_length;
+            record = reserve(ring, length, RECORD_FORMAT, &position);
+            record->format = format;
+
+            // strings may have grown since, what does not fit is left out
+            packer_t packer = { .data = (uint8_t *)(record + 1), .size = length };
+            pack_arguments(&packer, format, args);
+            record->length = packer.length;
+
+            commit(record, position);
+            if (is_error(format)) {
+                console_flush(ring, position);
+            }
+            notify();
+            return packer.length;
+        }
+    }
+
+    // a format made at run time, or one the records can not hold
     va_copy(args_copy, args);
-    int needed = vsnprintf(s_vprintf_buffer, sizeof(s_vprintf_buffer), format, args_copy);
+    int needed = vsnprintf(NULL, 0, format, args_copy);
     va_end(args_copy);
-
     if (needed < 0) {
-        xSemaphoreGiveRecursive(s_log_mutex);
         return 0;
     }
 
-    if (needed < sizeof(s_vprintf_buffer)) {
-        output = s_vprintf_buffer;
-    } else {
-        // Fallback to malloc for long lines
-        output = (char *)heap_caps_malloc(needed + 1, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-        if (!output) {
-            output = (char *)heap_caps_malloc(needed + 1, MALLOC_CAP_SPIRAM);
-        }
+    size_t length = (size_t)needed < max_length ? (size_t)needed : max_length - 1;
+    record = reserve(ring, length + 1, RECORD_TEXT, &position);
+    vsnprintf((char *)(record + 1), length + 1, format, args);
+    record->length = length;
+    commit(record, position);
+    if (is_error(format)) {
+        console_flush(ring, position);
+    }
+    notify();
+    return needed;
+}
 
-        if (output) {
-            va_copy(args_copy, args);
-            vsnprintf(output, needed + 1, format, args_copy);
-            va_end(args_copy);
-        }
+// Reading records
+
+typedef struct {
+    char * dest;
+    size_t size;
+    size_t length;
+    bool full;
+} output_t;
+
+static void output(output_t * o, const char * data, size_t length)
+{
+    size_t room = o->size - o->length;
+    if (length > room) {
+        length = room;
+        o->full = true;
     }
+    memcpy(o->dest + o->length, data, length);
+    o->length += length;
+}
+
+static void output_padding(output_t * o, int count)
+{
+    for (; count > 0 && !o->full; count--) {
+        output(o, " ", 1);
+    }
+}
+
+static void output_printf(output_t * o, const char * format, ...)
+{
+    size_t room = o->size - o->length;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(o->dest + o->length, room, format, args);
+    va_end(args);
+
+    if (length < 0) return;
+    if ((size_t)length >= room) {
+        // the terminator took the last byte
+        length = room ? room - 1 : 0;
+        o->full = true;
+    }
+    o->length += length;
+}
+
+typedef struct {
+    const uint8_t * data;
+    size_t length;
+    size_t offset;
+    bool short_of_data;
+} unpacker_t;
+
+static bool unpack(unpacker_t * u, void * value, size_t size)
+{
+    if (u->short_of_data || u->offset + size > u->length) {
+        u->short_of_data = true;
+        return false;
+    }
+    memcpy(value, u->data + u->offset, size);
+    u->offset += size;
+    return true;
+}
 
-    if (output) {
-        ring_write(output, needed);
-        websocket_log_notify();
-        fputs(output, stdout);
-        
-        if (output != s_vprintf_buffer) {
-            free(output);
+static void output_string(output_t * o, unpacker_t * u, const conversion_t * c, int width, int precision)
+{
+    uint8_t kind;
+    const char * string;
+    size_t length;
+
+    if (!unpack(u, &kind, 1)) return;
+    if (STRING_FLASH == kind) {
+        if (!unpack(u, &string, sizeof(string))) return;
+        if (!esp_ptr_in_drom(string)) {
+            u->short_of_data = true;
+            return;
         }
+        length = strnlen(string, precision >= 0 ? precision : STRING_MAX);
     } else {
-        /* Emergency fallback if absolutely out of memory */
-        vprintf(format, args);
+        uint16_t copied;
+        if (!unpack(u, &copied, sizeof(copied)) || u->offset + copied > u->length) {
+            u->short_of_data = true;
+            return;
+        }
+        string = (const char *)u->data + u->offset;
+        u->offset += copied;
+        length = (precision >= 0 && precision < copied) ? precision : copied;
     }
 
-    xSemaphoreGiveRecursive(s_log_mutex);
-    return needed;
+    bool left = NULL != memchr(c->flags, '-', c->flags_length);
+    int padding = width - (int)length;
+    if (!left) output_padding(o, padding);
+    output(o, string, length);
+    if (left) output_padding(o, padding);
 }
 
-void log_buffer_init(void)
+// Formats a record the way vsnprintf would have when it was logged
+static void format_record(const record_t * record, output_t * o)
 {
-    s_log_mutex = xSemaphoreCreateRecursiveMutex();
-    if (s_log_mutex == NULL) {
-        ESP_LOGW(TAG, "Failed to create recursive mutex");
+    unpacker_t u = { .data = (const uint8_t *)(record + 1), .length = record->length };
+
+    if (RECORD_TEXT == record->kind) {
+        output(o, (const char *)u.data, u.length);
         return;
     }
 
-    uint32_t expected_checksum = calculate_header_checksum(&s_header);
+    const char * format = record->format;
+    if (!esp_ptr_in_drom(format)) return;
 
-    if (s_header.magic != LOG_BUFFER_MAGIC || s_header.checksum != expected_checksum) {
-        memset(s_buffer, 0, LOG_BUFFER_SIZE);
-        esp_cache_msync(s_buffer, LOG_BUFFER_SIZE, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+    conversion_t c;
+    for (const char * percent; !o->full; format = c.end) {
+        percent = strchr(format, '%');
+        if (NULL == percent) {
+            output(o, format, strlen(format));
+            return;
+        }
+        output(o, format, percent - format);
+        if (!parse_conversion(percent + 1, &c)) return;
+        if ('%' == c.conversion) {
+            output(o, "%", 1);
+            continue;
+        }
 
-        s_header.total_written = 0;
-        s_header.magic = LOG_BUFFER_MAGIC;
-        s_header.checksum = calculate_header_checksum(&s_header);
-        esp_cache_msync(&s_header, sizeof(s_header), ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+        int width = c.width;
+        int precision = c.precision;
+        if (c.width_argument && !unpack(&u, &width, sizeof(width))) return;
+        if (c.precision_argument && !unpack(&u, &precision, sizeof(precision))) return;
+        if (precision < -1) precision = -1;
 
-        ESP_LOGI(TAG, "Cold boot or corrupted header, buffer initialized (%d KB)\n", LOG_BUFFER_SIZE / 1024);
-    } else {
-        ESP_LOGI(TAG, "Soft reboot detected, %" PRIu64 " bytes of logs preserved", s_header.total_written);
+        if ('s' == c.conversion) {
+            output_string(o, &u, &c, width, precision);
+            if (u.short_of_data) return;
+            continue;
+        }
 
-        const char * reboot_msg = "\n--- SYSTEM RESTART ---\n";
-        ring_write(reboot_msg, strlen(reboot_msg));        
+        // the conversion with its width and precision written out
+        char spec[40];
+        int length = snprintf(spec, sizeof(spec), "%%%.*s", c.flags_length, c.flags);
+        if (width >= 0 || c.width_argument) {
+            length += snprintf(spec + length, sizeof(spec) - length, "%d", width);
+        }
+        if (precision >= 0) {
+            length += snprintf(spec + length, sizeof(spec) - length, ".%d", precision);
+        }
+        snprintf(spec + length, sizeof(spec) - length, "%s%c", LENGTH_MODIFIERS[c.length], c.conversion);
+
+        if ('p' == c.conversion) {
+            void * value;
+            if (!unpack(&u, &value, sizeof(value))) return;
+            output_printf(o, spec, value);
+        } else if (is_float(c.conversion)) {
+            double value;
+            if (!unpack(&u, &value, sizeof(value))) return;
+            output_printf(o, spec, value);
+        } else if (sizeof(int) == integer_size(c.length)) {
+            int value;
+            if (!unpack(&u, &value, sizeof(value))) return;
+            output_printf(o, spec, value);
+        } else {
+            long long value;
+            if (!unpack(&u, &value, sizeof(value))) return;
+            output_printf(o, spec, value);
+        }
     }
+}
 
-    esp_log_set_vprintf(log_buffer_vprintf);
+// The oldest record a ring has at or after a position and before head, NULL
+// when there is none yet. A reader that was lapped starts again a little way
+// in front of the writers, at the first record it finds there.
+static const record_t * peek(int ring, uint32_t * position, uint32_t head)
+{
+    uint32_t p = *position;
+    bool lapped = false;
+
+    if ((int32_t)(head - p) < 0) {
+        p = head;
+    } else if (head - p > RING_SLOTS - RESYNC_MARGIN) {
+        p = head - (RING_SLOTS - RESYNC_MARGIN);
+        lapped = true;
+    }
+
+    while (p != head) {
+        const record_t * record = &slot_at(ring, p)->record;
+        if (atomic_load_explicit(&record->position, memory_order_acquire) == p
+            && record->kind >= RECORD_PADDING && record->kind <= RECORD_TEXT
+            && record->slots >= 1 && record->slots <= RECORD_MAX_SLOTS && record->slots <= head - p) {
+            if (RECORD_PADDING != record->kind) {
+                *position = p;
+                return record;
+            }
+            p += record->slots;
+            continue;
+        }
+
+        // a record still being written holds up the ones after it, unless
+        // its writer has gone for good
+        if (!lapped && head - p < RING_SLOTS / 2) break;
+        p++;
+    }
+    *position = p;
+    return NULL;
+}
+
+static bool is_older(const record_t * a, const record_t * b)
+{
+    int8_t boots = a->boot - b->boot;
+    return boots != 0 ? boots < 0 : a->time < b->time;
 }
 
-uint64_t log_buffer_get_total_written(void)
+static bool was_overwritten(int ring, uint32_t position)
 {
-    if (s_log_mutex && xSemaphoreTakeRecursive(s_log_mutex, portMAX_DELAY) == pdTRUE) {
-        uint64_t val = s_header.total_written;
-        xSemaphoreGiveRecursive(s_log_mutex);
-        return val;
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&s_header.heads[ring], memory_order_relaxed) - position > RING_SLOTS;
+}
+
+// Formats the lines from a read position up to the heads in end. A line
+// longer than max_len is cut short, unless whole is set and it is left for
+// a bigger read.
+static size_t read_lines(uint64_t *abs_pos, uint64_t end, char *dest, size_t max_len, bool whole)
+{
+    uint32_t positions[RING_COUNT];
+    uint32_t heads[RING_COUNT];
+    for (int ring = 0; ring < RING_COUNT; ring++) {
+        positions[ring] = *abs_pos >> (32 * ring);
+        heads[ring] = end >> (32 * ring);
+    }
+
+    output_t o = { .dest = dest, .size = max_len };
+    while (!o.full) {
+        const record_t * record = NULL;
+        int ring = 0;
+        for (int r = 0; r < RING_COUNT; r++) {
+            const record_t * candidate = peek(r, &positions[r], heads[r]);
+            if (candidate && (NULL == record || is_older(candidate, record))) {
+                record = candidate;
+                ring = r;
+            }
+        }
+        if (NULL == record) break;
+
+        size_t start = o.length;
+        uint16_t slots = record->slots;
+        format_record(record, &o);
+
+        if (was_overwritten(ring, positions[ring])) {
+            o.length = start;
+            o.full = false;
+            continue;   // the next peek starts it again in front of the writers
+        }
+        if (o.full && (start != 0 || whole)) {
+            // whole lines only, this one goes first next time
+            o.length = start;
+            break;
+        }
+        if (o.full) {
+            dest[o.length - 1] = '\n';
+        }
+        positions[ring] += slots;
+    }
+
+    uint64_t position = 0;
+    for (int ring = 0; ring < RING_COUNT; ring++) {
+        position |= (uint64_t)positions[ring] << (32 * ring);
     }
-    return 0;
+    *abs_pos = position;
+    return o.length;
+}
+
+static uint64_t heads_position(void)
+{
+    uint64_t position = 0;
+    for (int ring = 0; ring < RING_COUNT; ring++) {
+        position |= (uint64_t)atomic_load(&s_header.heads[ring]) << (32 * ring);
+    }
+    return position;
 }
 
 size_t log_buffer_read_absolute(uint64_t *abs_pos, char *dest, size_t max_len)
 {
-    if (s_log_mutex == NULL || abs_pos == NULL || dest == NULL || max_len == 0) {
+    if (!s_ready || abs_pos == NULL || dest == NULL || max_len == 0) {
         return 0;
     }
+    return read_lines(abs_pos, heads_position(), dest, max_len, false);
+}
 
-    if (xSemaphoreTakeRecursive(s_log_mutex, portMAX_DELAY) != pdTRUE) {
+uint64_t log_buffer_get_end(void)
+{
+    if (!s_ready) {
         return 0;
     }
+    return heads_position();
+}
 
-    uint64_t total = s_header.total_written;
-    uint64_t req_pos = *abs_pos;
+static void console_print(void)
+{
+    size_t length;
+    while ((length = log_buffer_read_absolute(&s_header.console_position, s_console_buffer, sizeof(s_console_buffer))) > 0) {
+        fwrite(s_console_buffer, 1, length, stdout);
+    }
+}
 
-    // Clamp position
-    if (req_pos > total) {
-        req_pos = total;
+// Prints an error from the task that logged it, so it is on the UART before
+// anything else happens. Up to ERROR_BACKLOG_MAX of the lines before it go
+// first, and nothing logged after it. With more of a backlog than that the
+// error is printed on its own, and again in order by the console task.
+static void console_flush(int ring, uint32_t position)
+{
+    if (xPortInIsrContext() || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        return;
     }
 
-    // Clamp on total buffer size
-    if (total >= LOG_BUFFER_SIZE && req_pos < total - LOG_BUFFER_SIZE) {
-        req_pos = total - LOG_BUFFER_SIZE;
-        
-        // Find next newline to resync to a line boundary.
-        // Limit scan to 4KB to avoid holding the mutex for too long.
-        size_t available_scan = (size_t)(total - req_pos);
-        if (available_scan > 4096) available_scan = 4096;
+    const record_t * record = &slot_at(ring, position)->record;
+    uint64_t end = heads_position() & ~((uint64_t)UINT32_MAX << (32 * ring));
+    end |= (uint64_t)(position + record->slots) << (32 * ring);
 
-        for (size_t i = 0; i < available_scan; i++) {
-            if (s_buffer[(req_pos + i) % LOG_BUFFER_SIZE] == '\n') {
-                req_pos += i + 1;
-                break;
-            }
+    xSemaphoreTake(s_console_mutex, portMAX_DELAY);
+
+    size_t printed = 0;
+    size_t length;
+    while (printed < ERROR_BACKLOG_MAX
+           && (length = read_lines(&s_header.console_position, end, s_console_buffer, ERROR_BACKLOG_MAX - printed, true)) > 0) {
+        fwrite(s_console_buffer, 1, length, stdout);
+        printed += length;
+    }
+
+    uint32_t printed_to = s_header.console_position >> (32 * ring);
+    if ((int32_t)(printed_to - position) <= 0) {
+        output_t o = { .dest = s_console_buffer, .size = sizeof(s_console_buffer) };
+        format_record(record, &o);
+        if (!was_overwritten(ring, position)) {
+            fwrite(s_console_buffer, 1, o.length, stdout);
         }
     }
 
-    size_t available = (size_t)(total - req_pos);
-    size_t to_read = (available < max_len) ? available : max_len;
+    fflush(stdout);
+    xSemaphoreGive(s_console_mutex);
+}
 
-    if (to_read > 0) {
-        size_t newline_idx = 0;
-        for (size_t i = 0; i < to_read; i++) {
-            if (s_buffer[(req_pos + i) % LOG_BUFFER_SIZE] == '\n') {
-                newline_idx = i + 1; // inclusive of newline
-                break;
-            }
+// Formats what was logged for the serial console, at a low priority so the
+// tasks that log never wait on the UART
+static void console_task(void * pvParameters)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        xSemaphoreTake(s_console_mutex, portMAX_DELAY);
+        console_print();
+        xSemaphoreGive(s_console_mutex);
+    }
+}
+
+void log_buffer_init(void)
+{
+    const esp_app_desc_t * app = esp_app_get_description();
+
+    // records written by other firmware point at its format strings
+    if (s_header.magic != LOG_BUFFER_MAGIC || s_header.checksum != calculate_header_checksum(&s_header)
+        || memcmp(s_header.elf_sha256, app->app_elf_sha256, sizeof(s_header.elf_sha256)) != 0) {
+        memset(s_slots, 0, sizeof(s_slots));
+        esp_cache_msync(s_slots, sizeof(s_slots), ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+
+        memcpy(s_header.elf_sha256, app->app_elf_sha256, sizeof(s_header.elf_sha256));
+        for (int ring = 0; ring < RING_COUNT; ring++) {
+            atomic_store(&s_header.heads[ring], 0);
         }
-        if (newline_idx > 0) {
-            to_read = newline_idx;
+        s_header.boot = 0;
+        s_header.console_position = 0;
+        s_header.magic = LOG_BUFFER_MAGIC;
+        s_header.checksum = calculate_header_checksum(&s_header);
+
+        ESP_LOGI(TAG, "Cold boot, new firmware or corrupted header, buffer initialized (%d KB)", LOG_BUFFER_SIZE / 1024);
+    } else {
+        s_header.boot++;
+        s_header.checksum = calculate_header_checksum(&s_header);
+        ESP_LOGI(TAG, "Soft reboot detected, logs preserved");
+        if (s_header.console_position != heads_position()) {
+            ESP_LOGW(TAG, "Printing the lines the console missed before the restart");
         }
 
-        size_t read_offset = req_pos % LOG_BUFFER_SIZE;
-        size_t till_end = LOG_BUFFER_SIZE - read_offset;
+        const char * reboot_msg = "\n--- SYSTEM RESTART ---\n";
+        uint32_t position;
+        record_t * record = reserve(0, strlen(reboot_msg), RECORD_TEXT, &position);
+        memcpy(record + 1, reboot_msg, strlen(reboot_msg));
+        commit(record, position);
+    }
+
+    s_console_mutex = xSemaphoreCreateMutex();
+    if (NULL == s_console_mutex) {
+        ESP_LOGW(TAG, "Failed to create console mutex");
+        return;
+    }
 
-        if (to_read <= till_end) {
-            memcpy(dest, &s_buffer[read_offset], to_read);
-        } else {
-            memcpy(dest, &s_buffer[read_offset], till_end);
-            memcpy(dest + till_end, s_buffer, to_read - till_end);
+    s_ready = true;
+    if (xTaskCreate(console_task, "log_console", 3072, NULL, 1, &s_console_task) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create console task");
+        s_ready = false;
+        return;
+    }
+
+    esp_log_set_vprintf(log_buffer_vprintf);
+}
+
+// Levels
+
+static const char LEVEL_LETTERS[] = "NEWIDV";   // by esp_log_level_t, as saved in NVS
+
+esp_err_t log_buffer_set_level(const char * tag, int level)
+{
+    esp_err_t err = log_levels_set(tag, level);
+    if (ESP_OK != err) {
+        return err;
+    }
+
+    const char * tag_set;
+    int tag_level;
+    if (0 == strcmp(tag, "*")) {
+        // esp_log forgets every tag when the default changes
+        esp_log_level_set("*", log_levels_get_default());
+        for (size_t i = 0; log_levels_get_at(i, &tag_set, &tag_level); i++) {
+            if (LOG_LEVEL_UNSET != tag_level) {
+                esp_log_level_set(tag_set, tag_level);
+            }
         }
+        return ESP_OK;
     }
 
-    *abs_pos = req_pos + to_read;
+    esp_log_level_set(tag, LOG_LEVEL_UNSET == level ? log_levels_get_default() : level);
+    return ESP_OK;
+}
 
-    xSemaphoreGiveRecursive(s_log_mutex);
-    return to_read;
+void log_buffer_save_levels(void)
+{
+    // "*:W,stratum_api:E"
+    char saved[LOG_LEVELS_MAX * (LOG_LEVELS_TAG_MAX + 3) + 8];
+    int length = 0;
+
+    int default_level = log_levels_get_default();
+    if (CONFIG_LOG_DEFAULT_LEVEL != default_level) {
+        length += snprintf(saved, sizeof(saved), "*:%c,", LEVEL_LETTERS[default_level]);
+    }
+    const char * tag;
+    int level;
+    for (size_t i = 0; log_levels_get_at(i, &tag, &level); i++) {
+        if (LOG_LEVEL_UNSET != level) {
+            length += snprintf(saved + length, sizeof(saved) - length, "%s:%c,", tag, LEVEL_LETTERS[level]);
+        }
+    }
+    if (length > 0) {
+        saved[length - 1] = '\0';
+    } else {
+        saved[0] = '\0';
+    }
+
+    nvs_config_set_string(NVS_CONFIG_LOG_LEVELS, saved);
+}
+
+void log_buffer_load_levels(void)
+{
+    char * saved = nvs_config_get_string(NVS_CONFIG_LOG_LEVELS);
+    if (NULL == saved) {
+        return;
+    }
+
+    char * next = saved;
+    for (char * entry = strsep(&next, ","); entry; entry = strsep(&next, ",")) {
+        char * letter = strrchr(entry, ':');
+        const char * level = letter && letter[1] ? strchr(LEVEL_LETTERS, letter[1]) : NULL;
+        if (NULL == level) {
+            continue;
+        }
+        *letter = '\0';
+        if (log_buffer_set_level(entry, level - LEVEL_LETTERS) != ESP_OK) {
+            ESP_LOGW(TAG, "Ignoring saved log level for %s", entry);
+        }
+    }
+    free(saved);
 }
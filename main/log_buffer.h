@@ -1,18 +1,38 @@
 #ifndef LOG_BUFFER_H_
 #define LOG_BUFFER_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "log_levels.h"
 
 void log_buffer_init(void);
-uint64_t log_buffer_get_total_written(void);
 
 /**
- * @param abs_pos Pointer to a 64-bit absolute track position. 
+ * @return The read position just past the last record logged.
+ */
+uint64_t log_buffer_get_end(void);
+
+/**
+ * Formats whole lines from a read position, oldest first.
+ *
+ * @param abs_pos Pointer to a read position, 0 for the oldest record kept. Moved past what was read.
  * @param dest Destination memory.
- * @param max_len Max chunk size to extract.
- * @return Bytes read into dest.
+ * @param max_len Max chunk size to extract, a longer line is cut short.
+ * @return Bytes formatted into dest, 0 once caught up.
  */
 size_t log_buffer_read_absolute(uint64_t *abs_pos, char *dest, size_t max_len);
 
+/**
+ * Sets the level of a tag with log_levels_set and passes it on to
+ * esp_log_level_set, "*" sets the default.
+ */
+esp_err_t log_buffer_set_level(const char * tag, int level);
+
+// Saves the levels to NVS, and applies the saved ones at startup
+void log_buffer_save_levels(void);
+void log_buffer_load_levels(void);
+
 #endif /* LOG_BUFFER_H_ */
@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <math.h>
+
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_psram.h"
@@ -5,6 +8,7 @@
 #include "asic_result_task.h"
 #include "create_jobs_task.h"
 #include "hashrate_monitor_task.h"
+#include "autotune_task.h"
 #include "fan_controller_task.h"
 #include "statistics_task.h"
 #include "system.h"
@@ -25,11 +29,48 @@
 #include "filesystem.h"
 #include "input.h"
 #include "log_buffer.h"
+#include "mock_pool.h"
 
 static GlobalState GLOBAL_STATE;
 
 static const char * TAG = "bitaxe";
 
+#if CONFIG_MOCK_POOL
+static void start_mock_pools(void)
+{
+    mock_pool_config_t config = {
+#if CONFIG_MOCK_POOL_SV2
+        .protocol = MOCK_POOL_SV2,
+#else
+        .protocol = MOCK_POOL_SV1,
+#endif
+        .port = CONFIG_STRATUM_PORT,
+        .difficulty = ldexp(1.0, CONFIG_MOCK_POOL_DIFFICULTY_BITS - 32),
+        .notify_interval_ms = CONFIG_MOCK_POOL_NOTIFY_INTERVAL_MS,
+        .block_interval_ms = CONFIG_MOCK_POOL_BLOCK_INTERVAL_MS,
+        .latency_ms = CONFIG_MOCK_POOL_LATENCY_MS,
+        .reject_permille = CONFIG_MOCK_POOL_REJECT_PERMILLE,
+        .reconnect_interval_ms = CONFIG_MOCK_POOL_RECONNECT_INTERVAL_MS,
+        .outage_ms = CONFIG_MOCK_POOL_OUTAGE_MS,
+#if !CONFIG_MOCK_POOL_SV2
+        .extranonce_interval_ms = CONFIG_MOCK_POOL_EXTRANONCE_INTERVAL_MS,
+#endif
+    };
+    mock_pool_t * pool;
+    if (mock_pool_start(&config, &pool) != ESP_OK) {
+        ESP_LOGE(TAG, "Error starting mock pool");
+    }
+
+    // the fallback stays up so failover has somewhere to go
+    config.port = CONFIG_FALLBACK_STRATUM_PORT;
+    config.reconnect_interval_ms = 0;
+    config.outage_ms = 0;
+    if (config.port != CONFIG_STRATUM_PORT && mock_pool_start(&config, &pool) != ESP_OK) {
+        ESP_LOGE(TAG, "Error starting fallback mock pool");
+    }
+}
+#endif
+
 void app_main(void)
 {
     if (esp_psram_is_initialized()) {
@@ -71,6 +112,7 @@ void app_main(void)
         ESP_LOGE(TAG, "Failed to init NVS");
         return;
     }
+    log_buffer_load_levels();
 
     // Ensure SSID is initialized before any screen/self-test uses it.
     GLOBAL_STATE.SYSTEM_MODULE.ssid = nvs_config_get_string(NVS_CONFIG_WIFI_SSID);
@@ -94,6 +136,10 @@ void app_main(void)
     }
 
     SYSTEM_init_system(&GLOBAL_STATE);
+    if (ASIC_chain_setup(&GLOBAL_STATE) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up ASIC chains");
+        return;
+    }
     if (scoreboard_init(&GLOBAL_STATE.SYSTEM_MODULE.scoreboard) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to init scoreboard");
     }
@@ -137,6 +183,17 @@ void app_main(void)
     }
 
     queue_init(&GLOBAL_STATE.stratum_queue);
+    for (int i = 0; i < GLOBAL_STATE.asic_chain_count; i++) {
+        queue_init(&GLOBAL_STATE.ASIC_CHAINS[i].job_queue);
+        GLOBAL_STATE.ASIC_CHAINS[i].job_queue.free_fn = (void (*)(void *))free_bm_job;
+    }
+    job_interval_init(&GLOBAL_STATE.job_interval);
+
+    if (core_heatmap_init(&GLOBAL_STATE.core_heatmap, GLOBAL_STATE.DEVICE_CONFIG.family.asic_count,
+                          GLOBAL_STATE.DEVICE_CONFIG.family.asic.core_count,
+                          GLOBAL_STATE.DEVICE_CONFIG.family.asic.small_core_count) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init core heatmap");
+    }
 
     if (system_init_ret == ESP_OK) {
         if (asic_initialize(&GLOBAL_STATE, ASIC_INIT_COLD_BOOT, 0) == 0) {
@@ -146,8 +203,16 @@ void app_main(void)
         if (xTaskCreate(create_jobs_task, "stratum miner", 8192, (void *) &GLOBAL_STATE, 20, NULL) != pdPASS) {
             ESP_LOGE(TAG, "Error creating stratum miner task");
         }
-        if (xTaskCreate(ASIC_result_task, "asic result", 8192, (void *) &GLOBAL_STATE, 15, NULL) != pdPASS) {
-            ESP_LOGE(TAG, "Error creating asic result task");
+        for (int i = 0; i < GLOBAL_STATE.asic_chain_count; i++) {
+            char task_name[configMAX_TASK_NAME_LEN];
+            snprintf(task_name, sizeof(task_name), "asic dispatch %d", i);
+            if (xTaskCreate(asic_dispatch_task, task_name, 4096, (void *) &GLOBAL_STATE.ASIC_CHAINS[i], 20, NULL) != pdPASS) {
+                ESP_LOGE(TAG, "Error creating asic dispatch task for chain %d", i);
+            }
+            snprintf(task_name, sizeof(task_name), "asic result %d", i);
+            if (xTaskCreate(ASIC_result_task, task_name, 8192, (void *) &GLOBAL_STATE.ASIC_CHAINS[i], 15, NULL) != pdPASS) {
+                ESP_LOGE(TAG, "Error creating asic result task for chain %d", i);
+            }
         }
 
         if (xTaskCreateWithCaps(hashrate_monitor_task, "hashrate monitor", 8192, (void *) &GLOBAL_STATE, 5, NULL, MALLOC_CAP_SPIRAM) != pdPASS) {
@@ -156,8 +221,15 @@ void app_main(void)
         if (xTaskCreateWithCaps(statistics_task, "statistics", 8192, (void *) &GLOBAL_STATE, 3, NULL, MALLOC_CAP_SPIRAM) != pdPASS) {
             ESP_LOGE(TAG, "Error creating statistics task");
         }
+        if (xTaskCreate(autotune_task, "autotune", 4096, (void *) &GLOBAL_STATE, 3, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Error creating autotune task");
+        }
     }
 
+#if CONFIG_MOCK_POOL
+    start_mock_pools();
+#endif
+
     protocol_coordinator_init(&GLOBAL_STATE);
     if (xTaskCreate(protocol_coordinator_task, "protocol coord", 8192, (void *) &GLOBAL_STATE, 5, NULL) != pdPASS) {
         ESP_LOGE(TAG, "Error creating protocol coordinator task");
@@ -13,6 +13,7 @@
 #include "display.h"
 #include "theme_api.h"
 #include "scoreboard.h"
+#include "fan_controller_task.h"
 
 #define NVS_CONFIG_NAMESPACE "main"
 #define NVS_STR_LIMIT (4000 - 1) // See nvs_set_str
@@ -73,6 +74,16 @@ static Settings settings[NVS_CONFIG_COUNT] = {
     [NVS_CONFIG_ASIC_FREQUENCY]                        = {.nvs_key_name = "asicfrequency_f", .type = TYPE_FLOAT, .default_value = {.f   = CONFIG_ASIC_FREQUENCY},                       .rest_name = "frequency",                          .min = 1,  .max = UINT16_MAX},
     [NVS_CONFIG_ASIC_VOLTAGE]                          = {.nvs_key_name = "asicvoltage",     .type = TYPE_U16,   .default_value = {.u16 = CONFIG_ASIC_VOLTAGE},                         .rest_name = "coreVoltage",                        .min = 1,  .max = UINT16_MAX},
     [NVS_CONFIG_OVERCLOCK_ENABLED]                     = {.nvs_key_name = "oc_enabled",      .type = TYPE_BOOL,                                                                         .rest_name = "overclockEnabled",                   .min = 0,  .max = 1},
+    [NVS_CONFIG_ADAPTIVE_JOB_INTERVAL]                 = {.nvs_key_name = "adaptjobintv",    .type = TYPE_BOOL,                                                                         .rest_name = "adaptiveJobInterval",                .min = 0,  .max = 1},
+    [NVS_CONFIG_AUTOTUNE_OBJECTIVE]                    = {.nvs_key_name = "autotuneobj",     .type = TYPE_U16,   .default_value = {.u16 = 0},                                           .rest_name = "autotuneObjective",                  .min = 0,  .max = 1},
+    [NVS_CONFIG_AUTOTUNE_MAX_TEMP]                     = {.nvs_key_name = "autotunemaxtemp", .type = TYPE_U16,   .default_value = {.u16 = 65},                                          .rest_name = "autotuneMaxTemp",                    .min = 40, .max = 75},
+    // Last autotune result, written by the autotune task only
+    [NVS_CONFIG_AUTOTUNE_FREQUENCY]                    = {.nvs_key_name = "autotunefreq",    .type = TYPE_FLOAT},
+    [NVS_CONFIG_AUTOTUNE_VOLTAGE]                      = {.nvs_key_name = "autotunevolt",    .type = TYPE_U16},
+    [NVS_CONFIG_AUTOTUNE_HASHRATE]                     = {.nvs_key_name = "autotunehash",    .type = TYPE_FLOAT},
+    [NVS_CONFIG_AUTOTUNE_POWER]                        = {.nvs_key_name = "autotunepower",   .type = TYPE_FLOAT},
+    // 0 caps at the board's max_power
+    [NVS_CONFIG_POWER_CAP]                             = {.nvs_key_name = "powercap",        .type = TYPE_U16,   .default_value = {.u16 = 0},                                           .rest_name = "powerCap",                           .min = 0,  .max = UINT16_MAX},
     
     [NVS_CONFIG_DISPLAY]                               = {.nvs_key_name = "display",         .type = TYPE_STR,   .default_value = {.str = DEFAULT_DISPLAY},                             .rest_name = "display",                            .min = 0,  .max = NVS_STR_LIMIT},
     [NVS_CONFIG_ROTATION]                              = {.nvs_key_name = "rotation",        .type = TYPE_U16,                                                                          .rest_name = "rotation",                           .min = 0,  .max = 270},
@@ -84,6 +95,8 @@ static Settings settings[NVS_CONFIG_COUNT] = {
     [NVS_CONFIG_MANUAL_FAN_SPEED]                      = {.nvs_key_name = "manualfanspeed",  .type = TYPE_U16,   .default_value = {.u16 = 100},                                         .rest_name = "manualFanSpeed",                     .min = 0,  .max = 100},
     [NVS_CONFIG_MIN_FAN_SPEED]                         = {.nvs_key_name = "minfanspeed",     .type = TYPE_U16,   .default_value = {.u16 = 25},                                          .rest_name = "minFanSpeed",                        .min = 0,  .max = 99},
     [NVS_CONFIG_TEMP_TARGET]                           = {.nvs_key_name = "temptarget",      .type = TYPE_U16,   .default_value = {.u16 = 60},                                          .rest_name = "temptarget",                         .min = 35, .max = 66},
+    // Autotuned PID gains per fan region, "kp;ki;kd", written by the fan controller only
+    [NVS_CONFIG_FAN_GAINS]                             = {.nvs_key_name = "fangains",        .type = TYPE_STR,   .array_size = FAN_REGION_COUNT},
     [NVS_CONFIG_OVERHEAT_MODE]                         = {.nvs_key_name = "overheat_mode",   .type = TYPE_BOOL,                                                                         .rest_name = "overheat_mode",                      .min = 0,  .max = 0},
 
     [NVS_CONFIG_STATISTICS_FREQUENCY]                  = {.nvs_key_name = "statsFrequency",  .type = TYPE_U16,                                                                          .rest_name = "statsFrequency",                     .min = 0,  .max = UINT16_MAX},
@@ -94,6 +107,7 @@ static Settings settings[NVS_CONFIG_COUNT] = {
     [NVS_CONFIG_THEME_SCHEME]                          = {.nvs_key_name = "themescheme",     .type = TYPE_STR,   .default_value = {.str = DEFAULT_THEME}},
     [NVS_CONFIG_THEME_COLORS]                          = {.nvs_key_name = "themecolors",     .type = TYPE_STR,   .default_value = {.str = DEFAULT_COLORS}},
     [NVS_CONFIG_SCOREBOARD]                            = {.nvs_key_name = "scoreboard",      .type = TYPE_STR,   .array_size = MAX_SCOREBOARD},
+    [NVS_CONFIG_LOG_LEVELS]                            = {.nvs_key_name = "loglevels",       .type = TYPE_STR,   .default_value = {.str = ""}},
     
     [NVS_CONFIG_BOARD_VERSION]                         = {.nvs_key_name = "boardversion",    .type = TYPE_STR,   .default_value = {.str = "000"}},
     [NVS_CONFIG_DEVICE_MODEL]                          = {.nvs_key_name = "devicemodel",     .type = TYPE_STR,   .default_value = {.str = "unknown"}},
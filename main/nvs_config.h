@@ -33,6 +33,14 @@ typedef enum {
     NVS_CONFIG_ASIC_FREQUENCY,
     NVS_CONFIG_ASIC_VOLTAGE,
     NVS_CONFIG_OVERCLOCK_ENABLED,
+    NVS_CONFIG_ADAPTIVE_JOB_INTERVAL,
+    NVS_CONFIG_AUTOTUNE_OBJECTIVE,
+    NVS_CONFIG_AUTOTUNE_MAX_TEMP,
+    NVS_CONFIG_AUTOTUNE_FREQUENCY,
+    NVS_CONFIG_AUTOTUNE_VOLTAGE,
+    NVS_CONFIG_AUTOTUNE_HASHRATE,
+    NVS_CONFIG_AUTOTUNE_POWER,
+    NVS_CONFIG_POWER_CAP,
     
     NVS_CONFIG_DISPLAY,
     NVS_CONFIG_ROTATION,
@@ -44,6 +52,7 @@ typedef enum {
     NVS_CONFIG_MANUAL_FAN_SPEED,
     NVS_CONFIG_MIN_FAN_SPEED,
     NVS_CONFIG_TEMP_TARGET,
+    NVS_CONFIG_FAN_GAINS,
     NVS_CONFIG_OVERHEAT_MODE,
     
     NVS_CONFIG_STATISTICS_FREQUENCY,
@@ -54,6 +63,7 @@ typedef enum {
     NVS_CONFIG_THEME_SCHEME,
     NVS_CONFIG_THEME_COLORS,
     NVS_CONFIG_SCOREBOARD,
+    NVS_CONFIG_LOG_LEVELS,
     
     NVS_CONFIG_BOARD_VERSION,
     NVS_CONFIG_DEVICE_MODEL,
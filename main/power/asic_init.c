@@ -19,41 +19,57 @@ uint8_t asic_initialize(GlobalState *GLOBAL_STATE, asic_init_mode_t mode, uint32
         return 0;
     }
 
-    // Check actual UART state for safety
-    bool uart_initialized = SERIAL_is_initialized();
-    
-    // Verify mode matches actual state
-    if (mode == ASIC_INIT_COLD_BOOT && uart_initialized) {
-        ESP_LOGW(TAG, "Cold boot mode but UART already initialized - will reset baud only");
-    } else if (mode == ASIC_INIT_RECOVERY && !uart_initialized) {
-        ESP_LOGW(TAG, "Recovery mode but UART not initialized - will do full init");
-    }
-    
-    // Use actual state for decision, not just mode
-    if (!uart_initialized) {
-        // Fresh boot - full UART initialization
-        ESP_LOGI(TAG, "Performing full UART initialization");
-        SERIAL_init();
-    } else {
-        // Live recovery - ASIC was reset, UART needs baud reset to 115200
-        // This preserves the running system and avoids reboot
-        ESP_LOGI(TAG, "UART already initialized, resetting baud to %d", UART_FREQ);
-        SERIAL_set_baud(UART_FREQ);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        asic_chain_t *chain = &GLOBAL_STATE->ASIC_CHAINS[i].chain;
+
+        // The reset put the PLLs back to their power-on frequency
+        ASIC_chain_reset(chain);
+
+        // Check actual UART state for safety
+        bool uart_initialized = SERIAL_is_initialized(chain->port);
+
+        // Verify mode matches actual state
+        if (mode == ASIC_INIT_COLD_BOOT && uart_initialized) {
+            ESP_LOGW(TAG, "Cold boot mode but chain %d UART already initialized - will reset baud only", i);
+        } else if (mode == ASIC_INIT_RECOVERY && !uart_initialized) {
+            ESP_LOGW(TAG, "Recovery mode but chain %d UART not initialized - will do full init", i);
+        }
+
+        // Use actual state for decision, not just mode
+        if (!uart_initialized) {
+            // Fresh boot - full UART initialization
+            ESP_LOGI(TAG, "Performing full UART initialization for chain %d", i);
+            SERIAL_init(chain->port);
+        } else {
+            // Live recovery - ASIC was reset, UART needs baud reset to 115200
+            // This preserves the running system and avoids reboot
+            ESP_LOGI(TAG, "Chain %d UART already initialized, resetting baud to %d", i, UART_FREQ);
+            SERIAL_set_baud(chain->port, UART_FREQ);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+        }
     }
 
     ESP_LOGI(TAG, "Detecting ASIC chips...");
-    uint8_t chip_count = ASIC_init(GLOBAL_STATE);
-    
-    if (chip_count == 0) {
-        ESP_LOGE(TAG, "ASIC initialization failed - chip count 0");
-        GLOBAL_STATE->SYSTEM_MODULE.asic_status = "Chip count 0";
-        return 0;
+    uint8_t chip_count = 0;
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        asic_chain_t *chain = &GLOBAL_STATE->ASIC_CHAINS[i].chain;
+
+        uint8_t chain_chip_count = ASIC_init(GLOBAL_STATE, chain);
+        if (chain_chip_count == 0) {
+            ESP_LOGE(TAG, "ASIC initialization failed - chip count 0 on chain %d", i);
+            GLOBAL_STATE->SYSTEM_MODULE.asic_status = "Chip count 0";
+            return 0;
+        }
+        chip_count += chain_chip_count;
     }
 
     ESP_LOGI(TAG, "Setting max baud rate and clearing buffers");
-    SERIAL_set_baud(ASIC_set_max_baud(GLOBAL_STATE));
-    SERIAL_clear_buffer();
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        asic_chain_t *chain = &GLOBAL_STATE->ASIC_CHAINS[i].chain;
+
+        SERIAL_set_baud(chain->port, ASIC_set_max_baud(GLOBAL_STATE, chain));
+        SERIAL_clear_buffer(chain->port);
+    }
 
     GLOBAL_STATE->ASIC_initalized = true;
     
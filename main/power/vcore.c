@@ -81,6 +81,11 @@ static TPS546_CONFIG get_tps546_config(const FamilyConfig * family)
     return config;
 }
 
+static int16_t read_core_voltage_mv(void * pvParameters)
+{
+    return VCORE_get_voltage_mv((GlobalState *) pvParameters);
+}
+
 esp_err_t VCORE_init(GlobalState * GLOBAL_STATE)
 {
     ESP_RETURN_ON_FALSE(GLOBAL_STATE->DEVICE_CONFIG.family.voltage_domains != 0, ESP_FAIL, TAG, "voltage_domains not defined");
@@ -113,6 +118,8 @@ esp_err_t VCORE_init(GlobalState * GLOBAL_STATE)
         }
     }
 
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.read_core_voltage_mv = read_core_voltage_mv;
+
     return ESP_OK;
 }
 
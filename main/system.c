@@ -126,8 +126,12 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     GLOBAL_STATE->sv2_conn = NULL;
 
     // Initialize mutexes
-    pthread_mutex_init(&GLOBAL_STATE->valid_jobs_lock, NULL);
     GLOBAL_STATE->stratum_mux = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    GLOBAL_STATE->share_estimator_mux = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+
+    for (int i = 0; i < POOL_COUNT; i++) {
+        share_estimator_reset(&module->share_estimators[i]);
+    }
 }
 
 void SYSTEM_init_versions(GlobalState * GLOBAL_STATE) {
@@ -259,11 +263,16 @@ void SYSTEM_clean_jobs_queue(GlobalState * GLOBAL_STATE)
     ESP_LOGI(TAG, "Clean Jobs: clearing queue");
     queue_clear(&GLOBAL_STATE->stratum_queue);
 
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    for (int i = 0; i < 128; i = i + 4) {
-        GLOBAL_STATE->valid_jobs[i] = 0;
+    for (int c = 0; c < GLOBAL_STATE->asic_chain_count; c++) {
+        AsicChainModule * module = &GLOBAL_STATE->ASIC_CHAINS[c];
+        asic_chain_t * chain = &module->chain;
+
+        // jobs generated but not yet written to the chain are stale as well
+        queue_clear(&module->job_queue);
+
+        // results for anything already sent are rejected from here on
+        invalidate_asic_jobs(chain);
     }
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
 
     // Reset hashrate measurements to prevent a spike on reconnection
     hashrate_monitor_reset_measurements(GLOBAL_STATE);
@@ -274,6 +283,38 @@ void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE)
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
     module->shares_accepted++;
+
+    // the pool credits the share at the difficulty it asked for
+    share_estimator_t * est = &module->share_estimators[module->is_using_fallback];
+    taskENTER_CRITICAL(&GLOBAL_STATE->share_estimator_mux);
+    share_estimator_add(est, SHARE_ESTIMATOR_ACCEPTED, GLOBAL_STATE->pool_difficulty, esp_timer_get_time());
+    taskEXIT_CRITICAL(&GLOBAL_STATE->share_estimator_mux);
+}
+
+void SYSTEM_notify_submitted_share(GlobalState * GLOBAL_STATE, double difficulty)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    share_estimator_t * est = &module->share_estimators[module->is_using_fallback];
+    taskENTER_CRITICAL(&GLOBAL_STATE->share_estimator_mux);
+    share_estimator_add(est, SHARE_ESTIMATOR_LOCAL, difficulty, esp_timer_get_time());
+    taskEXIT_CRITICAL(&GLOBAL_STATE->share_estimator_mux);
+}
+
+void SYSTEM_update_share_hashrate(GlobalState * GLOBAL_STATE, bool mining)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    int64_t now_us = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&GLOBAL_STATE->share_estimator_mux);
+    for (int i = 0; i < POOL_COUNT; i++) {
+        if (mining && i == module->is_using_fallback) {
+            share_estimator_advance(&module->share_estimators[i], now_us);
+        } else {
+            share_estimator_pause(&module->share_estimators[i]);
+        }
+    }
+    taskEXIT_CRITICAL(&GLOBAL_STATE->share_estimator_mux);
 }
 
 static int compare_rejected_reason_stats(const void *a, const void *b) {
@@ -326,7 +367,7 @@ void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
     settimeofday(&tv, NULL);
 }
 
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id)
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint32_t nbits)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
@@ -335,7 +376,7 @@ void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint8_t
         suffixString((uint64_t) diff, module->best_session_diff_string, DIFF_STRING_SIZE, 0);
     }
 
-    double network_diff = networkDifficulty(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->target);
+    double network_diff = networkDifficulty(nbits);
     if (diff >= network_diff) {
         module->block_found++;
         module->show_new_block = true;
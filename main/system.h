@@ -14,8 +14,14 @@ esp_err_t SYSTEM_init_peripherals(GlobalState * GLOBAL_STATE);
 void SYSTEM_clean_jobs_queue(GlobalState * GLOBAL_STATE);
 
 void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE);
+// A share that met the pool difficulty here, before the pool has seen it
+void SYSTEM_notify_submitted_share(GlobalState * GLOBAL_STATE, double difficulty);
 void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, char * error_msg);
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id);
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint32_t nbits);
 void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime);
 
+// Counts the time since the last call towards the share hashrate of the pool
+// in use, or towards none of them while not mining
+void SYSTEM_update_share_hashrate(GlobalState * GLOBAL_STATE, bool mining);
+
 #endif /* SYSTEM_H_ */
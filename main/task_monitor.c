@@ -1,11 +1,18 @@
+#include <stdlib.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "global_state.h"
+#include "task_monitor.h"
 
-#define MAX_TASKS 40
+#define MAX_TASKS TASK_MONITOR_MAX_TASKS
 #define INTERVAL_MS 60000
 
+#define CPU_MONITOR_MS 1000
+#define PROBE_STACK 2048
+
 static const char* TAG = "task_monitor";
 
 void task_monitor_task(void *pvParameters) {
@@ -85,10 +92,267 @@ void task_monitor_task(void *pvParameters) {
     vTaskDelete(NULL);
 }
 
+#ifdef CONFIG_ENABLE_TASK_MONITOR
+
+typedef struct
+{
+    const char * name;
+    const char * task_prefix;   // of the tasks it follows
+    const char * probe_name;
+    TaskHandle_t handle;
+    uint8_t priority;
+    int8_t core;
+    int64_t woken_us;           // 0 once the probe ran
+    uint64_t sum_us;
+    uint32_t max_us;
+    uint32_t samples;
+} latency_probe_t;
+
+static latency_probe_t probes[TASK_MONITOR_PROBE_COUNT] = {
+    { .name = "create_jobs", .task_prefix = "stratum miner", .probe_name = "probe jobs" },
+    { .name = "asic_result", .task_prefix = "asic result", .probe_name = "probe result" },
+    { .name = "stratum", .task_prefix = "stratum v", .probe_name = "probe stratum" },
+};
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static task_stats_t tasks[MAX_TASKS];
+static size_t task_count;
+static task_latency_t latencies[TASK_MONITOR_PROBE_COUNT];
+static size_t latency_count;
+
+// Two samples of the system state, the last one to take the next from
+static TaskStatus_t * sampled;
+static TaskStatus_t * sampling;
+static uint32_t sampled_count;
+static uint64_t sampled_runtime;
+
+static void wake_probes(void * arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    for (int i = 0; i < TASK_MONITOR_PROBE_COUNT; i++) {
+        latency_probe_t * probe = &probes[i];
+        if (NULL == probe->handle) continue;
+
+        // A probe that has not run yet is measured from when it was first woken
+        portENTER_CRITICAL(&lock);
+        if (0 == probe->woken_us) {
+            probe->woken_us = now;
+        }
+        portEXIT_CRITICAL(&lock);
+        xTaskNotifyGive(probe->handle);
+    }
+}
+
+static void probe_task(void * pvParameters)
+{
+    latency_probe_t * probe = (latency_probe_t *)pvParameters;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&lock);
+        if (0 != probe->woken_us) {
+            uint32_t latency = now - probe->woken_us;
+            probe->woken_us = 0;
+            probe->sum_us += latency;
+            if (latency > probe->max_us) {
+                probe->max_us = latency;
+            }
+            probe->samples++;
+        }
+        portEXIT_CRITICAL(&lock);
+    }
+}
+
+static int8_t task_core(const TaskStatus_t * task)
+{
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+    return tskNO_AFFINITY == task->xCoreID ? -1 : task->xCoreID;
+#else
+    return -1;
+#endif
+}
+
+// Starts each probe at the priority and on the core of the first task it
+// follows, and keeps it at that priority. Affinity cannot change once a
+// task runs, so neither does the probe's.
+static void follow_tasks(const TaskStatus_t * status, uint32_t count)
+{
+    for (int i = 0; i < TASK_MONITOR_PROBE_COUNT; i++) {
+        latency_probe_t * probe = &probes[i];
+        const TaskStatus_t * task = NULL;
+
+        for (uint32_t j = 0; j < count; j++) {
+            if (0 == strncmp(status[j].pcTaskName, probe->task_prefix, strlen(probe->task_prefix))) {
+                task = &status[j];
+                break;
+            }
+        }
+        // gone while the pool reconnects, the probe stays where it was
+        if (NULL == task) continue;
+
+        uint8_t priority = task->uxBasePriority;
+        if (NULL == probe->handle) {
+            int8_t core = task_core(task);
+            TaskHandle_t handle;
+            if (xTaskCreatePinnedToCore(probe_task, probe->probe_name, PROBE_STACK, probe, priority, &handle,
+                                        core < 0 ? tskNO_AFFINITY : core) != pdPASS) {
+                ESP_LOGE(TAG, "Error creating %s task", probe->probe_name);
+                continue;
+            }
+            probe->priority = priority;
+            probe->core = core;
+            probe->handle = handle;
+        } else if (priority != probe->priority) {
+            vTaskPrioritySet(probe->handle, priority);
+            probe->priority = priority;
+        }
+    }
+}
+
+static int busiest_first(const void * a, const void * b)
+{
+    float cpu_a = ((const task_stats_t *)a)->cpu;
+    float cpu_b = ((const task_stats_t *)b)->cpu;
+    return (cpu_a < cpu_b) - (cpu_a > cpu_b);
+}
+
+static void sample_tasks(void)
+{
+    static task_stats_t next[MAX_TASKS];
+    uint64_t runtime = 0;
+
+    uint32_t count = uxTaskGetSystemState(sampling, MAX_TASKS, &runtime);
+    if (0 == count) {
+        ESP_LOGW(TAG, "More than %d tasks, not sampled", MAX_TASKS);
+        return;
+    }
+    uint64_t elapsed = runtime - sampled_runtime;
+
+    for (uint32_t j = 0; j < count; j++) {
+        const TaskStatus_t * task = &sampling[j];
+        uint64_t task_delta = task->ulRunTimeCounter;
+
+        // A new task ran all its time during the sample
+        for (uint32_t i = 0; i < sampled_count; i++) {
+            if (sampled[i].xHandle == task->xHandle) {
+                task_delta -= sampled[i].ulRunTimeCounter;
+                break;
+            }
+        }
+
+        strlcpy(next[j].name, task->pcTaskName, sizeof(next[j].name));
+        next[j].cpu = 0 == elapsed ? 0 : task_delta * 100.0 / elapsed;
+        next[j].stack_free = task->usStackHighWaterMark;
+        next[j].priority = task->uxCurrentPriority;
+        next[j].core = task_core(task);
+    }
+    qsort(next, count, sizeof(next[0]), busiest_first);
+
+    follow_tasks(sampling, count);
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    memcpy(tasks, next, count * sizeof(next[0]));
+    task_count = count;
+
+    latency_count = 0;
+    for (int i = 0; i < TASK_MONITOR_PROBE_COUNT; i++) {
+        latency_probe_t * probe = &probes[i];
+        if (NULL == probe->handle) continue;
+
+        // A probe still waiting has waited at least this long
+        uint32_t max_us = probe->max_us;
+        if (0 != probe->woken_us && now - probe->woken_us > max_us) {
+            max_us = now - probe->woken_us;
+        }
+        latencies[latency_count++] = (task_latency_t){
+            .name = probe->name,
+            .priority = probe->priority,
+            .core = probe->core,
+            .average_us = 0 == probe->samples ? 0 : probe->sum_us / probe->samples,
+            .max_us = max_us,
+            .samples = probe->samples,
+        };
+        probe->sum_us = 0;
+        probe->max_us = 0;
+        probe->samples = 0;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    TaskStatus_t * swap = sampled;
+    sampled = sampling;
+    sampling = swap;
+    sampled_count = count;
+    sampled_runtime = runtime;
+}
+
+size_t task_monitor_get_tasks(task_stats_t * copy, size_t max)
+{
+    portENTER_CRITICAL(&lock);
+    size_t count = task_count < max ? task_count : max;
+    memcpy(copy, tasks, count * sizeof(tasks[0]));
+    portEXIT_CRITICAL(&lock);
+    return count;
+}
+
+size_t task_monitor_get_latencies(task_latency_t * copy, size_t max)
+{
+    portENTER_CRITICAL(&lock);
+    size_t count = latency_count < max ? latency_count : max;
+    memcpy(copy, latencies, count * sizeof(latencies[0]));
+    portEXIT_CRITICAL(&lock);
+    return count;
+}
+
+static bool start_sampling(void)
+{
+    sampled = malloc(MAX_TASKS * sizeof(TaskStatus_t));
+    sampling = malloc(MAX_TASKS * sizeof(TaskStatus_t));
+    if (sampled == NULL || sampling == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for task arrays");
+        free(sampled);
+        free(sampling);
+        return false;
+    }
+
+    const esp_timer_create_args_t probe_timer_args = {
+        .callback = wake_probes,
+        .name = "latency probes",
+    };
+    esp_timer_handle_t probe_timer;
+    if (esp_timer_create(&probe_timer_args, &probe_timer) != ESP_OK ||
+        esp_timer_start_periodic(probe_timer, TASK_MONITOR_PROBE_MS * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the latency probe timer");
+    }
+    return true;
+}
+
+#else
+
+size_t task_monitor_get_tasks(task_stats_t * copy, size_t max)
+{
+    return 0;
+}
+
+size_t task_monitor_get_latencies(task_latency_t * copy, size_t max)
+{
+    return 0;
+}
+
+#endif
+
 void cpu_monitor_task(void *pvParameters) {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
     float avg_idle = -1.0f;
     const float alpha = 0.5f;
+#ifdef CONFIG_ENABLE_TASK_MONITOR
+    bool sampling_tasks = start_sampling();
+    int ticks = 0;
+#endif
 
     while (1) {
         uint64_t idleTimeCore0 = ulTaskGetIdleRunTimePercentForCore(0);
@@ -102,7 +366,13 @@ void cpu_monitor_task(void *pvParameters) {
         }
 
         GLOBAL_STATE->SYSTEM_MODULE.cpu_usage = 100.0f - avg_idle;
-        
-        vTaskDelay(pdMS_TO_TICKS(1000));
+
+#ifdef CONFIG_ENABLE_TASK_MONITOR
+        if (sampling_tasks && 0 == ticks++ % (TASK_MONITOR_SAMPLE_MS / CPU_MONITOR_MS)) {
+            sample_tasks();
+        }
+#endif
+
+        vTaskDelay(pdMS_TO_TICKS(CPU_MONITOR_MS));
     }
 }
@@ -1,7 +1,51 @@
 #ifndef TASK_MONITOR_H_
 #define TASK_MONITOR_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Every so often the monitor looks at all tasks, for their share of a core,
+// the stack they never touched, their priority and the core they are pinned
+// to. Each mining task that must answer quickly gets a probe task at its
+// priority on its core, woken by a timer, whose wake up latency is what the
+// task itself would see.
+//
+// uxTaskGetSystemState holds the scheduler for the whole walk, so the
+// sampling and the probes only run with CONFIG_ENABLE_TASK_MONITOR. Without
+// it the getters find nothing.
+
+#define TASK_MONITOR_MAX_TASKS 40
+#define TASK_MONITOR_SAMPLE_MS 5000
+#define TASK_MONITOR_PROBE_MS 100
+#define TASK_MONITOR_PROBE_COUNT 3
+
+typedef struct
+{
+    char name[configMAX_TASK_NAME_LEN];
+    float cpu;              // percent of one core, over the last sample
+    uint32_t stack_free;    // bytes never used
+    uint8_t priority;
+    int8_t core;            // -1 for either
+} task_stats_t;
+
+typedef struct
+{
+    const char * name;      // of the tasks probed
+    uint8_t priority;
+    int8_t core;
+    uint32_t average_us;    // over the last sample
+    uint32_t max_us;
+    uint32_t samples;
+} task_latency_t;
+
 void task_monitor_task(void *pvParameters);
 void cpu_monitor_task(void *pvParameters);
 
+// Copies the tasks of the last sample, busiest first, returns how many
+size_t task_monitor_get_tasks(task_stats_t * tasks, size_t max);
+
+// Copies the latencies of the probes that run, returns how many
+size_t task_monitor_get_latencies(task_latency_t * latencies, size_t max);
+
 #endif /* TASK_MONITOR_H_ */
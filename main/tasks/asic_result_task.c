@@ -13,45 +13,55 @@
 #include "asic.h"
 #include "freertos/task.h"
 #include "scoreboard.h"
+#include "log_levels.h"
 
 static const char *TAG = "asic_result";
 
 void ASIC_result_task(void *pvParameters)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    AsicChainModule *module = (AsicChainModule *)pvParameters;
+    GlobalState *GLOBAL_STATE = (GlobalState *)module->global_state;
+    asic_chain_t *chain = &module->chain;
 
     while (1)
     {
+        if (atomic_load(&chain->paused)) {
+            // the soft reset reads the chip ids from here on
+            ASIC_chain_idle(chain);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+
         // Check if ASIC is initialized before trying to process work
         if (!GLOBAL_STATE->ASIC_initalized) {
             vTaskDelay(100 / portTICK_PERIOD_MS);
             continue;
         }
 
-        task_result *asic_result = ASIC_process_work(GLOBAL_STATE);
+        task_result *asic_result = ASIC_process_work(GLOBAL_STATE, chain);
 
         if (asic_result == NULL)
         {
             continue;
         }
 
+        // chip numbers are board-wide from here on
+        uint8_t asic_nr = chain->asic_offset + asic_result->asic_nr;
+
         if (asic_result->register_type != REGISTER_INVALID) {
-            hashrate_monitor_register_read(GLOBAL_STATE, asic_result->register_type, asic_result->asic_nr, asic_result->value, asic_result->timestamp_us);
+            hashrate_monitor_register_read(GLOBAL_STATE, asic_result->register_type, asic_nr, asic_result->value, asic_result->timestamp_us);
             continue;
         }
 
         uint8_t job_id = asic_result->job_id;
 
-        pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-        bool valid = (GLOBAL_STATE->valid_jobs[job_id] != 0);
-        bm_job *active_job = valid ? GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id] : NULL;
-        pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+        // the driver already checked the job against the chain's epoch
+        bm_job *active_job = asic_result->job;
+        job_interval_nonce(&GLOBAL_STATE->job_interval, chain->index, job_id, active_job,
+                           asic_result->nonce, asic_result->rolled_version, asic_result->timestamp_us);
+        core_heatmap_nonce(&GLOBAL_STATE->core_heatmap, asic_nr, asic_result->core_id, asic_result->small_core_id, asic_result->timestamp_us);
+        chain_health_nonce(&chain->health, asic_result->asic_nr, asic_result->timestamp_us);
 
-        if (!valid || active_job == NULL)
-        {
-            ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
-            continue;
-        }
         // check the nonce difficulty
         double nonce_diff = test_nonce_value(active_job, asic_result->nonce, asic_result->rolled_version);
 
@@ -60,6 +70,8 @@ void ASIC_result_task(void *pvParameters)
         uint32_t version_bits = asic_result->rolled_version ^ active_job->version;
         if (nonce_diff >= active_job->pool_diff)
         {
+            SYSTEM_notify_submitted_share(GLOBAL_STATE, active_job->pool_diff);
+
             if (GLOBAL_STATE->stratum_protocol == STRATUM_V2) {
                 // SV2: submit with binary protocol
                 int ret;
@@ -119,15 +131,20 @@ void ASIC_result_task(void *pvParameters)
 
                     float process_time = (sent_time_us - asic_result->timestamp_us) / 1000.0f;
                     GLOBAL_STATE->SYSTEM_MODULE.process_time = process_time;
-                    ESP_LOGI(TAG, "Processing time: %0.1f ms", process_time);
+                    latency_histogram_record(&GLOBAL_STATE->SYSTEM_MODULE.process_time_histogram, process_time);
+                    if (log_levels_enabled(TAG, ESP_LOG_INFO)) {
+                        ESP_LOGI(TAG, "Processing time: %0.1f ms", process_time);
+                    }
                 }
             }
         }
 
-        //log the ASIC response
-        ESP_LOGI(TAG, "ID: %s, ASIC nr: %d, Core: %d/%d, ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %g.", active_job->jobid, asic_result->asic_nr, asic_result->core_id, asic_result->small_core_id, asic_result->rolled_version, asic_result->nonce, nonce_diff, active_job->pool_diff);
+        //log the ASIC response, once per nonce so skipped early when the tag is quieted
+        if (log_levels_enabled(TAG, ESP_LOG_INFO)) {
+            ESP_LOGI(TAG, "ID: %s, ASIC nr: %d, Core: %d/%d, ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %g.", active_job->jobid, asic_nr, asic_result->core_id, asic_result->small_core_id, asic_result->rolled_version, asic_result->nonce, nonce_diff, active_job->pool_diff);
+        }
 
-        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, job_id);
+        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, active_job->target);
 
         scoreboard_add(&GLOBAL_STATE->SYSTEM_MODULE.scoreboard, nonce_diff, active_job->jobid, active_job->extranonce2, active_job->ntime, asic_result->nonce, version_bits);
     }
@@ -0,0 +1,235 @@
+#include <math.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "global_state.h"
+#include "nvs_config.h"
+#include "autotune_task.h"
+
+// Hill climb steps, the sweep takes bigger ones
+#define FREQUENCY_STEP 12.5f
+#define VOLTAGE_STEP 10
+
+// Time for the frequency ramp, the regulator and the chip temperature to
+// follow a new point, then the window its measurements are averaged over
+#define SETTLE_MS (30 * 1000)
+#define MEASURE_MS (60 * 1000)
+#define SAMPLE_MS 1000
+// Between the two halves of a move, see apply_point
+#define STEP_MS 1000
+
+#define MAX_ERROR_PERCENTAGE 1.0f
+
+static const char * TAG = "autotune_task";
+
+static bool can_tune(GlobalState * GLOBAL_STATE)
+{
+    SystemModule * sys_module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    return GLOBAL_STATE->ASIC_initalized
+        && !GLOBAL_STATE->SELF_TEST_MODULE.is_active
+        && !sys_module->mining_paused
+        && !sys_module->hardware_fault
+        && !sys_module->pools_unavailable
+        && !sys_module->overheat_mode;
+}
+
+static void get_limits(GlobalState * GLOBAL_STATE, autotune_limits_t * limits)
+{
+    const FamilyConfig * family = &GLOBAL_STATE->DEVICE_CONFIG.family;
+    const AsicConfig * asic = &family->asic;
+
+    *limits = (autotune_limits_t) {
+        .objective = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_OBJECTIVE) == 1 ? AUTOTUNE_HASHRATE : AUTOTUNE_EFFICIENCY,
+        .min_frequency = asic->frequency_options[0],
+        .frequency_step = FREQUENCY_STEP,
+        .min_voltage = asic->voltage_options[0],
+        .voltage_step = VOLTAGE_STEP,
+        .max_power = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power_governor.cap > 0
+                   ? GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power_governor.cap : family->max_power,
+        .max_temp = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_MAX_TEMP),
+        .max_error_percentage = MAX_ERROR_PERCENTAGE,
+        .hashrate_per_mhz = asic->small_core_count * family->asic_count / 1000.0f,
+        .min_hashrate_fraction = asic->hashrate_test_percentage_target,
+    };
+
+    // the board's own option lists bound the search
+    for (int i = 0; asic->frequency_options[i] != 0; i++) {
+        limits->max_frequency = asic->frequency_options[i];
+    }
+    for (int i = 0; asic->voltage_options[i] != 0; i++) {
+        limits->max_voltage = asic->voltage_options[i];
+    }
+}
+
+static void publish(AutotuneModule * module)
+{
+    const autotune_t * engine = &module->engine;
+
+    module->objective = engine->limits.objective;
+    module->progress = autotune_get_progress(engine);
+    module->tested = engine->tested_count;
+    module->frequency = engine->current.frequency;
+    module->voltage = engine->current.voltage;
+    module->has_best = autotune_get_best(engine, &module->best);
+    module->state = engine->state;
+}
+
+// Moves to a point without passing through a frequency its voltage cannot
+// carry: the lower frequency and the higher voltage go first
+static void apply_point(PowerManagementModule * power_management, float frequency, uint16_t voltage)
+{
+    float current_frequency = power_management->tune_frequency;
+    uint16_t current_voltage = power_management->tune_voltage;
+
+    power_management->tune_frequency = fminf(current_frequency, frequency);
+    power_management->tune_voltage = current_voltage > voltage ? current_voltage : voltage;
+    vTaskDelay(STEP_MS / portTICK_PERIOD_MS);
+
+    power_management->tune_voltage = voltage;
+    power_management->tune_frequency = frequency;
+}
+
+// Waits for the point to settle, then averages it, false when the run has to stop
+static bool measure_point(GlobalState * GLOBAL_STATE, AutotuneModule * module, const autotune_limits_t * limits,
+                          autotune_sample_t * sample)
+{
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    SystemModule * sys_module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    for (int elapsed = 0; elapsed < SETTLE_MS; elapsed += SAMPLE_MS) {
+        if (module->stop_requested || !can_tune(GLOBAL_STATE)) return false;
+        vTaskDelay(SAMPLE_MS / portTICK_PERIOD_MS);
+    }
+
+    float hashrate = 0;
+    float power = 0;
+    float errors = 0;
+    float peak_temp = 0;
+    float peak_power = 0;
+    int samples = 0;
+
+    for (int elapsed = 0; elapsed < MEASURE_MS; elapsed += SAMPLE_MS) {
+        if (module->stop_requested || !can_tune(GLOBAL_STATE)) return false;
+        vTaskDelay(SAMPLE_MS / portTICK_PERIOD_MS);
+
+        float temp = fmaxf(power_management->chip_temp_avg, power_management->chip_temp2_avg);
+
+        // only the hashes that come out right count
+        hashrate += sys_module->current_hashrate * (1.0f - sys_module->error_percentage / 100.0f);
+        power += power_management->power;
+        errors += sys_module->error_percentage;
+        peak_temp = fmaxf(peak_temp, temp);
+        peak_power = fmaxf(peak_power, power_management->power);
+        samples++;
+
+        // no need to sit out a point that is already past a limit
+        if (temp > limits->max_temp || power_management->power > limits->max_power) {
+            break;
+        }
+    }
+
+    sample->hashrate = hashrate / samples;
+    sample->power = peak_power > limits->max_power ? peak_power : power / samples;
+    sample->temp = peak_temp;
+    sample->error_percentage = errors / samples;
+    return true;
+}
+
+static void run(GlobalState * GLOBAL_STATE, AutotuneModule * module)
+{
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    float original_frequency = nvs_config_get_float(NVS_CONFIG_ASIC_FREQUENCY);
+    uint16_t original_voltage = nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE);
+
+    autotune_limits_t limits;
+    get_limits(GLOBAL_STATE, &limits);
+
+    // take over from the settings the board runs at now
+    power_management->tune_voltage = original_voltage;
+    power_management->tune_frequency = original_frequency;
+
+    autotune_start(&module->engine, &limits);
+    publish(module);
+
+    const autotune_point_t * point;
+    while ((point = autotune_get_point(&module->engine)) != NULL) {
+        apply_point(power_management, point->frequency, point->voltage);
+
+        autotune_sample_t sample;
+        if (!measure_point(GLOBAL_STATE, module, &limits, &sample)) {
+            ESP_LOGW(TAG, "Stopped %s", module->stop_requested ? "on request" : "as mining can no longer be tuned");
+            autotune_abort(&module->engine);
+            break;
+        }
+
+        autotune_measured(&module->engine, &sample);
+        publish(module);
+    }
+
+    autotune_point_t best;
+    if (module->engine.state == AUTOTUNE_DONE && autotune_get_best(&module->engine, &best)) {
+        ESP_LOGI(TAG, "Keeping %g MHz at %u mV", best.frequency, best.voltage);
+
+        apply_point(power_management, best.frequency, best.voltage);
+        nvs_config_set_float(NVS_CONFIG_ASIC_FREQUENCY, best.frequency);
+        nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, best.voltage);
+
+        nvs_config_set_float(NVS_CONFIG_AUTOTUNE_FREQUENCY, best.frequency);
+        nvs_config_set_u16(NVS_CONFIG_AUTOTUNE_VOLTAGE, best.voltage);
+        nvs_config_set_float(NVS_CONFIG_AUTOTUNE_HASHRATE, best.sample.hashrate);
+        nvs_config_set_float(NVS_CONFIG_AUTOTUNE_POWER, best.sample.power);
+    } else {
+        ESP_LOGI(TAG, "Restoring %g MHz at %u mV", original_frequency, original_voltage);
+        apply_point(power_management, original_frequency, original_voltage);
+    }
+    vTaskDelay(STEP_MS / portTICK_PERIOD_MS);
+
+    // hand the settings back to NVS, which now holds the same point
+    power_management->tune_frequency = 0;
+    power_management->tune_voltage = 0;
+
+    publish(module);
+}
+
+esp_err_t autotune_task_start(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    AutotuneModule * module = &GLOBAL_STATE->AUTOTUNE_MODULE;
+
+    if (module->start_requested || module->state == AUTOTUNE_SWEEP || module->state == AUTOTUNE_CLIMB) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!can_tune(GLOBAL_STATE)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    module->stop_requested = false;
+    module->start_requested = true;
+    return ESP_OK;
+}
+
+void autotune_task_stop(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    GLOBAL_STATE->AUTOTUNE_MODULE.stop_requested = true;
+}
+
+void autotune_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    AutotuneModule * module = &GLOBAL_STATE->AUTOTUNE_MODULE;
+
+    while (1) {
+        if (module->start_requested) {
+            run(GLOBAL_STATE, module);
+            module->start_requested = false;
+        }
+
+        vTaskDelay(SAMPLE_MS / portTICK_PERIOD_MS);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef AUTOTUNE_TASK_H_
+#define AUTOTUNE_TASK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "autotune.h"
+
+typedef struct
+{
+    autotune_t engine;              // owned by the autotune task
+    volatile bool start_requested;
+    volatile bool stop_requested;
+
+    // published for the API
+    autotune_state_t state;
+    autotune_objective_t objective;
+    uint8_t progress;
+    uint16_t tested;
+    float frequency;                // point being measured
+    uint16_t voltage;
+    bool has_best;
+    autotune_point_t best;
+} AutotuneModule;
+
+void autotune_task(void * pvParameters);
+
+// Fails with ESP_ERR_INVALID_STATE while a run is going or mining cannot be tuned
+esp_err_t autotune_task_start(void * pvParameters);
+void autotune_task_stop(void * pvParameters);
+
+#endif /* AUTOTUNE_TASK_H_ */
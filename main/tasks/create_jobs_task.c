@@ -11,20 +11,21 @@
 
 #include "asic.h"
 #include "system.h"
-#include "esp_heap_caps.h"
 #include "sv2_protocol.h"
 #include "stratum_api.h"
 #include "stratum_v2_task.h"
 #include "utils.h"
+#include "nvs_config.h"
+#include "log_levels.h"
 
 static const char *TAG = "create_jobs_task";
 
 #define MAX_EXTRANONCE2_LEN 32
 #define MAX_EXTRANONCE2_STR (MAX_EXTRANONCE2_LEN * 2 + 1)
 
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty);
-static void generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *job, double difficulty);
-static void generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *job, double difficulty, uint64_t extranonce_2_counter);
+static bm_job *generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty);
+static bm_job *generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *job, double difficulty, uint8_t chain_index);
+static bm_job *generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *job, double difficulty, uint64_t extranonce_2_counter);
 
 // Free a work item using the correct free function for the protocol it was created under
 static void free_work_item(GlobalState *GLOBAL_STATE, void *work, stratum_protocol_t protocol)
@@ -41,23 +42,63 @@ static void free_work_item(GlobalState *GLOBAL_STATE, void *work, stratum_protoc
     }
 }
 
-void create_jobs_task(void *pvParameters)
+// Restarts the interval of the chains in mask. The adapted interval applies
+// to the chain that needs work most often, the others keep their ratio to it.
+static void schedule_chains(GlobalState *GLOBAL_STATE, int64_t due_us[], uint32_t mask)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    int64_t now_us = esp_timer_get_time();
+    double base_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
+    bool adaptive = nvs_config_get_bool(NVS_CONFIG_ADAPTIVE_JOB_INTERVAL);
+    double interval_ms = job_interval_update(&GLOBAL_STATE->job_interval, base_ms, adaptive, now_us);
+
+    for (int c = 0; c < GLOBAL_STATE->asic_chain_count; c++) {
+        if (!(mask & (1u << c))) continue;
 
-    // Initialize ASIC task module (moved from ASIC_task)
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = heap_caps_malloc(sizeof(bm_job *) * 128, MALLOC_CAP_SPIRAM);
-    GLOBAL_STATE->valid_jobs = heap_caps_malloc(sizeof(uint8_t) * 128, MALLOC_CAP_SPIRAM);
-    for (int i = 0; i < 128; i++) {
-        GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
-        GLOBAL_STATE->valid_jobs[i] = 0;
+        double chain_ms = interval_ms;
+        if (base_ms > 0) {
+            chain_ms *= ASIC_get_chain_job_frequency_ms(GLOBAL_STATE, &GLOBAL_STATE->ASIC_CHAINS[c].chain) / base_ms;
+        }
+        due_us[c] = now_us + (int64_t)(chain_ms * 1000);
     }
+}
+
+// Time until the first chain is due, 0 when one already is
+static int next_due_ms(GlobalState *GLOBAL_STATE, const int64_t due_us[])
+{
+    int64_t first_us = due_us[0];
+    for (int c = 1; c < GLOBAL_STATE->asic_chain_count; c++) {
+        if (due_us[c] < first_us) first_us = due_us[c];
+    }
+    // rounded up, so the wait ends past the deadline
+    int64_t wait_ms = (first_us - esp_timer_get_time() + 999) / 1000;
+    return wait_ms > 0 ? (int)wait_ms : 0;
+}
+
+static uint32_t due_chains(GlobalState *GLOBAL_STATE, const int64_t due_us[])
+{
+    int64_t now_us = esp_timer_get_time();
+    uint32_t mask = 0;
+    for (int c = 0; c < GLOBAL_STATE->asic_chain_count; c++) {
+        if (due_us[c] <= now_us) mask |= 1u << c;
+    }
+    return mask;
+}
+
+void create_jobs_task(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
 
     double difficulty = GLOBAL_STATE->pool_difficulty;
     void *current_work = NULL;
     stratum_protocol_t current_work_protocol = GLOBAL_STATE->stratum_protocol;
     uint64_t extranonce_2 = 0;
-    int timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
+    // each chain's job epoch when current_work was taken, a clean job after that
+    // makes everything built from current_work stale even if it is sent later
+    uint32_t work_epochs[ASIC_MAX_CHAINS];
+    uint32_t all_chains = (1u << GLOBAL_STATE->asic_chain_count) - 1;
+    int64_t due_us[ASIC_MAX_CHAINS];
+    schedule_chains(GLOBAL_STATE, due_us, all_chains);
+    int timeout_ms = next_due_ms(GLOBAL_STATE, due_us);
 
     ESP_LOGI(TAG, "ASIC Job Interval: %d ms", timeout_ms);
     ESP_LOGI(TAG, "ASIC Ready!");
@@ -80,9 +121,9 @@ void create_jobs_task(void *pvParameters)
             current_work_protocol = active_protocol;
         }
 
-        uint64_t start_time = esp_timer_get_time();
         void *new_work = queue_dequeue_timeout(&GLOBAL_STATE->stratum_queue, timeout_ms);
-        timeout_ms -= (esp_timer_get_time() - start_time) / 1000;
+        timeout_ms = next_due_ms(GLOBAL_STATE, due_us);
+        uint32_t chains = all_chains;
 
         if (new_work != NULL) {
             active_protocol = GLOBAL_STATE->stratum_protocol;
@@ -100,22 +141,29 @@ void create_jobs_task(void *pvParameters)
                 ESP_LOGW(TAG, "Protocol switch detected during dequeue, discarding stale item");
                 free(new_work);
                 current_work_protocol = active_protocol;
-                timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
+                schedule_chains(GLOBAL_STATE, due_us, all_chains);
+                timeout_ms = next_due_ms(GLOBAL_STATE, due_us);
                 continue;
             }
 
             // Protocol unchanged — item matches current_work_protocol. Safe to cast.
-            if (current_work_protocol == STRATUM_V2) {
-                if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
-                    ESP_LOGI(TAG, "New Work Dequeued SV2 ext job %lu", ((sv2_ext_job_t *)new_work)->job_id);
+            // once per job, so skipped early when the tag is quieted
+            if (log_levels_enabled(TAG, ESP_LOG_INFO)) {
+                if (current_work_protocol == STRATUM_V2) {
+                    if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
+                        ESP_LOGI(TAG, "New Work Dequeued SV2 ext job %lu", ((sv2_ext_job_t *)new_work)->job_id);
+                    } else {
+                        ESP_LOGI(TAG, "New Work Dequeued SV2 job %lu", ((sv2_job_t *)new_work)->job_id);
+                    }
                 } else {
-                    ESP_LOGI(TAG, "New Work Dequeued SV2 job %lu", ((sv2_job_t *)new_work)->job_id);
+                    ESP_LOGI(TAG, "New Work Dequeued %s", ((mining_notify *)new_work)->job_id);
                 }
-            } else {
-                ESP_LOGI(TAG, "New Work Dequeued %s", ((mining_notify *)new_work)->job_id);
             }
 
             current_work = new_work;
+            for (int c = 0; c < GLOBAL_STATE->asic_chain_count; c++) {
+                work_epochs[c] = atomic_load(&GLOBAL_STATE->ASIC_CHAINS[c].chain.job_epoch);
+            }
 
             if (GLOBAL_STATE->new_set_mining_difficulty_msg) {
                 ESP_LOGI(TAG, "New pool difficulty %.2f", GLOBAL_STATE->pool_difficulty);
@@ -156,7 +204,13 @@ void create_jobs_task(void *pvParameters)
             // produces duplicate shares. Only send work on new jobs.
             // (V1 and SV2 extended are fine — extranonce_2 gives unique work each time.)
             if (active_protocol == STRATUM_V2 && !stratum_v2_is_extended_channel(GLOBAL_STATE)) {
-                timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
+                schedule_chains(GLOBAL_STATE, due_us, all_chains);
+                timeout_ms = next_due_ms(GLOBAL_STATE, due_us);
+                continue;
+            }
+            // only the chains whose own interval ran out
+            chains = due_chains(GLOBAL_STATE, due_us);
+            if (chains == 0) {
                 continue;
             }
         }
@@ -168,31 +222,63 @@ void create_jobs_task(void *pvParameters)
             free_work_item(GLOBAL_STATE, current_work, current_work_protocol);
             current_work = NULL;
             current_work_protocol = active_protocol;
-            timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
+            schedule_chains(GLOBAL_STATE, due_us, all_chains);
+            timeout_ms = next_due_ms(GLOBAL_STATE, due_us);
             continue;
         }
 
-        // Generate and send job
-        if (active_protocol == STRATUM_V2) {
-            if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
-                generate_work_sv2_ext(GLOBAL_STATE, (sv2_ext_job_t *)current_work, difficulty, extranonce_2);
-                extranonce_2++;
+        // Generate one job per chain that is due and hand it to that chain's dispatch task
+        for (int c = 0; c < GLOBAL_STATE->asic_chain_count; c++) {
+            if (!(chains & (1u << c))) continue;
+
+            bm_job *next_job;
+            if (active_protocol == STRATUM_V2) {
+                if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
+                    next_job = generate_work_sv2_ext(GLOBAL_STATE, (sv2_ext_job_t *)current_work, difficulty, extranonce_2);
+                    extranonce_2++;
+                } else {
+                    next_job = generate_work_sv2(GLOBAL_STATE, (sv2_job_t *)current_work, difficulty, c);
+                }
             } else {
-                generate_work_sv2(GLOBAL_STATE, (sv2_job_t *)current_work, difficulty);
+                next_job = generate_work(GLOBAL_STATE, (mining_notify *)current_work, extranonce_2, difficulty);
+                extranonce_2++;
+            }
+
+            if (next_job != NULL) {
+                next_job->epoch = work_epochs[c];
+                queue_enqueue(&GLOBAL_STATE->ASIC_CHAINS[c].job_queue, next_job);
             }
-        } else {
-            generate_work(GLOBAL_STATE, (mining_notify *)current_work, extranonce_2, difficulty);
-            extranonce_2++;
         }
-        timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
+        schedule_chains(GLOBAL_STATE, due_us, chains);
+        timeout_ms = next_due_ms(GLOBAL_STATE, due_us);
+    }
+}
+
+// Writes generated jobs to a single chain, so the UART transfers of several chains overlap
+void asic_dispatch_task(void *pvParameters)
+{
+    AsicChainModule *module = (AsicChainModule *)pvParameters;
+    GlobalState *GLOBAL_STATE = (GlobalState *)module->global_state;
+
+    while (1) {
+        bm_job *next_job = queue_dequeue(&module->job_queue);
+
+        if (!GLOBAL_STATE->ASIC_initalized || atomic_load(&module->chain.paused)) {
+            // Note: This job was never stored in active_jobs, so it's safe to free
+            free_bm_job(next_job);
+            continue;
+        }
+
+        ASIC_send_work(GLOBAL_STATE, &module->chain, next_job);
+        job_interval_job_sent(&GLOBAL_STATE->job_interval, module->chain.index, module->chain.job_id, esp_timer_get_time());
     }
 }
 
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty)
+static bm_job *generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty)
 {
     if (GLOBAL_STATE->extranonce_2_len > MAX_EXTRANONCE2_LEN) {
         ESP_LOGE(TAG, "extranonce_2_len %d exceeds maximum %d, skipping job", GLOBAL_STATE->extranonce_2_len, MAX_EXTRANONCE2_LEN);
-        return;
+        return NULL;
     }
     char extranonce_2_str[MAX_EXTRANONCE2_STR];
     extranonce_2_generate(extranonce_2, GLOBAL_STATE->extranonce_2_len, extranonce_2_str);
@@ -207,7 +293,7 @@ static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification
 
     if (next_job == NULL) {
         ESP_LOGE(TAG, "Failed to allocate memory for new job");
-        return;
+        return NULL;
     }
 
     construct_bm_job(notification, merkle_root, GLOBAL_STATE->version_mask, difficulty, next_job);
@@ -224,28 +310,29 @@ static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification
         free(next_job->jobid);
         free(next_job->extranonce2);
         free(next_job);
-        return;
+        return NULL;
     }
 
-    ASIC_send_work(GLOBAL_STATE, next_job);
+    return next_job;
 }
 
 // Construct bm_job directly from SV2 fields (no coinbase/merkle computation needed).
 // Standard channels rely on version rolling for unique work — the ASIC rolls the
 // version bits using version_mask, giving different midstates per nonce search space.
-static void generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *sv2_job, double difficulty)
+// With several chains there is no extranonce to split, so each chain gets its own ntime.
+static bm_job *generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *sv2_job, double difficulty, uint8_t chain_index)
 {
     bm_job *next_job = malloc(sizeof(bm_job));
     if (next_job == NULL) {
         ESP_LOGE(TAG, "Failed to allocate memory for new SV2 job");
-        return;
+        return NULL;
     }
 
     uint32_t version_mask = GLOBAL_STATE->version_mask;
 
     next_job->version = sv2_job->version;
     next_job->target = sv2_job->nbits;
-    next_job->ntime = sv2_job->ntime;
+    next_job->ntime = sv2_job->ntime + chain_index;
     next_job->starting_nonce = 0;
     next_job->pool_diff = difficulty;
 
@@ -298,24 +385,24 @@ static void generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *sv2_job, dou
         free(next_job->jobid);
         free(next_job->extranonce2);
         free(next_job);
-        return;
+        return NULL;
     }
 
-    ASIC_send_work(GLOBAL_STATE, next_job);
+    return next_job;
 }
 
 // Extended channel work generation: compute coinbase hash from prefix+extranonce+suffix,
 // then merkle root from merkle path, then midstates. extranonce_2 provides unique work.
-static void generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *ext_job,
-                                   double difficulty, uint64_t extranonce_2_counter)
+static bm_job *generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *ext_job,
+                                      double difficulty, uint64_t extranonce_2_counter)
 {
     sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
-    if (!conn) return;
+    if (!conn) return NULL;
 
     bm_job *next_job = malloc(sizeof(bm_job));
     if (!next_job) {
         ESP_LOGE(TAG, "Failed to allocate memory for SV2 ext job");
-        return;
+        return NULL;
     }
 
     uint32_t version_mask = GLOBAL_STATE->version_mask;
@@ -404,8 +491,8 @@ static void generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *ext_
         free(next_job->jobid);
         free(next_job->extranonce2);
         free(next_job);
-        return;
+        return NULL;
     }
 
-    ASIC_send_work(GLOBAL_STATE, next_job);
+    return next_job;
 }
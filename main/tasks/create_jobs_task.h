@@ -2,5 +2,6 @@
 #define CREATE_JOBS_TASK_H_
 
 void create_jobs_task(void *pvParameters);
+void asic_dispatch_task(void *pvParameters);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,9 @@
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "global_state.h"
@@ -17,9 +20,124 @@
 #define PID_I 0.1
 #define PID_D 2.0
 
+// Relay autotune, swinging the fan around where it sits
+#define TUNE_AMPLITUDE 15.0f
+#define TUNE_MIN_AMPLITUDE 5.0f
+#define TUNE_HYSTERESIS 0.3f
+#define TUNE_MAX_DEVIATION 8.0f
+#define TUNE_TIMEOUT_US (30 * 60 * 1000000LL)
+
+// Gain scheduling on the fan output, filtered over about a minute so a
+// passing spike does not switch regions
+#define REGION_MID 40.0f
+#define REGION_HIGH 70.0f
+#define REGION_HYSTERESIS 5.0f
+#define REGION_FILTER_ALPHA 0.002f
+
 static const char * TAG = "fan_controller";
 static const char * prev_context = "";
 
+const char * fan_region_to_string(fan_region_t region)
+{
+    switch (region) {
+        case FAN_REGION_LOW: return "low";
+        case FAN_REGION_MID: return "mid";
+        case FAN_REGION_HIGH: return "high";
+        default: return "unknown";
+    }
+}
+
+static fan_region_t region_of(float output, fan_region_t current)
+{
+    // the edges move away from the current region
+    float mid = REGION_MID + (current == FAN_REGION_LOW ? REGION_HYSTERESIS : -REGION_HYSTERESIS);
+    float high = REGION_HIGH + (current == FAN_REGION_HIGH ? -REGION_HYSTERESIS : REGION_HYSTERESIS);
+
+    if (output >= high) return FAN_REGION_HIGH;
+    if (output >= mid) return FAN_REGION_MID;
+    return FAN_REGION_LOW;
+}
+
+static bool read_gains(int region, pid_gains_t * gains)
+{
+    char * entry = nvs_config_get_string_indexed(NVS_CONFIG_FAN_GAINS, region);
+    bool found = entry != NULL && sscanf(entry, "%f;%f;%f", &gains->kp, &gains->ki, &gains->kd) == 3;
+    free(entry);
+    return found;
+}
+
+static void apply_gains(FanControllerModule * module, PIDController * pid, fan_region_t region)
+{
+    module->region = region;
+    module->tuned = false;
+
+    // a region not tuned yet borrows from the nearest one that is
+    for (int distance = 0; distance < FAN_REGION_COUNT && !module->tuned; distance++) {
+        if (region - distance >= 0 && read_gains(region - distance, &module->gains)) {
+            module->tuned = true;
+        } else if (distance > 0 && region + distance < FAN_REGION_COUNT && read_gains(region + distance, &module->gains)) {
+            module->tuned = true;
+        }
+    }
+    if (!module->tuned) {
+        module->gains = (pid_gains_t) { .kp = PID_P, .ki = PID_I, .kd = PID_D };
+    }
+
+    pid_set_tunings(pid, module->gains.kp, module->gains.ki, module->gains.kd);
+}
+
+static void start_autotune(FanControllerModule * module, float setpoint, float output, float output_min)
+{
+    float amplitude = fminf(TUNE_AMPLITUDE, fminf(output - output_min, 100 - output));
+    if (amplitude < TUNE_MIN_AMPLITUDE) {
+        ESP_LOGW(TAG, "No room to autotune around %.1f%%", output);
+        module->autotune.state = PID_AUTOTUNE_FAILED;
+        return;
+    }
+
+    pid_autotune_config_t config = {
+        .setpoint = setpoint,
+        .bias = output,
+        .amplitude = amplitude,
+        .hysteresis = TUNE_HYSTERESIS,
+        .max_deviation = TUNE_MAX_DEVIATION,
+        .timeout_us = TUNE_TIMEOUT_US,
+    };
+    pid_autotune_start(&module->autotune, &config, esp_timer_get_time());
+    ESP_LOGI(TAG, "Autotune around %.1f%% by %.1f%% at %.1f°C", output, amplitude, setpoint);
+}
+
+static void finish_autotune(FanControllerModule * module, PIDController * pid)
+{
+    const pid_autotune_t * tune = &module->autotune;
+    fan_region_t region = region_of(tune->config.bias, module->region);
+
+    char entry[48];
+    snprintf(entry, sizeof(entry), "%.4f;%.4f;%.4f", tune->gains.kp, tune->gains.ki, tune->gains.kd);
+    nvs_config_set_string_indexed(NVS_CONFIG_FAN_GAINS, region, entry);
+    ESP_LOGI(TAG, "Tuned the %s region", fan_region_to_string(region));
+
+    // the write above is queued, use the new gains straight away
+    module->region = region;
+    module->gains = tune->gains;
+    module->tuned = true;
+    pid_set_tunings(pid, module->gains.kp, module->gains.ki, module->gains.kd);
+}
+
+esp_err_t FAN_CONTROLLER_autotune_start(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    FanControllerModule * module = &GLOBAL_STATE->FAN_CONTROLLER_MODULE;
+
+    if (!nvs_config_get_bool(NVS_CONFIG_AUTO_FAN_SPEED)
+        || module->tune_requested || module->autotune.state == PID_AUTOTUNE_RUNNING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    module->tune_requested = true;
+    return ESP_OK;
+}
+
 static void update_fan_speed(GlobalState * GLOBAL_STATE, float target_perc, const char * context)
 {
     if (target_perc > 100.0f) target_perc = 100.0f;
@@ -56,18 +174,23 @@ void FAN_CONTROLLER_task(void * pvParameters)
     uint16_t pid_output_min = 0;
     int log_counter = 0;
     float filtered_input = -1.0f;
+    float filtered_output = 0;
 
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
 
     PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    FanControllerModule * module = &GLOBAL_STATE->FAN_CONTROLLER_MODULE;
 
     // Initialize PID controller with pid_d_startup and PID_REVERSE directly
     pid_init(&pid, &pid_input, &pid_output, &pid_setPoint, PID_P, PID_I, PID_D, PID_P_ON_E, PID_REVERSE);
     pid_set_sample_time(&pid, POLL_TIME_MS); // Sample time in ms
+    apply_gains(module, &pid, FAN_REGION_LOW);
 
     TickType_t taskWakeTime = xTaskGetTickCount();
 
     while (1) {
+        bool tuning = false;
+
         if (nvs_config_get_bool(NVS_CONFIG_OVERHEAT_MODE)) {
             update_fan_speed(GLOBAL_STATE, 100.0f, "Overheat");
         } else if (GLOBAL_STATE->SYSTEM_MODULE.mining_paused) {
@@ -108,14 +231,42 @@ void FAN_CONTROLLER_task(void * pvParameters)
                     if (pid_get_mode(&pid) == MANUAL) {
                         pid_set_mode(&pid, AUTOMATIC);
                         ESP_LOGI(TAG, "PID initialized at %.1f°C (P:%.1f I:%.1f D:%.1f", pid_input, pid.dispKp, pid.dispKi, pid.dispKd);
+                        filtered_output = pid_output;
+                    }
+
+                    if (module->tune_requested) {
+                        module->tune_requested = false;
+                        start_autotune(module, pid_setPoint, pid_output, pid_output_min);
                     }
-                    
-                    pid_compute(&pid);
 
-                    // Uncomment for debugging PID output directly after compute
-                    // ESP_LOGD(TAG, "DEBUG: PID raw output: %.2f%%, Input: %.1f, SetPoint: %.1f", pid_output, pid_input, pid_setPoint);
+                    if (module->autotune.state == PID_AUTOTUNE_RUNNING) {
+                        tuning = true;
+                        float tune_output = pid_autotune_update(&module->autotune, pid_input, esp_timer_get_time());
+                        if (module->autotune.state == PID_AUTOTUNE_DONE) {
+                            finish_autotune(module, &pid);
+                        }
+                        if (module->autotune.state != PID_AUTOTUNE_RUNNING) {
+                            // hand back to the PID from where the relay swung around
+                            pid_output = module->autotune.config.bias;
+                            pid_initialize(&pid);
+                        }
+                        update_fan_speed(GLOBAL_STATE, tune_output, "Autotune");
+                    } else {
+                        pid_compute(&pid);
+
+                        // Uncomment for debugging PID output directly after compute
+                        // ESP_LOGD(TAG, "DEBUG: PID raw output: %.2f%%, Input: %.1f, SetPoint: %.1f", pid_output, pid_input, pid_setPoint);
+
+                        filtered_output += REGION_FILTER_ALPHA * (pid_output - filtered_output);
+                        fan_region_t region = region_of(filtered_output, module->region);
+                        if (region != module->region) {
+                            apply_gains(module, &pid, region);
+                            ESP_LOGI(TAG, "Fan in the %s region (P:%.2f I:%.3f D:%.2f)",
+                                     fan_region_to_string(region), pid.dispKp, pid.dispKi, pid.dispKd);
+                        }
 
-                    update_fan_speed(GLOBAL_STATE, pid_output, "Auto");
+                        update_fan_speed(GLOBAL_STATE, pid_output, "Auto");
+                    }
 
                     log_counter += POLL_TIME_MS;
                     if (log_counter >= LOG_TIME_MS) {
@@ -131,6 +282,11 @@ void FAN_CONTROLLER_task(void * pvParameters)
             }
         }
 
+        // the relay only runs under auto control of a mining board
+        if (!tuning) {
+            pid_autotune_abort(&module->autotune);
+        }
+
         power_management->fan_rpm = Thermal_get_fan_speed(&GLOBAL_STATE->DEVICE_CONFIG);
         power_management->fan2_rpm = Thermal_get_fan2_speed(&GLOBAL_STATE->DEVICE_CONFIG);
 
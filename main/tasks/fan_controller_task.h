@@ -1,6 +1,35 @@
 #ifndef FAN_CONTROLLER_TASK_H_
 #define FAN_CONTROLLER_TASK_H_
 
+#include <stdbool.h>
+#include "esp_err.h"
+#include "pid_autotune.h"
+
+// Operating regions the PID gains are scheduled over, by how hard the fan
+// has to work: that follows both the ambient temperature and the load
+typedef enum {
+    FAN_REGION_LOW,
+    FAN_REGION_MID,
+    FAN_REGION_HIGH,
+    FAN_REGION_COUNT,
+} fan_region_t;
+
+typedef struct
+{
+    pid_autotune_t autotune;        // owned by the fan controller task
+    volatile bool tune_requested;
+
+    // published for the API
+    fan_region_t region;
+    pid_gains_t gains;              // in use for the region
+    bool tuned;                     // gains come from an autotune rather than the defaults
+} FanControllerModule;
+
 void FAN_CONTROLLER_task(void * pvParameters);
 
+// Fails with ESP_ERR_INVALID_STATE while a run is going or the fan is not on auto
+esp_err_t FAN_CONTROLLER_autotune_start(void * pvParameters);
+
+const char * fan_region_to_string(fan_region_t region);
+
 #endif /* FAN_CONTROLLER_TASK_H_ */
@@ -14,18 +14,9 @@
 #define HASHRATE_UNIT 0x100000uLL // Hashrate register unit (2^24 hashes)
 
 #define POLL_RATE 1000
-#define HASHRATE_1M_SIZE (60000 / POLL_RATE)  // 12
-#define HASHRATE_10M_SIZE 10
-#define HASHRATE_1H_SIZE 6
-#define DIV_10M (HASHRATE_1M_SIZE)
-#define DIV_1H (HASHRATE_10M_SIZE * DIV_10M)
-
-static unsigned long poll_count = 0;
-static float hashrate_1m[HASHRATE_1M_SIZE];
-static float hashrate_10m_prev;
-static float hashrate_10m[HASHRATE_10M_SIZE];
-static float hashrate_1h_prev;
-static float hashrate_1h[HASHRATE_1H_SIZE];
+// Register reads are spread out, so counters of a chip come in a poll period
+// apart give or take the scheduling
+#define MIN_COUNTER_INTERVAL_US 500000
 
 static const char *TAG = "hashrate_monitor";
 
@@ -75,7 +66,7 @@ void update_hash_counter(measurement_t * measurement, uint32_t value, uint64_t t
     uint64_t previous_time_us = measurement->time_us;
     if (previous_time_us != 0) {
         uint64_t duration_us = time_us - previous_time_us;
-        if (duration_us < 1000000) {
+        if (duration_us < MIN_COUNTER_INTERVAL_US) {
             // Ignore updates that are too close (e.g. rapid bursts) to avoid huge hashrate spikes
             return;
         }
@@ -87,58 +78,63 @@ void update_hash_counter(measurement_t * measurement, uint32_t value, uint64_t t
     measurement->time_us = time_us;
 }
 
-static void init_averages()
+static void update_measurement_average(hashrate_ewma_t * ewma, measurement_t * measurement, int64_t now_us)
 {
-    float nan_val = nanf("");
-    for (int i = 0; i < HASHRATE_1M_SIZE; i++) hashrate_1m[i] = nan_val;
-    for (int i = 0; i < HASHRATE_10M_SIZE; i++) hashrate_10m[i] = nan_val;
-    for (int i = 0; i < HASHRATE_1H_SIZE; i++) hashrate_1h[i] = nan_val;
-}
-
-static float calculate_avg_nan_safe(const float arr[], int size) {
-    float sum = 0.0f;
-    int count = 0;
-    for (int i = 0; i < size; i++) {
-        if (!isnanf(arr[i])) {
-            sum += arr[i];
-            count++;
-        }
+    // after a pause the counters need two reads before they give a hashrate,
+    // the zero in between is not a measurement
+    if (ewma->last_us == 0 && measurement->hashrate <= 0) {
+        return;
     }
-    return (count > 0) ? (sum / count) : 0.0f;
+
+    // chips without a read timestamp report their own hashrate, take the poll's
+    hashrate_ewma_update(ewma, measurement->hashrate, measurement->time_us != 0 ? measurement->time_us : now_us);
 }
 
-static void update_hashrate_averages(SystemModule * SYSTEM_MODULE)
+static void update_hashrate_averages(GlobalState * GLOBAL_STATE, int64_t now_us)
 {
-    hashrate_1m[poll_count % HASHRATE_1M_SIZE] = SYSTEM_MODULE->current_hashrate;
-    SYSTEM_MODULE->hashrate_1m = calculate_avg_nan_safe(hashrate_1m, HASHRATE_1M_SIZE);
+    HashrateMonitorModule * HASHRATE_MONITOR_MODULE = &GLOBAL_STATE->HASHRATE_MONITOR_MODULE;
+    SystemModule * SYSTEM_MODULE = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    int hashrate_10m_blend = poll_count % HASHRATE_1M_SIZE;
-    if (hashrate_10m_blend == 0) {
-        hashrate_10m_prev = hashrate_10m[(poll_count / DIV_10M) % HASHRATE_10M_SIZE];
-    }
-    float hashrate_1m_value = SYSTEM_MODULE->hashrate_1m;
-    if (!isnanf(hashrate_10m_prev)) {
-        float f = (hashrate_10m_blend + 1.0f) / (float)HASHRATE_1M_SIZE;
-        hashrate_1m_value = f * hashrate_1m_value + (1.0f - f) * hashrate_10m_prev;
-    }
+    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
+    int hash_domains = GLOBAL_STATE->DEVICE_CONFIG.family.asic.hash_domains;
 
-    hashrate_10m[(poll_count / DIV_10M) % HASHRATE_10M_SIZE] = hashrate_1m_value;
-    SYSTEM_MODULE->hashrate_10m = calculate_avg_nan_safe(hashrate_10m, HASHRATE_10M_SIZE);
+    // chips and domains are weighed by when their counters were read,
+    // a reading that did not change since the last poll is skipped
+    for (int asic_nr = 0; asic_nr < asic_count; asic_nr++) {
+        update_measurement_average(&HASHRATE_MONITOR_MODULE->asic_ewma[asic_nr],
+                                   &HASHRATE_MONITOR_MODULE->total_measurement[asic_nr], now_us);
 
-    int hashrate_1h_blend = poll_count % DIV_1H;
-    if (hashrate_1h_blend == 0) {
-        hashrate_1h_prev = hashrate_1h[(poll_count / DIV_1H) % HASHRATE_1H_SIZE];
-    }
-    float hashrate_10m_value = SYSTEM_MODULE->hashrate_10m;
-    if (!isnanf(hashrate_1h_prev)) {
-        float f = (hashrate_1h_blend + 1.0f) / (float)DIV_1H;
-        hashrate_10m_value = f * hashrate_10m_value + (1.0f - f) * hashrate_1h_prev;
+        for (int domain = 0; domain < hash_domains; domain++) {
+            update_measurement_average(&HASHRATE_MONITOR_MODULE->domain_ewma[asic_nr][domain],
+                                       &HASHRATE_MONITOR_MODULE->domain_measurements[asic_nr][domain], now_us);
+        }
     }
 
-    hashrate_1h[(poll_count / DIV_1H) % HASHRATE_1H_SIZE] = hashrate_10m_value;
-    SYSTEM_MODULE->hashrate_1h = calculate_avg_nan_safe(hashrate_1h, HASHRATE_1H_SIZE);
+    hashrate_ewma_t * ewma = &HASHRATE_MONITOR_MODULE->total_ewma;
+    hashrate_ewma_update(ewma, SYSTEM_MODULE->current_hashrate, now_us);
+
+    SYSTEM_MODULE->hashrate_5s = hashrate_ewma_get(ewma, HASHRATE_EWMA_5S);
+    SYSTEM_MODULE->hashrate_1m = hashrate_ewma_get(ewma, HASHRATE_EWMA_1M);
+    SYSTEM_MODULE->hashrate_10m = hashrate_ewma_get(ewma, HASHRATE_EWMA_10M);
+    SYSTEM_MODULE->hashrate_15m = hashrate_ewma_get(ewma, HASHRATE_EWMA_15M);
+    SYSTEM_MODULE->hashrate_1h = hashrate_ewma_get(ewma, HASHRATE_EWMA_1H);
+    SYSTEM_MODULE->hashrate_24h = hashrate_ewma_get(ewma, HASHRATE_EWMA_24H);
+}
+
+static void pause_hashrate_averages(GlobalState * GLOBAL_STATE)
+{
+    HashrateMonitorModule * HASHRATE_MONITOR_MODULE = &GLOBAL_STATE->HASHRATE_MONITOR_MODULE;
+
+    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
+    int hash_domains = GLOBAL_STATE->DEVICE_CONFIG.family.asic.hash_domains;
 
-    poll_count++;
+    hashrate_ewma_pause(&HASHRATE_MONITOR_MODULE->total_ewma);
+    for (int asic_nr = 0; asic_nr < asic_count; asic_nr++) {
+        hashrate_ewma_pause(&HASHRATE_MONITOR_MODULE->asic_ewma[asic_nr]);
+        for (int domain = 0; domain < hash_domains; domain++) {
+            hashrate_ewma_pause(&HASHRATE_MONITOR_MODULE->domain_ewma[asic_nr][domain]);
+        }
+    }
 }
 
 void hashrate_monitor_task(void *pvParameters)
@@ -158,17 +154,40 @@ void hashrate_monitor_task(void *pvParameters)
     }
     HASHRATE_MONITOR_MODULE->error_measurement = heap_caps_malloc(asic_count * sizeof(measurement_t), MALLOC_CAP_SPIRAM);
 
+    hashrate_ewma_reset(&HASHRATE_MONITOR_MODULE->total_ewma);
+    HASHRATE_MONITOR_MODULE->asic_ewma = heap_caps_calloc(asic_count, sizeof(hashrate_ewma_t), MALLOC_CAP_SPIRAM);
+    hashrate_ewma_t* domain_ewma = heap_caps_calloc(asic_count * hash_domains, sizeof(hashrate_ewma_t), MALLOC_CAP_SPIRAM);
+    HASHRATE_MONITOR_MODULE->domain_ewma = heap_caps_malloc(asic_count * sizeof(hashrate_ewma_t*), MALLOC_CAP_SPIRAM);
+    for (size_t asic_nr = 0; asic_nr < asic_count; asic_nr++) {
+        HASHRATE_MONITOR_MODULE->domain_ewma[asic_nr] = domain_ewma + (asic_nr * hash_domains);
+    }
+
     pthread_mutex_init(&HASHRATE_MONITOR_MODULE->lock, NULL);
     HASHRATE_MONITOR_MODULE->is_initialized = true;
 
     hashrate_monitor_reset_measurements(GLOBAL_STATE);
 
-    init_averages();
-
     bool was_asic_initialized = false;
-    TickType_t taskWakeTime = xTaskGetTickCount();
+    int64_t next_update_us = esp_timer_get_time();
     while (1) {
+        int64_t now_us = esp_timer_get_time();
         bool is_asic_initialized = GLOBAL_STATE->ASIC_initalized;
+        int64_t next_read_us = 0;
+
+        if (is_asic_initialized) {
+            next_read_us = ASIC_poll_registers(GLOBAL_STATE, now_us);
+        }
+
+        if (now_us < next_update_us) {
+            int64_t wake_us = next_read_us != 0 && next_read_us < next_update_us ? next_read_us : next_update_us;
+            TickType_t ticks = (wake_us - now_us) / 1000 / portTICK_PERIOD_MS;
+            vTaskDelay(ticks > 0 ? ticks : 1);
+            continue;
+        }
+        next_update_us += POLL_RATE * 1000LL;
+        if (next_update_us <= now_us) {
+            next_update_us = now_us + POLL_RATE * 1000LL;
+        }
 
         if (was_asic_initialized && !is_asic_initialized) {
             // ASIC just stopped (pause or overheat): clear measurements so that
@@ -180,9 +199,6 @@ void hashrate_monitor_task(void *pvParameters)
         was_asic_initialized = is_asic_initialized;
 
         if (is_asic_initialized) {
-            ASIC_read_registers(GLOBAL_STATE);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-
             pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
             float current_hashrate = sum_hashrates(HASHRATE_MONITOR_MODULE->total_measurement, asic_count);
             float error_hashrate = sum_hashrates(HASHRATE_MONITOR_MODULE->error_measurement, asic_count);
@@ -191,12 +207,20 @@ void hashrate_monitor_task(void *pvParameters)
             SYSTEM_MODULE->current_hashrate = current_hashrate;
             SYSTEM_MODULE->error_percentage = current_hashrate > 0 ? error_hashrate / current_hashrate * 100.f : 0;
 
-            if (current_hashrate > 0.0f) update_hashrate_averages(SYSTEM_MODULE);
+            pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
+            if (current_hashrate > 0.0f) {
+                update_hashrate_averages(GLOBAL_STATE, now_us);
+            } else {
+                pause_hashrate_averages(GLOBAL_STATE);
+            }
+            pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
+
+            SYSTEM_update_share_hashrate(GLOBAL_STATE, current_hashrate > 0.0f);
         } else {
             SYSTEM_MODULE->current_hashrate = 0;
+            pause_hashrate_averages(GLOBAL_STATE);
+            SYSTEM_update_share_hashrate(GLOBAL_STATE, false);
         }
-
-        vTaskDelayUntil(&taskWakeTime, POLL_RATE / portTICK_PERIOD_MS);
     }
 }
 
@@ -2,6 +2,7 @@
 #define HASHRATE_MONITOR_TASK_H_
 
 #include "asic_common.h"
+#include "hashrate_ewma.h"
 #include <pthread.h>
 
 typedef struct {
@@ -15,6 +16,11 @@ typedef struct {
     measurement_t** domain_measurements;
     measurement_t* error_measurement;
 
+    // averages, kept across pauses
+    hashrate_ewma_t total_ewma;
+    hashrate_ewma_t* asic_ewma;
+    hashrate_ewma_t** domain_ewma;
+
     pthread_mutex_t lock;
     bool is_initialized;
 } HashrateMonitorModule;
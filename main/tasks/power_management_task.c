@@ -1,4 +1,7 @@
+#include <math.h>
+
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "global_state.h"
@@ -10,7 +13,7 @@
 #include "utils.h"
 #include "asic_init.h"
 #include "asic_reset.h"
-#include "driver/uart.h"
+#include "serial.h"
 
 #define POLL_RATE 100
 #define MAX_TEMP 90.0
@@ -26,6 +29,11 @@
 
 #define ASIC_REDUCTION 100.0
 
+// Past this the fan has nothing left to give
+#define FAN_HEADROOM_PERC 95.0
+
+#define CHAIN_HEALTH_INTERVAL_US 1000000
+
 static const char * TAG = "power_management";
 
 static void mining_stop(GlobalState * GLOBAL_STATE)
@@ -52,7 +60,9 @@ static void mining_stop(GlobalState * GLOBAL_STATE)
     vTaskDelay(500 / portTICK_PERIOD_MS);
 
     // Flush any stale data from the UART buffers
-    uart_flush(UART_NUM_1);
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        SERIAL_clear_buffer(GLOBAL_STATE->ASIC_CHAINS[i].chain.port);
+    }
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     ESP_LOGI(TAG, "Mining stopped");
@@ -70,7 +80,9 @@ static uint8_t mining_start(GlobalState * GLOBAL_STATE)
     vTaskDelay(500 / portTICK_PERIOD_MS);
 
     // Clear any accumulated UART garbage before init
-    uart_flush(UART_NUM_1);
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        SERIAL_clear_buffer(GLOBAL_STATE->ASIC_CHAINS[i].chain.port);
+    }
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     POWER_MANAGEMENT_init_frequency(GLOBAL_STATE);
@@ -87,11 +99,65 @@ static uint8_t mining_start(GlobalState * GLOBAL_STATE)
     return chip_count;
 }
 
+// Soft resets the chains that lost a chip, or power cycles when a chain has
+// nothing left to bypass to
+static void check_chain_health(GlobalState * GLOBAL_STATE)
+{
+    int64_t now_us = esp_timer_get_time();
+    bool power_cycle = false;
+
+    for (int i = 0; i < GLOBAL_STATE->asic_chain_count; i++) {
+        asic_chain_t * chain = &GLOBAL_STATE->ASIC_CHAINS[i].chain;
+
+        switch (chain_health_check(&chain->health, now_us)) {
+            case CHAIN_HEALTH_OK:
+                break;
+            case CHAIN_HEALTH_RESET:
+            case CHAIN_HEALTH_BYPASS:
+                // keep this chain's tasks off its UART while it is re-addressed,
+                // the other chains go on hashing
+                if (!ASIC_pause_chain(chain)) {
+                    ESP_LOGE(TAG, "Chain %d result task did not pause", i);
+                    power_cycle = true;
+                    break;
+                }
+                // a job being written when the pause came is out by then
+                vTaskDelay(50 / portTICK_PERIOD_MS);
+
+                if (ASIC_soft_reset_chain(GLOBAL_STATE, chain) == 0) {
+                    // stays paused until the power cycle brings it back
+                    ESP_LOGE(TAG, "Chain %d did not come back from the soft reset", i);
+                    power_cycle = true;
+                    break;
+                }
+                atomic_store(&chain->paused, false);
+                break;
+            case CHAIN_HEALTH_POWER_CYCLE:
+                power_cycle = true;
+                break;
+        }
+    }
+
+    if (power_cycle) {
+        mining_stop(GLOBAL_STATE);
+        mining_start(GLOBAL_STATE);
+    }
+}
+
 static float expected_hashrate(GlobalState * GLOBAL_STATE)
 {
     return GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value * GLOBAL_STATE->DEVICE_CONFIG.family.asic.small_core_count * GLOBAL_STATE->DEVICE_CONFIG.family.asic_count / 1000.0;
 }
 
+// The configured power cap, never above what the board is built for
+static float power_cap(GlobalState * GLOBAL_STATE)
+{
+    float max_power = GLOBAL_STATE->DEVICE_CONFIG.family.max_power;
+    uint16_t cap = nvs_config_get_u16(NVS_CONFIG_POWER_CAP);
+
+    return cap != 0 && cap < max_power ? cap : max_power;
+}
+
 void POWER_MANAGEMENT_init_frequency(void * pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
@@ -117,6 +183,10 @@ void POWER_MANAGEMENT_task(void * pvParameters)
     SystemModule * sys_module = &GLOBAL_STATE->SYSTEM_MODULE;
 
     POWER_MANAGEMENT_init_frequency(GLOBAL_STATE);
+    power_governor_init(&power_management->power_governor, power_cap(GLOBAL_STATE),
+                        GLOBAL_STATE->DEVICE_CONFIG.family.asic.frequency_options[0]);
+    thermal_governor_init(&power_management->thermal_governor,
+                          GLOBAL_STATE->DEVICE_CONFIG.family.asic.frequency_options[0]);
     
     float last_asic_frequency = power_management->frequency_value;
 
@@ -126,6 +196,7 @@ void POWER_MANAGEMENT_task(void * pvParameters)
     uint16_t last_known_asic_voltage = 0;
     float last_known_asic_frequency = 0.0;
     bool is_paused = false;
+    int64_t last_health_us = esp_timer_get_time();
 
     while (1) {
         if (GLOBAL_STATE->SELF_TEST_MODULE.is_finished) {
@@ -149,6 +220,8 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             is_paused = true;
         } else if (!wants_stop && is_paused) {
             mining_start(GLOBAL_STATE);
+            power_governor_reset(&power_management->power_governor);
+            thermal_governor_reset(&power_management->thermal_governor);
             is_paused = false;
         }
 
@@ -230,6 +303,26 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         uint16_t core_voltage = nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE);
         float asic_frequency = nvs_config_get_float(NVS_CONFIG_ASIC_FREQUENCY);
 
+        // autotune points are tried without writing them to flash
+        if (power_management->tune_voltage != 0) {
+            core_voltage = power_management->tune_voltage;
+        }
+        if (power_management->tune_frequency != 0) {
+            asic_frequency = power_management->tune_frequency;
+        }
+
+        // trade frequency for power rather than tripping the overheat stop
+        power_governor_set_cap(&power_management->power_governor, power_cap(GLOBAL_STATE));
+        asic_frequency = power_governor_update(&power_management->power_governor, power_management->power,
+                                               asic_frequency, esp_timer_get_time());
+
+        // slow down ahead of the limits, the overheat stop above is the last resort
+        float chip_temp = fmaxf(power_management->chip_temp_avg, power_management->chip_temp2_avg);
+        float headroom = fminf(THROTTLE_TEMP - chip_temp, TPS546_THROTTLE_TEMP - power_management->vr_temp);
+        bool fan_headroom = nvs_config_get_bool(NVS_CONFIG_AUTO_FAN_SPEED) && power_management->fan_perc < FAN_HEADROOM_PERC;
+        asic_frequency = thermal_governor_update(&power_management->thermal_governor, headroom, fan_headroom,
+                                                 asic_frequency, esp_timer_get_time());
+
         if (core_voltage != last_core_voltage) {
             ESP_LOGI(TAG, "setting new vcore voltage to %umV", core_voltage);
             VCORE_set_voltage(GLOBAL_STATE, (double) core_voltage / 1000.0);
@@ -248,6 +341,11 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             last_asic_frequency = asic_frequency;
         }
 
+        if (!GLOBAL_STATE->SELF_TEST_MODULE.is_active && esp_timer_get_time() - last_health_us >= CHAIN_HEALTH_INTERVAL_US) {
+            check_chain_health(GLOBAL_STATE);
+            last_health_us = esp_timer_get_time();
+        }
+
         // Check for changing of overheat mode
         bool new_overheat_mode = nvs_config_get_bool(NVS_CONFIG_OVERHEAT_MODE);
         
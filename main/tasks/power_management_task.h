@@ -1,6 +1,9 @@
 #ifndef POWER_MANAGEMENT_TASK_H_
 #define POWER_MANAGEMENT_TASK_H_
 
+#include "power_governor.h"
+#include "thermal_governor.h"
+
 typedef struct
 {
     float fan_perc;
@@ -16,6 +19,13 @@ typedef struct
     float power;
     float current;
     float core_voltage;
+    // set by the autotune task while it measures a point, 0 follows NVS
+    float tune_frequency;
+    uint16_t tune_voltage;
+    power_governor_t power_governor;
+    thermal_governor_t thermal_governor;
+    // paces the frequency ramp, NULL ramps at a fixed pace
+    int16_t (*read_core_voltage_mv)(void * pvParameters);
 } PowerManagementModule;
 
 void POWER_MANAGEMENT_init_frequency(void * pvParameters);
@@ -2,6 +2,7 @@
 #include <pthread.h>
 #include <math.h>
 #include <string.h>
+#include <stddef.h>
 #include "esp_log.h"
 #include "esp_timer.h"
 #include <esp_heap_caps.h>
@@ -11,26 +12,180 @@
 #include "global_state.h"
 #include "nvs_config.h"
 #include "connect.h"
+#include "history.h"
 
 #define DEFAULT_POLL_RATE 1000
 
+// Each column is quantized to its resolution and kept in a history of
+// compressed blocks. Values beyond this many steps, and readings that are
+// not a number, are stored as 0.
+#define MAX_COLUMNS (1 + 3 * STATISTICS_FIELD_COUNT)
+#define MAX_STEPS 1e15
+
+_Static_assert(MAX_COLUMNS <= HISTORY_MAX_COLUMNS, "statistics columns do not fit a history block");
+
 static const char * TAG = "statistics_task";
 
-static StatisticsDataPtr statisticsBuffer;
-static uint16_t statisticsDataSize;
+// Round-robin tiers, each consolidating the one above it into avg, min and
+// max. Samples are taken every statsFrequency seconds and enter at the first
+// tier that is not finer than that, the tiers above it are not kept.
+typedef struct
+{
+    uint32_t interval;              // seconds per point
+    uint32_t size;                  // bytes of closed blocks
+    uint16_t blocks;                // most closed blocks held
+    uint8_t consolidations;         // avg only, or avg with the spreads down to min and up to max
+    history_t history;
+
+    // the point being consolidated from the tier above
+    uint64_t bucket;
+    uint32_t samples;
+    double sum[STATISTICS_FIELD_COUNT];
+    double low[STATISTICS_FIELD_COUNT];
+    double high[STATISTICS_FIELD_COUNT];
+    uint64_t timestamp;
+} StatisticsTier;
+
+typedef enum
+{
+    FIELD_FLOAT,
+    FIELD_INT16,
+    FIELD_UINT16,
+    FIELD_INT8,
+    FIELD_UINT32,
+} FieldType;
+
+static const struct
+{
+    size_t offset;
+    FieldType type;
+    float scale;                    // steps per unit kept
+} statisticsFields[STATISTICS_FIELD_COUNT] = {
+    [STATISTICS_HASHRATE] = {offsetof(struct StatisticsData, hashrate), FIELD_FLOAT, 0.1},
+    [STATISTICS_HASHRATE_1m] = {offsetof(struct StatisticsData, hashrate_1m), FIELD_FLOAT, 1},
+    [STATISTICS_HASHRATE_10m] = {offsetof(struct StatisticsData, hashrate_10m), FIELD_FLOAT, 1},
+    [STATISTICS_HASHRATE_1h] = {offsetof(struct StatisticsData, hashrate_1h), FIELD_FLOAT, 1},
+    [STATISTICS_ERROR_PERCENTAGE] = {offsetof(struct StatisticsData, errorPercentage), FIELD_FLOAT, 10},
+    [STATISTICS_ASIC_TEMP] = {offsetof(struct StatisticsData, chipTemperature), FIELD_FLOAT, 10},
+    [STATISTICS_ASIC_TEMP2] = {offsetof(struct StatisticsData, chipTemperature2), FIELD_FLOAT, 10},
+    [STATISTICS_VR_TEMP] = {offsetof(struct StatisticsData, vrTemperature), FIELD_FLOAT, 10},
+    [STATISTICS_ASIC_VOLTAGE] = {offsetof(struct StatisticsData, coreVoltageActual), FIELD_INT16, 1},
+    [STATISTICS_VOLTAGE] = {offsetof(struct StatisticsData, voltage), FIELD_FLOAT, 0.1},
+    [STATISTICS_POWER] = {offsetof(struct StatisticsData, power), FIELD_FLOAT, 10},
+    [STATISTICS_CURRENT] = {offsetof(struct StatisticsData, current), FIELD_FLOAT, 0.1},
+    [STATISTICS_FAN_SPEED] = {offsetof(struct StatisticsData, fanSpeed), FIELD_FLOAT, 1},
+    [STATISTICS_FAN_RPM] = {offsetof(struct StatisticsData, fanRPM), FIELD_UINT16, 0.1},
+    [STATISTICS_FAN2_RPM] = {offsetof(struct StatisticsData, fan2RPM), FIELD_UINT16, 0.1},
+    [STATISTICS_WIFI_RSSI] = {offsetof(struct StatisticsData, wifiRSSI), FIELD_INT8, 1},
+    [STATISTICS_FREE_HEAP] = {offsetof(struct StatisticsData, freeHeap), FIELD_UINT32, 0.001},
+    [STATISTICS_RESPONSE_TIME] = {offsetof(struct StatisticsData, responseTime), FIELD_FLOAT, 1},
+};
+
+// With the staging and the block lists the tiers take about 58 kB, 51 kB
+// once samples are 2 s or more apart, against the 56 kB the flat buffer of
+// 720 points of 80 bytes used to. The hourly tier keeps the avg only, so it
+// reaches back the 720 hours of the longest window. On simulated readings
+// with the noise of a running miner a sample packs into about 8 bytes, a
+// point of avg, min and max into 13 to 19; the spans below are for those.
+static StatisticsTier statisticsTiers[STATISTICS_TIER_COUNT] = {
+    {.interval = 1, .size = 6 * 1024, .blocks = 32, .consolidations = 1},          // ~13 min
+    {.interval = 10, .size = 8 * 1024, .blocks = 48, .consolidations = 3},         // ~1 h, ~2 h at 10 s samples
+    {.interval = 300, .size = 22 * 1024, .blocks = 88, .consolidations = 3},       // ~4 to 6 days
+    {.interval = 3600, .size = 8 * 1024, .blocks = 48, .consolidations = 1},       // ~6 weeks
+};
+static uint8_t statisticsFirstTier = STATISTICS_TIER_COUNT; // the one samples enter at, none kept at the count
 static pthread_mutex_t statisticsDataLock = PTHREAD_MUTEX_INITIALIZER;
 
-static const uint16_t maxDataCount = MAX_STATISTICS_COUNT;
+static double readField(const struct StatisticsData * data, int field)
+{
+    const uint8_t * value = (const uint8_t *)data + statisticsFields[field].offset;
+
+    switch (statisticsFields[field].type) {
+        case FIELD_FLOAT: return *(const float *)value;
+        case FIELD_INT16: return *(const int16_t *)value;
+        case FIELD_UINT16: return *(const uint16_t *)value;
+        case FIELD_INT8: return *(const int8_t *)value;
+        case FIELD_UINT32: return *(const uint32_t *)value;
+    }
+    return 0;
+}
+
+float getStatisticValue(const struct StatisticsData * data, StatisticsField field)
+{
+    return field < STATISTICS_FIELD_COUNT ? readField(data, field) : 0;
+}
+
+static void writeField(struct StatisticsData * data, int field, double value)
+{
+    uint8_t * target = (uint8_t *)data + statisticsFields[field].offset;
+
+    switch (statisticsFields[field].type) {
+        case FIELD_FLOAT: *(float *)target = value; break;
+        case FIELD_INT16: *(int16_t *)target = lround(value); break;
+        case FIELD_UINT16: *(uint16_t *)target = lround(value); break;
+        case FIELD_INT8: *(int8_t *)target = lround(value); break;
+        case FIELD_UINT32: *(uint32_t *)target = lround(value); break;
+    }
+}
+
+static void freeStatisticsTier(StatisticsTier * tier)
+{
+    history_t * history = &tier->history;
+    heap_caps_free(history->data);
+    heap_caps_free(history->blocks);
+    heap_caps_free(history->open);
+    history->data = history->open = NULL;
+    history->blocks = NULL;
+}
+
+static bool allocateStatisticsTier(StatisticsTier * tier)
+{
+    uint8_t columns = 1 + tier->consolidations * STATISTICS_FIELD_COUNT;
+
+    uint8_t * data = heap_caps_malloc(tier->size, MALLOC_CAP_SPIRAM);
+    history_block_t * blocks = heap_caps_malloc(sizeof(history_block_t) * tier->blocks, MALLOC_CAP_SPIRAM);
+    uint8_t * open = heap_caps_malloc(HISTORY_COLUMN_BYTES * columns, MALLOC_CAP_SPIRAM);
+
+    history_init(&tier->history, columns, data, tier->size, blocks, tier->blocks, open);
+    tier->samples = 0;
+
+    if (NULL == data || NULL == blocks || NULL == open) {
+        freeStatisticsTier(tier);
+        return false;
+    }
+    return true;
+}
+
+static void freeStatisticsTiers()
+{
+    for (int i = 0; i < STATISTICS_TIER_COUNT; i++) {
+        freeStatisticsTier(&statisticsTiers[i]);
+    }
+    statisticsFirstTier = STATISTICS_TIER_COUNT;
+}
 
-void createStatisticsBuffer()
+// Keeps the tiers from first on, those already held go on with their points
+void createStatisticsBuffer(uint8_t first)
 {
-    if (NULL == statisticsBuffer) {
+    if (first != statisticsFirstTier) {
         pthread_mutex_lock(&statisticsDataLock);
 
-        if (NULL == statisticsBuffer) {
-            statisticsBuffer = (StatisticsDataPtr)heap_caps_malloc(sizeof(struct StatisticsData) * maxDataCount, MALLOC_CAP_SPIRAM);
-            if (NULL == statisticsBuffer) {
+        if (first != statisticsFirstTier) {
+            bool ok = true;
+            for (int i = 0; i < STATISTICS_TIER_COUNT; i++) {
+                StatisticsTier * tier = &statisticsTiers[i];
+                if (i < first) {
+                    freeStatisticsTier(tier);
+                } else if (NULL == tier->history.data) {
+                    ok &= allocateStatisticsTier(tier);
+                }
+            }
+
+            if (ok) {
+                statisticsFirstTier = first;
+            } else {
                 ESP_LOGW(TAG, "Not enough memory for the statistics data buffer!");
+                freeStatisticsTiers();
             }
         }
 
@@ -40,21 +195,101 @@ void createStatisticsBuffer()
 
 void removeStatisticsBuffer()
 {
-    if (NULL != statisticsBuffer) {
+    if (STATISTICS_TIER_COUNT != statisticsFirstTier) {
         pthread_mutex_lock(&statisticsDataLock);
 
-        if (NULL != statisticsBuffer) {
-            heap_caps_free(statisticsBuffer);
-
-            statisticsBuffer = NULL;
-            statisticsDataSize = 0;
+        if (STATISTICS_TIER_COUNT != statisticsFirstTier) {
+            freeStatisticsTiers();
         }
 
         pthread_mutex_unlock(&statisticsDataLock);
     }
 }
 
-bool addStatisticData(StatisticsDataPtr data, uint16_t statsFrequency)
+static void accumulateTier(int index, const struct StatisticsData * avg, const struct StatisticsData * min, const struct StatisticsData * max);
+
+// Steps of the field's resolution, 0 for what would not fit
+static int64_t quantize(double value, int field)
+{
+    double steps = value * statisticsFields[field].scale;
+    return isfinite(steps) && fabs(steps) < MAX_STEPS ? llround(steps) : 0;
+}
+
+static void pushTier(int index, const struct StatisticsData * avg, const struct StatisticsData * min, const struct StatisticsData * max)
+{
+    StatisticsTier * tier = &statisticsTiers[index];
+    int64_t values[MAX_COLUMNS];
+
+    // in the order of StatisticsConsolidation, min and max as their spread
+    // around the avg, which stays small where the values themselves do not
+    values[0] = avg->timestamp;
+    for (int field = 0; field < STATISTICS_FIELD_COUNT; field++) {
+        int64_t middle = quantize(readField(avg, field), field);
+
+        values[1 + STATISTICS_AVG * STATISTICS_FIELD_COUNT + field] = middle;
+        if (1 < tier->consolidations) {
+            values[1 + STATISTICS_MIN * STATISTICS_FIELD_COUNT + field] = middle - quantize(readField(min, field), field);
+            values[1 + STATISTICS_MAX * STATISTICS_FIELD_COUNT + field] = quantize(readField(max, field), field) - middle;
+        }
+    }
+    history_push(&tier->history, values);
+
+    if (index + 1 < STATISTICS_TIER_COUNT) {
+        accumulateTier(index + 1, avg, min, max);
+    }
+}
+
+static void flushTier(int index)
+{
+    StatisticsTier * tier = &statisticsTiers[index];
+    struct StatisticsData avg = {.timestamp = tier->timestamp};
+    struct StatisticsData min = {.timestamp = tier->timestamp};
+    struct StatisticsData max = {.timestamp = tier->timestamp};
+
+    for (int field = 0; field < STATISTICS_FIELD_COUNT; field++) {
+        writeField(&avg, field, tier->sum[field] / tier->samples);
+        writeField(&min, field, tier->low[field]);
+        writeField(&max, field, tier->high[field]);
+    }
+    tier->samples = 0;
+
+    pushTier(index, &avg, &min, &max);
+}
+
+static void accumulateTier(int index, const struct StatisticsData * avg, const struct StatisticsData * min, const struct StatisticsData * max)
+{
+    StatisticsTier * tier = &statisticsTiers[index];
+    uint64_t bucket = avg->timestamp / (tier->interval * 1000ULL);
+
+    if (0 != tier->samples && bucket != tier->bucket) {
+        flushTier(index);
+    }
+
+    for (int field = 0; field < STATISTICS_FIELD_COUNT; field++) {
+        double low = readField(min, field);
+        double high = readField(max, field);
+
+        tier->sum[field] = (0 == tier->samples ? 0 : tier->sum[field]) + readField(avg, field);
+        if (0 == tier->samples || low < tier->low[field]) tier->low[field] = low;
+        if (0 == tier->samples || high > tier->high[field]) tier->high[field] = high;
+    }
+    tier->bucket = bucket;
+    tier->timestamp = avg->timestamp;
+    tier->samples++;
+}
+
+// The first tier whose points are at least as far apart as the samples
+static uint8_t entryTier(uint16_t frequency)
+{
+    for (uint8_t i = 0; i < STATISTICS_TIER_COUNT; i++) {
+        if (statisticsTiers[i].interval >= frequency) {
+            return i;
+        }
+    }
+    return STATISTICS_TIER_COUNT - 1;
+}
+
+bool addStatisticData(StatisticsDataPtr data, uint16_t frequency)
 {
     bool result = false;
 
@@ -62,89 +297,142 @@ bool addStatisticData(StatisticsDataPtr data, uint16_t statsFrequency)
         return result;
     }
 
-    createStatisticsBuffer();
+    createStatisticsBuffer(entryTier(frequency));
 
     pthread_mutex_lock(&statisticsDataLock);
 
-    if (NULL != statisticsBuffer) {
-        if (statisticsDataSize < maxDataCount) {
-            statisticsBuffer[statisticsDataSize] = *data;
-            statisticsDataSize++;
-            result = true;
+    if (STATISTICS_TIER_COUNT != statisticsFirstTier) {
+        // samples as far apart as the tier's points go in as they are
+        if (statisticsTiers[statisticsFirstTier].interval <= frequency) {
+            pushTier(statisticsFirstTier, data, data, data);
         } else {
-            // Buffer is full. Determine indexToRemove using Triangle Area thinning logic.
-            uint16_t indexToRemove = 0;
-            const uint64_t currentSpan = data->timestamp - statisticsBuffer[0].timestamp;
-            const uint64_t targetDuration = (uint64_t)maxDataCount * (uint64_t)statsFrequency * 1000;
+            accumulateTier(statisticsFirstTier, data, data, data);
+        }
+        result = true;
+    }
 
-            if (currentSpan >= targetDuration) {
-                indexToRemove = 0;
-            } else {
-                uint16_t low = 1;
-                uint16_t high = maxDataCount - 1;
-
-                while (high - low > 1) {
-                    uint64_t lowTime = statisticsBuffer[low].timestamp;
-                    uint64_t highTime = statisticsBuffer[high].timestamp;
-                    uint64_t midTime = (lowTime + highTime) / 2;
-
-                    uint16_t split = low;
-                    for (uint16_t i = low; i <= high; i++) {
-                        uint64_t t = statisticsBuffer[i].timestamp;
-                        if (t >= midTime) {
-                            split = i;
-                            break;
-                        }
-                    }
-
-                    // Ensure progress
-                    if (split == low) split++;
-                    if (split > high) split = high;
-
-                    uint16_t leftCount = split - low;
-                    uint16_t rightCount = high - split + 1;
-
-                    if (leftCount > rightCount) {
-                        high = split - 1;
-                    } else {
-                        low = split;
-                    }
-                }
-                indexToRemove = low;
-            }
+    pthread_mutex_unlock(&statisticsDataLock);
 
-            // Shift and append (Standard linear array shift)
-            if (indexToRemove < maxDataCount - 1) {
-                memmove(&statisticsBuffer[indexToRemove], &statisticsBuffer[indexToRemove + 1], (maxDataCount - indexToRemove - 1) * sizeof(struct StatisticsData));
-            }
-            statisticsBuffer[maxDataCount - 1] = *data;
-            result = true;
+    return result;
+}
+
+uint8_t getStatisticTier(uint32_t window)
+{
+    uint64_t now = esp_timer_get_time() / 1000;
+    uint64_t since = now > (uint64_t)window * 1000 ? now - (uint64_t)window * 1000 : 0;
+    uint8_t best = UINT8_MAX;
+    uint64_t bestOldest = UINT64_MAX;
+
+    pthread_mutex_lock(&statisticsDataLock);
+
+    for (uint8_t i = 0; i < STATISTICS_TIER_COUNT; i++) {
+        const StatisticsTier * tier = &statisticsTiers[i];
+        if (window / tier->interval > MAX_STATISTICS_COUNT) {
+            continue;
+        }
+
+        uint64_t oldest = NULL != tier->history.data ? history_oldest(&tier->history) : UINT64_MAX;
+        if (oldest <= since) {
+            best = i;
+            break;
+        }
+        // otherwise the one that goes back furthest
+        if (UINT8_MAX == best || oldest < bestOldest) {
+            best = i;
+            bestOldest = oldest;
         }
     }
 
     pthread_mutex_unlock(&statisticsDataLock);
 
-    return result;
+    return UINT8_MAX != best ? best : STATISTICS_TIER_COUNT - 1;
 }
 
-bool getStatisticData(uint16_t index, StatisticsDataPtr dataOut)
+uint32_t getStatisticTierInterval(uint8_t tier)
 {
-    bool result = false;
+    return tier < STATISTICS_TIER_COUNT ? statisticsTiers[tier].interval : 0;
+}
 
-    if ((NULL == statisticsBuffer) || (NULL == dataOut) || (maxDataCount <= index)) {
-        return result;
+// Decodes the wanted columns of a block, the timestamps always
+static void decodeBlock(const StatisticsTier * tier, const history_block_t * block, bool open,
+                        int consolidation, const bool columns[], struct StatisticsData * points)
+{
+    int64_t values[HISTORY_BLOCK_POINTS];
+    int64_t spreads[HISTORY_BLOCK_POINTS];
+
+    history_decode(&tier->history, block, open, 0, values);
+    for (int i = 0; i < block->points; i++) {
+        points[i].timestamp = values[i];
     }
 
-    pthread_mutex_lock(&statisticsDataLock);
+    for (int field = 0; field < STATISTICS_FIELD_COUNT; field++) {
+        if (columns[field]) {
+            history_decode(&tier->history, block, open, 1 + STATISTICS_AVG * STATISTICS_FIELD_COUNT + field, values);
+            if (STATISTICS_AVG != consolidation) {
+                history_decode(&tier->history, block, open, 1 + consolidation * STATISTICS_FIELD_COUNT + field, spreads);
+            }
+            for (int i = 0; i < block->points; i++) {
+                if (STATISTICS_MIN == consolidation) {
+                    values[i] -= spreads[i];
+                } else if (STATISTICS_MAX == consolidation) {
+                    values[i] += spreads[i];
+                }
+                writeField(&points[i], field, values[i] / (double)statisticsFields[field].scale);
+            }
+        }
+    }
+}
 
-    if ((NULL != statisticsBuffer) && (index < statisticsDataSize)) {
-        *dataOut = statisticsBuffer[index];
-        result = true;
+void readStatisticData(uint8_t tierIndex, StatisticsConsolidation consolidation, const bool columns[STATISTICS_FIELD_COUNT],
+                       uint64_t since, StatisticsCallback callback, void * context)
+{
+    if (STATISTICS_TIER_COUNT <= tierIndex || NULL == callback) {
+        return;
     }
 
-    pthread_mutex_unlock(&statisticsDataLock);
+    StatisticsTier * tier = &statisticsTiers[tierIndex];
+    // the first tier has samples only, they are their own min and max
+    int stream = consolidation < tier->consolidations ? consolidation : STATISTICS_AVG;
+    struct StatisticsData * points = heap_caps_malloc(sizeof(struct StatisticsData) * HISTORY_BLOCK_POINTS, MALLOC_CAP_SPIRAM);
+    if (NULL == points) {
+        return;
+    }
 
-    return result;
+    // a block at a time, so inserts are not held up while the points go out
+    uint32_t sequence = 0;
+    bool open = false;
+    while (!open) {
+        uint16_t count = 0;
+
+        pthread_mutex_lock(&statisticsDataLock);
+
+        const history_block_t * block = NULL;
+        if (NULL != tier->history.data) {
+            block = history_get_block(&tier->history, &sequence, &open);
+
+            // whole blocks from before the window are skipped undecoded
+            if (0 != block->points && block->last_timestamp >= since) {
+                memset(points, 0, sizeof(struct StatisticsData) * block->points);
+                decodeBlock(tier, block, open, stream, columns, points);
+                count = block->points;
+            }
+            sequence++;
+        }
+
+        pthread_mutex_unlock(&statisticsDataLock);
+
+        if (NULL == block) {
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (points[i].timestamp >= since) {
+                callback(&points[i], context);
+            }
+        }
+    }
+
+    heap_caps_free(points);
 }
 
 void statistics_task(void * pvParameters)
@@ -163,8 +451,8 @@ void statistics_task(void * pvParameters)
         const uint16_t configStatsFrequency = nvs_config_get_u16(NVS_CONFIG_STATISTICS_FREQUENCY);
 
         if (0 != configStatsFrequency) {
-            // Record every second (DEFAULT_POLL_RATE is 1000ms)
-            if (currentTime >= statsData.timestamp + 1000) {
+            // Record every statsFrequency seconds (DEFAULT_POLL_RATE is 1000ms)
+            if (currentTime >= statsData.timestamp + configStatsFrequency * 1000ULL) {
                 int8_t wifiRSSI = -90;
                 get_wifi_current_rssi(&wifiRSSI);
 
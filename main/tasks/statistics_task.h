@@ -4,7 +4,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Most points handed out for a window, the tier is picked to stay below it
 #define MAX_STATISTICS_COUNT 720
+#define STATISTICS_TIER_COUNT 4
 
 typedef struct StatisticsData * StatisticsDataPtr;
 
@@ -31,7 +33,49 @@ struct StatisticsData
     float responseTime;
 };
 
-bool getStatisticData(uint16_t index, StatisticsDataPtr dataOut);
+// Columns of the history, in the order of the statistics API columns
+typedef enum
+{
+    STATISTICS_HASHRATE,
+    STATISTICS_HASHRATE_1m,
+    STATISTICS_HASHRATE_10m,
+    STATISTICS_HASHRATE_1h,
+    STATISTICS_ERROR_PERCENTAGE,
+    STATISTICS_ASIC_TEMP,
+    STATISTICS_ASIC_TEMP2,
+    STATISTICS_VR_TEMP,
+    STATISTICS_ASIC_VOLTAGE,
+    STATISTICS_VOLTAGE,
+    STATISTICS_POWER,
+    STATISTICS_CURRENT,
+    STATISTICS_FAN_SPEED,
+    STATISTICS_FAN_RPM,
+    STATISTICS_FAN2_RPM,
+    STATISTICS_WIFI_RSSI,
+    STATISTICS_FREE_HEAP,
+    STATISTICS_RESPONSE_TIME,
+    STATISTICS_FIELD_COUNT // last
+} StatisticsField;
+
+typedef enum
+{
+    STATISTICS_AVG,
+    STATISTICS_MIN,
+    STATISTICS_MAX,
+} StatisticsConsolidation;
+
+// The finest tier that covers a window of the given seconds in at most MAX_STATISTICS_COUNT points
+uint8_t getStatisticTier(uint32_t window);
+uint32_t getStatisticTierInterval(uint8_t tier);
+
+float getStatisticValue(const struct StatisticsData * data, StatisticsField field);
+
+typedef void (*StatisticsCallback)(const struct StatisticsData * data, void * context);
+
+// Hands out the points of a tier no older than since, oldest first. Only the
+// selected columns are decoded, the others are left at zero.
+void readStatisticData(uint8_t tier, StatisticsConsolidation consolidation, const bool columns[STATISTICS_FIELD_COUNT],
+                       uint64_t since, StatisticsCallback callback, void * context);
 
 void statistics_task(void * pvParameters);
 
@@ -373,6 +373,9 @@ void stratum_v1_task(void *pvParameters)
                 break;
             } else if (stratum_api_v1_message.method == STRATUM_RESULT) {
                 float response_time_ms = STRATUM_V1_get_response_time_ms(stratum_api_v1_message.message_id, receive_time_us);
+                if (response_time_ms >= 0) {
+                    latency_histogram_record(&GLOBAL_STATE->SYSTEM_MODULE.response_time_histogram, response_time_ms);
+                }
                 if (stratum_api_v1_message.response_success) {
                     ESP_LOGI(TAG, "message result accepted");
                     if (response_time_ms >= 0) {
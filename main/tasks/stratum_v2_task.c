@@ -940,6 +940,7 @@ void stratum_v2_task(void *pvParameters)
                             ESP_LOGI(TAG, "Shares accepted: %lu (%.1f ms)", accepted_count, response_time_ms);
                             GLOBAL_STATE->SYSTEM_MODULE.response_time = response_time_ms;
                             GLOBAL_STATE->SYSTEM_MODULE.response_share_batch = (uint16_t)accepted_count;
+                            latency_histogram_record(&GLOBAL_STATE->SYSTEM_MODULE.response_time_histogram, response_time_ms);
                             stratum_v2_submit_time_us[slot] = 0;
                         } else {
                             ESP_LOGI(TAG, "Shares accepted: %lu", accepted_count);
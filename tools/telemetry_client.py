@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""
+telemetry_client.py
+===================
+Follow the live telemetry feed of an ESP-Miner device, ``/api/ws/live``, as
+JSON or as the binary CBOR feed, and compare the two.
+
+The CBOR feed is negotiated with the ``axeos-telemetry-cbor`` websocket
+subprotocol. Each message is a CBOR map from field id to value; the ids are
+listed by ``GET /api/system/telemetry/schema``. Fields of type ``members``
+hold an object whose members belong to the top level, like the settings.
+
+Usage examples
+--------------
+1. Print the decoded CBOR updates with their field names:
+
+    $ python3 telemetry_client.py 192.168.1.50
+
+2. Listen to both feeds for a minute and compare their size and decode time:
+
+    $ python3 telemetry_client.py 192.168.1.50 --compare --seconds 60
+
+Needs ``requests`` and ``websocket-client``, the CBOR decoder is built in.
+"""
+from __future__ import annotations
+
+import argparse
+import json
+import struct
+import sys
+import threading
+import time
+from typing import Any, Dict, List, Tuple
+
+import requests
+import websocket
+
+SUBPROTOCOL = "axeos-telemetry-cbor"
+_ENDPOINT_SCHEMA = "/api/system/telemetry/schema"
+_ENDPOINT_WS = "/api/ws/live"
+
+_BREAK = object()
+
+
+class CBORDecoder:
+    """Decodes the subset of CBOR (RFC 8949) the firmware writes."""
+
+    def __init__(self, data: bytes):
+        self.data = data
+        self.pos = 0
+
+    def _take(self, n: int) -> bytes:
+        if self.pos + n > len(self.data):
+            raise ValueError("truncated CBOR")
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def _argument(self, info: int) -> int | None:
+        if info < 24:
+            return info
+        if info == 31:
+            return None  # indefinite length
+        size = {24: 1, 25: 2, 26: 4, 27: 8}.get(info)
+        if size is None:
+            raise ValueError(f"bad CBOR additional info {info}")
+        return int.from_bytes(self._take(size), "big")
+
+    def decode(self) -> Any:
+        initial = self._take(1)[0]
+        major, info = initial >> 5, initial & 0x1F
+
+        if major == 7:
+            if info == 20:
+                return False
+            if info == 21:
+                return True
+            if info in (22, 23):
+                return None
+            if info == 25:
+                return struct.unpack(">e", self._take(2))[0]
+            if info == 26:
+                return struct.unpack(">f", self._take(4))[0]
+            if info == 27:
+                return struct.unpack(">d", self._take(8))[0]
+            if info == 31:
+                return _BREAK
+            raise ValueError(f"unsupported CBOR simple value {info}")
+
+        length = self._argument(info)
+        if major == 0:
+            return length
+        if major == 1:
+            return -1 - length
+        if major in (2, 3):
+            if length is None:
+                raise ValueError("indefinite strings are not supported")
+            raw = self._take(length)
+            return raw if major == 2 else raw.decode("utf-8")
+        if major == 4:
+            return self._items(length, pairs=False)
+        if major == 5:
+            return dict(self._items(length, pairs=True))
+        if major == 6:
+            return self.decode()  # tags carry no meaning here
+        raise ValueError(f"unsupported CBOR major type {major}")
+
+    def _items(self, length: int | None, pairs: bool) -> List[Any]:
+        items = []
+        while length is None or len(items) < length:
+            item = self.decode()
+            if item is _BREAK:
+                if length is not None:
+                    raise ValueError("unexpected CBOR break")
+                break
+            items.append((item, self.decode()) if pairs else item)
+        return items
+
+
+def cbor_decode(data: bytes) -> Any:
+    decoder = CBORDecoder(data)
+    value = decoder.decode()
+    if decoder.pos != len(data):
+        raise ValueError("trailing bytes after CBOR item")
+    return value
+
+
+def fetch_schema(host: str) -> Dict[int, Tuple[str, str]]:
+    response = requests.get(f"http://{host}{_ENDPOINT_SCHEMA}", timeout=10)
+    response.raise_for_status()
+    return {f["id"]: (f["name"], f["type"]) for f in response.json()["fields"]}
+
+
+def name_fields(message: Dict[int, Any], schema: Dict[int, Tuple[str, str]]) -> Dict[str, Any]:
+    """Turns a decoded CBOR message into the shape of the JSON feed's data."""
+    data: Dict[str, Any] = {}
+    for field_id, value in message.items():
+        name, kind = schema.get(field_id, (f"#{field_id}", "json"))
+        if kind == "members" and isinstance(value, dict):
+            data.update(value)
+        else:
+            data[name] = value
+    return data
+
+
+def watch(host: str, seconds: float) -> None:
+    schema = fetch_schema(host)
+    ws = websocket.create_connection(f"ws://{host}{_ENDPOINT_WS}", subprotocols=[SUBPROTOCOL], timeout=10)
+    if ws.getsubprotocol() != SUBPROTOCOL:
+        sys.exit("device did not accept the CBOR subprotocol, is the firmware too old?")
+
+    end = time.monotonic() + seconds if seconds > 0 else None
+    try:
+        while end is None or time.monotonic() < end:
+            frame = ws.recv()
+            print(json.dumps(name_fields(cbor_decode(frame), schema)), flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        ws.close()
+
+
+class FeedStats:
+    def __init__(self) -> None:
+        self.messages = 0
+        self.first_bytes = 0
+        self.update_bytes = 0
+        self.decode_seconds = 0.0
+
+
+def _listen(host: str, binary: bool, seconds: float, stats: FeedStats) -> None:
+    subprotocols = [SUBPROTOCOL] if binary else None
+    ws = websocket.create_connection(f"ws://{host}{_ENDPOINT_WS}", subprotocols=subprotocols, timeout=10)
+    end = time.monotonic() + seconds
+    try:
+        while time.monotonic() < end:
+            try:
+                frame = ws.recv()
+            except websocket.WebSocketTimeoutException:
+                continue
+            start = time.perf_counter()
+            if binary:
+                cbor_decode(frame)
+            else:
+                json.loads(frame)
+            stats.decode_seconds += time.perf_counter() - start
+
+            size = len(frame if isinstance(frame, bytes) else frame.encode("utf-8"))
+            if stats.messages == 0:
+                stats.first_bytes = size
+            else:
+                stats.update_bytes += size
+            stats.messages += 1
+    finally:
+        ws.close()
+
+
+def compare(host: str, seconds: float) -> None:
+    feeds = {"json": FeedStats(), "cbor": FeedStats()}
+    threads = [
+        threading.Thread(target=_listen, args=(host, name == "cbor", seconds, stats))
+        for name, stats in feeds.items()
+    ]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    print(f"{'feed':<6}{'messages':>10}{'full state B':>14}{'update B':>12}{'B/s':>10}{'decode us':>11}")
+    for name, stats in feeds.items():
+        updates = max(stats.messages - 1, 1)
+        print(f"{name:<6}{stats.messages:>10}{stats.first_bytes:>14}{stats.update_bytes / updates:>12.0f}"
+              f"{(stats.first_bytes + stats.update_bytes) / seconds:>10.0f}"
+              f"{stats.decode_seconds / max(stats.messages, 1) * 1e6:>11.1f}")
+
+    json_stats, cbor_stats = feeds["json"], feeds["cbor"]
+    if json_stats.update_bytes and cbor_stats.update_bytes:
+        print(f"CBOR updates are {cbor_stats.update_bytes / json_stats.update_bytes:.0%} of the JSON size, "
+              f"the full state {cbor_stats.first_bytes / json_stats.first_bytes:.0%}")
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Follow and compare the ESP-Miner live telemetry feeds.")
+    parser.add_argument("host", help="IP address or hostname of the device")
+    parser.add_argument("--compare", action="store_true", help="listen to the JSON and CBOR feeds side by side")
+    parser.add_argument("--seconds", type=float, default=0, help="how long to listen, 0 for ever (30 with --compare)")
+    args = parser.parse_args()
+
+    if args.compare:
+        compare(args.host, args.seconds or 30)
+    else:
+        watch(args.host, args.seconds)
+
+
+if __name__ == "__main__":
+    main()